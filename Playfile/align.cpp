@@ -0,0 +1,340 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  align.cpp
+ Purpose     :  Depth to color alignment with a precomputed ray table
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "align.h"
+#include "alloctrack.h"
+#include "threadpool.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define ALIGN_SSE2	1
+#include <emmintrin.h>
+#else
+#define ALIGN_SSE2	0
+#endif
+
+
+namespace {
+
+const int	ALIGN_MINBANDROWS = 8;			// Shorter bands don't pay for the task switch
+
+
+// float to int truncation with cvttps2dq semantics: out of range and NaN give INT_MIN
+inline int32 Trunc (float v)
+{
+	return (v > -2147483520.f && v < 2147483520.f) ? int32(v) : INT_MIN;
+}
+
+
+bool HasProjectDistortion (const AlignIntrinsics& c)
+{
+	return c.Model == ALIGN_DISTORTION_MODIFIED_BROWN_CONRADY || c.Model == ALIGN_DISTORTION_BROWN_CONRADY;
+}
+
+
+#if ALIGN_SSE2
+
+// Projects 4 rays scaled by d and moved by t into the color image: the pixel coordinates
+// of the rs2 projection rounded the way rs2::align rounds them. Same operations as ProjectCorner()
+inline void Project4 (__m128 d, const float* rx, const float* ry, const float* rz, const float* t, const AlignIntrinsics& c, int32* px, int32* py)
+{
+	__m128 x = _mm_add_ps(_mm_mul_ps(d, _mm_loadu_ps(rx)), _mm_set1_ps(t[0]));
+	__m128 y = _mm_add_ps(_mm_mul_ps(d, _mm_loadu_ps(ry)), _mm_set1_ps(t[1]));
+	__m128 z = _mm_add_ps(_mm_mul_ps(d, _mm_loadu_ps(rz)), _mm_set1_ps(t[2]));
+	__m128 behind = _mm_cmple_ps(z, _mm_setzero_ps());		// NaN there, truncated to INT_MIN: never in the image
+	x = _mm_or_ps(_mm_div_ps(x, z), behind);
+	y = _mm_or_ps(_mm_div_ps(y, z), behind);
+
+	if (HasProjectDistortion(c)) {
+		__m128 c0 = _mm_set1_ps(c.Coeffs[0]), c1 = _mm_set1_ps(c.Coeffs[1]), c4 = _mm_set1_ps(c.Coeffs[4]);
+		__m128 c2x2 = _mm_set1_ps(2 * c.Coeffs[2]), c3x2 = _mm_set1_ps(2 * c.Coeffs[3]);
+		__m128 c2 = _mm_set1_ps(c.Coeffs[2]), c3 = _mm_set1_ps(c.Coeffs[3]), two = _mm_set1_ps(2);
+
+		__m128 r2 = _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y));
+		__m128 f  = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_set1_ps(1), _mm_mul_ps(c0, r2)), _mm_mul_ps(_mm_mul_ps(c1, r2), r2)),
+							   _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(c4, r2), r2), r2));
+		__m128 xf = _mm_mul_ps(x, f);
+		__m128 yf = _mm_mul_ps(y, f);
+		if (c.Model == ALIGN_DISTORTION_MODIFIED_BROWN_CONRADY) {
+			x = xf;			// the tangential terms use the radially distorted point
+			y = yf;
+		}
+		__m128 dx = _mm_add_ps(_mm_add_ps(xf, _mm_mul_ps(_mm_mul_ps(c2x2, x), y)), _mm_mul_ps(c3, _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, x), x))));
+		__m128 dy = _mm_add_ps(_mm_add_ps(yf, _mm_mul_ps(_mm_mul_ps(c3x2, x), y)), _mm_mul_ps(c2, _mm_add_ps(r2, _mm_mul_ps(_mm_mul_ps(two, y), y))));
+		x = dx;
+		y = dy;
+	}
+
+	__m128 half = _mm_set1_ps(0.5f);
+	__m128 u = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(c.Fx)), _mm_set1_ps(c.Ppx)), half);
+	__m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_set1_ps(c.Fy)), _mm_set1_ps(c.Ppy)), half);
+	_mm_storeu_si128 ((__m128i*)px, _mm_cvttps_epi32(u));
+	_mm_storeu_si128 ((__m128i*)py, _mm_cvttps_epi32(v));
+}
+
+#endif
+
+
+inline void CopyPixel (uint8* dst, const uint8* src, int bpp)
+{
+	switch (bpp) {
+		case 1:  *dst = *src;  break;
+		case 2:  memcpy (dst, src, 2);  break;
+		case 3:  memcpy (dst, src, 3);  break;
+		case 4:  memcpy (dst, src, 4);  break;
+		default: memcpy (dst, src, bpp);
+	}
+}
+
+}
+
+
+
+DepthAligner::DepthAligner (const AlignIntrinsics& depth, const AlignIntrinsics& color, const AlignExtrinsics& depthToColor, float depthScale, int nthreads) :
+	Depth(depth), Color(color), Extrin(depthToColor), Scale(depthScale), Ncorners(depth.Width + 1)
+{
+	// 1. Rays through the pixel corners at distance 1, deprojected as rs2 does and rotated into the color camera
+	size_t ncorners = size_t(Depth.Height + 1) * Ncorners;
+	Rx.resize(ncorners);
+	Ry.resize(ncorners);
+	Rz.resize(ncorners);
+
+	const float* c = Depth.Coeffs;
+	const float* r = Extrin.Rotation;
+	for (int j = 0; j <= Depth.Height; j++) {
+		for (int i = 0; i <= Depth.Width; i++) {
+			float x = (float(i) - 0.5f - Depth.Ppx) / Depth.Fx;
+			float y = (float(j) - 0.5f - Depth.Ppy) / Depth.Fy;
+			if (Depth.Model == ALIGN_DISTORTION_INVERSE_BROWN_CONRADY) {
+				float r2 = x*x + y*y;
+				float f  = 1 + c[0]*r2 + c[1]*r2*r2 + c[4]*r2*r2*r2;
+				float ux = x*f + 2*c[2]*x*y + c[3]*(r2 + 2*x*x);
+				float uy = y*f + 2*c[3]*x*y + c[2]*(r2 + 2*y*y);
+				x = ux;
+				y = uy;
+			}
+			else if (Depth.Model == ALIGN_DISTORTION_BROWN_CONRADY) {
+				float xo = x, yo = y;
+				for (int k = 0; k < 10; k++) {		// iterative undistortion, converges in 10 steps
+					float r2 = x*x + y*y;
+					float icdist = 1.f / (1 + ((c[4]*r2 + c[1])*r2 + c[0])*r2);
+					float dx = 2*c[2]*x*y + c[3]*(r2 + 2*x*x);
+					float dy = 2*c[3]*x*y + c[2]*(r2 + 2*y*y);
+					x = (xo - dx) * icdist;
+					y = (yo - dy) * icdist;
+				}
+			}
+			size_t k = size_t(j) * Ncorners + i;
+			Rx[k] = r[0]*x + r[3]*y + r[6];
+			Ry[k] = r[1]*x + r[4]*y + r[7];
+			Rz[k] = r[2]*x + r[5]*y + r[8];
+		}
+	}
+
+	// 2. Two bands per thread, so the odd and the even ones keep all the threads busy in turns
+	if (nthreads <= 0)
+		nthreads = THREADPOOL::Threads();
+	int nbands = MAX(1, MIN(2 * nthreads, Depth.Height / ALIGN_MINBANDROWS));
+	while (!SplitBands(nbands))
+		nbands /= 2;
+	Nthreads = nthreads;
+}
+
+
+bool DepthAligner::SplitBands (int nbands)
+{
+	Bands.resize(nbands);
+	for (int k = 0; k < nbands; k++) {
+		Band& b = Bands[k];
+		b.Row0 = int(int64(Depth.Height) * k / nbands);
+		b.Row1 = int(int64(Depth.Height) * (k + 1) / nbands);
+		b.Cx0.resize(Depth.Width);
+		b.Cy0.resize(Depth.Width);
+		b.Cx1.resize(Depth.Width);
+		b.Cy1.resize(Depth.Width);
+	}
+
+	// Color rows a band may write. The rectangles of its pixels lie within the outline its border corners
+	// project to, so the border is projected, every corner of it, at depths from the smallest to the largest
+	// one a depth unit gives, 1.1 apart. Corners behind the color camera are never written
+	std::vector<float> meters;
+	for (float d = Scale; d < 65535 * Scale; d *= 1.1f)
+		meters.push_back(d);
+	meters.push_back(65535 * Scale);
+
+	const float* t = Extrin.Translation;
+	for (int k = 0; k < nbands; k++) {
+		Band& b = Bands[k];
+		b.ColorRow0 = INT_MAX;
+		b.ColorRow1 = INT_MIN;
+		auto border = [&] (int corner) {
+			for (float d : meters) {
+				int32 px, py;
+				if (d * Rz[corner] + t[2] <= 0)
+					continue;
+				ProjectCorner (d, corner, px, py);
+				if (py == INT_MIN) {				// too far to tell which way: any row
+					b.ColorRow0 = 0;
+					b.ColorRow1 = Color.Height - 1;
+					continue;
+				}
+				py = MAX(0, MIN(py, Color.Height - 1));
+				b.ColorRow0 = MIN(b.ColorRow0, py);
+				b.ColorRow1 = MAX(b.ColorRow1, py);
+			}
+		};
+		for (int x = 0; x < Ncorners; x++) {
+			border (b.Row0 * Ncorners + x);
+			border (b.Row1 * Ncorners + x);
+		}
+		for (int y = b.Row0 + 1; y < b.Row1; y++) {
+			border (y * Ncorners);
+			border (y * Ncorners + Ncorners - 1);
+		}
+	}
+	if (nbands <= 2)
+		return true;
+
+	// Bands of one phase run together: none may write a row another one writes
+	for (int k = 0; k < nbands; k++) {
+		for (int j = k + 2; j < nbands; j += 2) {
+			if (Bands[k].ColorRow0 <= Bands[j].ColorRow1 && Bands[j].ColorRow0 <= Bands[k].ColorRow1)
+				return false;
+		}
+	}
+	return true;
+}
+
+
+void DepthAligner::ProjectCorner (float d, int corner, int32& px, int32& py) const
+{
+	const float* t = Extrin.Translation;
+	float x = d * Rx[corner] + t[0];
+	float y = d * Ry[corner] + t[1];
+	float z = d * Rz[corner] + t[2];
+	if (z <= 0) {
+		px = py = INT_MIN;					// behind the color camera
+		return;
+	}
+	x = x / z;
+	y = y / z;
+
+	if (HasProjectDistortion(Color)) {
+		const float* c = Color.Coeffs;
+		float r2 = x*x + y*y;
+		float f  = 1 + c[0]*r2 + c[1]*r2*r2 + c[4]*r2*r2*r2;
+		float xf = x * f;
+		float yf = y * f;
+		if (Color.Model == ALIGN_DISTORTION_MODIFIED_BROWN_CONRADY) {
+			x = xf;
+			y = yf;
+		}
+		float dx = xf + 2*c[2]*x*y + c[3]*(r2 + 2*x*x);
+		float dy = yf + 2*c[3]*x*y + c[2]*(r2 + 2*y*y);
+		x = dx;
+		y = dy;
+	}
+
+	px = Trunc(x * Color.Fx + Color.Ppx + 0.5f);
+	py = Trunc(y * Color.Fy + Color.Ppy + 0.5f);
+}
+
+
+void DepthAligner::ProjectRow (const uint16* z, int y, Band& b) const
+{
+	int top	   = y * Ncorners;				// top-left corner of pixel x is corner x of row y,
+	int bottom = (y + 1) * Ncorners + 1;	// bottom-right is corner x + 1 of row y + 1
+	int x	   = 0;
+
+#if ALIGN_SSE2
+	const float* t = Extrin.Translation;
+	__m128 scale = _mm_set1_ps(Scale);
+	for (; x + 4 <= Depth.Width; x += 4) {
+		__m128i zi = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)(z + x)), _mm_setzero_si128());
+		__m128  d  = _mm_mul_ps(_mm_cvtepi32_ps(zi), scale);
+		Project4 (d, &Rx[top + x],	  &Ry[top + x],	   &Rz[top + x],	t, Color, &b.Cx0[x], &b.Cy0[x]);
+		Project4 (d, &Rx[bottom + x], &Ry[bottom + x], &Rz[bottom + x], t, Color, &b.Cx1[x], &b.Cy1[x]);
+	}
+#endif
+	for (; x < Depth.Width; x++) {
+		float d = float(z[x]) * Scale;
+		ProjectCorner (d, top + x,	  b.Cx0[x], b.Cy0[x]);
+		ProjectCorner (d, bottom + x, b.Cx1[x], b.Cy1[x]);
+	}
+}
+
+
+void DepthAligner::DepthToColor (const uint16* depth, uint16* out)
+{
+	// 1. Clear the z-buffer, a share per band
+	size_t total = size_t(Color.Width) * Color.Height;
+	int    nbands = int(Bands.size());
+	RunBands (0, 1, [&] (Band& b) {
+		size_t k = &b - &Bands[0];
+		size_t from = total * k / nbands, to = total * (k + 1) / nbands;
+		memset (out + from, 0, (to - from) * sizeof(uint16));
+	});
+
+	// 2. Every depth pixel covers its color rectangle unless a nearer one is there already
+	auto scatter = [&] (Band& b) {
+		for (int y = b.Row0; y < b.Row1; y++) {
+			const uint16* z = depth + size_t(y) * Depth.Width;
+			ProjectRow (z, y, b);
+			for (int x = 0; x < Depth.Width; x++) {
+				uint16 d = z[x];
+				if (!d)
+					continue;
+				int32 x0 = b.Cx0[x], y0 = b.Cy0[x], x1 = b.Cx1[x], y1 = b.Cy1[x];
+				if (x0 < 0 || y0 < 0 || x1 >= Color.Width || y1 >= Color.Height)
+					continue;
+				for (int cy = y0; cy <= y1; cy++) {
+					uint16* o = out + size_t(cy) * Color.Width;
+					for (int cx = x0; cx <= x1; cx++)
+						o[cx] = o[cx] ? MIN(o[cx], d) : d;
+				}
+			}
+		}
+	};
+	RunBands (0, 2, scatter);
+	RunBands (1, 2, scatter);
+}
+
+
+void DepthAligner::ColorToDepth (const uint16* depth, const void* color, int bpp, void* out)
+{
+	// rs2::align copies every color pixel of the rectangle in turn, so the bottom-right one stays
+	RunBands (0, 1, [&] (Band& b) {
+		for (int y = b.Row0; y < b.Row1; y++) {
+			const uint16* z = depth + size_t(y) * Depth.Width;
+			uint8*		  o = (uint8*)out + size_t(y) * Depth.Width * bpp;
+			ProjectRow (z, y, b);
+			for (int x = 0; x < Depth.Width; x++, o += bpp) {
+				int32 x0 = b.Cx0[x], y0 = b.Cy0[x], x1 = b.Cx1[x], y1 = b.Cy1[x];
+				if (!z[x] || x0 < 0 || y0 < 0 || x1 >= Color.Width || y1 >= Color.Height || x0 > x1 || y0 > y1)
+					memset (o, 0, bpp);
+				else
+					CopyPixel (o, (const uint8*)color + (size_t(y1) * Color.Width + x1) * bpp, bpp);
+			}
+		}
+	});
+}
+
+
+void DepthAligner::RunBands (int first, int step, const std::function<void (Band&)>& job)
+{
+	int nbands = int(Bands.size());
+	if (first >= nbands)
+		return;
+
+	// The caller takes bands as well
+	ParallelJob run((nbands - first + step - 1) / step, [&] (int k) {
+		ALLOC_TAG ("align");
+		job(Bands[first + k * step]);
+	}, Nthreads);
+	run.Wait();
+}
@@ -0,0 +1,98 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  align.h
+ Purpose     :  Depth to color alignment with a precomputed ray table
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _ALIGN_H
+#define _ALIGN_H
+
+#include <functional>
+#include <vector>
+
+
+// Lens distortion models, the same values as rs2_distortion
+enum AlignDistortion
+{
+	ALIGN_DISTORTION_NONE,
+	ALIGN_DISTORTION_MODIFIED_BROWN_CONRADY,
+	ALIGN_DISTORTION_INVERSE_BROWN_CONRADY,
+	ALIGN_DISTORTION_FTHETA,
+	ALIGN_DISTORTION_BROWN_CONRADY
+};
+
+
+// Pinhole camera model, the same layout as rs2_intrinsics
+struct AlignIntrinsics
+{
+	int				Width, Height;
+	float			Ppx, Ppy;												// Principal point, pixels
+	float			Fx, Fy;													// Focal length, pixels
+	AlignDistortion	Model;
+	float			Coeffs [5];
+};
+
+
+// Rigid transform between two cameras, the same layout as rs2_extrinsics
+struct AlignExtrinsics
+{
+	float			Rotation [9];											// Column-major 3x3
+	float			Translation [3];										// Meters
+};
+
+
+/*
+ ******************************************************************************
+  Maps a depth image into the color viewport or a color image into the depth
+  viewport, producing the same images as rs2::align. Every depth pixel covers
+  the color rectangle between its projected corners.
+  The corner rays of the depth camera, already rotated into the color camera,
+  are computed once, so a corner costs a multiply-add per coordinate and one
+  projection; both run 4 pixels at a time with SSE2. Occlusions are resolved
+  with a z-buffer: the nearest depth wins. The rows are split into bands run
+  on the thread pool; bands writing to neighbouring color rows run in turns.
+  Depth and color projection support the distortion models of RealSense
+  cameras: inverse Brown-Conrady / Brown-Conrady for the depth camera,
+  (modified) Brown-Conrady for the color camera; the others are ignored.
+  Images are tightly packed (stride = width * bytes per pixel).
+ ******************************************************************************
+*/
+class DepthAligner
+{
+  public:
+	// depthScale - meters per depth unit; nthreads <= 0 - all the pool's
+	DepthAligner (const AlignIntrinsics& depth, const AlignIntrinsics& color, const AlignExtrinsics& depthToColor, float depthScale, int nthreads = 0);
+
+	void	DepthToColor (const uint16* depth, uint16* out);				// out is color Width * Height: depth of every color pixel, 0 where unknown
+	void	ColorToDepth (const uint16* depth, const void* color, int bpp, void* out);	// out is depth Width * Height * bpp: color of every depth pixel, 0 where unknown
+
+	const AlignIntrinsics&  DepthIntrinsics () const	{ return Depth; }
+	const AlignIntrinsics&  ColorIntrinsics () const	{ return Color; }
+
+  private:
+	struct Band
+	{
+		int						Row0, Row1;									// Depth rows [Row0, Row1)
+		int						ColorRow0, ColorRow1;						// Color rows the band may write, [ColorRow0, ColorRow1]
+		std::vector<int32>		Cx0, Cy0, Cx1, Cy1;							// Color rectangles of the pixels of one depth row, corners included
+	};
+
+	void	ProjectRow (const uint16* z, int y, Band& b) const;				// Color rectangles of the depth pixels of row y
+	void	ProjectCorner (float d, int corner, int32& px, int32& py) const;
+	bool	SplitBands (int nbands);										// False if the bands two apart may write to the same color rows
+	void	RunBands (int first, int step, const std::function<void (Band&)>& job);	// Runs job on bands first, first + step, ... in parallel
+
+  private:
+	AlignIntrinsics				Depth, Color;
+	AlignExtrinsics				Extrin;
+	float						Scale;
+	int							Ncorners;									// Corners per row, Depth.Width + 1
+	std::vector<float>			Rx, Ry, Rz;									// Corner rays in the color camera, (Depth.Height + 1) * Ncorners
+	std::vector<Band>			Bands;
+	int							Nthreads;									// Threads running the bands of a job, the caller's included
+};
+
+
+#endif // _ALIGN_H
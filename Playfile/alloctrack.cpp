@@ -0,0 +1,472 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  alloctrack.cpp
+ Purpose     :  Allocation accounting and steady state allocation finder
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#define ALLOCTRACK_NOHOOK		// the real malloc & co. here
+#include "def.h"
+#include "alloctrack.h"
+
+#if UTILS_ALLOCTRACK
+
+#include <atomic>
+#include <new>
+#include <thread>
+
+#if PLATFORM == PLATFORM_WIN
+#include <windows.h>
+#include <dbghelp.h>
+#include <intrin.h>
+#pragma comment(lib, "dbghelp.lib")
+#else
+#include <dlfcn.h>
+#endif
+
+#if PLATCOMPL == PLATCOMPL_MS
+#define ALLOC_CALLER()		_ReturnAddress()
+#define ALLOC_NOINLINE		__declspec(noinline)
+#else
+#define ALLOC_CALLER()		__builtin_return_address(0)
+#define ALLOC_NOINLINE		__attribute__((noinline))
+#endif
+
+
+namespace {
+
+enum
+{
+	MAXTAGS		= 32,
+	MAXSITES	= 4096,													// Steady state call sites, power of 2
+	LIVECAP		= UTILS_ALLOCTRACK_MAXLIVE								// Live allocations, power of 2
+};
+
+struct TagStats
+{
+	cchar*		Name;
+	uint64		Allocs, Frees, Bytes;
+	size_t		Live, Peak;
+	uint64		SteadyAllocs, SteadyBytes;
+};
+
+struct Site
+{
+	cchar*		File;													// nullptr - Addr is the site
+	int			Line;
+	void*		Addr;
+	int			Tag;
+	uint64		Count, Bytes;
+	int64		First, Last;											// Frames
+};
+
+struct LiveEntry
+{
+	void*		P;
+	size_t		Size;
+	int			Tag;
+};
+
+// All zero-initialized: allocations come before any constructor has run
+std::atomic_flag		Lock = ATOMIC_FLAG_INIT;
+std::atomic<int64>		FrameCount;
+TagStats				Tags  [MAXTAGS];								// 0 - untagged, also all the tags beyond MAXTAGS
+TagStats				Total;
+Site					Sites [MAXSITES];
+int						Nsites;
+uint64					SitesLost;										// Steady state allocations at sites beyond MAXSITES
+LiveEntry				Live [LIVECAP];
+size_t					Nlive;
+uint64					Untracked;										// Allocations the live table had no room for
+thread_local cchar*		ThisTag;
+thread_local bool		InHook;											// The tracker itself allocating
+
+static_assert ((LIVECAP & (LIVECAP - 1)) == 0 && (MAXSITES & (MAXSITES - 1)) == 0, "the tables must be powers of 2");
+
+
+struct Locker
+{
+	Locker ()			{ while (Lock.test_and_set(std::memory_order_acquire)) std::this_thread::yield(); }
+	~Locker ()			{ Lock.clear(std::memory_order_release); }
+};
+
+
+size_t HashPtr (const void* p)
+{
+	uint64 h = uint64(size_t(p) >> 4) * 0x9E3779B97F4A7C15ull;
+	return size_t(h >> 40);
+}
+
+
+int TagIndex (cchar* name)
+{
+	if (!name)
+		return 0;
+	for (int i = 1; i < MAXTAGS; i++) {
+		if (!Tags[i].Name) {
+			Tags[i].Name = name;
+			return i;
+		}
+		if (Tags[i].Name == name || !strcmp(Tags[i].Name, name))
+			return i;
+	}
+	return 0;
+}
+
+
+void Count (TagStats& s, size_t n, bool steady)
+{
+	s.Allocs++;
+	s.Bytes += n;
+	s.Live  += n;
+	s.Peak   = MAX(s.Peak, s.Live);
+	if (steady) {
+		s.SteadyAllocs++;
+		s.SteadyBytes += n;
+	}
+}
+
+
+void Uncount (TagStats& s, size_t n)
+{
+	s.Frees++;
+	s.Live -= MIN(s.Live, n);
+}
+
+
+// Linear probing without tombstones: a removed entry is refilled by the following ones that may move back
+void LiveRemove (size_t i)
+{
+	for (size_t j = i;;) {
+		j = (j + 1) & (LIVECAP - 1);
+		if (!Live[j].P)
+			break;
+		size_t h = HashPtr(Live[j].P) & (LIVECAP - 1);
+		if (i <= j ? (i < h && h <= j) : (i < h || h <= j))
+			continue;
+		Live[i] = Live[j];
+		i = j;
+	}
+	Live[i].P = nullptr;
+	Nlive--;
+}
+
+
+// Removes p from the live table and uncounts it; false if p isn't there
+bool Forget (void* p)
+{
+	for (size_t i = HashPtr(p) & (LIVECAP - 1); Live[i].P; i = (i + 1) & (LIVECAP - 1)) {
+		if (Live[i].P == p) {
+			Uncount (Total, Live[i].Size);
+			Uncount (Tags[Live[i].Tag], Live[i].Size);
+			LiveRemove (i);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void RecordSite (cchar* file, int line, void* addr, int tag, size_t n, int64 frame)
+{
+	if (file)
+		addr = nullptr;
+	size_t h = (HashPtr(file ? (void*)file : addr) ^ size_t(line) * 31) & (MAXSITES - 1);
+	for (int k = 0; k < MAXSITES; k++, h = (h + 1) & (MAXSITES - 1)) {
+		Site& s = Sites[h];
+		if (!s.Count) {
+			if (Nsites >= MAXSITES / 2)
+				break;
+			Nsites++;
+			s.File	= file;
+			s.Line	= line;
+			s.Addr	= addr;
+			s.Tag	= tag;
+			s.First = frame;
+		}
+		else if (s.File != file || s.Line != line || s.Addr != addr)
+			continue;
+		s.Count++;
+		s.Bytes += n;
+		s.Last	 = frame;
+		return;
+	}
+	SitesLost++;
+}
+
+
+void Record (void* p, size_t n, cchar* file, int line, void* addr)
+{
+	if (!p || InHook)
+		return;
+	int64 frame  = FrameCount.load(std::memory_order_relaxed);
+	bool  steady = frame > UTILS_ALLOCTRACK_WARMUP;
+
+	Locker lock;
+	Forget (p);			// a block freed where the hooks don't reach
+	int tag = TagIndex(ThisTag);
+	Count (Total, n, steady);
+	Count (Tags[tag], n, steady);
+	if (steady)
+		RecordSite (file, line, addr, tag, n, frame);
+
+	if (Nlive >= LIVECAP / 8 * 7) {
+		Untracked++;
+		return;
+	}
+	size_t i = HashPtr(p) & (LIVECAP - 1);
+	while (Live[i].P)
+		i = (i + 1) & (LIVECAP - 1);
+	Live[i].P	 = p;
+	Live[i].Size = n;
+	Live[i].Tag	 = tag;
+	Nlive++;
+}
+
+
+void Unrecord (void* p)
+{
+	if (!p || InHook)
+		return;
+	Locker lock;
+	Forget (p);
+}
+
+
+void* Allocate (size_t n, void* caller)
+{
+	void* p = malloc(n ? n : 1);
+	Record (p, n, nullptr, 0, caller);
+	return p;
+}
+
+
+// Function and file:line of a call site, or the module and the offset for addr2line
+void PrintSite (const Site& s)
+{
+	if (s.File) {
+		printf ("%s:%d", s.File, s.Line);
+		return;
+	}
+#if PLATFORM == PLATFORM_WIN
+	static bool init = false;
+	HANDLE proc = GetCurrentProcess();
+	if (!init) {
+		SymSetOptions (SYMOPT_LOAD_LINES | SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+		init = SymInitialize(proc, nullptr, TRUE) != FALSE;
+	}
+	char			 buf [sizeof(SYMBOL_INFO) + 256];
+	SYMBOL_INFO*	 si = (SYMBOL_INFO*)buf;
+	DWORD64			 disp;
+	DWORD			 linedisp;
+	IMAGEHLP_LINE64	 line;
+	si->SizeOfStruct = sizeof(SYMBOL_INFO);
+	si->MaxNameLen	 = 255;
+	line.SizeOfStruct = sizeof(line);
+	if (init && SymFromAddr(proc, DWORD64(s.Addr), &disp, si))
+		printf ("%s", si->Name);
+	else
+		printf ("%p", s.Addr);
+	if (init && SymGetLineFromAddr64(proc, DWORD64(s.Addr), &linedisp, &line))
+		printf (" %s:%lu", line.FileName, line.LineNumber);
+#else
+	Dl_info info;
+	if (dladdr(s.Addr, &info) && info.dli_fname) {
+		if (info.dli_sname)
+			printf ("%s+0x%zx ", info.dli_sname, size_t((char*)s.Addr - (char*)info.dli_saddr));
+		printf ("(%s+0x%zx)", info.dli_fname, size_t((char*)s.Addr - (char*)info.dli_fbase));
+	}
+	else
+		printf ("%p", s.Addr);
+#endif
+}
+
+
+int CompareSites (const void* a, const void* b)
+{
+	uint64 ca = ((const Site*)a)->Count, cb = ((const Site*)b)->Count;
+	return ca > cb ? -1 : ca < cb;
+}
+
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									ALLOCTRACK
+\*--------------------------------------------------------------------------------------*/
+
+void ALLOCTRACK::Frame ()
+{
+	FrameCount.fetch_add (1, std::memory_order_relaxed);
+}
+
+
+int64 ALLOCTRACK::Frames ()
+{
+	return FrameCount.load(std::memory_order_relaxed);
+}
+
+
+bool ALLOCTRACK::Steady ()
+{
+	return Frames() > UTILS_ALLOCTRACK_WARMUP;
+}
+
+
+cchar* ALLOCTRACK::SetTag (cchar* tag)
+{
+	cchar* prev = ThisTag;
+	ThisTag = tag;
+	return prev;
+}
+
+
+ALLOCTRACK::Stats ALLOCTRACK::GetStats (cchar* tag)
+{
+	Locker lock;
+	TagStats* t = &Total;
+	if (tag) {
+		t = nullptr;
+		for (int i = 1; i < MAXTAGS && Tags[i].Name && !t; i++)
+			if (!strcmp(Tags[i].Name, tag))
+				t = &Tags[i];
+	}
+	Stats s = {};
+	if (t) {
+		s.Allocs	   = t->Allocs;
+		s.Frees		   = t->Frees;
+		s.Bytes		   = t->Bytes;
+		s.Live		   = t->Live;
+		s.Peak		   = t->Peak;
+		s.SteadyAllocs = t->SteadyAllocs;
+		s.SteadyBytes  = t->SteadyBytes;
+	}
+	return s;
+}
+
+
+void ALLOCTRACK::Report ()
+{
+	// A copy to print from without the lock: printing may allocate
+	static Site		sites [MAXSITES];
+	static TagStats	tags  [MAXTAGS];
+	TagStats		total;
+	int				nsites = 0;
+	uint64			lost, untracked;
+	int64			frames = Frames();
+	InHook = true;
+	{
+		Locker lock;
+		total = Total;
+		memcpy (tags, Tags, sizeof(tags));
+		for (auto& s : Sites)
+			if (s.Count)
+				sites[nsites++] = s;
+		lost	  = SitesLost;
+		untracked = Untracked;
+	}
+
+	printf ("Allocations: %llu (%.1f MB), %llu freed, live %.1f MB, peak %.1f MB\n",
+			total.Allocs, total.Bytes / 1048576., total.Frees, total.Live / 1048576., total.Peak / 1048576.);
+	if (untracked)
+		printf ("  %llu allocations not tracked, the live table is full (UTILS_ALLOCTRACK_MAXLIVE)\n", untracked);
+	printf ("  %-16s %10s %10s %10s %10s %10s\n", "tag", "allocs", "MB", "live MB", "peak MB", "steady");
+	for (int i = 0; i < MAXTAGS; i++) {
+		const TagStats& t = tags[i];
+		if (t.Allocs)
+			printf ("  %-16s %10llu %10.1f %10.2f %10.2f %10llu\n", i ? t.Name : "-", t.Allocs, t.Bytes / 1048576., t.Live / 1048576., t.Peak / 1048576., t.SteadyAllocs);
+	}
+
+	int64 nsteady = frames - UTILS_ALLOCTRACK_WARMUP;
+	if (nsteady <= 0)
+		printf ("Steady state not reached: %lld frames of %d warm up\n", frames, UTILS_ALLOCTRACK_WARMUP);
+	else if (!nsites)
+		printf ("Steady state, %lld frames: no allocations\n", nsteady);
+	else {
+		printf ("Steady state, %lld frames: %llu allocations (%.1f KB) at %d sites, %.1f per frame\n",
+				nsteady, total.SteadyAllocs, total.SteadyBytes / 1024., nsites, double(total.SteadyAllocs) / nsteady);
+		if (lost)
+			printf ("  %llu allocations at sites beyond %d\n", lost, MAXSITES / 2);
+		qsort (sites, nsites, sizeof(Site), CompareSites);
+		printf ("  %10s %10s %12s  %-12s site\n", "count", "per frame", "bytes", "tag");
+		for (int i = 0; i < nsites; i++) {
+			const Site& s = sites[i];
+			printf ("  %10llu %10.2f %12llu  %-12s ", s.Count, double(s.Count) / nsteady, s.Bytes, s.Tag ? tags[s.Tag].Name : "-");
+			PrintSite (s);
+			printf ("\n");
+		}
+	}
+	InHook = false;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									Hooks
+\*--------------------------------------------------------------------------------------*/
+
+ALLOC_NOINLINE void* AllocTrackMalloc (size_t n, cchar* file, int line)
+{
+	void* p = malloc(n);
+	Record (p, n, file, line, file ? nullptr : ALLOC_CALLER());
+	return p;
+}
+
+
+ALLOC_NOINLINE void* AllocTrackCalloc (size_t n, size_t size, cchar* file, int line)
+{
+	void* p = calloc(n, size);
+	Record (p, n * size, file, line, file ? nullptr : ALLOC_CALLER());
+	return p;
+}
+
+
+ALLOC_NOINLINE void* AllocTrackRealloc (void* p, size_t n, cchar* file, int line)
+{
+	Unrecord (p);		// before, p may be gone after realloc(); if realloc() fails, the block stays untracked
+	void* q = realloc(p, n);
+	Record (q, n, file, line, file ? nullptr : ALLOC_CALLER());
+	return q;
+}
+
+
+void AllocTrackFree (void* p)
+{
+	Unrecord (p);
+	free (p);
+}
+
+
+// The global operator new / delete, the whole program's C++ allocations
+ALLOC_NOINLINE void* operator new (size_t n)
+{
+	void* p = Allocate(n, ALLOC_CALLER());
+	if (!p)
+		throw std::bad_alloc ();
+	return p;
+}
+
+
+ALLOC_NOINLINE void* operator new[] (size_t n)
+{
+	void* p = Allocate(n, ALLOC_CALLER());
+	if (!p)
+		throw std::bad_alloc ();
+	return p;
+}
+
+
+ALLOC_NOINLINE void* operator new (size_t n, const std::nothrow_t&) noexcept		{ return Allocate (n, ALLOC_CALLER()); }
+ALLOC_NOINLINE void* operator new[] (size_t n, const std::nothrow_t&) noexcept	{ return Allocate (n, ALLOC_CALLER()); }
+
+void operator delete (void* p) noexcept									{ AllocTrackFree (p); }
+void operator delete[] (void* p) noexcept								{ AllocTrackFree (p); }
+void operator delete (void* p, size_t) noexcept							{ AllocTrackFree (p); }
+void operator delete[] (void* p, size_t) noexcept						{ AllocTrackFree (p); }
+void operator delete (void* p, const std::nothrow_t&) noexcept			{ AllocTrackFree (p); }
+void operator delete[] (void* p, const std::nothrow_t&) noexcept		{ AllocTrackFree (p); }
+
+
+#endif // UTILS_ALLOCTRACK
@@ -0,0 +1,118 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  alloctrack.h
+ Purpose     :  Allocation accounting and steady state allocation finder
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  Off unless built with UTILS_ALLOCTRACK = 1. Then def.h
+				redefines malloc, calloc, realloc and free of every module
+				including it, and alloctrack.cpp replaces the global
+				operator new / delete. A module including an SDK header
+				with members of these names (ZED's sl::Mat::free) after
+				def.h and calling them defines ALLOCTRACK_NOHOOK before
+				def.h.
+\**********************************************************************/
+
+#ifndef _ALLOCTRACK_H
+#define _ALLOCTRACK_H
+
+#include <stddef.h>
+
+
+/*
+ * Attributes allocations in the rest of the enclosing scope (of the calling thread) to
+ * subsystem "name", a literal. Compiled out with UTILS_ALLOCTRACK = 0.
+ */
+#define ALLOC_TAG(name)				AllocTag  ALLOC_TAG_VAR(__LINE__) (name)
+#define ALLOC_TAG_VAR(line)			ALLOC_TAG_VAR2(line)
+#define ALLOC_TAG_VAR2(line)		_alloctag##line
+
+
+#if UTILS_ALLOCTRACK
+
+/*
+ ***************************************************************************
+ Counts every allocation and release with its bytes, per subsystem tag and
+ in total, with the peak of live bytes. The frame path calls Frame() once a
+ frame; after UTILS_ALLOCTRACK_WARMUP frames the player is in steady state,
+ where it is not supposed to allocate any more (FRAMEPOOL, FrameBuf, cached
+ cv::Mat): the allocations still made are recorded by call site, file and
+ line for malloc & co., the return address for new, and Report() lists
+ them with their number per frame.
+ ***************************************************************************
+*/
+class ALLOCTRACK
+{
+  public:
+	struct Stats
+	{
+		uint64		Allocs, Frees;
+		uint64		Bytes;												// Allocated in all
+		size_t		Live, Peak;											// Bytes allocated and not freed yet
+		uint64		SteadyAllocs, SteadyBytes;							// Allocated in steady state
+	};
+
+	static void		Frame ();											// The frame path got a new frame
+	static int64	Frames ();
+	static bool		Steady ();											// The warm up frames are over
+	static Stats	GetStats (cchar* tag = nullptr);					// All the allocations or one tag's
+	static void		Report ();											// Prints the totals, the tags and the steady state call sites
+
+	static cchar*	SetTag (cchar* tag);								// Tag of the calling thread, returns the previous one
+};
+
+
+class AllocTag
+{
+  public:
+	AllocTag (cchar* name) : Prev(ALLOCTRACK::SetTag(name))	{}
+	~AllocTag ()									{ ALLOCTRACK::SetTag(Prev); }
+
+  private:
+	cchar*	Prev;
+};
+
+
+// The hooks def.h maps malloc & co. to; file nullptr records the caller's address instead of file and line
+void*	AllocTrackMalloc  (size_t n, cchar* file, int line);
+void*	AllocTrackCalloc  (size_t n, size_t size, cchar* file, int line);
+void*	AllocTrackRealloc (void* p, size_t n, cchar* file, int line);
+void	AllocTrackFree    (void* p);
+
+#include <cstdlib>		// before the macros: libstdc++'s <cstdlib> #undef-s malloc & co.
+namespace std {
+	using ::AllocTrackMalloc;	using ::AllocTrackCalloc;	using ::AllocTrackRealloc;	using ::AllocTrackFree;		// std::malloc(n) ...
+}
+
+#else
+
+class ALLOCTRACK
+{
+  public:
+	struct Stats
+	{
+		uint64		Allocs, Frees;
+		uint64		Bytes;
+		size_t		Live, Peak;
+		uint64		SteadyAllocs, SteadyBytes;
+	};
+
+	static void		Frame ()						{}
+	static int64	Frames ()						{ return 0; }
+	static bool		Steady ()						{ return false; }
+	static Stats	GetStats (cchar* tag = nullptr)	{ Stats s = {}; return s; }
+	static void		Report ()						{}
+	static cchar*	SetTag (cchar* tag)				{ return nullptr; }
+};
+
+
+class AllocTag
+{
+  public:
+	AllocTag (cchar* name)							{}
+};
+
+#endif // UTILS_ALLOCTRACK
+
+
+#endif // _ALLOCTRACK_H
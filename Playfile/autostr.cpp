@@ -0,0 +1,45 @@
+/******************************************************************************\
+ Library     :  Utils / Common
+ Filename    :  autostr.cpp
+ Purpose     :  Global string allocator for prints/debug purpose
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  Every thread has its own cyclic buffer of AUTOSTR_MAXSTRS strings,
+				allocated on the first autostrGet() call of the thread and freed
+				when the thread exits. No locks, no shared state.
+\******************************************************************************/
+
+#include "def.h"
+#include "autostr.h"
+
+
+namespace {
+
+struct AutostrRing
+{
+	char*		Buf;
+	unsigned	Next;
+
+	AutostrRing () : Buf(nullptr), Next(0)	{}
+	~AutostrRing ()							{ free(Buf); }
+};
+
+thread_local AutostrRing  Ring;
+
+}
+
+
+char* autostrGet ()
+{
+	AutostrRing& r = Ring;
+	if (!r.Buf) {
+		r.Buf = (char*) malloc (AUTOSTR_MAXSTRS * AUTOSTR_MAXLEN);
+		LOW_ASSERT (r.Buf);
+	}
+
+	char* s = r.Buf + r.Next * AUTOSTR_MAXLEN;
+	if (++r.Next == AUTOSTR_MAXSTRS)
+		r.Next = 0;
+	s[0] = '\0';
+	return s;
+}
@@ -5,7 +5,9 @@
  Author      :  (c) RedSoft, Sergey Krasnitsky
  Created     :  3.9.2009
  Note		 :  See also AUTOSTR & STRING classes in str.h
- Important	 :  FOR LOGGING/DEBUG USAGE ONLY! NOT MULTITHREAD PROTECTED 
+ Important	 :  FOR LOGGING/DEBUG USAGE ONLY! The cyclic buffer is per thread
+				(see autostr.cpp): a string stays valid until its thread makes
+				AUTOSTR_MAXSTRS more calls or exits.
 \******************************************************************************/
 
 #ifndef _AUTOSTR_H
@@ -0,0 +1,2107 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  bench.cpp
+ Purpose     :  Built-in benchmarks, run by "playfile -bench=<name>"
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "str.h"
+#include "bench.h"
+#include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "align.h"
+#include "pixconv.h"
+#include "depth.h"
+#include "resize.h"
+#include "framepool.h"
+#include "alloctrack.h"
+#include "frameexec.h"
+#include "threadpool.h"
+#include "frameshm.h"
+#include "framenet.h"
+
+#include <opencv2/opencv.hpp>
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+/*--------------------------------------------------------------------------------------*\
+									Helpers
+\*--------------------------------------------------------------------------------------*/
+
+// Thread counts to measure scaling: 1, 2, 4, ... up to the number of cores
+static std::vector<int> BenchThreadCounts ()
+{
+	int ncores = MAX(1, int(std::thread::hardware_concurrency()));
+	std::vector<int> counts;
+	for (int n = 1; n < ncores; n *= 2)
+		counts.push_back(n);
+	counts.push_back(ncores);
+	return counts;
+}
+
+
+// Runs body(thread index) on nthreads threads started together, returns the wall time in seconds
+template <class Body> static double BenchParallel (int nthreads, Body body)
+{
+	std::atomic<int>			ready(0);
+	std::atomic<bool>			go(false);
+	std::vector<std::thread>	threads;
+
+	for (int t = 0; t < nthreads; t++) {
+		threads.emplace_back([&, t] {
+			ready++;
+			while (!go)
+				std::this_thread::yield();
+			body(t);
+		});
+	}
+	while (ready < nthreads)
+		std::this_thread::yield();
+
+	BenchTimer timer;
+	go = true;
+	for (auto& th : threads)
+		th.join();
+	return timer.Seconds();
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									autostr
+\*--------------------------------------------------------------------------------------*/
+
+// The former single cyclic buffer, made thread safe the obvious way, for comparison
+static char*  LockedAutostrGet ()
+{
+	static char			buf [AUTOSTR_MAXSTRS][AUTOSTR_MAXLEN];
+	static unsigned		next;
+	static std::mutex	mtx;
+
+	std::lock_guard<std::mutex> lock(mtx);
+	char* s = buf[next];
+	if (++next == AUTOSTR_MAXSTRS)
+		next = 0;
+	return s;
+}
+
+
+// Every thread formats numbers into autostr strings and checks that strings it got
+// a while ago were not overwritten by other threads
+template <char* (*Get)()> static bool BenchAutostrRun (int nthreads, int64 iterations, double* seconds)
+{
+	enum { KEEP = 16 };		// Strings kept alive by each thread, must be < AUTOSTR_MAXSTRS
+	std::atomic<int64> errors(0);
+
+	*seconds = BenchParallel (nthreads, [&] (int t) {
+		char*	kept [KEEP];
+		char	keptcopy [KEEP][STRB::UINT64_MAX_LEN];
+		int64	nerr = 0;
+
+		for (int64 i = 0; i < iterations; i++) {
+			char* s = Get();
+			int len = STRB::lltoa ((int64(t) << 40) + i, s);
+
+			int k = int(i % KEEP);
+			if (i >= KEEP && strcmp(kept[k], keptcopy[k]) != 0)
+				nerr++;
+			kept[k] = s;
+			memcpy (keptcopy[k], s, len + 1);
+		}
+		errors += nerr;
+	});
+
+	return errors == 0;
+}
+
+
+static int  BenchAutostr ()
+{
+	const int64 iterations = 1000000;
+
+	printf ("autostrGet: %lld strings per thread, ring of %d strings per thread\n\n", iterations, int(AUTOSTR_MAXSTRS));
+	printf ("%8s  %16s  %16s  %16s\n", "threads", "per-thread Mops", "locked Mops", "speedup");
+
+	bool ok = true;
+	for (int n : BenchThreadCounts()) {
+		double t1, t2;
+		bool ok1 = BenchAutostrRun<autostrGet>		 (n, iterations, &t1);
+		bool ok2 = BenchAutostrRun<LockedAutostrGet> (n, iterations, &t2);
+		double mops1 = n * iterations / t1 / 1e6;
+		double mops2 = n * iterations / t2 / 1e6;
+		printf ("%8d  %16.2f  %16.2f  %15.2fx%s%s\n", n, mops1, mops2, mops1 / mops2,
+				ok1 ? "" : "  per-thread ring CORRUPTED", ok2 ? "" : "  locked ring overrun");
+		ok = ok && ok1;		// a shared ring is overrun by design once enough threads keep strings
+	}
+	return ok ? 0 : 1;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									strfmt
+\*--------------------------------------------------------------------------------------*/
+
+static volatile int64 BenchSink;		// Keeps the measured calls from being optimized out
+
+
+// Values spread over all magnitudes, with exact ties and signed zeros among them
+static double BenchRandomDouble (std::mt19937_64& rng)
+{
+	double mag = pow(10., int(rng() % 24) - 12);
+	switch (rng() % 8) {
+		case 0:		return (int64(rng() % 200001) - 100000) / 8.;				// ties at every precision
+		case 1:		return (rng() & 1) ? -0. : 0.;
+		case 2:		return (int64(rng() % 2000001) - 1000000) / 1000.;			// typical measurements
+		default:	return (double(rng() >> 11) / 9007199254740992. * 2 - 1) * mag;
+	}
+}
+
+
+static int64 BenchRandomInt (std::mt19937_64& rng)
+{
+	int64 v = int64(rng());
+	return (rng() & 1) ? v : v >> (rng() % 64);
+}
+
+
+static int BenchVsprintf (char* out, cchar* fmt, ...)
+{
+	va_list args;
+	va_start (args, fmt);
+	int ret = vsprintf (out, fmt, args);
+	va_end (args);
+	return ret;
+}
+
+
+static int BenchCompare (cchar* what, cchar* fmt, cchar* fast, cchar* ref, int* nshown)
+{
+	if (strcmp(fast, ref) == 0)
+		return 0;
+	if ((*nshown)++ < 10)
+		printf ("  MISMATCH %s \"%s\": \"%s\" vs sprintf \"%s\"\n", what, fmt, fast, ref);
+	return 1;
+}
+
+
+static int  BenchStrfmt ()
+{
+	static cchar* const intFmts[]	= { "%d", "%5d", "%-6d|", "%05d", "%+d", "% d", "%.3d", "%.0d", "%08.3d", "%x", "%X", "%08X", "[%u]", "%i" };
+	static cchar* const llFmts[]	= { "%lld", "%llu", "%20lld", "%-20lld|", "%+lld", "%llx", "0x%llX" };
+	static cchar* const floatFmts[]	= { "%f", "%lf", "%.0f", "%.1f", "%.2f", "%.3f", "%10.4f", "%-12.5f|", "%+.2f", "% .1f", "%012.3f", "%.9f", "%.6f mm", "%.12f", "%g" };
+	const int nvalues = 200000;
+
+	std::mt19937_64 rng(12345);
+	std::vector<int64>  ints(nvalues);
+	std::vector<double> doubles(nvalues);
+	for (int i = 0; i < nvalues; i++) {
+		ints[i] = BenchRandomInt(rng);
+		doubles[i] = BenchRandomDouble(rng);
+	}
+
+	// Byte compatibility with sprintf
+	char	fast[128], ref[128];
+	int64	nchecked = 0, nmismatch = 0;
+	int		nshown = 0;
+	for (int i = 0; i < nvalues; i++) {
+		for (cchar* fmt : intFmts) {
+			STRB::itoa (int(ints[i]), fast, fmt);
+			sprintf (ref, fmt, int(ints[i]));
+			nmismatch += BenchCompare ("itoa", fmt, fast, ref, &nshown);
+		}
+		for (cchar* fmt : llFmts) {
+			STRB::lltoa (ints[i], fast, fmt);
+			sprintf (ref, fmt, ints[i]);
+			nmismatch += BenchCompare ("lltoa", fmt, fast, ref, &nshown);
+		}
+		for (cchar* fmt : floatFmts) {
+			STRB::ftoa (doubles[i], fast, fmt);
+			sprintf (ref, fmt, doubles[i]);
+			nmismatch += BenchCompare ("ftoa", fmt, fast, ref, &nshown);
+		}
+		cchar* mixed = "[%3d:%-4u] D = %6.2f %s%c %08llX%%";
+		AUTOSTR s;
+		s.Print (mixed, int(ints[i]), unsigned(ints[i] >> 7), doubles[i], "mm", '!', ints[i]);
+		BenchVsprintf (ref, mixed, int(ints[i]), unsigned(ints[i] >> 7), doubles[i], "mm", '!', ints[i]);
+		nmismatch += BenchCompare ("Print", mixed, s, ref, &nshown);
+
+		// Shortest round trip: must read back exactly and be no longer than the shortest %g which does
+		STRB::ftoa_short (doubles[i], fast);
+		int glen = 0;
+		for (int prec = 1; prec <= 17; prec++) {
+			glen = sprintf (ref, "%.*g", prec, doubles[i]);
+			if (strtod(ref, nullptr) == doubles[i])
+				break;
+		}
+		int flen = int(strlen(fast));
+		bool ok = strtod(fast, nullptr) == doubles[i] && (flen <= glen || strchr(ref, 'e'));
+		nmismatch += BenchCompare ("ftoa_short", "round trip", fast, ok ? fast : ref, &nshown);
+		nchecked += sizeof(intFmts) / sizeof(*intFmts) + sizeof(llFmts) / sizeof(*llFmts) + sizeof(floatFmts) / sizeof(*floatFmts) + 2;
+	}
+	printf ("strfmt: %lld conversions checked against sprintf, %lld mismatches\n\n", nchecked, nmismatch);
+
+	// Speed
+	printf ("%-28s  %12s  %12s  %8s\n", "conversion", "STRB ns", "sprintf ns", "speedup");
+	auto row = [&] (cchar* name, auto fastCall, auto refCall) {
+		int64 sink = 0;
+		BenchTimer timer;
+		for (int i = 0; i < nvalues; i++)
+			sink += fastCall(i);
+		double tfast = timer.Seconds();
+		timer.Restart();
+		for (int i = 0; i < nvalues; i++)
+			sink += refCall(i);
+		double tref = timer.Seconds();
+		BenchSink += sink;
+		printf ("%-28s  %12.1f  %12.1f  %7.2fx\n", name, tfast / nvalues * 1e9, tref / nvalues * 1e9, tref / tfast);
+	};
+	row ("itoa",				[&] (int i) { return STRB::itoa (int(ints[i]), fast); },		 [&] (int i) { return sprintf (ref, "%d", int(ints[i])); });
+	row ("lltoa",				[&] (int i) { return STRB::lltoa (ints[i], fast); },			 [&] (int i) { return sprintf (ref, "%lld", ints[i]); });
+	row ("hex0xstr",			[&] (int i) { return STRB::hex0xstr (uint64(ints[i]), fast); }, [&] (int i) { return sprintf (ref, "0x%llX", ints[i]); });
+	row ("ftoa",				[&] (int i) { return STRB::ftoa (doubles[i], fast); },			 [&] (int i) { return sprintf (ref, "%lf", doubles[i]); });
+	row ("ftoa \"%.3f\"",		[&] (int i) { return STRB::ftoa (doubles[i], fast, "%.3f"); },	 [&] (int i) { return sprintf (ref, "%.3f", doubles[i]); });
+	row ("ftoa_short vs %.17g",	[&] (int i) { return STRB::ftoa_short (doubles[i], fast); },	 [&] (int i) { return sprintf (ref, "%.17g", doubles[i]); });
+	row ("Print \"[%2d:%2d] D = %3d\"", [&] (int i) { AUTOSTR s; s.Print ("[%2d:%2d] D = %3d", int(i & 1023), int(i >> 10), int(ints[i] & 0xFFFF)); return s.Length(); },
+										[&] (int i) { return sprintf (ref, "[%2d:%2d] D = %3d", int(i & 1023), int(i >> 10), int(ints[i] & 0xFFFF)); });
+
+	return nmismatch ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									log
+\*--------------------------------------------------------------------------------------*/
+
+#if PLATFORM == PLATFORM_WIN
+#define BENCH_NULL_FILE		"NUL"
+#else
+#define BENCH_NULL_FILE		"/dev/null"
+#endif
+
+
+// Every thread logs bursts of messages and waits for the writer between them (untimed), so nothing is dropped.
+// Returns the time spent in LOG() per message, averaged over the threads
+static double BenchLogRun (int nthreads, int bursts, int burst)
+{
+	std::vector<double> seconds(nthreads);
+	BenchParallel (nthreads, [&] (int t) {
+		for (int b = 0; b < bursts; b++) {
+			BenchTimer timer;
+			for (int i = 0; i < burst; i++)
+				LOG (INFO, "[%2d:%2d] D = %3d", i & 1023, t, i * 7);
+			seconds[t] += timer.Seconds();
+			LOGGER::Flush();
+		}
+	});
+
+	double total = 0;
+	for (double s : seconds)
+		total += s;
+	return total / nthreads / (double(bursts) * burst);
+}
+
+
+static int  BenchLog ()
+{
+	cchar*		tmpfile = "bench-log.tmp";
+	const int	nmsgs	= 2000;
+	int			errors	= 0;
+
+	// 1. What the writer thread prints must be what sprintf prints
+	LOGGER::SetLevel (LOGLEVEL_DEBUG);
+	if (!LOGGER::SetOutput(tmpfile)) {
+		printf ("log: cannot create %s\n", tmpfile);
+		return 1;
+	}
+	std::mt19937_64 rng(777);
+	std::vector<std::string> expected;
+	for (int i = 0; i < nmsgs; i++) {
+		int64	v = BenchRandomInt(rng);
+		double	d = BenchRandomDouble(rng);
+		char	buf[512];
+		STR<40> s;
+		s.Print ("str-%d", i);
+		LOG (DEBUG, "#%d %lld %08x %-6s| %.3f %g %c%%", i, v, unsigned(v), s, d, d, 'a' + i % 26);
+		sprintf (buf, "#%d %lld %08x %-6s| %.3f %g %c%%", i, v, unsigned(v), (cchar*)s, d, d, 'a' + i % 26);
+		expected.push_back(buf);
+		LOG (TRACE, "never written %d", i);
+		if (i % 100 == 0) {
+			// A null string is written as "(null)", the arguments after it intact
+			LOG (DEBUG, "null %s #%d %.2f", (cchar*)nullptr, i, d);
+			sprintf (buf, "null (null) #%d %.2f", i, d);
+			expected.push_back(buf);
+			// A long double goes as a double
+			LOG (DEBUG, "long double %.3Lf %Lg", (long double)d, (long double)d);
+			sprintf (buf, "long double %.3f %g", d, d);
+			expected.push_back(buf);
+		}
+	}
+	const int nexpected = int(expected.size());
+	LOGGER::SetOutput (BENCH_NULL_FILE);		// Flushes the file: the writer drains into the previous output first
+	LOGGER::Flush ();
+
+	FILE* f = fopen(tmpfile, "r");
+	char  line[1024];
+	int   nlines = 0;
+	while (f && fgets(line, sizeof(line), f)) {
+		char* msg = strstr(line, " D  ");		// "   0.001234  T1  D  message"
+		if (msg) {
+			msg += 4;
+			msg[strcspn(msg, "\n")] = '\0';
+			if (nlines >= nexpected || expected[nlines] != msg) {
+				if (errors++ < 5)
+					printf ("  MISMATCH: \"%s\" vs sprintf \"%s\"\n", msg, nlines < nexpected ? expected[nlines].c_str() : "");
+			}
+		}
+		nlines++;
+	}
+	if (f)
+		fclose (f);
+	remove (tmpfile);
+	if (nlines != nexpected) {
+		printf ("  %d lines written, %d expected\n", nlines, nexpected);
+		errors++;
+	}
+	printf ("log: %d messages checked against sprintf, %d mismatches\n\n", nexpected, errors);
+
+	// 2. Caller cost
+	LOGGER::SetLevel (LOGLEVEL_INFO);
+	const int bursts = 200, burst = 2000;
+	int64 dropped0 = LOGGER::Dropped();
+
+	BenchTimer timer;
+	for (int i = 0; i < bursts * burst; i++)
+		LOG (DEBUG, "[%2d:%2d] D = %3d", i & 1023, i >> 10, i * 7);
+	double tdisabled = timer.Seconds();
+
+	FILE* null = fopen(BENCH_NULL_FILE, "w");
+	timer.Restart();
+	for (int i = 0; i < bursts * burst && null; i++)
+		fprintf (null, "[%2d:%2d] D = %3d\n", i & 1023, i >> 10, i * 7);
+	double tfprintf = timer.Seconds();
+	if (null)
+		fclose (null);
+
+	printf ("%-36s  %10.1f ns\n", "LOG() below the level", tdisabled / (bursts * burst) * 1e9);
+	printf ("%-36s  %10.1f ns\n", "fprintf() to " BENCH_NULL_FILE, tfprintf / (bursts * burst) * 1e9);
+	printf ("\n%8s  %16s\n", "threads", "LOG() ns/call");
+	for (int n : BenchThreadCounts())
+		printf ("%8d  %16.1f\n", n, BenchLogRun(n, bursts, burst) * 1e9);
+
+	int64 dropped = LOGGER::Dropped() - dropped0;
+	if (dropped)
+		printf ("\n%lld messages dropped\n", dropped);
+	LOGGER::Close ();
+	return errors || dropped ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									trace
+\*--------------------------------------------------------------------------------------*/
+
+static int  BenchTrace ()
+{
+#if UTILS_TRACE
+	cchar*		tmpfile = "bench-trace.tmp";
+	const int	nzones	= 200000;
+	bool		wasOn	= TRACER::Enabled.load();
+
+	// 1. Zone cost with tracing off and on
+	TRACER::Stop ();
+	BenchTimer timer;
+	for (int i = 0; i < nzones; i++) {
+		TRACE_ZONE ("bench", i);
+		BenchSink = BenchSink + i;
+	}
+	double toff = timer.Seconds();
+
+	TRACER::Start ();
+	int64 zones0 = TRACER::Zones(), dropped0 = TRACER::Dropped();
+	timer.Restart();
+	for (int i = 0; i < nzones; i++) {
+		TRACE_ZONE ("bench", i);
+		BenchSink = BenchSink + i;
+	}
+	double ton = timer.Seconds();
+	if (!wasOn)
+		TRACER::Stop ();
+
+	printf ("%-36s  %10.1f ns\n", "TRACE_ZONE() tracing off", toff / nzones * 1e9);
+	printf ("%-36s  %10.1f ns\n", "TRACE_ZONE() tracing on", ton / nzones * 1e9);
+
+	// 2. Every zone recorded must be saved
+	int64 recorded = TRACER::Zones() - zones0 + TRACER::Dropped() - dropped0;
+	timer.Restart();
+	bool saved = TRACER::Save(tmpfile);
+	double tsave = timer.Seconds();
+
+	int64 nsaved = 0;
+	FILE* f = fopen(tmpfile, "r");
+	char  line[256];
+	while (f && fgets(line, sizeof(line), f))
+		if (strstr(line, "\"ph\":\"X\"") && strstr(line, "\"name\":\"bench\""))
+			nsaved++;
+	if (f)
+		fclose (f);
+	remove (tmpfile);
+
+	printf ("\ntrace: %lld zones recorded, %lld saved in %.0f ms\n", recorded, nsaved, tsave * 1e3);
+	return saved && nsaved == recorded ? 0 : 1;
+#else
+	puts ("trace: compiled out (UTILS_TRACE = 0)");
+	return 0;
+#endif
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									metrics
+\*--------------------------------------------------------------------------------------*/
+
+#if PLATFORM == PLATFORM_WIN
+#include <winsock2.h>
+#define BenchCloseSocket	closesocket
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#define BenchCloseSocket	close
+#endif
+
+
+// One HTTP GET over loopback, returns the whole response ("" on error)
+static std::string BenchHttpGet (int port, cchar* path)
+{
+	std::string resp;
+	auto s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in sa;
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family	   = AF_INET;
+	sa.sin_addr.s_addr = IpAddr(127,0,0,1);
+	sa.sin_port		   = htons(uint16(port));
+	if (connect(s, (sockaddr*)&sa, sizeof(sa)) == 0) {
+		STR<128> req;
+		req.Print ("GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+		if (send(s, (cchar*)req, req.Length(), 0) == int(req.Length())) {
+			char buf[4096];
+			int  n;
+			while ((n = recv(s, buf, sizeof(buf), 0)) > 0)
+				resp.append(buf, n);
+		}
+	}
+	BenchCloseSocket (s);
+	return resp;
+}
+
+
+static MetricCounter	BenchCounter	("bench_ops_total",		"Operations counted by the metrics bench");
+static MetricGauge		BenchGauge		("bench_level",			"Gauge set by the metrics bench");
+static MetricHistogram	BenchHist		("bench_seconds",		"Latencies observed by the metrics bench", "kind=\"test\"", { 0.001, 0.01, 0.1 });
+
+
+static int  BenchMetrics ()
+{
+	const int64	ncalls = 20000000;
+	int			errors = 0;
+
+	// 1. Update costs, a contended atomic counter for comparison
+	BenchTimer timer;
+	for (int64 i = 0; i < ncalls; i++)
+		BenchCounter.Inc();
+	double tinc = timer.Seconds();
+
+	timer.Restart();
+	for (int64 i = 0; i < ncalls; i++)
+		BenchHist.Observe(double(i & 1023) * 1e-4);
+	double tobserve = timer.Seconds();
+
+	printf ("%-36s  %10.2f ns\n", "MetricCounter::Inc()", tinc / ncalls * 1e9);
+	printf ("%-36s  %10.2f ns\n", "MetricHistogram::Observe()", tobserve / ncalls * 1e9);
+
+	static std::atomic<uint64> shared(0);
+	printf ("\n%8s  %16s  %16s\n", "threads", "Inc() ns/call", "atomic add ns");
+	for (int n : BenchThreadCounts()) {
+		double t1 = BenchParallel (n, [&] (int) {
+			for (int64 i = 0; i < ncalls / 4; i++)
+				BenchCounter.Inc();
+		});
+		double t2 = BenchParallel (n, [&] (int) {
+			for (int64 i = 0; i < ncalls / 4; i++)
+				shared.fetch_add(1, std::memory_order_relaxed);
+		});
+		printf ("%8d  %16.2f  %16.2f\n", n, t1 / (ncalls / 4) * 1e9, t2 / (ncalls / 4) * 1e9);
+	}
+
+	// 2. Scrape over loopback: the page must hold the exact values
+	uint64 expected = BenchCounter.Value();
+	BenchGauge.Set (2.5);
+	if (!METRICS::Serve("127.0.0.1:0")) {
+		puts ("\nmetrics: cannot listen on 127.0.0.1");
+		return 1;
+	}
+	timer.Restart();
+	std::string page = BenchHttpGet(METRICS::Port(), "/metrics");
+	double tscrape = timer.Seconds();
+	std::string notfound = BenchHttpGet(METRICS::Port(), "/nothing");
+	METRICS::Stop ();
+
+	STR<128> line;
+	line.Print ("\nbench_ops_total %llu\n", expected);
+	cchar* musthave[] = { "HTTP/1.1 200 OK", "# TYPE bench_ops_total counter", (cchar*)line, "\nbench_level 2.5\n",
+						  "# TYPE bench_seconds histogram", "bench_seconds_bucket{kind=\"test\",le=\"0.001\"} ",
+						  "bench_seconds_bucket{kind=\"test\",le=\"+Inf\"} ", "process_resident_memory_bytes " };
+	for (cchar* s : musthave) {
+		if (page.find(s) == std::string::npos) {
+			printf ("  MISSING: %s\n", s);
+			errors++;
+		}
+	}
+	line.Print ("bench_seconds_count{kind=\"test\"} %lld\n", ncalls);
+	if (page.find((cchar*)line) == std::string::npos) {
+		printf ("  MISSING: %s", (cchar*)line);
+		errors++;
+	}
+	if (notfound.find("HTTP/1.1 404") == std::string::npos) {
+		puts ("  /nothing is not 404");
+		errors++;
+	}
+	printf ("\nmetrics: scraped %d bytes over loopback in %.2f ms, %d errors\n", int(page.size()), tscrape * 1e3, errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									align
+\*--------------------------------------------------------------------------------------*/
+
+// D435-like depth and color cameras: 848x480 depth, 1280x720 color 15 mm aside, slightly rotated
+static const AlignIntrinsics	BenchDepthIntrin = { 848, 480, 424.7f, 239.3f, 421.5f, 421.5f, ALIGN_DISTORTION_BROWN_CONRADY, { 0, 0, 0, 0, 0 } };
+static const AlignIntrinsics	BenchColorIntrin = { 1280, 720, 641.2f, 362.8f, 912.4f, 911.9f, ALIGN_DISTORTION_INVERSE_BROWN_CONRADY, { 0, 0, 0, 0, 0 } };
+static const AlignExtrinsics	BenchExtrin		 = { { 0.99999f, -0.00384f, 0.00213f, 0.00385f, 0.99999f, -0.00256f, -0.00212f, 0.00257f, 0.99999f }, { 0.01503f, 0.00011f, 0.00032f } };
+static const float				BenchDepthScale	 = 0.001f;
+
+
+// Wall at 3-4 m, boxes at 0.6-2 m in front of it, holes where the stereo has no match
+static std::vector<uint16> BenchDepthScene (const AlignIntrinsics& in)
+{
+	std::mt19937_64		rng(38);
+	std::vector<uint16> z(size_t(in.Width) * in.Height);
+	for (int y = 0; y < in.Height; y++)
+		for (int x = 0; x < in.Width; x++)
+			z[size_t(y) * in.Width + x] = uint16(3000 + x + y);
+
+	for (int b = 0; b < 12; b++) {
+		int x0 = int(rng() % in.Width), y0 = int(rng() % in.Height);
+		int w  = 20 + int(rng() % 200), h = 20 + int(rng() % 150);
+		uint16 d = uint16(600 + rng() % 1400);
+		for (int y = y0; y < MIN(y0 + h, in.Height); y++)
+			for (int x = x0; x < MIN(x0 + w, in.Width); x++)
+				z[size_t(y) * in.Width + x] = d;
+	}
+	for (auto& d : z)
+		if (rng() % 20 == 0)
+			d = 0;
+	return z;
+}
+
+
+// rs2::align's algorithm as written in librealsense (align_z_to_other), one pixel corner at a time
+static void BenchAlignReference (const uint16* depth, uint16* out)
+{
+	const AlignIntrinsics& di = BenchDepthIntrin;
+	const AlignIntrinsics& ci = BenchColorIntrin;
+	const float* r = BenchExtrin.Rotation;
+	const float* t = BenchExtrin.Translation;
+
+	auto project = [&] (float px, float py, float d, int& u, int& v) {
+		// rs2_deproject_pixel_to_point, Brown-Conrady undistortion
+		float x = (px - di.Ppx) / di.Fx, y = (py - di.Ppy) / di.Fy;
+		float xo = x, yo = y;
+		for (int k = 0; k < 10; k++) {
+			float r2 = x*x + y*y;
+			float icdist = 1.f / (1 + ((di.Coeffs[4]*r2 + di.Coeffs[1])*r2 + di.Coeffs[0])*r2);
+			float dx = 2*di.Coeffs[2]*x*y + di.Coeffs[3]*(r2 + 2*x*x);
+			float dy = 2*di.Coeffs[3]*x*y + di.Coeffs[2]*(r2 + 2*y*y);
+			x = (xo - dx) * icdist;
+			y = (yo - dy) * icdist;
+		}
+		float p[3] = { d * x, d * y, d };
+		// rs2_transform_point_to_point, rs2_project_point_to_pixel
+		float q[3] = { r[0]*p[0] + r[3]*p[1] + r[6]*p[2] + t[0], r[1]*p[0] + r[4]*p[1] + r[7]*p[2] + t[1], r[2]*p[0] + r[5]*p[1] + r[8]*p[2] + t[2] };
+		u = int(q[0] / q[2] * ci.Fx + ci.Ppx + 0.5f);
+		v = int(q[1] / q[2] * ci.Fy + ci.Ppy + 0.5f);
+	};
+
+	memset (out, 0, size_t(ci.Width) * ci.Height * sizeof(uint16));
+	for (int y = 0; y < di.Height; y++) {
+		for (int x = 0; x < di.Width; x++) {
+			uint16 z = depth[size_t(y) * di.Width + x];
+			if (!z)
+				continue;
+			float d = z * BenchDepthScale;
+			int x0, y0, x1, y1;
+			project (x - 0.5f, y - 0.5f, d, x0, y0);
+			project (x + 0.5f, y + 0.5f, d, x1, y1);
+			if (x0 < 0 || y0 < 0 || x1 >= ci.Width || y1 >= ci.Height)
+				continue;
+			for (int v = y0; v <= y1; v++)
+				for (int u = x0; u <= x1; u++) {
+					uint16& o = out[size_t(v) * ci.Width + u];
+					o = o ? MIN(o, z) : z;
+				}
+		}
+	}
+}
+
+
+// Share of the pixels equal in a and b, and of those known in one only
+static void BenchAlignCompare (cchar* what, const std::vector<uint16>& a, const std::vector<uint16>& b)
+{
+	size_t nequal = 0, nknown = 0, nmissing = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		nequal	 += a[i] == b[i];
+		nknown	 += a[i] != 0;
+		nmissing += (a[i] == 0) != (b[i] == 0);
+	}
+	printf ("%-36s  %9.4f%% equal, %.4f%% known in one only (%.1f%% known)\n", what,
+			100. * nequal / a.size(), 100. * nmissing / a.size(), 100. * nknown / a.size());
+}
+
+
+static rs2_intrinsics BenchToRs2 (const AlignIntrinsics& in)
+{
+	rs2_intrinsics out;
+	out.width  = in.Width;
+	out.height = in.Height;
+	out.ppx	   = in.Ppx;
+	out.ppy	   = in.Ppy;
+	out.fx	   = in.Fx;
+	out.fy	   = in.Fy;
+	out.model  = rs2_distortion(in.Model);
+	memcpy (out.coeffs, in.Coeffs, sizeof(out.coeffs));
+	return out;
+}
+
+
+// The same frames through rs2::align on a software device. Returns the time per frame, < 0 on failure
+static double BenchAlignRs2 (const std::vector<uint16>& depth, const std::vector<uint8>& color, std::vector<uint16>& out, int nframes)
+{
+	const AlignIntrinsics& di = BenchDepthIntrin;
+	const AlignIntrinsics& ci = BenchColorIntrin;
+	try {
+		rs2::software_device	dev;
+		rs2::software_sensor	dsensor = dev.add_sensor("Depth");
+		rs2::software_sensor	csensor = dev.add_sensor("Color");
+		rs2::stream_profile		dstream = dsensor.add_video_stream({ RS2_STREAM_DEPTH, 0, 0, di.Width, di.Height, 30, 2, RS2_FORMAT_Z16, BenchToRs2(di) });
+		rs2::stream_profile		cstream = csensor.add_video_stream({ RS2_STREAM_COLOR, 0, 1, ci.Width, ci.Height, 30, 3, RS2_FORMAT_RGB8, BenchToRs2(ci) });
+		dsensor.add_read_only_option (RS2_OPTION_DEPTH_UNITS, BenchDepthScale);
+
+		rs2_extrinsics extrin;
+		memcpy (extrin.rotation, BenchExtrin.Rotation, sizeof(extrin.rotation));
+		memcpy (extrin.translation, BenchExtrin.Translation, sizeof(extrin.translation));
+		dstream.register_extrinsics_to (cstream, extrin);
+
+		dev.create_matcher (RS2_MATCHER_DLR_C);
+		rs2::syncer sync;
+		dsensor.start (sync);
+		csensor.start (sync);
+
+		// The first frame builds rs2::align's tables and is not counted
+		rs2::align	align(RS2_STREAM_COLOR);
+		double		seconds = 0;
+		for (int i = 0; i <= nframes; i++) {
+			dsensor.on_video_frame ({ (void*)depth.data(), [] (void*) {}, di.Width * 2, 2, rs2_time_t(i * 33), RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, i, dstream });
+			csensor.on_video_frame ({ (void*)color.data(), [] (void*) {}, ci.Width * 3, 3, rs2_time_t(i * 33), RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, i, cstream });
+			rs2::frameset fs = sync.wait_for_frames(5000);
+
+			BenchTimer timer;
+			rs2::frameset aligned = align.process(fs);
+			rs2::depth_frame d = aligned.get_depth_frame();
+			if (i)
+				seconds += timer.Seconds();
+			if (!d || d.get_width() != ci.Width || d.get_height() != ci.Height)
+				return -1;
+			memcpy (out.data(), d.get_data(), out.size() * sizeof(uint16));
+		}
+		dsensor.stop ();
+		csensor.stop ();
+		return seconds / nframes;
+	}
+	catch (const rs2::error& e) {
+		printf ("rs2::align failed: %s\n", e.what());
+		return -1;
+	}
+}
+
+
+static int  BenchAlign ()
+{
+	const AlignIntrinsics& ci = BenchColorIntrin;
+	const int nframes = 50;
+	int ncores = MAX(1, int(std::thread::hardware_concurrency()));
+
+	std::vector<uint16> depth = BenchDepthScene(BenchDepthIntrin);
+	std::vector<uint8>	color(size_t(ci.Width) * ci.Height * 3, 0x80);
+	std::vector<uint16> ref(size_t(ci.Width) * ci.Height), one(ref.size()), all(ref.size()), rs(ref.size());
+
+	// 1. Time per frame: the one-corner-at-a-time reference, the aligner on one and on all the cores
+	BenchTimer timer;
+	for (int i = 0; i < nframes / 10; i++)
+		BenchAlignReference (depth.data(), ref.data());
+	double tref = timer.Seconds() / (nframes / 10);
+
+	DepthAligner aligner1 (BenchDepthIntrin, BenchColorIntrin, BenchExtrin, BenchDepthScale, 1);
+	DepthAligner alignerN (BenchDepthIntrin, BenchColorIntrin, BenchExtrin, BenchDepthScale, ncores);
+	timer.Restart();
+	for (int i = 0; i < nframes; i++)
+		aligner1.DepthToColor (depth.data(), one.data());
+	double tone = timer.Seconds() / nframes;
+	timer.Restart();
+	for (int i = 0; i < nframes; i++)
+		alignerN.DepthToColor (depth.data(), all.data());
+	double tall = timer.Seconds() / nframes;
+
+	std::vector<uint8> mapped(size_t(BenchDepthIntrin.Width) * BenchDepthIntrin.Height * 3);
+	timer.Restart();
+	for (int i = 0; i < nframes; i++)
+		alignerN.ColorToDepth (depth.data(), color.data(), 3, mapped.data());
+	double tcolor = timer.Seconds() / nframes;
+
+	STR<64> what;
+	printf ("%-36s  %10.2f ms\n", "reference, 1 thread", tref * 1e3);
+	printf ("%-36s  %10.2f ms\n", "DepthAligner, 1 thread", tone * 1e3);
+	printf ("%-36s  %10.2f ms\n", (cchar*)what.Print("DepthAligner, %d threads", ncores), tall * 1e3);
+	printf ("%-36s  %10.2f ms\n", (cchar*)what.Print("ColorToDepth RGB8, %d threads", ncores), tcolor * 1e3);
+
+	// 2. rs2::align on the same frames
+	double trs = BenchAlignRs2 (depth, color, rs, nframes);
+	if (trs >= 0)
+		printf ("%-36s  %10.2f ms\n", "rs2::align", trs * 1e3);
+
+	// 3. Agreement: the threads must not change a pixel, the reference and rs2 differ by rounding at the rectangle edges only
+	puts ("");
+	BenchAlignCompare ("1 thread vs all threads", one, all);
+	BenchAlignCompare ("DepthAligner vs reference", all, ref);
+	if (trs >= 0)
+		BenchAlignCompare ("DepthAligner vs rs2::align", all, rs);
+
+	bool same = one == all;
+	printf ("\nalign: %s\n", same ? "ok" : "thread count changes the result");
+	return same ? 0 : 1;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									pixconv
+\*--------------------------------------------------------------------------------------*/
+
+static int  BenchPixconv ()
+{
+	static const struct { PixFormat Format; cchar* Name; } formats[] =
+	{
+		{ PIX_YUYV, "YUYV" }, { PIX_UYVY, "UYVY" }, { PIX_RGB8, "RGB8" }, { PIX_BGR8, "BGR8" }, { PIX_RGBA8, "RGBA8" }, { PIX_BGRA8, "BGRA8" },
+		{ PIX_Y8, "Y8" }, { PIX_RAW8, "RAW8" }, { PIX_Y16, "Y16" }, { PIX_RAW16, "RAW16" }, { PIX_RAW10, "RAW10" }
+	};
+	static cchar*		   targets[] = { "BGR", "BGRA", "gray" };
+	const int width = 1288, height = 720, nframes = 20;		// 1288 - leaves a tail for every kernel
+	PixIsa	  best = PIXCONV::Isa();
+	int		  errors = 0;
+
+	std::mt19937_64		rng(39);
+	std::vector<uint8>	in(size_t(width) * height * 4);
+	for (auto& b : in)
+		b = uint8(rng());
+	std::vector<uint8>	ref(size_t(width) * height * 4), out(ref.size());
+
+	// 1. Time per 1288x720 frame and byte equality of every instruction set with the scalar code
+	printf ("best instruction set: %s\n\n%-6s %-5s  %10s  %10s  %8s\n", PIXCONV::IsaName(best), "from", "to", "scalar ms", "best ms", "equal");
+	for (auto& f : formats) {
+		for (int d = 0; d < PIX_TARGETS; d++) {
+			double t[PIX_ISAS] = {};
+			for (int isa = PIX_ISA_SCALAR; isa <= best; isa++) {
+				PIXCONV::SetIsa (PixIsa(isa));
+				std::vector<uint8>& o = isa == PIX_ISA_SCALAR ? ref : out;
+				BenchTimer timer;
+				for (int i = 0; i < nframes; i++)
+					PIXCONV::Convert (f.Format, PixTarget(d), in.data(), 0, o.data(), 0, width, height);
+				t[isa] = timer.Seconds() / nframes;
+			}
+			bool equal = best == PIX_ISA_SCALAR || ref == out;
+			errors += !equal;
+			printf ("%-6s %-5s  %10.3f  %10.3f  %8s\n", f.Name, targets[d], t[PIX_ISA_SCALAR] * 1e3, t[best] * 1e3, equal ? "yes" : "NO");
+		}
+	}
+	PIXCONV::SetIsa (best);
+
+	// 2. OpenCV doing the same
+	cv::Mat rgb(height, width, CV_8UC3, in.data()), yuyv(height, width, CV_8UC2, in.data()), bgr;
+	BenchTimer timer;
+	for (int i = 0; i < nframes; i++)
+		cv::cvtColor (rgb, bgr, cv::COLOR_RGB2BGR);
+	double tcvrgb = timer.Seconds() / nframes;
+	timer.Restart();
+	for (int i = 0; i < nframes; i++)
+		cv::cvtColor (yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+	double tcvyuyv = timer.Seconds() / nframes;
+	printf ("\n%-36s  %10.3f ms\n%-36s  %10.3f ms\n", "cv::cvtColor RGB8 to BGR", tcvrgb * 1e3, "cv::cvtColor YUYV to BGR", tcvyuyv * 1e3);
+
+	printf ("\npixconv: %d mismatches\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									depth
+\*--------------------------------------------------------------------------------------*/
+
+// The conversion one pixel at a time, as DepthFrame defines it
+static float BenchDepthRef (const DepthFrame& in, int x, int y, DepthUnits units, float scale)
+{
+	const uint8* row = (const uint8*)in.Data + y * in.Stride;
+	float raw = in.IsFloat() ? ((const float*)row)[x] : ((const uint16*)row)[x];
+	float v   = DepthFrame::Valid(raw) ? raw * (in.Scale / (units == DEPTH_Z16 ? scale : DepthFrame::UnitScale(units))) : 0;
+	return units == DEPTH_M32F || units == DEPTH_MM32F ? v : float(uint16(MIN(v + 0.5f, 65535.f)));
+}
+
+
+static int  BenchDepth ()
+{
+	static cchar*	names[] = { "Z16", "MM16", "M32F", "MM32F" };
+	const int		width = 1284, height = 720, nframes = 50;			// 1284 - leaves a tail
+	const float		z16scale = 0.0001f;									// D400 high accuracy preset
+	int				errors = 0;
+
+	// ZED-like float millimeters with NaN and infinities, and the same scene in RealSense units
+	std::mt19937_64		rng(40);
+	cv::Mat				mm32f(height, width, CV_32FC1), z16(height, width, CV_16UC1);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			float v = 300.f + float(rng() % 6000000) * 0.001f;
+			switch (rng() % 50) {
+				case 0:  v = NAN;		break;
+				case 1:  v = INFINITY;	break;
+				case 2:  v = -INFINITY;	break;
+			}
+			mm32f.at<float>(y, x) = v;
+			z16.at<uint16>(y, x)  = DepthFrame::Valid(v) ? uint16(v * 10) : 0;
+		}
+	}
+	DepthFrame sources[] = { DepthFrame(DEPTH_Z16, z16scale, z16), DepthFrame(DEPTH_MM32F, 0, mm32f) };
+
+	// 1. Every source to every form: time per frame, equality with the conversion of single pixels
+	printf ("%-6s %-6s  %10s  %8s\n", "from", "to", "ms", "equal");
+	for (auto& src : sources) {
+		for (int u = DEPTH_Z16; u <= DEPTH_MM32F; u++) {
+			DepthUnits units = DepthUnits(u);
+			DepthFrame out;
+			BenchTimer timer;
+			for (int i = 0; i < nframes; i++)
+				out = src.Convert(units, z16scale);
+			double t = timer.Seconds() / nframes;
+
+			int64 nbad = 0;
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					float ref = BenchDepthRef(src, x, y, units, z16scale);
+					float got = out.IsFloat() ? ((const float*)((const uint8*)out.Data + y * out.Stride))[x] : ((const uint16*)((const uint8*)out.Data + y * out.Stride))[x];
+					if (out.Data == src.Data && !DepthFrame::Valid(got))
+						got = 0;			// a view keeps NaN and infinities
+					nbad += got != ref && fabsf(got - ref) > 1e-6f * fabsf(ref);
+				}
+			}
+			errors += nbad != 0;
+			printf ("%-6s %-6s  %10.3f  %8s%s\n", names[src.Units], names[units], t * 1e3, nbad ? "NO" : "yes", out.Data == src.Data ? "  (view)" : "");
+		}
+	}
+
+	// 2. The same point in both cameras' forms
+	unsigned a = sources[0].Millimeters(100, 100), b = sources[1].Millimeters(100, 100);
+	printf ("\ndepth: pixel 100,100 is %u mm in Z16, %u mm in MM32F; %d mismatching conversions\n", a, b, errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									resize
+\*--------------------------------------------------------------------------------------*/
+
+static int  BenchResize ()
+{
+	const int width = 2208, height = 1242, nframes = 20;		// ZED HD2K
+	int errors = 0;
+
+	std::mt19937_64 rng(42);
+	printf ("%-8s %6s  %10s  %10s  %10s  %10s\n", "image", "factor", "ms", "clone ms", "cv ms", "cv equal");
+	for (int ch : { 3, 4 }) {
+		cv::Mat src(height, width, ch == 3 ? CV_8UC3 : CV_8UC4), dst, cvdst, copy;
+		for (int y = 0; y < height; y++)
+			for (int i = 0; i < width * ch; i++)
+				src.ptr<uint8>(y)[i] = uint8(rng());
+
+		for (int factor : { 2, 3, 4 }) {
+			BenchTimer timer;
+			for (int i = 0; i < nframes; i++)
+				AreaDownscale (src, dst, factor);
+			double t = timer.Seconds() / nframes;
+
+			timer.Restart();
+			for (int i = 0; i < nframes; i++)
+				copy = src.clone();
+			double tclone = timer.Seconds() / nframes;
+
+			timer.Restart();
+			for (int i = 0; i < nframes; i++)
+				cv::resize (src, cvdst, cv::Size(width / factor, height / factor), 0, 0, cv::INTER_AREA);
+			double tcv = timer.Seconds() / nframes;
+
+			// Every output byte against the block average, and the share equal to OpenCV
+			int64 nbad = 0, ncvequal = 0, ntotal = int64(dst.rows) * dst.cols * ch;
+			for (int y = 0; y < dst.rows; y++) {
+				for (int i = 0; i < dst.cols * ch; i++) {
+					int x = i / ch, c = i % ch, sum = 0;
+					for (int dy = 0; dy < factor; dy++)
+						for (int dx = 0; dx < factor; dx++)
+							sum += src.ptr<uint8>(y * factor + dy)[(x * factor + dx) * ch + c];
+					uint8 v = dst.ptr<uint8>(y)[i];
+					nbad	 += v != (sum + factor * factor / 2) / (factor * factor);
+					ncvequal += !cvdst.empty() && cvdst.rows == dst.rows && cvdst.cols == dst.cols && cvdst.ptr<uint8>(y)[i] == v;
+				}
+			}
+			errors += nbad != 0;
+			printf ("%-8s %6d  %10.3f  %10.3f  %10.3f  %9.2f%%%s\n", ch == 3 ? "BGR" : "BGRA", factor, t * 1e3, tclone * 1e3, tcv * 1e3,
+					100. * ncvequal / ntotal, nbad ? "  WRONG AVERAGES" : "");
+		}
+	}
+
+	printf ("\nresize: %d wrong results\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									framepool
+\*--------------------------------------------------------------------------------------*/
+
+// Frames #from..to-1 through a queue of depth frames to a consumer thread, by handle. Returns the frames received damaged
+static int BenchPoolPipeline (size_t bytes, int from, int to)
+{
+	const int				depth = 4;
+	FrameBuf				queue [depth];
+	int						head = from, tail = from;						// Frame numbers pushed and popped
+	std::mutex				mtx;
+	std::condition_variable	cond;
+	int						nbad = 0;
+
+	std::thread consumer ([&] {
+		for (int n = from; n < to; n++) {
+			FrameBuf b;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				cond.wait (lock, [&] { return head > n; });
+				b = std::move(queue[n % depth]);
+				tail++;
+			}
+			cond.notify_all ();
+			nbad += ((int*)b.Data())[0] != n || ((int*)(b.Data() + bytes))[-1] != n;
+		}
+	});
+
+	for (int n = from; n < to; n++) {
+		FrameBuf b = FRAMEPOOL::Get(bytes);
+		memset (b.Data(), n, bytes);
+		((int*)b.Data())[0] = ((int*)(b.Data() + bytes))[-1] = n;
+		std::unique_lock<std::mutex> lock(mtx);
+		cond.wait (lock, [&] { return n - tail < depth; });
+		queue[n % depth] = std::move(b);
+		head++;
+		lock.unlock ();
+		cond.notify_all ();
+	}
+	consumer.join ();
+	return nbad;
+}
+
+
+static int  BenchFramepool ()
+{
+	const int	 width = 2208, height = 1242, nframes = 100;				// ZED HD2K, BGRA
+	const size_t bytes = size_t(width) * height * 4;
+	int			 errors = 0;
+
+	// 1. A frame allocated, written and released
+	BenchTimer timer;
+	for (int i = 0; i < nframes; i++) {
+		FrameBuf b = FRAMEPOOL::Get(bytes);
+		memset (b.Data(), i, bytes);
+	}
+	double tpool = timer.Seconds() / nframes;
+
+	timer.Restart();
+	for (int i = 0; i < nframes; i++) {
+		uint8* p = new uint8[bytes];
+		memset (p, i, bytes);
+		delete[] p;
+	}
+	double tnew = timer.Seconds() / nframes;
+
+	timer.Restart();
+	for (int i = 0; i < nframes; i++) {
+		cv::Mat m(height, width, CV_8UC4);
+		memset (m.data, i, bytes);
+	}
+	double tmat = timer.Seconds() / nframes;
+
+	timer.Restart();
+	for (int i = 0; i < nframes; i++) {
+		cv::Mat m = FRAMEPOOL::NewMat(height, width, CV_8UC4);
+		memset (m.data, i, bytes);
+	}
+	double tpoolmat = timer.Seconds() / nframes;
+
+	printf ("%d * %d BGRA frame, allocated, written, released, ms:\n"
+			"  pool %.3f, pooled cv::Mat %.3f, new[] %.3f, cv::Mat %.3f\n\n", width, height, tpool * 1e3, tpoolmat * 1e3, tnew * 1e3, tmat * 1e3);
+
+	// 2. A producer and a consumer thread passing frames by handle: after the warm up every buffer comes from the pool
+	FRAMEPOOL::Stats s0 = FRAMEPOOL::GetStats();
+	{
+		FrameBuf held [6];		// the most the pipeline holds at once: 4 queued, 1 being produced, 1 being consumed
+		for (auto& b : held)
+			b = FRAMEPOOL::Get(bytes);
+	}
+	errors += BenchPoolPipeline (bytes, 0, nframes);
+	FRAMEPOOL::Stats s1 = FRAMEPOOL::GetStats();
+	errors += BenchPoolPipeline (bytes, nframes, 3 * nframes);
+	FRAMEPOOL::Stats s2 = FRAMEPOOL::GetStats();
+
+	uint64 misses = (s2.Gets - s1.Gets) - (s2.Hits - s1.Hits);
+	errors += misses != 0;
+	printf ("Pipeline, queue of 4: warm up hits %.1f%%, steady state hits %.1f%% (%llu misses), %d damaged frames\n",
+			100. * (s1.Hits - s0.Hits) / (s1.Gets - s0.Gets), 100. * (s2.Hits - s1.Hits) / (s2.Gets - s1.Gets), misses, errors - (misses != 0));
+	FRAMEPOOL::PrintStats ();
+
+	printf ("\nframepool: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									alloctrack
+\*--------------------------------------------------------------------------------------*/
+
+static int  BenchAlloctrack ()
+{
+#if UTILS_ALLOCTRACK
+	const int	nallocs = 200000, nframes = 50;
+	int			errors	= 0;
+
+	// 1. Hook cost: (malloc) in parentheses is the real one, the macro doesn't expand
+	BenchTimer timer;
+	for (int i = 0; i < nallocs; i++) {
+		void* p = (malloc)(64 + (i & 255));
+		BenchSink = BenchSink + int(size_t(p) & 1);
+		(free)(p);
+	}
+	double traw = timer.Seconds();
+
+	timer.Restart();
+	for (int i = 0; i < nallocs; i++) {
+		void* p = malloc(64 + (i & 255));
+		BenchSink = BenchSink + int(size_t(p) & 1);
+		free (p);
+	}
+	double thook = timer.Seconds();
+
+	timer.Restart();
+	for (int i = 0; i < nallocs; i++) {
+		uint8* p = new uint8[64 + (i & 255)];
+		BenchSink = BenchSink + int(size_t(p) & 1);
+		delete[] p;
+	}
+	double tnew = timer.Seconds();
+
+	printf ("%-36s  %10.1f ns\n", "malloc() + free(), not tracked", traw / nallocs * 1e9);
+	printf ("%-36s  %10.1f ns\n", "malloc() + free(), tracked", thook / nallocs * 1e9);
+	printf ("%-36s  %10.1f ns\n", "new[] + delete[], tracked", tnew / nallocs * 1e9);
+
+	// 2. A frame loop allocating 2 blocks a frame, one kept: both are steady state allocations once the warm up is over
+	ALLOC_TAG ("bench");
+	std::vector<void*> kept;
+	kept.reserve (UTILS_ALLOCTRACK_WARMUP + nframes);
+	auto frame = [&] {
+		ALLOCTRACK::Frame ();
+		kept.push_back (malloc(1000));
+		std::unique_ptr<int[]> tmp (new int[100]);
+		BenchSink = BenchSink + tmp[0];
+	};
+	ALLOCTRACK::Stats s0 = ALLOCTRACK::GetStats("bench");
+	while (ALLOCTRACK::Frames() < UTILS_ALLOCTRACK_WARMUP)
+		frame ();
+	for (int i = 0; i < nframes; i++)
+		frame ();
+	ALLOCTRACK::Stats s1 = ALLOCTRACK::GetStats("bench");
+	for (void* p : kept)
+		free (p);
+	ALLOCTRACK::Stats s2 = ALLOCTRACK::GetStats("bench");
+
+	uint64 nkept = kept.size();
+	errors += s1.SteadyAllocs - s0.SteadyAllocs != 2 * nframes;
+	errors += s1.Live - s0.Live != nkept * 1000;
+	errors += s2.Live != s0.Live;
+	printf ("\nFrame loop, %d steady frames: %llu steady state allocations (%d expected), live %llu bytes (%llu expected), %llu after free\n\n",
+			nframes, s1.SteadyAllocs - s0.SteadyAllocs, 2 * nframes, uint64(s1.Live - s0.Live), nkept * 1000, uint64(s2.Live - s0.Live));
+	ALLOCTRACK::Report ();
+
+	printf ("\nalloctrack: %d errors\n", errors);
+	return errors ? 1 : 0;
+#else
+	puts ("alloctrack: compiled out (UTILS_ALLOCTRACK = 0)");
+	return 0;
+#endif
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									frameexec
+\*--------------------------------------------------------------------------------------*/
+
+struct BenchExecFrame
+{
+	int64		N;
+	uint32		Pixels [4096];
+	uint32		Filtered, Temporal, Colorized;
+};
+
+
+// Stand-in for a filter: reads all the pixels a few times, ~0.5 ms
+static uint32 BenchExecFilter (const uint32* p, uint32 seed)
+{
+	uint32 h = seed;
+	for (int r = 0; r < 64; r++)
+		for (int i = 0; i < 4096; i++)
+			h = (h ^ p[i]) * 16777619u + uint32(r);
+	return h;
+}
+
+
+// Frames through parallel - ordered - parallel - ordered stages, like rs-measure, on a pool of
+// nworkers; returns frames/s. out gets the output of every frame in the order it came out
+static double BenchExecRun (int nworkers, int nframes, std::vector<uint32>& out)
+{
+	THREADPOOL::Stop ();
+	THREADPOOL::Start (nworkers);
+	FrameExecutor<std::shared_ptr<BenchExecFrame>> exec;
+	uint32 state = 0;
+	out.clear ();
+	exec.AddStage (STAGE_PARALLEL, [](std::shared_ptr<BenchExecFrame>& f, int) { f->Filtered = BenchExecFilter(f->Pixels, 1); });
+	exec.AddStage (STAGE_ORDERED,  [&](std::shared_ptr<BenchExecFrame>& f, int) { f->Temporal = state = state * 31 + f->Filtered; });
+	exec.AddStage (STAGE_PARALLEL, [](std::shared_ptr<BenchExecFrame>& f, int) { f->Colorized = BenchExecFilter(f->Pixels, f->Temporal); });
+	exec.AddStage (STAGE_ORDERED,  [&](std::shared_ptr<BenchExecFrame>& f, int) { out.push_back (uint32(f->N) ^ f->Colorized); });
+
+	BenchTimer timer;
+	for (int n = 0; n < nframes; n++) {
+		auto f = std::make_shared<BenchExecFrame>();
+		f->N = n;
+		for (int i = 0; i < 4096; i++)
+			f->Pixels[i] = uint32(n * 4096 + i) * 2654435761u;
+		exec.Push (std::move(f));
+	}
+	exec.Drain ();
+	return nframes / timer.Seconds();
+}
+
+
+static int  BenchFrameexec ()
+{
+	const int	nframes = 400;
+	int			errors	= 0;
+
+	// Reference: the same stages one frame after another
+	std::vector<uint32> ref;
+	uint32 state = 0;
+	BenchExecFrame f;
+	BenchTimer timer;
+	for (int n = 0; n < nframes; n++) {
+		for (int i = 0; i < 4096; i++)
+			f.Pixels[i] = uint32(n * 4096 + i) * 2654435761u;
+		state = state * 31 + BenchExecFilter(f.Pixels, 1);
+		ref.push_back (uint32(n) ^ BenchExecFilter(f.Pixels, state));
+	}
+	double serial = nframes / timer.Seconds();
+
+	printf ("%d frames, 2 parallel stages of ~%.1f ms, 2 ordered ones\n", nframes, 0.5 / serial * 1e3);
+	printf ("%8s  %10s  %8s  %10s\n", "workers", "frames/s", "speedup", "mismatches");
+	printf ("%8s  %10.0f  %8s\n", "serial", serial, "1.00");
+	for (int n : BenchThreadCounts()) {
+		std::vector<uint32> out;
+		double fps = BenchExecRun (n, nframes, out);
+		int bad = out.size() != ref.size();
+		for (size_t i = 0; !bad && i < ref.size(); i++)
+			bad += out[i] != ref[i];
+		errors += bad;
+		printf ("%8d  %10.0f  %8.2f  %10d\n", n, fps, fps / serial, bad);
+	}
+
+	// A stage error skips the frame's other stages, the ordered ones still let the next frames pass
+	FrameExecutor<int> exec (4);
+	int outputs = 0, thrown = 0;
+	exec.AddStage (STAGE_PARALLEL, [](int& n, int) { if (n == 5) throw std::runtime_error("frame 5"); });
+	exec.AddStage (STAGE_ORDERED,  [&](int& n, int) { outputs++; });
+	for (int n = 0; n < 20; n++) {
+		try {
+			exec.Push (n);
+		}
+		catch (const std::exception&) {
+			thrown++;
+		}
+	}
+	try {
+		exec.Drain ();
+	}
+	catch (const std::exception&) {
+		thrown++;
+	}
+	errors += outputs != 19 || thrown != 1;
+	printf ("\nStage error: %d of 20 frames out (19 expected), %d rethrown (1 expected)\n", outputs, thrown);
+
+	THREADPOOL::Stop ();
+
+	printf ("\nframeexec: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									threadpool
+\*--------------------------------------------------------------------------------------*/
+
+// Rows [y0, y1) of a 3x3 box blur of a BGRA image, the edge rows and columns copied
+static void BenchPoolBlur (const cv::Mat& src, cv::Mat& dst, int y0, int y1)
+{
+	int n = src.cols * 4;
+	for (int y = y0; y < y1; y++) {
+		const uint8* s = src.ptr<uint8>(y);
+		uint8*		 d = dst.ptr<uint8>(y);
+		if (y == 0 || y == src.rows - 1) {
+			memcpy (d, s, n);
+			continue;
+		}
+		const uint8* a = src.ptr<uint8>(y - 1);
+		const uint8* b = src.ptr<uint8>(y + 1);
+		memcpy (d, s, 4);
+		memcpy (d + n - 4, s + n - 4, 4);
+		for (int i = 4; i < n - 4; i++)
+			d[i] = uint8((a[i - 4] + a[i] + a[i + 4] + s[i - 4] + s[i] + s[i + 4] + b[i - 4] + b[i] + b[i + 4]) / 9);
+	}
+}
+
+
+static int  BenchThreadpool ()
+{
+	const int width = 1920, height = 1080, nframes = 20;
+	int errors = 0;
+
+	std::mt19937_64 rng(42);
+	cv::Mat src(height, width, CV_8UC4), ref(height, width, CV_8UC4), dst(height, width, CV_8UC4);
+	for (int y = 0; y < height; y++)
+		for (int i = 0; i < width * 4; i++)
+			src.ptr<uint8>(y)[i] = uint8(rng());
+
+	// 1. ParallelFor over row bands vs a thread per band started for every frame, as the samples did
+	BenchTimer timer;
+	for (int i = 0; i < nframes; i++)
+		BenchPoolBlur (src, ref, 0, height);
+	double serial = timer.Seconds() / nframes;
+
+	printf ("3x3 blur of %dx%d BGRA, %d frames\n", width, height, nframes);
+	printf ("%8s  %10s  %8s  %14s  %10s\n", "threads", "ms", "speedup", "thread/band ms", "mismatches");
+	printf ("%8s  %10.3f  %8s\n", "serial", serial * 1e3, "1.00");
+	for (int n : BenchThreadCounts()) {
+		THREADPOOL::Stop ();
+		THREADPOOL::Start (n);
+		auto body = [&] (int y0, int y1) { BenchPoolBlur (src, dst, y0, y1); };
+		THREADPOOL::ParallelFor (height, 16, body, n);		// wakes the workers up
+		timer.Restart();
+		for (int i = 0; i < nframes; i++)
+			THREADPOOL::ParallelFor (height, 16, body, n);
+		double t = timer.Seconds() / nframes;
+		int bad = 0;
+		for (int y = 0; y < height; y++)
+			bad += memcmp (ref.ptr<uint8>(y), dst.ptr<uint8>(y), width * 4) != 0;
+
+		timer.Restart();
+		for (int i = 0; i < nframes; i++) {
+			std::vector<std::thread> threads;
+			for (int k = 0; k < n; k++)
+				threads.emplace_back (BenchPoolBlur, std::cref(src), std::ref(dst), height * k / n, height * (k + 1) / n);
+			for (auto& th : threads)
+				th.join ();
+		}
+		double tspawn = timer.Seconds() / nframes;
+		errors += bad;
+		printf ("%8d  %10.3f  %8.2f  %14.3f  %10d\n", n, t * 1e3, serial / t, tspawn * 1e3, bad);
+	}
+	THREADPOOL::Stop ();
+	THREADPOOL::Start ();
+
+	// 2. Cost of a task: empty tasks submitted from outside the pool
+	const int ntasks = 200000;
+	std::atomic<int> left(ntasks);
+	std::mutex mtx;
+	std::condition_variable cond;
+	timer.Restart();
+	for (int i = 0; i < ntasks; i++)
+		THREADPOOL::Submit ([&] {
+			if (--left == 0) {
+				std::lock_guard<std::mutex> lock(mtx);
+				cond.notify_all ();
+			}
+		});
+	{
+		std::unique_lock<std::mutex> lock(mtx);
+		cond.wait (lock, [&] { return left == 0; });
+	}
+	printf ("\n%d empty tasks on %d workers: %.0f ns per task\n", ntasks, THREADPOOL::Threads(), timer.Seconds() / ntasks * 1e9);
+
+	// 3. Nested jobs: tasks running ParallelFor themselves must not deadlock, the idle workers steal the bands
+	THREADPOOL::Stats s0 = THREADPOOL::GetStats();
+	std::atomic<int64> sum(0);
+	THREADPOOL::ParallelFor (64, 1, [&] (int i0, int i1) {
+		for (int i = i0; i < i1; i++)
+			THREADPOOL::ParallelFor (1000, 10, [&] (int j0, int j1) {
+				int64 s = 0;
+				for (int j = j0; j < j1; j++)
+					s += int64(i) * 1000 + j;
+				sum += s;
+			});
+	});
+	int64 expect = 64 * 1000 * int64(64 * 1000 - 1) / 2;
+	int64 stolen = int64(THREADPOOL::GetStats().Stolen - s0.Stolen);
+	errors += sum != expect;
+	printf ("Nested ParallelFor: sum %s, %lld tasks stolen\n", sum == expect ? "ok" : "WRONG", stolen);
+
+	// 4. Priority: with the only worker busy, the tasks queued meanwhile run capture first, export last
+	THREADPOOL::Stop ();
+	THREADPOOL::Start (1);
+	std::atomic<bool> started(false), release(false);
+	std::vector<int> order;
+	THREADPOOL::Submit ([&] { started = true; while (!release) std::this_thread::yield(); });
+	while (!started)
+		std::this_thread::yield();
+	for (int cls : { TASK_EXPORT, TASK_PROCESSING, TASK_CAPTURE })
+		for (int i = 0; i < 10; i++)
+			THREADPOOL::Submit ([&, cls] { std::lock_guard<std::mutex> lock(mtx); order.push_back(cls); }, TaskClass(cls));
+	release = true;
+	THREADPOOL::Stop ();
+	bool ordered = order.size() == 30 && std::is_sorted(order.begin(), order.end());
+	errors += !ordered;
+	printf ("Priority classes: %s\n", ordered ? "capture, processing, export" : "WRONG ORDER");
+
+	printf ("\nthreadpool: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									frameshm
+\*--------------------------------------------------------------------------------------*/
+
+// Frame #n: every image byte and depth pixel is n, so a reader can tell a torn frame
+static void BenchShmFill (cv::Mat& image, cv::Mat& depth, int64 n)
+{
+	for (int y = 0; y < image.rows; y++)
+		memset (image.ptr<uint8>(y), uint8(n), image.cols * image.elemSize());
+	for (int y = 0; y < depth.rows; y++)
+		std::fill (depth.ptr<uint16>(y), depth.ptr<uint16>(y) + depth.cols, uint16(n));
+}
+
+
+// Samples of the frame, about the bytes a consumer reading it would touch
+static bool BenchShmCheck (const FrameShmView& v)
+{
+	bool ok = !v.Image.empty() && !v.Depth.Empty();
+	for (int y = 0; ok && y < v.Image.rows; y += 7) {
+		const uint8* p = v.Image.ptr<uint8>(y);
+		ok = p[0] == uint8(v.N) && p[v.Image.cols * 3 - 1] == uint8(v.N);
+	}
+	for (int y = 0; ok && y < v.Depth.Height; y += 7)
+		ok = ((const uint16*)((const uint8*)v.Depth.Data + y * v.Depth.Stride))[y % v.Depth.Width] == uint16(v.N);
+	return ok;
+}
+
+
+#if PLATFORM != PLATFORM_WIN
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+struct BenchShmResult
+{
+	bool		Created;											// The producer got its segment
+	double		Median, P99;										// Latency, ms
+	double		Received;											// Share of the frames published
+	int64		Lost;
+	int			Torn;												// Frames which passed Valid() with another frame's data
+};
+
+
+// What a reader found, its latencies in ms follow
+struct BenchShmReport
+{
+	int64		Lost, Torn, Count;
+};
+
+
+// A consumer with its own mapping: takes every frame in order till the producer closes
+static void BenchShmRead (cchar* name, int nframes, std::atomic<int>& ready, BenchShmReport& rep, double* latency)
+{
+	FrameShmReader reader;
+	reader.Open (name);
+	ready++;
+	FrameShmView v;
+	while (reader.Next(v, 500, false)) {
+		bool ok = BenchShmCheck(v);
+		uint64 now = FrameShmNow();
+		if (!reader.Valid(v))
+			continue;												// Overwritten meanwhile: dropped, as a consumer would
+		rep.Torn += !ok;
+		if (rep.Count < nframes)
+			latency[rep.Count++] = (now - v.Timestamp) * 1e-6;
+	}
+	rep.Lost = reader.Lost();
+}
+
+
+// nreaders consumers take every frame in order while the producer publishes nframes at fps.
+// Linux: the consumers are processes of their own, reporting through an anonymous shared mapping;
+// Windows: threads of this process, each with its own mapping, an upper bound for processes
+static BenchShmResult BenchShmRun (cchar* name, int nreaders, int nframes, int fps, int width, int height)
+{
+	BenchShmResult res;
+	memset (&res, 0, sizeof(res));
+	FrameShmWriter writer;
+	if (!(res.Created = writer.Create(name, 8, width * height * 3, width * height * 2)))
+		return res;
+
+	size_t stride = sizeof(BenchShmReport) + nframes * sizeof(double);
+	size_t bytes  = 64 + nreaders * stride;
+#if PLATFORM == PLATFORM_WIN
+	std::vector<uint64> mem ((bytes + 7) / 8);
+	uint8* shared = (uint8*)mem.data();
+#else
+	uint8* shared = (uint8*)mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED)
+		return res;
+#endif
+	std::atomic<int>& ready = *new (shared) std::atomic<int>(0);		// Lock free: works across processes
+	auto report	 = [&] (int r) -> BenchShmReport& { return *(BenchShmReport*)(shared + 64 + r * stride); };
+	auto latency = [&] (int r) { return (double*)(shared + 64 + r * stride + sizeof(BenchShmReport)); };
+
+#if PLATFORM == PLATFORM_WIN
+	std::vector<std::thread> readers;
+	for (int r = 0; r < nreaders; r++)
+		readers.emplace_back ([&, r] { BenchShmRead (name, nframes, ready, report(r), latency(r)); });
+#else
+	std::vector<pid_t> readers;
+	for (int r = 0; r < nreaders; r++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			BenchShmRead (name, nframes, ready, report(r), latency(r));
+			_exit (0);
+		}
+		if (pid > 0)
+			readers.push_back (pid);
+		else
+			ready++;												// Not started: reports nothing
+	}
+#endif
+	while (ready < nreaders)
+		std::this_thread::yield();
+
+	cv::Mat image, depth;
+	auto period = std::chrono::nanoseconds(1000000000 / fps);
+	auto next	= std::chrono::steady_clock::now();
+	for (int n = 0; n < nframes; n++) {
+		std::this_thread::sleep_until (next += period);
+		writer.Begin (n, width, height, CV_8UC3, image);
+		writer.BeginDepth (DEPTH_Z16, 0.001f, width, height, AlignIntrinsics(), depth);
+		BenchShmFill (image, depth, n);
+		writer.Publish ();
+	}
+	writer.Close ();
+#if PLATFORM == PLATFORM_WIN
+	for (auto& th : readers)
+		th.join ();
+#else
+	for (pid_t pid : readers)
+		waitpid (pid, nullptr, 0);
+#endif
+
+	std::vector<double> all;
+	for (int r = 0; r < nreaders; r++) {
+		BenchShmReport& rep = report(r);
+		all.insert (all.end(), latency(r), latency(r) + rep.Count);
+		res.Lost += rep.Lost;
+		res.Torn += int(rep.Torn);
+	}
+#if PLATFORM != PLATFORM_WIN
+	munmap (shared, bytes);
+#endif
+	std::sort (all.begin(), all.end());
+	res.Median	 = all.empty() ? 0 : all[all.size() / 2];
+	res.P99		 = all.empty() ? 0 : all[all.size() * 99 / 100];
+	res.Received = double(all.size()) / (double(nframes) * nreaders);
+	return res;
+}
+
+
+static int  BenchFrameshm ()
+{
+	const int width = 1280, height = 720, nframes = 300;
+	cchar*	  name	= "playfile-bench";
+	int errors = 0;
+
+	// 1. Producer cost of a 1280x720 BGR + Z16 frame: copied in by Write(), rendered in place, a plain memcpy
+	cv::Mat	   image(height, width, CV_8UC3), depth16(height, width, CV_16UC1), copy(height, width, CV_8UC3), slot, slotdepth;
+	DepthFrame depth(DEPTH_Z16, 0.001f, depth16);
+	FrameShmWriter writer;
+	if (!writer.Create(name, 8, width * height * 3, width * height * 2)) {
+		printf ("Cannot create the shared memory segment\n");
+		return 1;
+	}
+	BenchShmFill (image, depth16, 1);
+	BenchTimer timer;
+	for (int n = 0; n < nframes; n++)
+		writer.Write (n, image, depth);
+	double twrite = timer.Seconds() / nframes;
+
+	timer.Restart();
+	for (int n = 0; n < nframes; n++) {
+		writer.Begin (n, width, height, CV_8UC3, slot);
+		writer.BeginDepth (DEPTH_Z16, 0.001f, width, height, AlignIntrinsics(), slotdepth);
+		writer.Publish ();
+	}
+	double tinplace = timer.Seconds() / nframes;
+
+	timer.Restart();
+	for (int n = 0; n < nframes; n++) {
+		memcpy (copy.data, image.data, width * height * 3);
+		memcpy (copy.data, depth16.data, width * height * 2);
+	}
+	double tcopy = timer.Seconds() / nframes;
+
+	printf ("Producer, %dx%d BGR + Z16 frame\n", width, height);
+	printf ("%-34s  %10.1f us\n", "Write(), copied into the slot", twrite * 1e6);
+	printf ("%-34s  %10.1f us\n", "Begin() + Publish(), in place", tinplace * 1e6);
+	printf ("%-34s  %10.1f us\n", "memcpy of the frame", tcopy * 1e6);
+
+	// 2. A reader holding a view doesn't stop the producer: its slot is overwritten and Valid() turns false
+	FrameShmReader reader;
+	FrameShmView   held, v;
+	bool opened = reader.Open(name);
+	opened = opened && reader.Next(held, 0) && reader.Valid(held);
+	timer.Restart();
+	for (int n = 0; n < 16; n++)
+		writer.Write (n, image, depth);
+	double theld = timer.Seconds() / 16;
+	bool stale	 = opened && !reader.Valid(held);
+	bool next	 = reader.Next(v, 0, false) && reader.Valid(v) && reader.Lost() > 0;
+	errors += !stale + !next;
+	printf ("Slow reader: Write() %.1f us with a view held, the view %s, next frame in order %s, %lld lost\n",
+			theld * 1e6, stale ? "invalidated" : "STILL VALID", next ? "ok" : "WRONG", reader.Lost());
+	reader.Close ();
+	writer.Close ();
+	errors += reader.Open(name);											// Gone with the producer
+
+#if PLATFORM != PLATFORM_WIN
+	// 3. A producer process which crashed: the next producer takes its segment over, a reader goes on with it
+	{
+		cchar* crashed = "playfile-bench-crashed";
+		pid_t  pid	   = fork();
+		if (pid == 0) {
+			FrameShmWriter w;
+			if (w.Create(crashed, 8, width * height * 3, width * height * 2))
+				for (int n = 0; n < 5; n++)
+					w.Write (n, image, depth);
+			_exit (0);														// No Close(): the segment is left as by a crash
+		}
+		if (pid > 0)
+			waitpid (pid, nullptr, 0);
+		FrameShmReader r;
+		FrameShmView   fv;
+		bool ok = pid > 0 && r.Open(crashed) && r.Next(fv, 0) && fv.N == 4;
+		ok = ok && writer.Create(crashed, 8, width * height * 3, width * height * 2) && writer.Published() == 5;
+		writer.Write (5, image, depth);
+		ok = ok && r.Next(fv, 500) && fv.N == 5 && r.Valid(fv) && !r.Closed();
+		errors += !ok;
+		printf ("Crashed producer process: its segment %s\n", ok ? "taken over, the reader goes on" : "NOT TAKEN OVER");
+		r.Close ();
+		writer.Close ();
+	}
+#endif
+
+	// 4. End-to-end latency from the start of writing to a reader having checked the frame, by consumers
+	const int fps = 100, nlive = 100;
+	int maxreaders = 0;
+#if PLATFORM == PLATFORM_WIN
+	cchar* consumers = "reader threads of this process, an upper bound for processes";
+#else
+	cchar* consumers = "reader processes";
+#endif
+	printf ("\n%d frames at %d fps, every reader takes every frame in order; %s\n", nlive, fps, consumers);
+	printf ("%8s  %10s  %10s  %9s  %8s  %6s\n", "readers", "median ms", "p99 ms", "received", "lost", "torn");
+	for (int n = 1; n <= 64; n *= 2) {
+		BenchShmResult res = BenchShmRun(name, n, nlive, fps, width, height);
+		if (!res.Created) {
+			printf ("Cannot create the shared memory segment\n");
+			errors++;
+			break;
+		}
+		errors += res.Torn;
+		printf ("%8d  %10.3f  %10.3f  %8.1f%%  %8lld  %6d\n", n, res.Median, res.P99, res.Received * 100, res.Lost, res.Torn);
+		if (res.Received >= 0.99 && res.P99 < 1000.0 / fps)
+			maxreaders = n;
+	}
+	printf ("Max consumers keeping up with %d fps: %d%s\n", fps, maxreaders, maxreaders == 64 ? " or more" : "");
+
+	printf ("\nframeshm: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									framenet
+\*--------------------------------------------------------------------------------------*/
+
+// Frames the producer cycles through: a smooth image, depth of a slanted plane with noise and unknown holes
+struct BenchNetSource
+{
+	std::vector<cv::Mat>	Images, Depths;
+
+	BenchNetSource (int nframes, int width, int height)
+	{
+		std::mt19937 rng(7);
+		for (int n = 0; n < nframes; n++) {
+			cv::Mat image(height, width, CV_8UC3), depth(height, width, CV_16UC1);
+			for (int y = 0; y < height; y++) {
+				uint8*	p = image.ptr<uint8>(y);
+				uint16* d = depth.ptr<uint16>(y);
+				for (int x = 0; x < width * 3; x++)
+					p[x] = uint8(x / 3 + y + n * 5 + (rng() & 3));
+				for (int x = 0; x < width; x++)
+					d[x] = (x / 40 + y / 30) % 7 == n % 7 ? 0 : uint16(800 + x + 2 * y + n + (rng() & 7));
+			}
+			Images.push_back (image);
+			Depths.push_back (depth);
+		}
+	}
+};
+
+
+// The frame got as the server had it: every byte when not decimated, every k-th depth pixel when decimated
+static bool BenchNetCheck (const BenchNetSource& src, const FrameNetFrame& f, const FrameNetRequest& req)
+{
+	const cv::Mat& image = src.Images[f.N % src.Images.size()];
+	const cv::Mat& depth = src.Depths[f.N % src.Depths.size()];
+	int  k = req.Decimation;
+	bool withimage = (req.Streams & FRAMENET_IMAGE) != 0;
+	bool withdepth = (req.Streams & FRAMENET_DEPTH) != 0;
+	if (withimage ? f.Image.rows != image.rows / k || f.Image.cols != image.cols / k : !f.Image.empty())
+		return false;
+	if (withdepth ? f.Depth.Height != depth.rows / k || f.Depth.Width != depth.cols / k : !f.Depth.Empty())
+		return false;
+	for (int y = 0; withimage && k == 1 && y < image.rows; y++)
+		if (memcmp(f.Image.ptr<uint8>(y), image.ptr<uint8>(y), image.cols * 3))
+			return false;
+	for (int y = 0; withdepth && y < f.Depth.Height; y++) {
+		const uint16* d = (const uint16*)((const uint8*)f.Depth.Data + y * f.Depth.Stride);
+		const uint16* s = depth.ptr<uint16>(y * k);
+		for (int x = 0; x < f.Depth.Width; x++)
+			if (d[x] != s[x * k])
+				return false;
+	}
+	return true;
+}
+
+
+struct BenchNetResult
+{
+	double		Fps;												// Per client
+	double		MBps;												// All the clients together
+	double		Median, P99;										// Latency, ms
+	int			Errors;
+};
+
+
+// nclients receive what the server streams while the producer publishes at fps for the seconds given
+static BenchNetResult BenchNetRun (const BenchNetSource& src, const FrameNetRequest& req, int nclients, int fps, double seconds)
+{
+	FrameNetServer server;
+	BenchNetResult res;
+	memset (&res, 0, sizeof(res));
+	if (!server.Start("0")) {
+		res.Errors = 1;
+		return res;
+	}
+	STR<32> addr;
+	addr.Print ("127.0.0.1:%d", server.Port());
+
+	std::atomic<bool>				 stop(false);
+	std::vector<std::vector<double>> latency (nclients);
+	std::vector<uint64>				 bytes (nclients);
+	std::vector<int>				 bad (nclients);
+	std::vector<std::thread>		 clients;
+	for (int c = 0; c < nclients; c++) {
+		clients.emplace_back ([&, c] {
+			FrameNetClient client;
+			FrameNetFrame  f;
+			if (!client.Connect(addr, req)) {
+				bad[c]++;
+				return;
+			}
+			while (!stop) {
+				if (!client.Receive(f, 50)) {
+					bad[c] += !client.IsOpen();
+					if (!client.IsOpen())
+						return;
+					continue;
+				}
+				latency[c].push_back ((FrameShmNow() - f.Timestamp) * 1e-6);
+				bytes[c] += f.WireBytes;
+				bad[c]	 += !BenchNetCheck(src, f, req);
+			}
+		});
+	}
+	for (int i = 0; i < 200 && server.Clients() < nclients; i++)
+		std::this_thread::sleep_for (std::chrono::milliseconds(5));
+
+	int	 nframes = int(seconds * fps);
+	auto period	 = std::chrono::nanoseconds(1000000000 / fps);
+	auto next	 = std::chrono::steady_clock::now();
+	BenchTimer timer;
+	for (int n = 0; n < nframes; n++) {
+		std::this_thread::sleep_until (next += period);
+		int i = n % src.Images.size();
+		server.Publish (n, src.Images[i], DepthFrame(DEPTH_Z16, 0.001f, src.Depths[i]));
+	}
+	double t = timer.Seconds();
+	std::this_thread::sleep_for (std::chrono::milliseconds(100));		// the last frames on their way
+	stop = true;
+	for (auto& th : clients)
+		th.join ();
+	server.Stop ();
+
+	std::vector<double> all;
+	uint64 total = 0;
+	for (int c = 0; c < nclients; c++) {
+		all.insert (all.end(), latency[c].begin(), latency[c].end());
+		total	   += bytes[c];
+		res.Errors += bad[c];
+	}
+	std::sort (all.begin(), all.end());
+	res.Fps	   = all.size() / t / nclients;
+	res.MBps   = total / t / 1e6;
+	res.Median = all.empty() ? 0 : all[all.size() / 2];
+	res.P99	   = all.empty() ? 0 : all[all.size() * 99 / 100];
+	return res;
+}
+
+
+static int  BenchFramenet ()
+{
+	const int width = 848, height = 480, fps = 60;
+	const double seconds = 1;
+	int errors = 0;
+
+	BenchNetSource src(8, width, height);
+
+	// 1. The codec: the depth decoded as it was, its ratio
+	cv::Mat depth = src.Depths[0];
+	FrameNetRequest delta;
+	delta.Codec = FRAMENET_DELTA;
+	FrameNetServer server;
+	FrameNetClient client;
+	FrameNetFrame  f;
+	bool ok = server.Start("0");
+	STR<32> addr;
+	addr.Print ("127.0.0.1:%d", server.Port());
+	ok = ok && client.Connect(addr, delta);
+	for (int i = 0; ok && i < 200 && server.Clients() < 1; i++)
+		std::this_thread::sleep_for (std::chrono::milliseconds(5));
+	server.Publish (0, src.Images[0], DepthFrame(DEPTH_Z16, 0.001f, depth));
+	ok = ok && client.Receive(f, 2000) && BenchNetCheck(src, f, delta);
+	errors += !ok;
+	printf ("Lossless delta codec, %dx%d Z16 depth: %s, BGR + Z16 frame of %.2f MB sent as %.2f MB, the image raw\n", width, height, ok ? "identical" : "DIFFERENT",
+			(width * height * 5) / 1e6, f.WireBytes / 1e6);
+
+	// 2. A client requesting nonsense is dropped, the server goes on
+	client.Close ();
+	FrameNetRequest wrong;
+	wrong.Decimation = 100;
+	ok = client.Connect(addr, wrong);
+	server.Publish (1, src.Images[1], DepthFrame(DEPTH_Z16, 0.001f, src.Depths[1]));
+	ok = ok && !client.Receive(f, 2000) && !client.IsOpen();
+	errors += !ok;
+	printf ("Bad request: %s\n", ok ? "dropped" : "NOT DROPPED");
+	client.Close ();
+	server.Stop ();
+
+	// 3. 0.0.0.0 listens on all the interfaces, loopback included
+	ok = server.Start("0.0.0.0:0");
+	addr.Print ("127.0.0.1:%d", server.Port());
+	ok = ok && client.Connect(addr, FrameNetRequest());
+	for (int i = 0; ok && i < 200 && server.Clients() < 1; i++)
+		std::this_thread::sleep_for (std::chrono::milliseconds(5));
+	server.Publish (2, src.Images[2], DepthFrame(DEPTH_Z16, 0.001f, src.Depths[2]));
+	ok = ok && client.Receive(f, 2000) && f.N == 2;
+	errors += !ok;
+	printf ("Served on 0.0.0.0: %s\n", ok ? "reached over loopback" : "FAILED");
+
+	// 4. A pooled depth released by the player right after Publish(): the server keeps its own reference,
+	// the block the pool hands out next is another one
+	{
+		cv::Mat pooled = FRAMEPOOL::Clone(src.Depths[3]);
+		uint8*	block  = pooled.data;
+		server.Publish (3, src.Images[3], DepthFrame(DEPTH_Z16, 0.001f, pooled));
+		pooled.release();
+		cv::Mat next = FRAMEPOOL::NewMat(height, width, CV_16UC1);
+		next.setTo(cv::Scalar(0xFFFF));
+		ok = ok && next.data != block && client.Receive(f, 2000) && f.N == 3 && BenchNetCheck(src, f, FrameNetRequest());
+	}
+	errors += !ok;
+	printf ("Depth released after Publish(): %s\n", ok ? "kept by the server, sent intact" : "BUFFER REUSED");
+	client.Close ();
+	server.Stop ();
+
+	// 5. Throughput and latency by clients: raw, delta coded, decimated
+	static const struct { cchar* Name; cchar* Options; } modes[] = { { "raw", "" }, { "delta", "delta" }, { "dec=2", "dec=2" }, { "depth", "depth,delta" } };
+	printf ("\n%dx%d BGR + Z16 at %d fps over loopback, %.0f s a run\n", width, height, fps, seconds);
+	printf ("%-8s  %8s  %10s  %10s  %10s  %10s  %6s\n", "mode", "clients", "fps each", "MB/s", "median ms", "p99 ms", "errors");
+	for (auto& m : modes) {
+		FrameNetRequest req;
+		req.Parse (m.Options);
+		for (int n : { 1, 4, 16 }) {
+			BenchNetResult res = BenchNetRun(src, req, n, fps, seconds);
+			errors += res.Errors;
+			printf ("%-8s  %8d  %10.1f  %10.1f  %10.3f  %10.3f  %6d\n", m.Name, n, res.Fps, res.MBps, res.Median, res.P99, res.Errors);
+		}
+	}
+
+	printf ("\nframenet: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									pointcloud
+\*--------------------------------------------------------------------------------------*/
+
+#include "../ZED/ZED-save-depth/pointcloud-writer.hpp"
+
+// Body of the file written point by point, the way the writer must lay it out
+static std::vector<uint8> BenchCloudBody (const PointCloudView& cloud, PointCloudFileFormat format, bool skipInvalid)
+{
+	std::vector<uint8> body;
+	for (int y = 0; y < cloud.height; y++) {
+		for (int x = 0; x < cloud.width; x++) {
+			const float* p = cloud.data + y * cloud.stepFloats + x * 4;
+			if (skipInvalid && !std::isfinite(p[2]))
+				continue;
+			const uint8* b = (const uint8*)p;
+			body.insert (body.end(), b, b + 12);
+			if (format == POINT_CLOUD_FILE_PLY_BINARY)
+				body.insert (body.end(), { b[12], b[13], b[14] });
+			else
+				body.insert (body.end(), { b[14], b[13], b[12], 0 });
+		}
+	}
+	return body;
+}
+
+
+// The file after its header against the expected body. Returns the bytes mismatching or missing
+static int64 BenchCloudCheck (cchar* filename, const std::vector<uint8>& body)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f)
+		return int64(body.size()) + 1;
+	std::vector<uint8> file;
+	uint8 buf[65536];
+	for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) != 0; )
+		file.insert (file.end(), buf, buf + n);
+	fclose (f);
+
+	if (file.size() < body.size())
+		return int64(body.size() - file.size());
+	const uint8* p = file.data() + file.size() - body.size();
+	int64 nbad = 0;
+	for (size_t i = 0; i < body.size(); i++)
+		nbad += p[i] != body[i];
+	return nbad;
+}
+
+
+static int  BenchPointcloud ()
+{
+	const int	width = 2208, height = 1242, nwrites = 10;		// ZED HD2K
+	cchar*		tmpfile = "bench-cloud.tmp";
+	int			errors = 0;
+
+	// Surfaces 0.5..20 m with 10% holes, random colors
+	std::mt19937_64 rng(42);
+	std::vector<float> data(size_t(width) * height * 4);
+	int64 nvalid = 0;
+	for (size_t i = 0; i < data.size(); i += 4) {
+		float z = rng() % 10 ? 0.5f + float(rng() % 19500) * 1e-3f : NAN;
+		uint32 rgba = uint32(rng()) | 0xFF000000;
+		data[i + 0] = float(int(rng() % 2000) - 1000) * 1e-3f * z;
+		data[i + 1] = float(int(rng() % 2000) - 1000) * 1e-3f * z;
+		data[i + 2] = z;
+		memcpy (&data[i + 3], &rgba, 4);
+		nvalid += std::isfinite(z);
+	}
+	PointCloudView cloud = { data.data(), width, height, size_t(width) * 4 };
+
+	printf ("%dx%d cloud, %.1f%% valid points, written to %s, best of %d writes\n", width, height, 100. * nvalid / (int64(width) * height), tmpfile, nwrites);
+	printf ("%-11s  %-7s  %12s  %10s  %10s  %8s  %10s\n", "format", "invalid", "per point ms", "1 band ms", "ms", "MB/s", "mismatches");
+
+	PointCloudWriter writer;
+	for (PointCloudFileFormat format : { POINT_CLOUD_FILE_PLY_BINARY, POINT_CLOUD_FILE_PCD_BINARY }) {
+		for (bool skip : { true, false }) {
+			std::vector<uint8> body = BenchCloudBody(cloud, format, skip);
+			int64 npoints = skip ? nvalid : int64(width) * height;
+
+			// A buffered fwrite() of every point, serially, as a writer without bands would do
+			double tpoint = 1e9;
+			for (int i = 0; i < nwrites; i++) {
+				BenchTimer timer;
+				FILE* f = fopen(tmpfile, "wb");
+				if (!f)
+					break;
+				size_t rec = body.size() / MAX(npoints, int64(1));
+				for (size_t o = 0; o < body.size(); o += rec)
+					fwrite (&body[o], 1, rec, f);
+				fclose (f);
+				tpoint = MIN(tpoint, timer.Seconds());
+			}
+
+			// PointCloudWriter with one band and with a band per pool thread
+			double tband[2] = { 1e9, 1e9 };
+			int64 nbad = 0;
+			for (int k = 0; k < 2; k++) {
+				PointCloudWriteOptions opt;
+				opt.skipInvalid = skip;
+				opt.nbands = k == 0 ? 1 : 0;
+				for (int i = 0; i < nwrites; i++) {
+					BenchTimer timer;
+					int64 written = writer.write(tmpfile, cloud, format, opt);
+					tband[k] = MIN(tband[k], timer.Seconds());
+					if (written != npoints)
+						nbad++;
+				}
+				nbad += BenchCloudCheck(tmpfile, body);
+			}
+			errors += nbad != 0;
+			printf ("%-11s  %-7s  %12.2f  %10.2f  %10.2f  %8.0f  %10lld\n", PointCloudWriter::formatName(format), skip ? "skipped" : "kept",
+					tpoint * 1e3, tband[0] * 1e3, tband[1] * 1e3, body.size() / tband[1] / 1e6, (long long)nbad);
+		}
+	}
+	remove (tmpfile);
+
+	printf ("\npointcloud: %d errors\n", errors);
+	return errors ? 1 : 0;
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									Registry
+\*--------------------------------------------------------------------------------------*/
+
+struct BenchEntry
+{
+	cchar*		Name;
+	int			(*Func)();
+	cchar*		Description;
+};
+
+static const BenchEntry  Benches[] =
+{
+	{ "autostr",	BenchAutostr,	"autostrGet() per-thread ring scaling vs a locked global ring" },
+	{ "strfmt",		BenchStrfmt,	"STRB number formatting vs sprintf: speed and byte compatibility" },
+	{ "log",		BenchLog,		"Deferred logger: caller cost per message, thread scaling, output vs sprintf" },
+	{ "trace",		BenchTrace,		"Trace zones: cost with tracing off and on, saved JSON zone count" },
+	{ "metrics",	BenchMetrics,	"Metrics: counter/histogram update cost, Prometheus page over loopback" },
+	{ "align",		BenchAlign,		"Depth to color alignment: reference vs SIMD vs threads vs rs2::align, agreement" },
+	{ "pixconv",	BenchPixconv,	"Pixel format conversion: scalar vs SIMD for every format, vs cv::cvtColor" },
+	{ "depth",		BenchDepth,		"Depth frame: conversions between the depth forms, views without copies" },
+	{ "resize",		BenchResize,	"Display downscaling: area average vs Frame.clone() vs cv::resize(INTER_AREA)" },
+	{ "framepool",	BenchFramepool,	"Frame buffer pool vs new[] and cv::Mat, handles between threads, steady state hits" },
+	{ "alloctrack",	BenchAlloctrack, "Allocation tracking: hook cost, steady state allocations of a frame loop found" },
+	{ "frameexec",	BenchFrameexec,	"Frame-parallel executor: throughput by workers vs serial, output order, stage errors" },
+	{ "threadpool",	BenchThreadpool, "Thread pool: ParallelFor scaling vs a thread per band, task cost, nesting, priorities" },
+	{ "frameshm",	BenchFrameshm,	"Shared memory frames: producer cost, slow readers, end-to-end latency by consumers" },
+	{ "framenet",	BenchFramenet,	"TCP frame streaming over loopback: codec, throughput and latency at 1, 4 and 16 clients" },
+	{ "pointcloud",	BenchPointcloud, "ZED point cloud PLY/PCD binary writer: time for a 2K cloud by bands vs per point, bytes" },
+};
+
+
+void BenchList ()
+{
+	puts ("Benchmarks:");
+	for (auto& b : Benches)
+		printf ("  %-12s %s\n", b.Name, b.Description);
+}
+
+
+int BenchRun (cchar* name)
+{
+	bool all = STRB::strequ(name, "all");
+	int  ret = 0;
+	bool found = false;
+
+	for (auto& b : Benches) {
+		if (all || STRB::strequ(name, b.Name)) {
+			printf ("\n=== %s ===\n", b.Name);
+			ret |= b.Func();
+			found = true;
+		}
+	}
+	if (!found) {
+		printf ("Unknown benchmark '%s'\n", name);
+		BenchList();
+		return 1;
+	}
+	return ret;
+}
@@ -0,0 +1,36 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  bench.h
+ Purpose     :  Built-in benchmarks, run by "playfile -bench=<name>"
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <chrono>
+
+
+int		BenchRun (cchar* name);												// Runs the named benchmark, "all" runs all of them. Returns the process exit code
+void	BenchList ();														// Prints the names of available benchmarks
+
+
+/*
+ ******************************************************************************
+  Wall clock stopwatch for benchmarks
+ ******************************************************************************
+*/
+class BenchTimer
+{
+  public:
+	BenchTimer ()							{ Restart(); }
+	void	Restart ()						{ T0 = std::chrono::steady_clock::now(); }
+	double	Seconds () const				{ return std::chrono::duration<double>(std::chrono::steady_clock::now() - T0).count(); }
+
+  private:
+	std::chrono::steady_clock::time_point	T0;
+};
+
+
+#endif // _BENCH_H
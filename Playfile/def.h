@@ -338,6 +338,19 @@ inline void   INT16_SET (void* ptr, int16 x)    { int16  __packed__ *p = (int16*
 #include "options.h"
 
 
+/***********************************************************************\
+    Allocation tracking (alloctrack.h): malloc & co. of every module
+	including def.h go to the tracker, which records the call site.
+\***********************************************************************/
+#if UTILS_ALLOCTRACK && defined(__cplusplus) && !defined(ALLOCTRACK_NOHOOK)
+#include "alloctrack.h"
+#define malloc(n)		AllocTrackMalloc  (n, __FILE__, __LINE__)
+#define calloc(n,s)		AllocTrackCalloc  (n, s, __FILE__, __LINE__)
+#define realloc(p,n)	AllocTrackRealloc (p, n, __FILE__, __LINE__)
+#define free(p)			AllocTrackFree    (p)
+#endif
+
+
 /***********************************************************************\
     Sometimes in low-level basic modules the ASSERT must be used,
 	but may be not defined because of some complex h-dependencies.
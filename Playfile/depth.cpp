@@ -0,0 +1,191 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  depth.cpp
+ Purpose     :  Camera independent depth frame
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "depth.h"
+#include "framepool.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define DEPTH_SSE2	1
+#include <emmintrin.h>
+#else
+#define DEPTH_SSE2	0
+#endif
+
+
+namespace {
+
+// Row converters: out = in * k, unknown depth becomes 0, integers are rounded and saturated
+
+void U16ToF32 (const uint16* in, float* out, int n, float k)
+{
+	int x = 0;
+#if DEPTH_SSE2
+	__m128 mk = _mm_set1_ps(k);
+	__m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= n; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+		_mm_storeu_ps (out + x,		_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), mk));
+		_mm_storeu_ps (out + x + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), mk));
+	}
+#endif
+	for (; x < n; x++)
+		out[x] = float(in[x]) * k;
+}
+
+
+void F32ToF32 (const float* in, float* out, int n, float k)
+{
+	int x = 0;
+#if DEPTH_SSE2
+	__m128 mk = _mm_set1_ps(k), zero = _mm_setzero_ps(), inf = _mm_set1_ps(INFINITY);
+	for (; x + 4 <= n; x += 4) {
+		__m128 v = _mm_loadu_ps(in + x);
+		__m128 valid = _mm_and_ps(_mm_cmpgt_ps(v, zero), _mm_cmplt_ps(v, inf));
+		_mm_storeu_ps (out + x, _mm_and_ps(_mm_mul_ps(v, mk), valid));
+	}
+#endif
+	for (; x < n; x++)
+		out[x] = DepthFrame::Valid(in[x]) ? in[x] * k : 0.f;
+}
+
+
+#if DEPTH_SSE2
+
+// 8 floats in [0, 65535] to uint16: SSE2 packs signed only, so the range is moved by 32768 and back
+inline __m128i PackU16 (__m128 a, __m128 b)
+{
+	__m128i bias = _mm_set1_epi32(32768);
+	__m128i ia = _mm_sub_epi32(_mm_cvttps_epi32(a), bias);
+	__m128i ib = _mm_sub_epi32(_mm_cvttps_epi32(b), bias);
+	return _mm_xor_si128(_mm_packs_epi32(ia, ib), _mm_set1_epi16(-32768));
+}
+
+
+// Rounds and saturates scaled depth, 0 where unknown
+inline __m128 ToU16Range (__m128 v)
+{
+	__m128 valid = _mm_and_ps(_mm_cmpgt_ps(v, _mm_setzero_ps()), _mm_cmplt_ps(v, _mm_set1_ps(INFINITY)));
+	return _mm_and_ps(_mm_min_ps(_mm_add_ps(v, _mm_set1_ps(0.5f)), _mm_set1_ps(65535.f)), valid);
+}
+
+#endif
+
+
+inline uint16 ToU16 (float v)
+{
+	return DepthFrame::Valid(v) ? uint16(MIN(v + 0.5f, 65535.f)) : 0;
+}
+
+
+void F32ToU16 (const float* in, uint16* out, int n, float k)
+{
+	int x = 0;
+#if DEPTH_SSE2
+	__m128 mk = _mm_set1_ps(k);
+	for (; x + 8 <= n; x += 8) {
+		__m128 a = ToU16Range(_mm_mul_ps(_mm_loadu_ps(in + x), mk));
+		__m128 b = ToU16Range(_mm_mul_ps(_mm_loadu_ps(in + x + 4), mk));
+		_mm_storeu_si128 ((__m128i*)(out + x), PackU16(a, b));
+	}
+#endif
+	for (; x < n; x++)
+		out[x] = ToU16(in[x] * k);
+}
+
+
+void U16ToU16 (const uint16* in, uint16* out, int n, float k)
+{
+	int x = 0;
+#if DEPTH_SSE2
+	__m128 mk = _mm_set1_ps(k);
+	__m128i zero = _mm_setzero_si128();
+	for (; x + 8 <= n; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+		__m128 a = ToU16Range(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), mk));
+		__m128 b = ToU16Range(_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), mk));
+		_mm_storeu_si128 ((__m128i*)(out + x), PackU16(a, b));
+	}
+#endif
+	for (; x < n; x++)
+		out[x] = ToU16(float(in[x]) * k);
+}
+
+}
+
+
+
+DepthFrame::DepthFrame (DepthUnits units, float scale, int width, int height, const void* data, size_t stride) :
+	Units(units), Scale(scale > 0 ? scale : UnitScale(units)), Width(width), Height(height), Data(data)
+{
+	Stride = stride ? stride : width * (IsFloat() ? sizeof(float) : sizeof(uint16));
+	memset (&Intrin, 0, sizeof(Intrin));
+}
+
+
+DepthFrame::DepthFrame (DepthUnits units, float scale, const cv::Mat& mat) :
+	DepthFrame (units, scale, mat.cols, mat.rows, mat.data, mat.step)
+{
+	Hold = mat;
+}
+
+
+float DepthFrame::Meters (int x, int y) const
+{
+	if (!Data || x < 0 || y < 0 || x >= Width || y >= Height)
+		return 0;
+	if (IsFloat()) {
+		float v = ((const float*)Row(y))[x];
+		return Valid(v) ? v * Scale : 0;
+	}
+	return ((const uint16*)Row(y))[x] * Scale;
+}
+
+
+DepthFrame DepthFrame::Convert (DepthUnits units, float scale) const
+{
+	DepthFrame out(units, units == DEPTH_Z16 ? scale : 0, Width, Height, nullptr);
+	if (Data && out.IsFloat() == IsFloat() && out.Scale == Scale) {
+		// Already in this form: a view of the same data
+		out = *this;
+		out.Units = units;
+		return out;
+	}
+
+	if (Data) {
+		out.Hold = FRAMEPOOL::NewMat (Height, Width, out.IsFloat() ? CV_32FC1 : CV_16UC1);
+		out.Data = out.Hold.data;
+		out.Stride = out.Hold.step;
+		ConvertTo (units, out.Scale, out.Hold.data, out.Stride);
+	}
+	out.Intrin = Intrin;
+	return out;
+}
+
+
+void DepthFrame::ConvertTo (DepthUnits units, float scale, void* out, size_t stride) const
+{
+	bool  tofloat = units == DEPTH_M32F || units == DEPTH_MM32F;
+	float k = Scale / (units == DEPTH_Z16 && scale > 0 ? scale : UnitScale(units));
+	if (!stride)
+		stride = Width * (tofloat ? sizeof(float) : sizeof(uint16));
+
+	for (int y = 0; y < Height; y++) {
+		uint8* o = (uint8*)out + y * stride;
+		if (IsFloat() && tofloat)
+			F32ToF32 ((const float*)Row(y), (float*)o, Width, k);
+		else if (IsFloat())
+			F32ToU16 ((const float*)Row(y), (uint16*)o, Width, k);
+		else if (tofloat)
+			U16ToF32 ((const uint16*)Row(y), (float*)o, Width, k);
+		else if (k == 1)
+			memcpy (o, Row(y), Width * sizeof(uint16));
+		else
+			U16ToU16 ((const uint16*)Row(y), (uint16*)o, Width, k);
+	}
+}
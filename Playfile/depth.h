@@ -0,0 +1,70 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  depth.h
+ Purpose     :  Camera independent depth frame
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _DEPTH_H
+#define _DEPTH_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+#include "align.h"
+
+
+// Forms of depth data. Every form is a pixel type and a scale in meters per unit
+enum DepthUnits
+{
+	DEPTH_Z16,											// uint16 device units, RealSense; Scale is the device depth scale
+	DEPTH_MM16,											// uint16 millimeters
+	DEPTH_M32F,											// float meters
+	DEPTH_MM32F											// float millimeters, ZED
+};
+
+
+/*
+ ******************************************************************************
+  Depth image of either camera, a view of data owned elsewhere: by the
+  player's buffers, the SDK or the cv::Mat in Hold. Unknown depth is 0 in
+  the uint16 forms and 0, NaN or infinity in the float ones (ZED marks
+  occlusions with NaN, too close / too far with -/+ infinity).
+  Convert() returns the depth in another form; when the data is in that
+  form already it returns a view of the same data, otherwise the rows are
+  converted 4/8 pixels at a time with SSE2 into a new cv::Mat.
+ ******************************************************************************
+*/
+class DepthFrame
+{
+  public:
+	DepthFrame () : Units(DEPTH_MM16), Scale(0.001f), Width(0), Height(0), Stride(0), Data(nullptr)	{ memset (&Intrin, 0, sizeof(Intrin)); }
+	DepthFrame (DepthUnits units, float scale, int width, int height, const void* data, size_t stride = 0);	// scale - meters per unit, 0 - the units' own
+	DepthFrame (DepthUnits units, float scale, const cv::Mat& mat);			// Keeps mat alive in Hold
+
+	bool		Empty () const							{ return !Data; }
+	bool		IsFloat () const						{ return Units == DEPTH_M32F || Units == DEPTH_MM32F; }
+	static bool	Valid (float v)							{ return v > 0 && v < INFINITY; }	// false for NaN too
+
+	float		Meters (int x, int y) const;									// 0 where unknown or outside
+	unsigned	Millimeters (int x, int y) const								{ return unsigned(Meters(x, y) * 1000 + 0.5f); }
+
+	DepthFrame	Convert (DepthUnits units, float scale = 0) const;				// scale - for DEPTH_Z16, meters per unit
+	void		ConvertTo (DepthUnits units, float scale, void* out, size_t stride = 0) const;	// Into the caller's buffer
+
+	static float	UnitScale (DepthUnits units)		{ return units == DEPTH_M32F ? 1.f : 0.001f; }
+
+  public:
+	DepthUnits		Units;
+	float			Scale;													// Meters per unit
+	int				Width, Height;
+	size_t			Stride;													// Bytes per row
+	const void*		Data;
+	cv::Mat			Hold;													// Owner of Data, may be empty
+	AlignIntrinsics	Intrin;													// Camera of the depth viewport, Width = 0 when unknown
+
+  private:
+	const uint8*	Row (int y) const						{ return (const uint8*)Data + y * Stride; }
+};
+
+
+#endif // _DEPTH_H
@@ -0,0 +1,333 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  framecache.cpp
+ Purpose     :  Memory budgeted cache of decoded frames
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "framecache.h"
+#include "tracer.h"
+#include "alloctrack.h"
+
+#include <chrono>
+#include <vector>
+
+
+static MetricCounter  CacheHits		("playfile_cache_requests_total",	"Frame requests to the decoded frame cache", "result=\"hit\"");
+static MetricCounter  CacheMisses	("playfile_cache_requests_total",	"Frame requests to the decoded frame cache", "result=\"miss\"");
+static MetricCounter  CacheDecoded	("playfile_cache_decoded_total",	"Frames decoded by the cache worker");
+static MetricCounter  CacheEvicted	("playfile_cache_evicted_total",	"Frames evicted from the cache");
+
+
+FrameCache::FrameCache (DecodeFunc decode, int64 nframes, const Params& params) :
+	Decode(decode), Prm(params), Nframes(nframes), Bytes(0), FullBytes(0), Playhead(0), Direction(1), Wanted(-1), BackLo(-1), BackHi(-1), Stopping(false),
+	Nhits(0), NproxyHits(0), Nmisses(0), Ndecoded(0), Ndemoted(0), Nevicted(0), PeakBytes(0),
+	MetricBytes  ("playfile_cache_bytes",  "Memory held by the decoded frame cache", nullptr, [this] { std::lock_guard<std::mutex> lock(Mtx); return double(Bytes); }),
+	MetricFrames ("playfile_cache_frames", "Frames held by the decoded frame cache", nullptr, [this] { std::lock_guard<std::mutex> lock(Mtx); return double(Entries.size()); })
+{
+	Worker = std::thread (&FrameCache::WorkerProcess, this);
+}
+
+
+FrameCache::~FrameCache ()
+{
+	Stop();
+}
+
+
+void FrameCache::Stop ()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		Stopping = true;
+	}
+	WorkCond.notify_all();
+	ReadyCond.notify_all();
+	if (Worker.joinable())
+		Worker.join();
+}
+
+
+bool FrameCache::Get (int64 n, CachedFrame& out, int waitms)
+{
+	if (n < 0 || (Nframes >= 0 && n >= Nframes))
+		return false;	// never decoded, it would be waited for forever
+
+	std::unique_lock<std::mutex> lock(Mtx);
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(waitms);
+
+	auto it = Entries.find(n);
+	if (it != Entries.end() && !it->second.Frame.Proxy) {
+		Nhits++;
+		CacheHits.Inc();
+	}
+	else {
+		Nmisses++;
+		CacheMisses.Inc();
+	}
+
+	for (;;) {
+		it = Entries.find(n);
+		if (it != Entries.end() && !it->second.Frame.Proxy) {
+			LruList.splice (LruList.begin(), LruList, it->second.Lru);
+			out = it->second.Frame;
+			return true;
+		}
+		if (Failed.count(n) || Stopping)
+			return false;
+
+		if (Wanted != n) {
+			Wanted = n;
+			WorkCond.notify_one();
+		}
+		if (waitms < 0)
+			ReadyCond.wait(lock);
+		else if (ReadyCond.wait_until(lock, deadline) == std::cv_status::timeout)
+			return false;
+	}
+}
+
+
+bool FrameCache::Peek (int64 n, CachedFrame& out)
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	auto it = Entries.find(n);
+	if (it == Entries.end())
+		return false;
+	if (it->second.Frame.Proxy)
+		NproxyHits++;
+	LruList.splice (LruList.begin(), LruList, it->second.Lru);
+	out = it->second.Frame;
+	return true;
+}
+
+
+bool FrameCache::IsMissing (int64 n)
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	return Failed.count(n) != 0;
+}
+
+
+void FrameCache::SetPlayhead (int64 n, int direction)
+{
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		Playhead  = n;
+		Direction = direction;
+	}
+	WorkCond.notify_one();
+}
+
+
+void FrameCache::Drop (int64 n)
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	auto it = Entries.find(n);
+	if (it != Entries.end()) {
+		Bytes -= it->second.Bytes;
+		LruList.erase(it->second.Lru);
+		Entries.erase(it);
+	}
+	Failed.erase(n);
+}
+
+
+void FrameCache::Clear ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	Entries.clear();
+	LruList.clear();
+	Failed.clear();
+	Bytes = 0;
+}
+
+
+void FrameCache::PrintStats ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	int64 nproxies = 0;
+	for (auto& e : Entries)
+		nproxies += e.second.Frame.Proxy;
+
+	printf ("Frame cache: %d frames (%d proxies), %.1f MB, peak %.1f MB of %.1f MB\n"
+	        "  hits %lld, misses %lld, proxy hits %lld, decoded %lld, demoted %lld, evicted %lld\n",
+			int(Entries.size()), int(nproxies), Bytes / 1048576., PeakBytes / 1048576., Prm.Budget / 1048576.,
+			Nhits, Nmisses, NproxyHits, Ndecoded, Ndemoted, Nevicted);
+}
+
+
+bool FrameCache::HasFull (int64 n) const
+{
+	auto it = Entries.find(n);
+	return it != Entries.end() && !it->second.Frame.Proxy;
+}
+
+
+int64 FrameCache::NextToDecode ()
+{
+	auto wanted = [this] (int64 k) {
+		return k >= 0 && (Nframes < 0 || k < Nframes) && !HasFull(k) && !Failed.count(k);
+	};
+
+	if (Wanted >= 0 && wanted(Wanted))
+		return Wanted;
+
+	// Never prefetch beyond the full resolution radius or more than the budget holds,
+	// otherwise prefetched frames would be demoted or evict each other forever
+	int64 ahead = MIN(Prm.Prefetch, Prm.FullRadius);
+	if (FullBytes > 0)
+		ahead = MIN(ahead, int64(Prm.Budget / FullBytes) - 1);
+
+	if (Direction > 0) {
+		for (int64 k = Playhead; k <= Playhead + ahead; k++)
+			if (wanted(k))
+				return k;
+	}
+	else if (Direction < 0) {
+		// Blocks behind the playhead, each one lowest frame first so the source decodes sequentially.
+		// The block stays put while the playhead moves through it, otherwise every step would cost a seek.
+		if (BackHi < 0 || Playhead < BackLo || Playhead > BackHi + ahead) {
+			BackHi = Playhead;
+			BackLo = MAX(Playhead - ahead, 0);
+		}
+		for (;;) {
+			for (int64 k = BackLo; k <= BackHi; k++)
+				if (wanted(k))
+					return k;
+			if (BackLo == 0 || Playhead - BackLo >= ahead)
+				break;
+			BackHi = BackLo - 1;
+			BackLo = MAX(BackHi - ahead, 0);
+		}
+	}
+	else if (wanted(Playhead)) {
+		return Playhead;
+	}
+	return -1;
+}
+
+
+void FrameCache::WorkerProcess ()
+{
+	TRACER::SetThreadName ("frame cache");
+	ALLOC_TAG ("frame cache");
+	for (;;) {
+		int64 n;
+		{
+			std::unique_lock<std::mutex> lock(Mtx);
+			WorkCond.wait(lock, [&] { return Stopping || (n = NextToDecode()) >= 0; });
+			if (Stopping)
+				break;
+		}
+
+		CachedFrame f;
+		f.N = n;
+		bool ok;
+		{
+			TRACE_ZONE ("Decode", n);
+			ok = Decode (n, f) && !f.Image.empty();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(Mtx);
+			if (ok) {
+				Ndecoded++;
+				CacheDecoded.Inc();
+				FullBytes = FrameBytes(f);
+				Insert (f);
+			}
+			else {
+				Failed.insert(n);
+			}
+			if (Wanted == n)
+				Wanted = -1;
+		}
+		ReadyCond.notify_all();
+
+		{
+			TRACE_ZONE ("Demote", n);
+			Demote();
+		}
+		{
+			TRACE_ZONE ("Evict", n);
+			std::lock_guard<std::mutex> lock(Mtx);
+			Evict();
+		}
+	}
+
+	// Release waiters of Get()
+	ReadyCond.notify_all();
+}
+
+
+void FrameCache::Insert (CachedFrame& f)
+{
+	auto it = Entries.find(f.N);
+	if (it != Entries.end()) {
+		Bytes -= it->second.Bytes;
+		LruList.erase(it->second.Lru);
+		Entries.erase(it);
+	}
+
+	LruList.push_front(f.N);
+	Entry& e = Entries[f.N];
+	e.Frame = f;
+	e.Bytes = FrameBytes(f);
+	e.Lru   = LruList.begin();
+	Bytes += e.Bytes;
+	if (Bytes > PeakBytes)
+		PeakBytes = Bytes;
+}
+
+
+void FrameCache::Demote ()
+{
+	// Collect the full frames far from the playhead, downscale them without holding the lock
+	std::vector<CachedFrame> far;
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		for (auto& e : Entries)
+			if (!e.second.Frame.Proxy && llabs(e.first - Playhead) > Prm.FullRadius)
+				far.push_back(e.second.Frame);
+	}
+	if (far.empty() || Prm.ProxyScale <= 1)
+		return;
+
+	for (auto& f : far) {
+		CachedFrame proxy;
+		proxy.N = f.N;
+		proxy.Timestamp = f.Timestamp;
+		proxy.Proxy = true;
+		cv::resize (f.Image, proxy.Image, cv::Size(), 1. / Prm.ProxyScale, 1. / Prm.ProxyScale, cv::INTER_AREA);
+
+		std::lock_guard<std::mutex> lock(Mtx);
+		auto it = Entries.find(f.N);
+		if (it == Entries.end() || it->second.Frame.Image.data != f.Image.data)
+			continue;	// evicted or replaced meanwhile
+		Bytes -= it->second.Bytes;
+		it->second.Frame = proxy;
+		it->second.Bytes = FrameBytes(proxy);
+		Bytes += it->second.Bytes;
+		Ndemoted++;
+	}
+}
+
+
+void FrameCache::Evict ()
+{
+	auto it = LruList.end();
+	while (Bytes > Prm.Budget && it != LruList.begin()) {
+		--it;
+		if (*it == Playhead)
+			continue;	// never the frame on screen
+		auto e = Entries.find(*it);
+		Bytes -= e->second.Bytes;
+		Entries.erase(e);
+		it = LruList.erase(it);
+		Nevicted++;
+		CacheEvicted.Inc();
+	}
+}
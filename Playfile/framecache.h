@@ -0,0 +1,123 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  framecache.h
+ Purpose     :  Memory budgeted cache of decoded frames
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _FRAMECACHE_H
+#define _FRAMECACHE_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+#include "metrics.h"
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+
+/*
+ ******************************************************************************
+  A decoded frame. Image and Depth are reference counted cv::Mat, so a copy
+  handed out by the cache stays valid after the entry is demoted or evicted.
+ ******************************************************************************
+*/
+struct CachedFrame
+{
+	int64			N;														// Frame number
+	uint64			Timestamp;												// Source timestamp in ns, 0 when unknown
+	cv::Mat			Image;
+	cv::Mat			Depth;													// Empty for proxies, sources without depth or frames decoded without it
+	bool			Proxy;													// Image is a downscaled proxy of the frame
+
+	CachedFrame() : N(-1), Timestamp(0), Proxy(false) {}
+};
+
+
+/*
+ ******************************************************************************
+  LRU cache of decoded frames keyed by frame number, bounded by a memory
+  budget. Frames near the playhead are kept in full resolution, farther ones
+  are downscaled to proxies (image only) which still allow instant scrubbing.
+  A background thread is the only caller of the decode function: it serves
+  urgent requests first and then prefetches in the direction of travel. In
+  backward direction it decodes a block behind the playhead in ascending
+  order, as sources decode sequentially much faster than by seeking.
+ ******************************************************************************
+*/
+class FrameCache
+{
+  public:
+	typedef std::function<bool (int64 n, CachedFrame& out)>  DecodeFunc;	// Fills out.Image, Depth and Timestamp of frame #n, false if there is no such frame
+
+	struct Params
+	{
+		size_t		Budget;													// Memory budget in bytes
+		int			FullRadius;												// Frames within this distance from the playhead are kept in full resolution
+		int			Prefetch;												// Number of frames prefetched in the direction of travel
+		int			ProxyScale;												// Proxy downscale factor per axis
+
+		Params() : Budget(size_t(512) << 20), FullRadius(60), Prefetch(30), ProxyScale(4) {}
+	};
+
+	FrameCache (DecodeFunc decode, int64 nframes, const Params& params = Params());		// nframes < 0 means unknown
+	~FrameCache ();
+
+	bool	Get (int64 n, CachedFrame& out, int waitms);					// Full resolution frame #n, waiting up to waitms (< 0 - no limit). Returns false on timeout or when there is no such frame
+	bool	Peek (int64 n, CachedFrame& out);								// Any cached version of frame #n, full or proxy, without waiting
+	bool	IsMissing (int64 n);											// The source failed to decode frame #n
+	void	SetPlayhead (int64 n, int direction);							// Direction of travel: 1 forward, -1 backward, 0 still
+	void	Drop (int64 n);													// Forgets frame #n, the next Get() decodes it again
+	void	Clear ();
+	void	PrintStats ();
+	void	Stop ();														// Waits for the decode in progress: the source may be closed afterwards. Get() no longer waits for a decode
+
+  private:
+	struct Entry
+	{
+		CachedFrame					Frame;
+		size_t						Bytes;
+		std::list<int64>::iterator	Lru;
+	};
+
+	void	WorkerProcess ();
+	int64	NextToDecode ();												// Called with Mtx held, -1 when there is nothing to do
+	bool	HasFull (int64 n) const;
+	void	Insert (CachedFrame& f);
+	void	Demote ();
+	void	Evict ();
+
+	static size_t FrameBytes (const CachedFrame& f)	{ return f.Image.total() * f.Image.elemSize() + f.Depth.total() * f.Depth.elemSize(); }
+
+  private:
+	DecodeFunc					Decode;
+	Params						Prm;
+	int64						Nframes;
+
+	std::mutex					Mtx;										// Protects everything below
+	std::condition_variable		WorkCond;									// Signalled on new request, playhead change or stop
+	std::condition_variable		ReadyCond;									// Signalled when a frame is decoded
+	std::map<int64,Entry>		Entries;
+	std::list<int64>			LruList;									// Most recently used first
+	std::set<int64>				Failed;										// Frames the source could not decode
+	size_t						Bytes;
+	size_t						FullBytes;									// Size of the last decoded full resolution frame
+	int64						Playhead;
+	int							Direction;
+	int64						Wanted;										// Urgent request from Get(), -1 if none
+	int64						BackLo, BackHi;								// Block being prefetched in backward direction
+	bool						Stopping;
+	std::thread					Worker;
+
+	int64						Nhits, NproxyHits, Nmisses, Ndecoded, Ndemoted, Nevicted;
+	size_t						PeakBytes;
+
+	MetricGauge					MetricBytes, MetricFrames;					// Sampled under Mtx at the scrape time
+};
+
+
+#endif // _FRAMECACHE_H
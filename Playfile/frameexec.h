@@ -0,0 +1,229 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  frameexec.h
+ Purpose     :  Frame-parallel stage executor with an ordered reorder buffer
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  Stages are added once, before the first Push(). A stage
+				keeping state from frame to frame (a temporal filter, the
+				output queue) is STAGE_ORDERED, the others STAGE_PARALLEL;
+				a parallel stage whose objects aren't thread safe keeps one
+				per pool worker, its function gets the worker index.
+\**********************************************************************/
+
+#ifndef _FRAMEEXEC_H
+#define _FRAMEEXEC_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "threadpool.h"
+
+
+enum FrameStageMode
+{
+	STAGE_PARALLEL,							// Any worker, several frames at once
+	STAGE_ORDERED							// One frame at a time, in the order pushed
+};
+
+
+/*
+ ***************************************************************************
+ Runs consecutive frames through a chain of stages on the thread pool.
+ Frames live in a ring of Capacity slots, the reorder buffer: frame #k
+ takes slot k % Capacity, so Push() waits while the frame Capacity frames
+ older is still in there, and no more than Capacity frames are ever in
+ flight. Every frame which can advance gets a pool task for its next stage,
+ the oldest first: the stage is parallel, or ordered and this frame is the
+ next one the stage expects.
+ A frame whose stage throws skips its remaining stages (the ordered ones
+ still see its turn pass); the next Push() or Drain() rethrows the error.
+ ***************************************************************************
+*/
+template <class T>
+class FrameExecutor
+{
+  public:
+	typedef std::function<void (T& frame, int worker)>  StageFunc;
+
+	struct Stats
+	{
+		int64		Pushed, Done, Failed;
+		int			InFlight, PeakInFlight;
+		int64		Stalls;												// Push() calls which waited for a slot
+	};
+
+	// capacity 0 - twice the pool's workers
+	FrameExecutor (int capacity = 0, TaskClass cls = TASK_PROCESSING)
+	{
+		Slots.resize (capacity > 0 ? capacity : 2 * THREADPOOL::Threads());
+		Class		= cls;
+		Outstanding	= 0;
+		Stopping	= false;
+		memset (&St, 0, sizeof(St));
+	}
+
+	~FrameExecutor ()								{ Stop(); }
+
+	void AddStage (FrameStageMode mode, StageFunc func)
+	{
+		Stage s;
+		s.Mode = mode;
+		s.Func = std::move(func);
+		s.Next = 0;
+		s.Busy = false;
+		Stages.push_back (std::move(s));
+	}
+
+	// Frames must come in their order. Waits while the reorder buffer is full; false once stopped.
+	// The frame is taken even when the error of an earlier one is rethrown
+	bool Push (T frame)
+	{
+		std::unique_lock<std::mutex> lock(Mtx);
+		Slot& s = Slots[St.Pushed % Slots.size()];
+		if (s.Used) {
+			St.Stalls++;
+			SpaceCond.wait (lock, [&] { return !s.Used || Stopping; });
+		}
+		if (Stopping)
+			return false;
+		s.Frame	 = std::move(frame);
+		s.Seq	 = St.Pushed++;
+		s.Stage	 = 0;
+		s.Used	 = true;
+		s.Busy	 = false;
+		s.Failed = false;
+		St.InFlight++;
+		St.PeakInFlight = MAX(St.PeakInFlight, St.InFlight);
+		Dispatch ();
+		Rethrow (lock);
+		return true;
+	}
+
+	// Waits until all the frames pushed have passed the last stage
+	void Drain ()
+	{
+		std::unique_lock<std::mutex> lock(Mtx);
+		SpaceCond.wait (lock, [&] { return St.Done == St.Pushed || Stopping; });
+		Rethrow (lock);
+	}
+
+	// Frames not done are dropped, stages running finish first
+	void Stop ()
+	{
+		std::unique_lock<std::mutex> lock(Mtx);
+		Stopping = true;
+		SpaceCond.notify_all ();
+		IdleCond.wait (lock, [this] { return Outstanding == 0; });
+	}
+
+	int		Workers () const						{ return THREADPOOL::Threads(); }
+	int		Capacity () const						{ return int(Slots.size()); }
+	Stats	GetStats ()								{ std::lock_guard<std::mutex> lock(Mtx); return St; }
+
+  private:
+	struct Stage
+	{
+		FrameStageMode	Mode;
+		StageFunc		Func;
+		int64			Next;											// Ordered: the frame whose turn it is
+		bool			Busy;											// Ordered: a frame is in
+	};
+
+	struct Slot
+	{
+		T				Frame;
+		int64			Seq;
+		int				Stage;											// Next stage to run
+		bool			Used, Busy, Failed;
+
+		Slot () : Seq(0), Stage(0), Used(false), Busy(false), Failed(false) {}
+	};
+
+	// Submits a task for every frame which can advance, oldest first. Called with Mtx locked
+	void Dispatch ()
+	{
+		if (Stopping)
+			return;
+		for (int64 seq = MAX(int64(0), St.Pushed - int64(Slots.size())); seq < St.Pushed; seq++) {
+			Slot& s = Slots[seq % Slots.size()];
+			if (!s.Used || s.Busy || s.Seq != seq)
+				continue;
+			Stage& st = Stages[s.Stage];
+			if (st.Mode == STAGE_ORDERED && (st.Busy || st.Next != s.Seq))
+				continue;
+
+			s.Busy = true;
+			if (st.Mode == STAGE_ORDERED)
+				st.Busy = true;
+			Outstanding++;
+			THREADPOOL::Submit ([this, &s] { RunStage(s); }, Class);
+		}
+	}
+
+	void RunStage (Slot& s)
+	{
+		Stage& st = Stages[s.Stage];
+		if (!s.Failed) {
+			std::exception_ptr err;
+			try {
+				st.Func (s.Frame, THREADPOOL::WorkerIndex());
+			}
+			catch (...) {
+				err = std::current_exception();
+			}
+			if (err) {
+				std::lock_guard<std::mutex> lock(Mtx);
+				s.Failed = true;
+				St.Failed++;
+				if (!Error)
+					Error = err;
+			}
+		}
+		if (s.Stage + 1 == int(Stages.size()))
+			s.Frame = T();												// Frames are released in their task, not in Push()
+
+		std::lock_guard<std::mutex> lock(Mtx);
+		s.Busy = false;
+		if (st.Mode == STAGE_ORDERED) {
+			st.Busy = false;
+			st.Next++;
+		}
+		if (++s.Stage == int(Stages.size())) {
+			s.Used = false;
+			St.Done++;
+			St.InFlight--;
+			SpaceCond.notify_all ();
+		}
+		Dispatch ();
+		if (--Outstanding == 0)
+			IdleCond.notify_all ();
+	}
+
+	void Rethrow (std::unique_lock<std::mutex>& lock)
+	{
+		if (Error) {
+			std::exception_ptr err = Error;
+			Error = nullptr;
+			lock.unlock ();
+			std::rethrow_exception (err);
+		}
+	}
+
+	TaskClass					Class;
+	std::vector<Stage>			Stages;
+	std::vector<Slot>			Slots;
+	std::mutex					Mtx;
+	std::condition_variable		SpaceCond;								// A slot got free
+	std::condition_variable		IdleCond;								// No task of ours is left in the pool
+	int							Outstanding;							// Tasks submitted and not finished
+	bool						Stopping;
+	std::exception_ptr			Error;									// First stage error not rethrown yet
+	Stats						St;
+};
+
+
+#endif // _FRAMEEXEC_H
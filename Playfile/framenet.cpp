@@ -0,0 +1,717 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  framenet.cpp
+ Purpose     :  Frames streamed over TCP to viewers on other machines
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "str.h"
+#include "framenet.h"
+#include "frameshm.h"
+#include "framepool.h"
+#include "resize.h"
+#include "tracer.h"
+
+#if PLATFORM == PLATFORM_WIN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET			socket_t;
+#define closesock		closesocket
+#define SHUT_RDWR		SD_BOTH
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+typedef int				socket_t;
+#define INVALID_SOCKET	(-1)
+#define closesock		close
+#endif
+
+
+namespace {
+
+const uint32	NET_MAGIC		= Bytes2Word32('F', 'N', 'E', 'T');
+const uint32	NET_REQUEST		= Bytes2Word32('F', 'N', 'R', 'Q');
+const uint32	NET_VERSION		= 1;
+const int		NET_POLL_MS		= 200;			// How soon Stop() is noticed
+const int		NET_TIMEOUT_MS	= 2000;			// A peer not sending or taking its part in time is dropped
+const int		NET_MAXBUFS		= 64;			// Buffers per writev() call
+const uint32	NET_MAXPLANE	= 1u << 30;		// Larger planes are taken for a broken stream
+
+
+// The first bytes a client sends. Both ends are little endian
+struct WireRequest
+{
+	uint32			Magic, Version;
+	uint32			Streams;
+	int32			Decimation, Codec;
+};
+
+
+// In front of every frame; Bytes of payload follow: ImageBytes of the image, DepthBytes of the depth
+struct WireHeader
+{
+	uint32			Magic, Bytes;
+	int64			N;
+	uint64			Timestamp;
+	int32			Width, Height, ImageType, ImageBytes;			// ImageBytes 0 - no image
+	int32			DepthWidth, DepthHeight, DepthUnits, DepthBytes;	// DepthBytes 0 - no depth
+	float			DepthScale;
+	int32			Codec;
+	AlignIntrinsics	Intrin;
+};
+
+
+struct NetBuf
+{
+	const void*		Data;
+	size_t			Size;
+};
+
+
+bool NetStartup ()
+{
+#if PLATFORM == PLATFORM_WIN
+	static bool started = false;
+	if (!started) {
+		WSADATA wsa;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+			return false;
+		started = true;
+	}
+#endif
+	return true;
+}
+
+
+void SetTimeouts (socket_t s)
+{
+#if PLATFORM == PLATFORM_WIN
+	DWORD tv = NET_TIMEOUT_MS;
+#else
+	timeval tv = { NET_TIMEOUT_MS / 1000, (NET_TIMEOUT_MS % 1000) * 1000 };
+#endif
+	int on = 1;
+	setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, (cchar*)&tv, sizeof(tv));
+	setsockopt (s, SOL_SOCKET, SO_SNDTIMEO, (cchar*)&tv, sizeof(tv));
+	setsockopt (s, IPPROTO_TCP, TCP_NODELAY, (cchar*)&on, sizeof(on));	// The end of a frame goes out at once
+}
+
+
+bool Readable (socket_t s, int ms)
+{
+	fd_set fds;
+	FD_ZERO (&fds);
+	FD_SET (s, &fds);
+	timeval tv = { ms / 1000, (ms % 1000) * 1000 };
+	return select(int(s) + 1, &fds, nullptr, nullptr, &tv) > 0;
+}
+
+
+bool RecvAll (socket_t s, void* data, size_t size)
+{
+	uint8* p = (uint8*)data;
+	while (size) {
+		int n = recv(s, (char*)p, int(MIN(size, size_t(1) << 30)), 0);
+		if (n <= 0)
+			return false;
+		p	 += n;
+		size -= n;
+	}
+	return true;
+}
+
+
+// Gathers up to NET_MAXBUFS buffers a call, the kernel takes them from where they are
+bool SendBufs (socket_t s, std::vector<NetBuf>& bufs)
+{
+	size_t i = 0;
+	while (i < bufs.size()) {
+		size_t nb = MIN(bufs.size() - i, size_t(NET_MAXBUFS));
+#if PLATFORM == PLATFORM_WIN
+		WSABUF v [NET_MAXBUFS];
+		for (size_t k = 0; k < nb; k++) {
+			v[k].buf = (char*)bufs[i + k].Data;
+			v[k].len = ULONG(bufs[i + k].Size);
+		}
+		DWORD sent;
+		if (WSASend(s, v, DWORD(nb), &sent, 0, nullptr, nullptr) != 0)
+			return false;
+		size_t n = sent;
+#else
+		iovec v [NET_MAXBUFS];
+		for (size_t k = 0; k < nb; k++) {
+			v[k].iov_base = (void*)bufs[i + k].Data;
+			v[k].iov_len  = bufs[i + k].Size;
+		}
+		msghdr msg;
+		memset (&msg, 0, sizeof(msg));
+		msg.msg_iov	   = v;
+		msg.msg_iovlen = nb;
+		ssize_t n = sendmsg(s, &msg, MSG_NOSIGNAL);							// writev() with flags: a client gone must not raise SIGPIPE
+		if (n <= 0)
+			return false;
+#endif
+		// A partial send resumes in the middle of a buffer
+		for (; n > 0 && size_t(n) >= bufs[i].Size; i++)
+			n -= bufs[i].Size;
+		if (n > 0) {
+			bufs[i].Data  = (const uint8*)bufs[i].Data + n;
+			bufs[i].Size -= n;
+		}
+	}
+	return true;
+}
+
+
+// One buffer for continuous data, a buffer per row otherwise
+void AddRows (std::vector<NetBuf>& bufs, const cv::Mat& m)
+{
+	size_t rowbytes = m.cols * m.elemSize();
+	if (m.isContinuous()) {
+		NetBuf b = { m.data, rowbytes * m.rows };
+		bufs.push_back (b);
+		return;
+	}
+	for (int y = 0; y < m.rows; y++) {
+		NetBuf b = { m.ptr<uint8>(y), rowbytes };
+		bufs.push_back (b);
+	}
+}
+
+
+// Zigzag varints of the differences from the left pixel: 1 byte for |d| < 64, 3 at most
+size_t DeltaEncode (const cv::Mat& m, uint8* out)
+{
+	uint8* o = out;
+	for (int y = 0; y < m.rows; y++) {
+		const uint16* p = m.ptr<uint16>(y);
+		int prev = 0;
+		for (int x = 0; x < m.cols; x++) {
+			int	   d = int(p[x]) - prev;
+			uint32 z = (uint32(d) << 1) ^ uint32(d >> 31);
+			prev = p[x];
+			if (z < 0x80)
+				*o++ = uint8(z);
+			else if (z < 0x4000) {
+				*o++ = uint8(z | 0x80);
+				*o++ = uint8(z >> 7);
+			}
+			else {
+				*o++ = uint8(z | 0x80);
+				*o++ = uint8((z >> 7) | 0x80);
+				*o++ = uint8(z >> 14);
+			}
+		}
+	}
+	return o - out;
+}
+
+
+// A plane announced by a header: w x h of type, sent in bytes, coded - the delta codec (16 bit planes only, up to 3 bytes a pixel)
+bool PlaneFits (int w, int h, int type, int32 bytes, bool coded)
+{
+	if (w <= 0 || h <= 0 || bytes <= 0)
+		return false;
+	uint64 plane = uint64(w) * uint64(h) * CV_ELEM_SIZE(type);
+	if (plane > NET_MAXPLANE)
+		return false;
+	return coded ? CV_ELEM_SIZE(type) == 2 && uint64(bytes) <= uint64(w) * uint64(h) * 3 : uint64(bytes) == plane;
+}
+
+
+bool DeltaDecode (const uint8* in, size_t n, cv::Mat& m)
+{
+	const uint8* end = in + n;
+	for (int y = 0; y < m.rows; y++) {
+		uint16* p = m.ptr<uint16>(y);
+		int prev = 0;
+		for (int x = 0; x < m.cols; x++) {
+			uint32 z = 0;
+			for (int shift = 0; ; shift += 7) {
+				if (in == end || shift > 14)
+					return false;
+				z |= uint32(*in & 0x7F) << shift;
+				if (!(*in++ & 0x80))
+					break;
+			}
+			prev = prev + int((z >> 1) ^ (0 - (z & 1)));
+			p[x] = uint16(prev);
+		}
+	}
+	return in == end;
+}
+
+
+template <class T> void DecimateNearest (const cv::Mat& src, cv::Mat& dst, int k)
+{
+	for (int y = 0; y < dst.rows; y++) {
+		const T* s = src.ptr<T>(y * k);
+		T*		 d = dst.ptr<T>(y);
+		for (int x = 0; x < dst.cols; x++)
+			d[x] = s[x * k];
+	}
+}
+
+
+// 8 bit images are area averaged; depth and the others take every k-th pixel, averaging would mix in the unknown zeros
+cv::Mat Decimate (const cv::Mat& src, int k)
+{
+	cv::Mat dst;
+	if (src.depth() == CV_8U && src.channels() <= 4) {
+		dst = FRAMEPOOL::NewMat(src.rows / k, src.cols / k, src.type());
+		AreaDownscale (src, dst, k);
+		return dst;
+	}
+	dst = FRAMEPOOL::NewMat(src.rows / k, src.cols / k, src.type());
+	switch (src.elemSize()) {
+		case 1:  DecimateNearest<uint8>  (src, dst, k);  break;
+		case 2:  DecimateNearest<uint16> (src, dst, k);  break;
+		case 4:  DecimateNearest<uint32> (src, dst, k);  break;
+		default: DecimateNearest<uint64> (src, dst, k);  break;
+	}
+	return dst;
+}
+
+} // namespace
+
+
+
+/*--------------------------------------------------------------------------*\
+ FrameNetRequest
+\*--------------------------------------------------------------------------*/
+
+bool FrameNetRequest::Parse (cchar* options)
+{
+	unsigned streams = 0;
+	while (options && *options) {
+		size_t len = strcspn(options, ",");
+		if (len == 5 && STRB::strequ(options, "image", 5))
+			streams |= FRAMENET_IMAGE;
+		else if (len == 5 && STRB::strequ(options, "depth", 5))
+			streams |= FRAMENET_DEPTH;
+		else if (len == 5 && STRB::strequ(options, "delta", 5))
+			Codec = FRAMENET_DELTA;
+		else if (len == 3 && STRB::strequ(options, "raw", 3))
+			Codec = FRAMENET_RAW;
+		else if (len > 4 && STRB::strequ(options, "dec=", 4)) {
+			Decimation = STRB::atoi32(options + 4);
+			if (Decimation < 1 || Decimation > RESIZE_MAXFACTOR)
+				return false;
+		}
+		else
+			return false;
+		options += len;
+		if (*options == ',')
+			options++;
+	}
+	if (streams)
+		Streams = streams;
+	return true;
+}
+
+
+
+/*--------------------------------------------------------------------------*\
+ FrameNetServer
+\*--------------------------------------------------------------------------*/
+
+// A frame published, with the variants the clients asked for
+struct FrameNetServer::Frame
+{
+	struct Variant
+	{
+		int					Decimation, Codec;
+		cv::Mat				Image, Depth;
+		AlignIntrinsics		Intrin;
+		std::vector<uint8>	ImageCode, DepthCode;					// FRAMENET_DELTA of the 16 bit planes
+	};
+
+	int64				Seq, N;
+	uint64				Timestamp;
+	cv::Mat				Image, Depth;
+	DepthUnits			Units;
+	float				Scale;
+	AlignIntrinsics		Intrin;
+	std::mutex			Mtx;
+	std::vector<std::unique_ptr<Variant>>	Variants;
+
+	// Made by the first client asking, under Mtx: the others asking for the same wait for it rather than make it again
+	const Variant& Get (int decimation, int codec)
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		for (auto& v : Variants)
+			if (v->Decimation == decimation && v->Codec == codec)
+				return *v;
+
+		TRACE_ZONE ("EncodeFrame", N);
+		std::unique_ptr<Variant> v (new Variant);
+		v->Decimation = decimation;
+		v->Codec	  = codec;
+		v->Intrin	  = Intrin;
+		v->Image	  = decimation > 1 && !Image.empty() ? Decimate(Image, decimation) : Image;
+		v->Depth	  = decimation > 1 && !Depth.empty() ? Decimate(Depth, decimation) : Depth;
+		if (decimation > 1 && Intrin.Width) {
+			// The pixel centers of the decimated depth
+			v->Intrin.Width  = Intrin.Width / decimation;
+			v->Intrin.Height = Intrin.Height / decimation;
+			v->Intrin.Ppx	 = (Intrin.Ppx + 0.5f) / decimation - 0.5f;
+			v->Intrin.Ppy	 = (Intrin.Ppy + 0.5f) / decimation - 0.5f;
+			v->Intrin.Fx	/= decimation;
+			v->Intrin.Fy	/= decimation;
+		}
+		if (codec == FRAMENET_DELTA) {
+			if (v->Image.type() == CV_16UC1) {
+				v->ImageCode.resize (v->Image.total() * 3);
+				v->ImageCode.resize (DeltaEncode(v->Image, v->ImageCode.data()));
+			}
+			if (v->Depth.type() == CV_16UC1) {
+				v->DepthCode.resize (v->Depth.total() * 3);
+				v->DepthCode.resize (DeltaEncode(v->Depth, v->DepthCode.data()));
+			}
+		}
+		Variants.push_back (std::move(v));
+		return *Variants.back();
+	}
+};
+
+
+struct FrameNetServer::Client
+{
+	socket_t			Sock;
+	FrameNetRequest		Req;
+	std::thread			Thread;
+	std::atomic<bool>	Done;
+};
+
+
+bool FrameNetServer::Start (cchar* addr)
+{
+	uint32 ip;
+	uint16 port;
+	if (Running || !NetStartup() || !STRB::str2addr(addr, &ip, &port))
+		return false;
+
+	sockaddr_in sa;
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family	   = AF_INET;
+	sa.sin_addr.s_addr = ip;				// IpAddr is in network order already
+	sa.sin_port		   = htons(port);
+	socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return false;
+#if PLATFORM != PLATFORM_WIN
+	int on = 1;
+	setsockopt (s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));	// Restarts don't wait for TIME_WAIT (on Windows it would allow stealing the port)
+#endif
+	socklen_t salen = sizeof(sa);
+	if (bind(s, (sockaddr*)&sa, sizeof(sa)) != 0 || listen(s, 16) != 0 || getsockname(s, (sockaddr*)&sa, &salen) != 0) {
+		closesock (s);
+		return false;
+	}
+	Listener   = intptr_t(s);
+	ServerPort = ntohs(sa.sin_port);
+	Running	   = true;
+	AcceptThread = std::thread(&FrameNetServer::AcceptProcess, this);
+	return true;
+}
+
+
+void FrameNetServer::Stop ()
+{
+	if (!Running)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		Running = false;
+	}
+	NewFrame.notify_all ();
+	AcceptThread.join ();
+
+	// Sends in progress fail at once
+	for (Client* c : ClientList) {
+		shutdown (c->Sock, SHUT_RDWR);
+		c->Thread.join ();
+		closesock (c->Sock);
+		delete c;
+	}
+	ClientList.clear ();
+	closesock (socket_t(Listener));
+	Listener   = -1;
+	ServerPort = 0;
+	Latest.reset ();
+}
+
+
+int FrameNetServer::Clients ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	int n = 0;
+	for (Client* c : ClientList)
+		n += !c->Done;
+	return n;
+}
+
+
+FrameNetServer::Stats FrameNetServer::GetStats ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	return St;
+}
+
+
+void FrameNetServer::Publish (int64 n, const cv::Mat& image, const DepthFrame& depth)
+{
+	if (!Running)
+		return;
+
+	TRACE_ZONE ("PublishFrame", n);
+	std::shared_ptr<Frame> f = std::make_shared<Frame>();
+	f->N		 = n;
+	f->Timestamp = FrameShmNow();
+	f->Image	 = image.empty() || image.u ? image : FRAMEPOOL::Clone(image);	// an SDK buffer may be reused by the next grab
+	f->Units	 = depth.Units;
+	f->Scale	 = depth.Scale;
+	f->Intrin	 = depth.Intrin;
+	if (!depth.Empty()) {
+		// The owner itself shares the buffer: a view of it is released with the caller's frame
+		cv::Mat view (depth.Height, depth.Width, depth.IsFloat() ? CV_32FC1 : CV_16UC1, (void*)depth.Data, depth.Stride);
+		const cv::Mat& hold = depth.Hold;
+		bool owned = hold.u && hold.data == depth.Data && hold.rows == depth.Height && hold.cols == depth.Width && hold.type() == view.type() && hold.step == view.step;
+		f->Depth = owned ? hold : FRAMEPOOL::Clone(view);
+	}
+
+	std::lock_guard<std::mutex> lock(Mtx);
+	f->Seq = Seq++;
+	Latest = f;
+	St.Published++;
+	NewFrame.notify_all ();
+}
+
+
+void FrameNetServer::AcceptProcess ()
+{
+	TRACER::SetThreadName ("frame server");
+	socket_t listener = socket_t(Listener);
+	while (Running) {
+		{
+			// Clients gone are joined here
+			std::lock_guard<std::mutex> lock(Mtx);
+			for (auto it = ClientList.begin(); it != ClientList.end(); ) {
+				Client* c = *it;
+				if (!c->Done) {
+					++it;
+					continue;
+				}
+				c->Thread.join ();
+				closesock (c->Sock);
+				delete c;
+				it = ClientList.erase(it);
+			}
+		}
+
+		if (!Readable(listener, NET_POLL_MS))
+			continue;
+		socket_t s = accept(listener, nullptr, nullptr);
+		if (s == INVALID_SOCKET)
+			continue;
+		SetTimeouts (s);
+
+		Client* c = new Client;
+		c->Sock = s;
+		c->Done = false;
+		std::lock_guard<std::mutex> lock(Mtx);
+		ClientList.push_back (c);
+		c->Thread = std::thread(&FrameNetServer::ClientProcess, this, c);
+	}
+}
+
+
+void FrameNetServer::ClientProcess (Client* c)
+{
+	TRACER::SetThreadName ("frame client");
+	WireRequest req;
+	if (RecvAll(c->Sock, &req, sizeof(req)) && req.Magic == NET_REQUEST && req.Version == NET_VERSION &&
+		req.Decimation >= 1 && req.Decimation <= RESIZE_MAXFACTOR && (req.Codec == FRAMENET_RAW || req.Codec == FRAMENET_DELTA)) {
+		c->Req.Streams	  = req.Streams;
+		c->Req.Decimation = req.Decimation;
+		c->Req.Codec	  = req.Codec;
+
+		int64 last = -1;
+		for (;;) {
+			std::shared_ptr<Frame> f;
+			{
+				std::unique_lock<std::mutex> lock(Mtx);
+				NewFrame.wait (lock, [&] { return !Running || (Latest && Latest->Seq > last); });
+				if (!Running)
+					break;
+				f = Latest;
+				if (last >= 0)
+					St.Skipped += f->Seq - last - 1;
+			}
+			last = f->Seq;
+			if (!SendFrame(c, *f))
+				break;
+		}
+	}
+	c->Done = true;
+}
+
+
+bool FrameNetServer::SendFrame (Client* c, Frame& f)
+{
+	const Frame::Variant& v = f.Get(c->Req.Decimation, c->Req.Codec);
+	bool image = (c->Req.Streams & FRAMENET_IMAGE) && !v.Image.empty();
+	bool depth = (c->Req.Streams & FRAMENET_DEPTH) && !v.Depth.empty();
+
+	WireHeader h;
+	memset (&h, 0, sizeof(h));
+	h.Magic		  = NET_MAGIC;
+	h.N			  = f.N;
+	h.Timestamp	  = f.Timestamp;
+	h.Codec		  = c->Req.Codec;
+	h.ImageType	  = -1;
+	std::vector<NetBuf> bufs;
+	NetBuf hb = { &h, sizeof(h) };
+	bufs.push_back (hb);
+	if (image) {
+		h.Width		 = v.Image.cols;
+		h.Height	 = v.Image.rows;
+		h.ImageType	 = v.Image.type();
+		if (!v.ImageCode.empty()) {
+			NetBuf b = { v.ImageCode.data(), v.ImageCode.size() };
+			bufs.push_back (b);
+		}
+		else
+			AddRows (bufs, v.Image);
+		h.ImageBytes = int32(v.ImageCode.empty() ? v.Image.total() * v.Image.elemSize() : v.ImageCode.size());
+	}
+	if (depth) {
+		h.DepthWidth  = v.Depth.cols;
+		h.DepthHeight = v.Depth.rows;
+		h.DepthUnits  = f.Units;
+		h.DepthScale  = f.Scale;
+		h.Intrin	  = v.Intrin;
+		if (!v.DepthCode.empty()) {
+			NetBuf b = { v.DepthCode.data(), v.DepthCode.size() };
+			bufs.push_back (b);
+		}
+		else
+			AddRows (bufs, v.Depth);
+		h.DepthBytes = int32(v.DepthCode.empty() ? v.Depth.total() * v.Depth.elemSize() : v.DepthCode.size());
+	}
+	h.Bytes = uint32(h.ImageBytes) + uint32(h.DepthBytes);
+
+	TRACE_ZONE ("SendFrame", f.N);
+	if (!SendBufs(c->Sock, bufs))
+		return false;
+	std::lock_guard<std::mutex> lock(Mtx);
+	St.Sent++;
+	St.Bytes += sizeof(h) + h.Bytes;
+	return true;
+}
+
+
+
+/*--------------------------------------------------------------------------*\
+ FrameNetClient
+\*--------------------------------------------------------------------------*/
+
+bool FrameNetClient::Connect (cchar* addr, const FrameNetRequest& req)
+{
+	Close();
+	uint32 ip;
+	uint16 port;
+	if (!NetStartup() || !STRB::str2addr(addr, &ip, &port))
+		return false;
+
+	sockaddr_in sa;
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family	   = AF_INET;
+	sa.sin_addr.s_addr = ip;
+	sa.sin_port		   = htons(port);
+	socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == INVALID_SOCKET)
+		return false;
+	SetTimeouts (s);
+
+	WireRequest wr;
+	wr.Magic	  = NET_REQUEST;
+	wr.Version	  = NET_VERSION;
+	wr.Streams	  = req.Streams;
+	wr.Decimation = req.Decimation;
+	wr.Codec	  = req.Codec;
+	if (connect(s, (sockaddr*)&sa, sizeof(sa)) != 0 || send(s, (cchar*)&wr, sizeof(wr), 0) != int(sizeof(wr))) {
+		closesock (s);
+		return false;
+	}
+	Sock = intptr_t(s);
+	return true;
+}
+
+
+void FrameNetClient::Close ()
+{
+	if (Sock != -1)
+		closesock (socket_t(Sock));
+	Sock = -1;
+}
+
+
+bool FrameNetClient::Receive (FrameNetFrame& frame, int timeoutms)
+{
+	socket_t s = socket_t(Sock);
+	if (Sock == -1 || !Readable(s, timeoutms))
+		return false;
+
+	// Sizes are checked before anything is allocated for them: a raw plane must be what its header describes
+	WireHeader h;
+	bool ok = RecvAll(s, &h, sizeof(h)) && h.Magic == NET_MAGIC && (h.Codec == FRAMENET_RAW || h.Codec == FRAMENET_DELTA) &&
+			  h.ImageBytes >= 0 && h.DepthBytes >= 0 && h.Bytes == uint32(h.ImageBytes) + uint32(h.DepthBytes);
+	bool imagecoded = ok && h.Codec == FRAMENET_DELTA && h.ImageType == CV_16UC1;
+	bool depthfloat = ok && (h.DepthUnits == DEPTH_M32F || h.DepthUnits == DEPTH_MM32F);
+	bool depthcoded = ok && h.Codec == FRAMENET_DELTA && !depthfloat;
+	ok = ok && (!h.ImageBytes || (h.ImageType >= 0 && h.ImageType <= CV_MAT_TYPE_MASK && CV_MAT_CN(h.ImageType) <= 4 &&
+								  PlaneFits(h.Width, h.Height, h.ImageType, h.ImageBytes, imagecoded))) &&
+			   (!h.DepthBytes || (uint32(h.DepthUnits) <= DEPTH_MM32F &&
+								  PlaneFits(h.DepthWidth, h.DepthHeight, depthfloat ? CV_32FC1 : CV_16UC1, h.DepthBytes, depthcoded)));
+
+	frame.Image = cv::Mat();
+	frame.Depth = DepthFrame();
+	if (ok && h.ImageBytes) {
+		cv::Mat m = FRAMEPOOL::NewMat(h.Height, h.Width, h.ImageType);
+		if (imagecoded) {
+			Code.resize (h.ImageBytes);
+			ok = RecvAll(s, Code.data(), Code.size()) && DeltaDecode(Code.data(), Code.size(), m);
+		}
+		else
+			ok = RecvAll(s, m.data, h.ImageBytes);
+		frame.Image = m;
+	}
+	if (ok && h.DepthBytes) {
+		cv::Mat m = FRAMEPOOL::NewMat(h.DepthHeight, h.DepthWidth, depthfloat ? CV_32FC1 : CV_16UC1);
+		if (depthcoded) {
+			Code.resize (h.DepthBytes);
+			ok = RecvAll(s, Code.data(), Code.size()) && DeltaDecode(Code.data(), Code.size(), m);
+		}
+		else
+			ok = RecvAll(s, m.data, h.DepthBytes);
+		frame.Depth = DepthFrame(DepthUnits(h.DepthUnits), h.DepthScale, m);
+		frame.Depth.Intrin = h.Intrin;
+	}
+	if (!ok) {
+		Close();
+		return false;
+	}
+	frame.N			= h.N;
+	frame.Timestamp = h.Timestamp;
+	frame.WireBytes = sizeof(h) + h.Bytes;
+	return true;
+}
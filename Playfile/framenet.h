@@ -0,0 +1,139 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  framenet.h
+ Purpose     :  Frames streamed over TCP to viewers on other machines
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _FRAMENET_H
+#define _FRAMENET_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+#include "depth.h"
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+enum FrameNetStreams
+{
+	FRAMENET_IMAGE		= 1,
+	FRAMENET_DEPTH		= 2
+};
+
+enum FrameNetCodec
+{
+	FRAMENET_RAW,												// As they are
+	FRAMENET_DELTA												// 16 bit planes as varint deltas from the left pixel, lossless; the others raw
+};
+
+
+// What a client asks the server for
+struct FrameNetRequest
+{
+	unsigned	Streams;										// FRAMENET_IMAGE | FRAMENET_DEPTH
+	int			Decimation;										// 1 .. RESIZE_MAXFACTOR: frames downscaled this many times
+	int			Codec;
+
+	FrameNetRequest () : Streams(FRAMENET_IMAGE | FRAMENET_DEPTH), Decimation(1), Codec(FRAMENET_RAW) {}
+	bool		Parse (cchar* options);							// "image", "depth", "dec=<n>", "delta" separated by commas. False if unknown
+};
+
+
+// A frame received. Image and Depth are pooled buffers of their own
+struct FrameNetFrame
+{
+	int64			N;
+	uint64			Timestamp;									// FrameShmNow() of the server's Publish(): latency means something on one machine only
+	cv::Mat			Image;										// Empty if not asked for or the server had none
+	DepthFrame		Depth;
+	size_t			WireBytes;									// Received for the frame, the header included
+
+	FrameNetFrame () : N(-1), Timestamp(0), WireBytes(0) {}
+};
+
+
+/*
+ ******************************************************************************
+  Streams the frames published to every client connected. A frame is a
+  header with the length of the payload following it: the image rows, then
+  the depth rows, sent by one sendmsg() / WSASend() straight from the frame
+  buffers. Decimated and compressed variants are made once per frame for
+  all the clients asking for them. Every client has a thread of its own;
+  Publish() only swaps the newest frame and never waits: a client still
+  sending an older frame gets the newest one next, skipping the others.
+ ******************************************************************************
+*/
+class FrameNetServer
+{
+  public:
+	struct Stats
+	{
+		int64		Published, Sent, Skipped;					// Skipped - frames clients got no time for
+		uint64		Bytes;
+	};
+
+	FrameNetServer () : Listener(-1), ServerPort(0), Running(false), Seq(0)	{ memset (&St, 0, sizeof(St)); }
+	~FrameNetServer ()									{ Stop(); }
+
+	bool	Start (cchar* addr);								// "[<ip>:]<port>", 127.0.0.1 unless an ip is given, port 0 - any free one
+	void	Stop ();
+	bool	IsRunning () const							{ return Running; }
+	int		Port () const								{ return ServerPort; }
+	int		Clients ();
+	Stats	GetStats ();
+
+	void	Publish (int64 n, const cv::Mat& image, const DepthFrame& depth);	// Views without a reference count are copied
+
+  private:
+	struct Frame;
+	struct Client;
+
+	void	AcceptProcess ();
+	void	ClientProcess (Client* c);
+	bool	SendFrame (Client* c, Frame& f);
+
+  private:
+	intptr_t					Listener;
+	int							ServerPort;
+	std::atomic<bool>			Running;
+	std::thread					AcceptThread;
+	std::mutex					Mtx;
+	std::condition_variable		NewFrame;
+	std::shared_ptr<Frame>		Latest;
+	int64						Seq;								// Frames published
+	std::list<Client*>			ClientList;
+	Stats						St;
+};
+
+
+/*
+ ******************************************************************************
+  Receives the frames of a FrameNetServer. The client reads the payload
+  right into pooled buffers.
+ ******************************************************************************
+*/
+class FrameNetClient
+{
+  public:
+	FrameNetClient () : Sock(-1)						{}
+	~FrameNetClient ()									{ Close(); }
+
+	bool	Connect (cchar* addr, const FrameNetRequest& req);	// "[<ip>:]<port>", 127.0.0.1 unless an ip is given
+	void	Close ();
+	bool	IsOpen () const								{ return Sock != -1; }
+
+	bool	Receive (FrameNetFrame& frame, int timeoutms);		// False on the timeout or when the connection is lost (closed then)
+
+  private:
+	intptr_t				Sock;
+	std::vector<uint8>		Code;								// Compressed plane received
+};
+
+
+#endif // _FRAMENET_H
@@ -0,0 +1,87 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  framepool-cv.cpp
+ Purpose     :  cv::Mat with the pixels in the frame buffer pool
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "framepool.h"
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+
+
+/*
+ ***************************************************************************
+ OpenCV allocator taking the pixels from the pool. The cv::Mat's reference
+ count (UMatData) is constructed in the block's header, so a pooled cv::Mat
+ costs no heap allocation either; all its copies share the block, the last
+ one gone returns it to the pool.
+ ***************************************************************************
+*/
+class PoolMatAllocator : public cv::MatAllocator
+{
+  public:
+	cv::UMatData* allocate (int dims, const int* sizes, int type, void* data, size_t* step, int flags, cv::UMatUsageFlags usage) const
+	{
+		if (data)	// the caller's memory, nothing to pool
+			return cv::Mat::getStdAllocator()->allocate (dims, sizes, type, data, step, flags, usage);
+
+		size_t total = CV_ELEM_SIZE(type);
+		for (int i = dims - 1; i >= 0; i--) {
+			if (step)
+				step[i] = total;
+			total *= sizes[i];
+		}
+
+		FrameBlock*	  b = FRAMEPOOL::Alloc (total);
+		cv::UMatData* u = new (b->Ext) cv::UMatData (this);
+		u->data = u->origdata = b->Data();
+		u->size	  = total;
+		u->handle = b;
+		return u;
+	}
+
+	bool allocate (cv::UMatData* u, int access, cv::UMatUsageFlags usage) const
+	{
+		return u != nullptr;
+	}
+
+	void deallocate (cv::UMatData* u) const
+	{
+		if (!u)
+			return;
+		FrameBlock* b = (FrameBlock*)u->handle;
+		u->~UMatData ();
+		FRAMEPOOL::Release (b->Data());
+	}
+};
+
+static_assert (sizeof(cv::UMatData) <= FRAMEPOOL_EXT, "FRAMEPOOL_EXT is too small for UMatData");
+
+
+// Never destroyed: pooled cv::Mat may still be released by destructors of other statics
+static PoolMatAllocator* MatAllocator ()
+{
+	static PoolMatAllocator* a = new PoolMatAllocator;
+	return a;
+}
+
+
+
+cv::Mat FRAMEPOOL::NewMat (int rows, int cols, int type)
+{
+	cv::Mat m;
+	m.allocator = MatAllocator();
+	m.create (rows, cols, type);
+	return m;
+}
+
+
+cv::Mat FRAMEPOOL::Clone (const cv::Mat& m)
+{
+	cv::Mat out = NewMat (m.rows, m.cols, m.type());
+	m.copyTo (out);
+	return out;
+}
@@ -0,0 +1,288 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  framepool.cpp
+ Purpose     :  Pool of reference counted frame buffers
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "framepool.h"
+
+#include <mutex>
+#include <new>
+
+#if PLATFORM == PLATFORM_WIN
+#include <windows.h>
+#include <malloc.h>
+#pragma comment(lib, "advapi32.lib")
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+
+namespace {
+
+const int		MINSHIFT	= 12;											// Smallest class, 4 KB
+const int		STEPBITS	= 3;											// 8 classes per power of two
+const int		MAXSHIFT	= 40;
+const int		CLASSES		= 1 + ((MAXSHIFT - MINSHIFT) << STEPBITS);
+const size_t	HUGEPAGE	= size_t(2) << 20;
+
+static_assert (sizeof(FrameBlock) % FRAMEPOOL_ALIGN == 0, "the data must stay aligned");
+
+
+int ClassOf (size_t bytes)
+{
+	if (bytes <= (size_t(1) << MINSHIFT))
+		return 0;
+	int e = MINSHIFT;	// 2^e <= bytes - 1 < 2^(e+1)
+	while ((bytes - 1) >> (e + 1))
+		e++;
+	return 1 + ((e - MINSHIFT) << STEPBITS) + int(((bytes - 1) >> (e - STEPBITS)) & ((1 << STEPBITS) - 1));
+}
+
+
+size_t ClassSize (int c)
+{
+	if (!c)
+		return size_t(1) << MINSHIFT;
+	int e = ((c - 1) >> STEPBITS) + MINSHIFT;
+	int k = (c - 1) & ((1 << STEPBITS) - 1);
+	return (size_t(1) << e) + (size_t(k + 1) << (e - STEPBITS));
+}
+
+
+size_t HugeBytes (size_t bytes)
+{
+#if PLATFORM == PLATFORM_WIN
+	size_t page = GetLargePageMinimum();
+#else
+	size_t page = HUGEPAGE;
+#endif
+	return page ? (bytes + page - 1) / page * page : 0;
+}
+
+
+// Raw memory for a block of bytes, the header included; nullptr if there is none
+FrameBlock* OsAlloc (size_t bytes, bool huge)
+{
+	void* p = nullptr;
+	if (huge) {
+		size_t n = HugeBytes(bytes);
+#if PLATFORM == PLATFORM_WIN
+		p = n ? VirtualAlloc(nullptr, n, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE) : nullptr;
+#else
+		p = mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			p = nullptr;
+  #ifdef MADV_HUGEPAGE
+		else
+			madvise (p, n, MADV_HUGEPAGE);
+  #endif
+#endif
+		if (p) {
+			FrameBlock* b = new (p) FrameBlock;
+			b->Huge = true;
+			return b;
+		}
+	}
+
+#if PLATFORM == PLATFORM_WIN
+	p = _aligned_malloc(bytes, FRAMEPOOL_ALIGN);
+#else
+	if (posix_memalign(&p, FRAMEPOOL_ALIGN, bytes))
+		p = nullptr;
+#endif
+	if (!p)
+		return nullptr;
+	FrameBlock* b = new (p) FrameBlock;
+	b->Huge = false;
+	return b;
+}
+
+
+void OsFree (FrameBlock* b)
+{
+	if (b->Huge) {
+#if PLATFORM == PLATFORM_WIN
+		VirtualFree (b, 0, MEM_RELEASE);
+#else
+		munmap (b, HugeBytes(sizeof(FrameBlock) + b->Capacity));
+#endif
+	}
+	else {
+#if PLATFORM == PLATFORM_WIN
+		_aligned_free (b);
+#else
+		free (b);
+#endif
+	}
+}
+
+
+struct Pool
+{
+	std::mutex			Mtx;												// Protects everything but Huge
+	FrameBlock*			Free [CLASSES];
+	size_t				Cached;
+	FRAMEPOOL::Stats	St;
+	std::atomic<bool>	Huge;
+
+	Pool () : Cached(0), Huge(false)		{ memset (Free, 0, sizeof(Free));  memset (&St, 0, sizeof(St)); }
+};
+
+
+// Never destroyed: buffers may still be released by destructors of other statics
+Pool& ThePool ()
+{
+	static Pool* p = new Pool;
+	return *p;
+}
+
+}
+
+
+
+FrameBuf FRAMEPOOL::Get (size_t bytes)
+{
+	return FrameBuf (Alloc(bytes));
+}
+
+
+void FRAMEPOOL::Release (void* data)
+{
+	if (data) {
+		FrameBuf b (FrameBlock::Of(data));	// takes the reference over, drops it when gone
+	}
+}
+
+
+FrameBlock* FRAMEPOOL::Alloc (size_t bytes)
+{
+	int c = ClassOf(bytes);
+	if (c >= CLASSES)
+		throw std::bad_alloc ();
+
+	Pool&		p	= ThePool();
+	size_t		cap = ClassSize(c);
+	FrameBlock* b;
+	{
+		std::lock_guard<std::mutex> lock(p.Mtx);
+		p.St.Gets++;
+		if ((b = p.Free[c]) != nullptr) {
+			p.Free[c] = b->Next;
+			p.Cached -= cap;
+			p.St.Hits++;
+		}
+		p.St.Used	  += cap;
+		p.St.PeakUsed  = MAX(p.St.PeakUsed, p.St.Used);
+		p.St.PeakReserved = MAX(p.St.PeakReserved, p.St.Used + p.Cached);
+	}
+
+	if (!b) {
+		b = OsAlloc (sizeof(FrameBlock) + cap, p.Huge && cap >= HUGEPAGE);
+		if (!b) {
+			std::lock_guard<std::mutex> lock(p.Mtx);
+			p.St.Used -= cap;
+			throw std::bad_alloc ();
+		}
+		b->Class	= c;
+		b->Capacity = cap;
+		if (b->Huge) {
+			std::lock_guard<std::mutex> lock(p.Mtx);
+			p.St.HugeBlocks++;
+		}
+	}
+
+	b->Refs.store (1, std::memory_order_relaxed);
+	b->Size = bytes;
+	b->Next = nullptr;
+	return b;
+}
+
+
+void FRAMEPOOL::Free (FrameBlock* b)
+{
+	Pool& p = ThePool();
+	bool  keep;
+	{
+		std::lock_guard<std::mutex> lock(p.Mtx);
+		p.St.Used -= b->Capacity;
+		keep = p.Cached + b->Capacity <= UTILS_FRAMEPOOL_MAXCACHED;
+		if (keep) {
+			b->Next = p.Free[b->Class];
+			p.Free[b->Class] = b;
+			p.Cached += b->Capacity;
+		}
+	}
+	if (!keep)
+		OsFree (b);
+}
+
+
+bool FRAMEPOOL::UseHugePages (bool on)
+{
+	bool ok = !on;
+	if (on) {
+#if PLATFORM == PLATFORM_WIN
+		// Large pages need the "Lock pages in memory" privilege enabled in the process token
+		HANDLE			 token = nullptr;
+		TOKEN_PRIVILEGES tp;
+		tp.PrivilegeCount = 1;
+		tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		ok = OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token) &&
+			 LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+			 AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS &&
+			 GetLargePageMinimum() > 0;
+		if (token)
+			CloseHandle (token);
+#elif defined(MADV_HUGEPAGE)
+		ok = true;	// transparent huge pages, the kernel decides
+#endif
+	}
+	ThePool().Huge = on && ok;
+	return ok;
+}
+
+
+void FRAMEPOOL::Trim ()
+{
+	Pool&		p = ThePool();
+	FrameBlock* lists [CLASSES];
+	{
+		std::lock_guard<std::mutex> lock(p.Mtx);
+		memcpy (lists, p.Free, sizeof(lists));
+		memset (p.Free, 0, sizeof(p.Free));
+		p.Cached = 0;
+	}
+	for (FrameBlock* b : lists) {
+		while (b) {
+			FrameBlock* next = b->Next;
+			OsFree (b);
+			b = next;
+		}
+	}
+}
+
+
+FRAMEPOOL::Stats FRAMEPOOL::GetStats ()
+{
+	Pool& p = ThePool();
+	std::lock_guard<std::mutex> lock(p.Mtx);
+	Stats s = p.St;
+	s.Cached   = p.Cached;
+	s.Reserved = s.Used + s.Cached;
+	return s;
+}
+
+
+void FRAMEPOOL::PrintStats ()
+{
+	Stats s = GetStats();
+	printf ("Frame pool: %.1f MB used, %.1f MB free, peak %.1f MB used, %.1f MB reserved\n"
+	        "  gets %llu, hits %.1f%%, large page buffers %llu\n",
+			s.Used / 1048576., s.Cached / 1048576., s.PeakUsed / 1048576., s.PeakReserved / 1048576.,
+			s.Gets, s.Gets ? 100. * s.Hits / s.Gets : 0., s.HugeBlocks);
+}
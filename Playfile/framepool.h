@@ -0,0 +1,135 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  framepool.h
+ Purpose     :  Pool of reference counted frame buffers
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  FRAMEPOOL::Get() hands out raw buffers, FRAMEPOOL::NewMat()
+				cv::Mat whose pixels live in the pool (framepool-cv.cpp,
+				the only part depending on OpenCV).
+\**********************************************************************/
+
+#ifndef _FRAMEPOOL_H
+#define _FRAMEPOOL_H
+
+#include <atomic>
+#include <utility>
+
+namespace cv { class Mat; }
+
+
+enum
+{
+	FRAMEPOOL_ALIGN		= 64,							// Data alignment, a cache line
+	FRAMEPOOL_EXT		= 160							// Bytes for an object living with the buffer, the cv::Mat's UMatData
+};
+
+
+/*
+ ***************************************************************************
+ Header in front of the data of every pooled buffer, the reference count
+ included: a handle is a single pointer and a data pointer leads back to
+ its buffer.
+ ***************************************************************************
+*/
+struct alignas(FRAMEPOOL_ALIGN) FrameBlock
+{
+	std::atomic<int>	Refs;
+	int					Class;											// Size class, the free list it returns to
+	size_t				Size;											// Bytes asked for
+	size_t				Capacity;										// Data bytes of the class
+	FrameBlock*			Next;											// In the free list
+	bool				Huge;											// Allocated on large pages
+	alignas(16) uint8	Ext [FRAMEPOOL_EXT];
+
+	uint8*				Data ()				{ return (uint8*)(this + 1); }
+	static FrameBlock*	Of (void* data)		{ return (FrameBlock*)data - 1; }
+};
+
+
+/*
+ ***************************************************************************
+ Handle of a pooled buffer. Copies share the buffer, the last handle gone
+ returns it to the pool. A reference may also be passed on as the plain
+ data pointer (Detach), e.g. to an SDK taking a deleter callback, which
+ gives it back with FRAMEPOOL::Release().
+ ***************************************************************************
+*/
+class FrameBuf
+{
+  public:
+	FrameBuf () : Blk(nullptr) {}
+	FrameBuf (const FrameBuf& b) : Blk(b.Blk)	{ if (Blk) Blk->Refs.fetch_add (1, std::memory_order_relaxed); }
+	FrameBuf (FrameBuf&& b) : Blk(b.Blk)		{ b.Blk = nullptr; }
+	~FrameBuf ()								{ Reset(); }
+
+	FrameBuf&	operator = (const FrameBuf& b)	{ FrameBuf t(b); Swap(t); return *this; }
+	FrameBuf&	operator = (FrameBuf&& b)		{ FrameBuf t(std::move(b)); Swap(t); return *this; }
+	void		Swap (FrameBuf& b)				{ FrameBlock* t = Blk; Blk = b.Blk; b.Blk = t; }
+
+	bool		Empty () const					{ return !Blk; }
+	uint8*		Data () const					{ return Blk ? Blk->Data() : nullptr; }
+	size_t		Size () const					{ return Blk ? Blk->Size : 0; }
+	int			Refs () const					{ return Blk ? Blk->Refs.load() : 0; }
+	void		Reset ();											// Drops the reference
+	uint8*		Detach ()						{ uint8* d = Data(); Blk = nullptr; return d; }		// The reference goes with the pointer
+
+  private:
+	friend class FRAMEPOOL;
+	explicit FrameBuf (FrameBlock* b) : Blk(b) {}
+
+	FrameBlock*	Blk;
+};
+
+
+/*
+ ***************************************************************************
+ Frame buffers of all stages come from here. Sizes are rounded up to one of
+ 8 classes per power of two (at most 12.5% more, 4 KB at least); a released
+ buffer goes to the free list of its class and the next request of the
+ class takes it, so a steady stream of frames of the same sizes does no
+ heap allocation. Free buffers above UTILS_FRAMEPOOL_MAXCACHED are given
+ back to the OS. Large pages (UseHugePages) cut TLB misses on big frames;
+ Windows grants them only with the "Lock pages in memory" privilege.
+ ***************************************************************************
+*/
+class FRAMEPOOL
+{
+  public:
+	struct Stats
+	{
+		uint64		Gets;												// Buffers handed out
+		uint64		Hits;												// Of them taken from a free list
+		size_t		Used, PeakUsed;										// Bytes in buffers being used
+		size_t		Cached;												// Bytes in free buffers
+		size_t		Reserved, PeakReserved;								// Used + Cached
+		uint64		HugeBlocks;											// Allocated on large pages
+	};
+
+	static FrameBuf	Get (size_t bytes);									// Throws std::bad_alloc as new does
+	static cv::Mat	NewMat (int rows, int cols, int type);				// A pooled cv::Mat, its copies share the buffer
+	static cv::Mat	Clone (const cv::Mat& m);							// m.clone() into a pooled cv::Mat
+	static void		Release (void* data);								// Drops a reference passed on by FrameBuf::Detach()
+
+	static bool		UseHugePages (bool on);								// For new buffers of 2 MB and more. Returns false if the OS refuses
+	static void		Trim ();											// Frees all the free buffers
+	static Stats	GetStats ();
+	static void		PrintStats ();
+
+  private:
+	friend class FrameBuf;
+	friend class PoolMatAllocator;
+	static FrameBlock*	Alloc (size_t bytes);
+	static void			Free (FrameBlock* b);
+};
+
+
+inline void FrameBuf::Reset ()
+{
+	if (Blk && Blk->Refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		FRAMEPOOL::Free (Blk);
+	Blk = nullptr;
+}
+
+
+#endif // _FRAMEPOOL_H
@@ -0,0 +1,485 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  frameshm.cpp
+ Purpose     :  Frames shared between processes in a shared memory ring
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "str.h"
+#include "frameshm.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if PLATFORM == PLATFORM_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+const uint32	SHM_MAGIC	= Bytes2Word32('F', 'S', 'H', 'M');
+const uint32	SHM_VERSION	= 1;
+const size_t	SHM_PAGE	= 4096;
+const size_t	SHM_SLOTHDR	= 256;											// Slot header, the image follows
+const size_t	SHM_LINE	= 64;											// The depth starts on a cache line
+
+static_assert (ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "the segment's atomics must be lock free to work between processes");
+
+
+// The first page of the segment. Written by the producer only: readers map it read-only
+struct SegHeader
+{
+	uint32					Magic, Version;
+	int32					Nslots, Pad;
+	uint64					SlotBytes;										// Multiple of SHM_PAGE
+	uint64					ImageBytes, DepthBytes;
+	std::atomic<int64>		Published;										// Frames published, Seq of the next one
+	std::atomic<uint32>		Wake;											// Low bits of Published, the futex readers wait on
+	std::atomic<uint32>		Closed;
+};
+
+
+// Seq is 2 * seq + 1 while frame #seq is written into the slot, 2 * seq + 2 once it's published
+struct SlotHeader
+{
+	std::atomic<uint64>		Seq;
+	int64					N;
+	uint64					Timestamp;
+	int32					Width, Height, ImageType, ImageStride;			// ImageType < 0 - no image
+	int32					DepthWidth, DepthHeight, DepthUnits, DepthStride;	// DepthWidth 0 - no depth
+	float					DepthScale;
+	AlignIntrinsics			Intrin;
+};
+
+static_assert (sizeof(SegHeader) <= SHM_PAGE && sizeof(SlotHeader) <= SHM_SLOTHDR, "segment headers");
+
+
+size_t RoundUp (size_t n, size_t to)
+{
+	return (n + to - 1) / to * to;
+}
+
+
+SlotHeader* SlotOf (const uint8* map, int64 seq)
+{
+	const SegHeader* h = (const SegHeader*)map;
+	return (SlotHeader*)(map + SHM_PAGE + size_t(seq % h->Nslots) * h->SlotBytes);
+}
+
+
+uint8* ImageOf (SlotHeader* s)
+{
+	return (uint8*)s + SHM_SLOTHDR;
+}
+
+
+uint8* DepthOf (const SegHeader* h, SlotHeader* s)
+{
+	return (uint8*)s + SHM_SLOTHDR + RoundUp(size_t(h->ImageBytes), SHM_LINE);
+}
+
+
+// Consistent sizes: the segment may come from another build or a producer which crashed
+bool CheckHeader (const uint8* map, size_t bytes)
+{
+	const SegHeader* h = (const SegHeader*)map;
+	return bytes >= SHM_PAGE && h->Magic == SHM_MAGIC && h->Version == SHM_VERSION && h->Nslots > 0 &&
+		   h->SlotBytes >= SHM_SLOTHDR + RoundUp(size_t(h->ImageBytes), SHM_LINE) + h->DepthBytes &&
+		   SHM_PAGE + uint64(h->Nslots) * h->SlotBytes <= bytes;
+}
+
+
+size_t DepthPixelBytes (DepthUnits units)
+{
+	return (units == DEPTH_M32F || units == DEPTH_MM32F) ? sizeof(float) : sizeof(uint16);
+}
+
+
+void SegmentName (cchar* name, STRING& out)
+{
+#if PLATFORM == PLATFORM_WIN
+	out = "Local\\frameshm.";
+#else
+	out = "/frameshm.";
+#endif
+	out += name;
+}
+
+
+void WakeReaders (SegHeader* h)
+{
+	h->Wake.store (uint32(h->Published.load(std::memory_order_relaxed)), std::memory_order_release);
+#if PLATFORM != PLATFORM_WIN
+	syscall (SYS_futex, &h->Wake, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);	// shared futex: the readers are other processes
+#endif
+}
+
+
+// Waits while Wake is still wake, up to ms. Windows has no wait on an address between processes: readers poll
+void WaitWake (const SegHeader* h, uint32 wake, int ms)
+{
+#if PLATFORM == PLATFORM_WIN
+	for (int i = 0; i < 100 && h->Wake.load(std::memory_order_acquire) == wake; i++)
+		std::this_thread::yield();
+	if (h->Wake.load(std::memory_order_acquire) == wake)
+		Sleep (MIN(ms, 1));
+#else
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+	syscall (SYS_futex, &h->Wake, FUTEX_WAIT, wake, &ts, nullptr, 0);
+#endif
+}
+
+
+// Maps the segment name, creating it with bytes if bytes > 0. Returns the size mapped, 0 on failure
+size_t MapSegment (cchar* name, size_t bytes, bool write, intptr_t& handle, uint8*& map)
+{
+	STRING sname;
+	SegmentName (name, sname);
+	map = nullptr;
+#if PLATFORM == PLATFORM_WIN
+	HANDLE h = bytes ? CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64(bytes) >> 32), DWORD(bytes), sname)
+					 : OpenFileMappingA(FILE_MAP_READ, FALSE, sname);
+	if (!h)
+		return 0;
+	map = (uint8*)MapViewOfFile(h, write ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION mbi;
+	if (!map || !VirtualQuery(map, &mbi, sizeof(mbi))) {
+		if (map)
+			UnmapViewOfFile (map);
+		CloseHandle (h);
+		map = nullptr;
+		return 0;
+	}
+	handle = intptr_t(h);
+	return mbi.RegionSize;													// Of an existing mapping, whatever size was asked
+#else
+	int fd = shm_open(sname, bytes ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+	struct stat st;
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || (st.st_size == 0 && bytes && ftruncate(fd, off_t(bytes)) < 0) || fstat(fd, &st) < 0 || st.st_size == 0) {
+		close (fd);
+		return 0;
+	}
+	void* p = mmap(nullptr, size_t(st.st_size), write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		close (fd);
+		return 0;
+	}
+	map	   = (uint8*)p;
+	handle = fd;
+	return size_t(st.st_size);
+#endif
+}
+
+
+void UnmapSegment (const uint8* map, size_t bytes, intptr_t handle)
+{
+#if PLATFORM == PLATFORM_WIN
+	UnmapViewOfFile (map);
+	CloseHandle (HANDLE(handle));
+#else
+	munmap ((void*)map, bytes);
+	close (int(handle));
+#endif
+}
+
+} // namespace
+
+
+
+uint64 FrameShmNow ()
+{
+	// steady_clock is CLOCK_MONOTONIC / QueryPerformanceCounter, common to all the processes
+	return uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+
+
+/*--------------------------------------------------------------------------*\
+ FrameShmWriter
+\*--------------------------------------------------------------------------*/
+
+bool FrameShmWriter::Create (cchar* name, int nslots, size_t imagebytes, size_t depthbytes)
+{
+	Close();
+	if (nslots < 2)
+		return false;
+
+	size_t slotbytes = RoundUp(SHM_SLOTHDR + RoundUp(imagebytes, SHM_LINE) + depthbytes, SHM_PAGE);
+	size_t bytes	 = SHM_PAGE + nslots * slotbytes;
+	size_t mapped	 = MapSegment(name, bytes, true, Handle, Map);
+	if (!mapped)
+		return false;
+
+	// Left by a producer which crashed: taken over if its slots are large enough
+	SegHeader* h = (SegHeader*)Map;
+	if (h->Magic && !(CheckHeader(Map, mapped) && h->Nslots == nslots && h->ImageBytes >= imagebytes && h->DepthBytes >= depthbytes)) {
+		h->Closed = 1;
+		WakeReaders (h);
+		UnmapSegment (Map, mapped, Handle);
+		Map = nullptr;
+#if PLATFORM == PLATFORM_WIN
+		return false;														// Exists while anybody maps it
+#else
+		STRING sname;
+		SegmentName (name, sname);
+		shm_unlink (sname);
+		if (!(mapped = MapSegment(name, bytes, true, Handle, Map)))
+			return false;
+		h = (SegHeader*)Map;
+#endif
+	}
+	if (!h->Magic) {
+		if (mapped < bytes) {
+			UnmapSegment (Map, mapped, Handle);
+			Map = nullptr;
+			return false;
+		}
+		h->Nslots	  = nslots;
+		h->SlotBytes  = slotbytes;
+		h->ImageBytes = imagebytes;
+		h->DepthBytes = depthbytes;
+		h->Published  = 0;
+		h->Wake		  = 0;
+		h->Version	  = SHM_VERSION;
+		h->Magic	  = SHM_MAGIC;											// Readers check the magic first
+	}
+	h->Closed = 0;
+	Bytes	  = mapped;
+	Name	  = name;
+	Next	  = h->Published;												// Taken over: the readers go on from where they were
+	Writing	  = false;
+	return true;
+}
+
+
+void FrameShmWriter::Close ()
+{
+	if (!Map)
+		return;
+	SegHeader* h = (SegHeader*)Map;
+	h->Closed = 1;
+	WakeReaders (h);
+	UnmapSegment (Map, Bytes, Handle);
+#if PLATFORM != PLATFORM_WIN
+	STRING sname;
+	SegmentName (Name, sname);
+	shm_unlink (sname);														// The readers keep their mappings until they close them
+#endif
+	Map	   = nullptr;
+	Handle = -1;
+}
+
+
+bool FrameShmWriter::Begin (int64 n, int width, int height, int imagetype, cv::Mat& image)
+{
+	SegHeader* h = (SegHeader*)Map;
+	if (!Map || width < 0 || height < 0 || (imagetype >= 0 && size_t(width) * height * CV_ELEM_SIZE(imagetype) > h->ImageBytes))
+		return false;
+
+	// The odd Seq reaches the readers before any byte of the slot changes
+	SlotHeader* s = SlotOf(Map, Next);
+	s->Seq.store (2 * Next + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence (std::memory_order_release);
+
+	s->N		   = n;
+	s->Timestamp   = FrameShmNow();
+	s->Width	   = width;
+	s->Height	   = height;
+	s->ImageType   = imagetype;
+	s->ImageStride = imagetype >= 0 ? width * CV_ELEM_SIZE(imagetype) : 0;
+	s->DepthWidth  = 0;
+	Writing = true;
+
+	image = imagetype >= 0 ? cv::Mat(height, width, imagetype, ImageOf(s), s->ImageStride) : cv::Mat();
+	return true;
+}
+
+
+bool FrameShmWriter::BeginDepth (DepthUnits units, float scale, int width, int height, const AlignIntrinsics& intrin, cv::Mat& depth)
+{
+	SegHeader* h = (SegHeader*)Map;
+	size_t pixbytes = DepthPixelBytes(units);
+	if (!Writing || width <= 0 || height <= 0 || size_t(width) * height * pixbytes > h->DepthBytes)
+		return false;
+
+	SlotHeader* s = SlotOf(Map, Next);
+	s->DepthWidth  = width;
+	s->DepthHeight = height;
+	s->DepthUnits  = units;
+	s->DepthStride = int32(width * pixbytes);
+	s->DepthScale  = scale;
+	s->Intrin	   = intrin;
+
+	depth = cv::Mat(height, width, pixbytes == sizeof(float) ? CV_32FC1 : CV_16UC1, DepthOf(h, s), s->DepthStride);
+	return true;
+}
+
+
+int64 FrameShmWriter::Publish ()
+{
+	if (!Writing)
+		return -1;
+	SegHeader*	h = (SegHeader*)Map;
+	SlotHeader* s = SlotOf(Map, Next);
+	s->Seq.store (2 * Next + 2, std::memory_order_release);
+	h->Published.store (Next + 1, std::memory_order_release);
+	WakeReaders (h);
+	Writing = false;
+	return Next++;
+}
+
+
+int64 FrameShmWriter::Write (int64 n, const cv::Mat& image, const DepthFrame& depth)
+{
+	SegHeader* h = (SegHeader*)Map;
+	if (!Map || (!depth.Empty() && size_t(depth.Width) * depth.Height * DepthPixelBytes(depth.Units) > h->DepthBytes))
+		return -1;
+
+	cv::Mat img, dth;
+	if (!Begin(n, image.cols, image.rows, image.empty() ? -1 : image.type(), img))
+		return -1;
+	if (!image.empty()) {
+		size_t rowbytes = image.cols * image.elemSize();
+		for (int y = 0; y < image.rows; y++)
+			memcpy (img.ptr<uint8>(y), image.ptr<uint8>(y), rowbytes);
+	}
+	if (!depth.Empty() && BeginDepth(depth.Units, depth.Scale, depth.Width, depth.Height, depth.Intrin, dth)) {
+		size_t rowbytes = dth.cols * dth.elemSize();
+		for (int y = 0; y < depth.Height; y++)
+			memcpy (dth.ptr<uint8>(y), (const uint8*)depth.Data + y * depth.Stride, rowbytes);
+	}
+	return Publish();
+}
+
+
+
+/*--------------------------------------------------------------------------*\
+ FrameShmReader
+\*--------------------------------------------------------------------------*/
+
+bool FrameShmReader::Open (cchar* name)
+{
+	Close();
+	uint8* map;
+	Bytes = MapSegment(name, 0, false, Handle, map);
+	if (!Bytes)
+		return false;
+	if (!CheckHeader(map, Bytes)) {
+		UnmapSegment (map, Bytes, Handle);
+		Bytes = 0;
+		return false;
+	}
+	Map	  = map;
+	Last  = -1;
+	Nlost = 0;
+	return true;
+}
+
+
+void FrameShmReader::Close ()
+{
+	if (Map)
+		UnmapSegment (Map, Bytes, Handle);
+	Map	   = nullptr;
+	Handle = -1;
+}
+
+
+bool FrameShmReader::Closed () const
+{
+	return !Map || ((const SegHeader*)Map)->Closed.load(std::memory_order_acquire);
+}
+
+
+bool FrameShmReader::Next (FrameShmView& view, int timeoutms, bool latest)
+{
+	if (!Map)
+		return false;
+	const SegHeader* h = (const SegHeader*)Map;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutms);
+
+	for (;;) {
+		uint32 wake	  = h->Wake.load(std::memory_order_acquire);
+		bool   closed = h->Closed.load(std::memory_order_acquire) != 0;		// The frames published before are still there
+		int64  pub	  = h->Published.load(std::memory_order_acquire);
+		if (pub - 1 > Last) {
+			// The slot of frame pub - Nslots may be being written already
+			int64 seq = (latest || Last < 0) ? pub - 1 : MAX(Last + 1, pub - h->Nslots + 1);
+			if (Last >= 0)
+				Nlost += seq - Last - 1;
+			Last = seq;
+			if (Take(seq, view))
+				return true;
+			Nlost++;														// Overwritten while being read
+			continue;
+		}
+
+		if (closed)
+			return false;
+		int ms = int(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count());
+		if (ms <= 0)
+			return false;
+		WaitWake (h, wake, ms);
+	}
+}
+
+
+bool FrameShmReader::Take (int64 seq, FrameShmView& view)
+{
+	const SegHeader* h = (const SegHeader*)Map;
+	SlotHeader*		 s = SlotOf(Map, seq);
+	uint64			 v = s->Seq.load(std::memory_order_acquire);
+	if (v != uint64(2 * seq + 2))
+		return false;
+
+	SlotHeader hdr;
+	memcpy ((void*)&hdr, s, sizeof(hdr));									// Copied, then checked: the producer may be changing it
+	std::atomic_thread_fence (std::memory_order_acquire);
+	if (s->Seq.load(std::memory_order_relaxed) != v)
+		return false;
+
+	// Sizes within the slot, the views must not reach out of the segment
+	if ((hdr.ImageType >= 0 && (hdr.Width < 0 || hdr.Height < 0 || hdr.ImageStride < hdr.Width * int(CV_ELEM_SIZE(hdr.ImageType)) ||
+								 uint64(hdr.ImageStride) * hdr.Height > h->ImageBytes)) ||
+		(hdr.DepthWidth && (hdr.DepthWidth < 0 || hdr.DepthHeight < 0 || uint32(hdr.DepthUnits) > DEPTH_MM32F ||
+							uint64(hdr.DepthStride) < hdr.DepthWidth * DepthPixelBytes(DepthUnits(hdr.DepthUnits)) ||
+							uint64(hdr.DepthStride) * hdr.DepthHeight > h->DepthBytes)))
+		return false;
+
+	view.Seq	   = seq;
+	view.N		   = hdr.N;
+	view.Timestamp = hdr.Timestamp;
+	view.Slot	   = s;
+	view.Image	   = hdr.ImageType >= 0 ? cv::Mat(hdr.Height, hdr.Width, hdr.ImageType, ImageOf(s), hdr.ImageStride) : cv::Mat();
+	if (hdr.DepthWidth) {
+		view.Depth = DepthFrame(DepthUnits(hdr.DepthUnits), hdr.DepthScale, hdr.DepthWidth, hdr.DepthHeight, DepthOf(h, s), hdr.DepthStride);
+		view.Depth.Intrin = hdr.Intrin;
+	}
+	else
+		view.Depth = DepthFrame();
+	return true;
+}
+
+
+bool FrameShmReader::Valid (const FrameShmView& view) const
+{
+	if (!Map || !view.Slot)
+		return false;
+	std::atomic_thread_fence (std::memory_order_acquire);
+	return ((const SlotHeader*)view.Slot)->Seq.load(std::memory_order_relaxed) == uint64(2 * view.Seq + 2);
+}
@@ -0,0 +1,120 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  frameshm.h
+ Purpose     :  Frames shared between processes in a shared memory ring
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _FRAMESHM_H
+#define _FRAMESHM_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+#include "depth.h"
+
+
+/*
+ ******************************************************************************
+  A frame taken from the ring: Image and Depth are views of the slot in the
+  shared memory, mapped read-only, nothing is copied. The producer may reuse
+  the slot at any time, so a reader checks FrameShmReader::Valid() after it
+  has used the data (or copied what it keeps) and drops its results if the
+  frame was overwritten meanwhile.
+ ******************************************************************************
+*/
+struct FrameShmView
+{
+	int64			Seq;													// Frames published before this one
+	int64			N;														// Frame number given by the producer
+	uint64			Timestamp;												// FrameShmNow() when the producer started to write it
+	cv::Mat			Image;													// Empty if the producer had no image
+	DepthFrame		Depth;													// Empty if the producer had no depth
+	const void*		Slot;
+
+	FrameShmView () : Seq(-1), N(-1), Timestamp(0), Slot(nullptr) {}
+};
+
+
+/*
+ ******************************************************************************
+  Producer side. The segment is a header and a ring of slots, each with a
+  seqlock: the sequence number is odd while the slot is being written and
+  even once the frame is published. The producer never waits for anybody:
+  it does not know its readers, it only overwrites the oldest slot.
+  Write() copies a frame in; Begin() and Publish() let the producer render
+  a frame right into the slot. A segment left by a producer which crashed
+  is taken over if its slots fit, otherwise replaced (Linux only);
+  the readers of a segment replaced or closed see it Closed().
+ ******************************************************************************
+*/
+class FrameShmWriter
+{
+  public:
+	FrameShmWriter () : Map(nullptr), Bytes(0), Handle(-1), Next(0), Writing(false)	{}
+	~FrameShmWriter ()										{ Close(); }
+
+	// Slots for images and depth up to the sizes given, in bytes. False if the segment can't be created
+	bool	Create (cchar* name, int nslots, size_t imagebytes, size_t depthbytes);
+	void	Close ();
+	bool	IsOpen () const									{ return Map != nullptr; }
+
+	int64	Write (int64 n, const cv::Mat& image, const DepthFrame& depth);	// Returns the frame's Seq, -1 if it doesn't fit a slot
+
+	// The slot of the next frame as views to fill, tightly packed; Publish() makes the frame visible.
+	// imagetype < 0 - no image; BeginDepth() is optional. False if it doesn't fit a slot
+	bool	Begin (int64 n, int width, int height, int imagetype, cv::Mat& image);
+	bool	BeginDepth (DepthUnits units, float scale, int width, int height, const AlignIntrinsics& intrin, cv::Mat& depth);
+	int64	Publish ();														// Returns the frame's Seq
+
+	int64	Published () const								{ return Next; }
+
+  private:
+	uint8*		Map;
+	size_t		Bytes;
+	intptr_t	Handle;														// File mapping (Windows) or descriptor (Linux) of the segment, -1 if none
+	STRING		Name;
+	int64		Next;														// Seq of the next frame
+	bool		Writing;													// Between Begin() and Publish()
+};
+
+
+/*
+ ******************************************************************************
+  Consumer side, maps the segment read-only: any number of readers, in this
+  process or others, cost the producer nothing. A reader falling behind
+  loses frames, Lost() counts them.
+ ******************************************************************************
+*/
+class FrameShmReader
+{
+  public:
+	FrameShmReader () : Map(nullptr), Bytes(0), Handle(-1), Last(-1), Nlost(0)	{}
+	~FrameShmReader ()										{ Close(); }
+
+	bool	Open (cchar* name);												// False while there is no such segment
+	void	Close ();
+	bool	IsOpen () const									{ return Map != nullptr; }
+	bool	Closed () const;												// The producer has closed or replaced the segment
+
+	// Waits up to timeoutms for a frame newer than the last one taken. latest - the newest one,
+	// otherwise the next in order, if still there. False on the timeout or once closed
+	bool	Next (FrameShmView& view, int timeoutms, bool latest = true);
+	bool	Valid (const FrameShmView& view) const;						// The slot still holds the frame
+	int64	Lost () const									{ return Nlost; }
+
+  private:
+	bool	Take (int64 seq, FrameShmView& view);
+
+  private:
+	const uint8*	Map;
+	size_t			Bytes;
+	intptr_t		Handle;
+	int64			Last;													// Seq of the last frame taken
+	int64			Nlost;
+};
+
+
+uint64	FrameShmNow ();														// ns of a clock common to all the processes
+
+
+#endif // _FRAMESHM_H
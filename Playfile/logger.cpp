@@ -0,0 +1,445 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  logger.cpp
+ Purpose     :  Deferred logging for hot paths
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "str.h"
+#include "logger.h"
+#include "alloctrack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+static_assert ((UTILS_LOG_RINGSIZE & (UTILS_LOG_RINGSIZE - 1)) == 0, "UTILS_LOG_RINGSIZE must be a power of 2");
+static_assert (sizeof(LogRecord) % 8 == 0, "LogRecord must keep records 8-byte aligned");
+
+std::atomic<int>  LOGGER::Level (LOGLEVEL_INFO);
+
+
+namespace {
+
+const int	LOG_MAXLINE = 4096;
+
+int64 LogNow ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Single producer (the owner thread), single consumer (the writer thread)
+struct LogRing
+{
+	uint8*				Buf;
+	std::atomic<uint64>	Head;		// Written by the owner thread only
+	std::atomic<uint64>	Tail;		// Written by the writer thread only
+	std::atomic<int64>	Ndropped;
+	std::atomic<bool>	Orphan;		// The owner thread has exited, the writer frees the ring once drained
+	int					ThreadNo;
+	uint64				Scanned;	// Writer only: end of the records collected in the current pass
+	std::atomic<int64>	Nreported;	// Drops already reported, written by the writer thread only
+
+	LogRing (int threadno) : Buf((uint8*)malloc(UTILS_LOG_RINGSIZE)), Head(0), Tail(0), Ndropped(0), Orphan(false), ThreadNo(threadno), Scanned(0), Nreported(0)
+	{
+		LOW_ASSERT (Buf);
+	}
+	~LogRing ()		{ free(Buf); }
+};
+
+
+struct LogRingHolder
+{
+	LogRing*	Ring;
+
+	LogRingHolder () : Ring(nullptr)	{}
+	~LogRingHolder ()					{ if (Ring) Ring->Orphan.store(true, std::memory_order_release); }
+};
+
+thread_local LogRingHolder  ThisRing;
+
+
+struct LogItem
+{
+	int64				Time;
+	LogRing*			Ring;
+	const LogRecord*	Rec;
+
+	bool operator < (const LogItem& b) const	{ return Time < b.Time; }
+};
+
+
+/*
+ * Ring registry and the writer thread
+ */
+class LogWriter
+{
+  public:
+	LogWriter () : Out(stdout), Stopping(false), Running(false), FlushReq(0), FlushDone(0), Nthreads(0), Ndropped(0), T0(LogNow())	{}
+	~LogWriter ()		{ Stop(); }
+
+	LogRing* Register ()
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		if (!Running) {
+			Stopping = false;
+			Running  = true;
+			Thread   = std::thread(&LogWriter::Run, this);
+		}
+		Rings.push_back(new LogRing(++Nthreads));
+		return Rings.back();
+	}
+
+	// The messages logged so far go to the previous output
+	bool SetOutput (cchar* file)
+	{
+		FILE* f = file ? fopen(file, "a") : stdout;
+		if (!f)
+			return false;
+		Flush();
+		std::lock_guard<std::mutex> lock(OutMtx);
+		if (Out != stdout)
+			fclose (Out);
+		Out = f;
+		return true;
+	}
+
+	void Flush ()
+	{
+		std::unique_lock<std::mutex> lock(Mtx);
+		if (!Running)
+			return;
+		uint64 req = ++FlushReq;
+		Cond.notify_one();
+		DrainedCond.wait(lock, [&] { return FlushDone >= req || !Running; });
+	}
+
+	void Stop ()
+	{
+		{
+			std::lock_guard<std::mutex> lock(Mtx);
+			if (!Running)
+				return;
+			Stopping = true;
+		}
+		Cond.notify_one();
+		Thread.join();
+
+		std::lock_guard<std::mutex> lock(Mtx);
+		Running = false;
+		DrainedCond.notify_all();
+
+		std::lock_guard<std::mutex> olock(OutMtx);
+		if (Out != stdout)
+			fclose (Out);
+		Out = stdout;
+	}
+
+	int64 Dropped ()
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		int64 n = Ndropped;
+		for (auto r : Rings)
+			n += r->Ndropped.load(std::memory_order_relaxed) - r->Nreported.load(std::memory_order_relaxed);
+		return n;
+	}
+
+  private:
+	void Run ()
+	{
+		ALLOC_TAG ("log");
+		std::unique_lock<std::mutex> lock(Mtx);
+		for (;;) {
+			Cond.wait_for(lock, std::chrono::milliseconds(UTILS_LOG_FLUSH_MS), [&] { return Stopping || FlushReq != FlushDone; });
+			bool	last = Stopping;
+			uint64	req  = FlushReq;
+			std::vector<LogRing*> rings = Rings;
+			lock.unlock();
+
+			{
+				std::lock_guard<std::mutex> olock(OutMtx);
+				Drain (rings, Out);
+			}
+
+			lock.lock();
+			// Free the rings of exited threads once they are empty
+			for (auto it = Rings.begin(); it != Rings.end(); ) {
+				LogRing* r = *it;
+				if (r->Orphan.load(std::memory_order_acquire) && r->Head.load(std::memory_order_acquire) == r->Tail.load(std::memory_order_relaxed)) {
+					Ndropped += r->Ndropped - r->Nreported;
+					delete r;
+					it = Rings.erase(it);
+				}
+				else
+					++it;
+			}
+			FlushDone = req;
+			DrainedCond.notify_all();
+			if (last)
+				break;
+		}
+	}
+
+	void Drain (std::vector<LogRing*>& rings, FILE* out)
+	{
+		Items.clear();
+		for (auto r : rings) {
+			uint64 head = r->Head.load(std::memory_order_acquire);
+			uint64 pos  = r->Tail.load(std::memory_order_relaxed);
+			while (pos < head) {
+				uint32 offset = uint32(pos & (UTILS_LOG_RINGSIZE - 1));
+				if (UTILS_LOG_RINGSIZE - offset < sizeof(LogRecord)) {
+					pos += UTILS_LOG_RINGSIZE - offset;			// Too short a tail for a header, the producer wrapped
+					continue;
+				}
+				const LogRecord* rec = (const LogRecord*)(r->Buf + offset);
+				if (rec->Site) {
+					LogItem item = { rec->Time, r, rec };
+					Items.push_back(item);
+				}
+				pos += rec->Size;
+			}
+			r->Scanned = pos;
+		}
+		std::stable_sort (Items.begin(), Items.end());
+
+		char  buf [LOG_MAXLINE];
+		for (auto& item : Items) {
+			STRB line (buf, LOG_MAXLINE);
+			line.Clear();
+			Format (line, item);
+			line += '\n';
+			fwrite ((cchar*)line, 1, line.Length(), out);
+		}
+
+		for (auto r : rings) {
+			r->Tail.store(r->Scanned, std::memory_order_release);
+			int64 dropped = r->Ndropped.load(std::memory_order_relaxed);
+			int64 reported = r->Nreported.load(std::memory_order_relaxed);
+			if (dropped != reported) {
+				fprintf (out, "%10.6f  T%-2d   *** %lld log messages dropped, the ring is full\n", (LogNow() - T0) / 1e9, r->ThreadNo, dropped - reported);
+				r->Nreported.store(dropped, std::memory_order_relaxed);
+			}
+		}
+		if (!Items.empty())
+			fflush (out);
+	}
+
+	void Format (STRB& line, const LogItem& item)
+	{
+		const LogRecord* rec = item.Rec;
+		line.AddSprintf ("%10.6f  T%-2d %c  ", (rec->Time - T0) / 1e9, item.Ring->ThreadNo, "-EWIDT"[rec->Site->Level]);
+
+		const uint8*	arg  = (const uint8*)(rec + 1);
+		int				iarg = 0;
+		cchar*			p	 = rec->Site->Format;
+		while (*p) {
+			cchar* q = p;
+			while (*q && *q != '%')
+				q++;
+			line.Add (p, int(q - p));
+			if (!*q)
+				break;
+			if (q[1] == '%') {
+				line += '%';
+				p = q + 2;
+				continue;
+			}
+
+			// One conversion: flags, width, precision, length, conversion char
+			cchar* e = q + 1;
+			while (*e && strchr("-+ #0123456789.", *e))
+				e++;
+			bool is64 = false;
+			for (; *e && strchr("hlLjztqI3264", *e); e++) {
+				if (*e == 'j' || *e == 'z' || *e == 't' || *e == 'q' || (e[0] == 'l' && e[1] == 'l') || (e[0] == '6' && e[1] == '4'))
+					is64 = true;
+				else if (*e == 'l' && sizeof(long) == 8)
+					is64 = true;
+			}
+			char conv = *e;
+			p = conv ? e + 1 : e;
+
+			char spec [40];
+			int  speclen = int(p - q);
+			if (speclen >= int(sizeof(spec)) || iarg >= rec->Nargs || line.Length() > LOG_MAXLINE - LOG_MAXSTR - 64) {
+				line.Add (q, MIN(speclen, LOG_MAXLINE - line.Length() - 2));
+				continue;
+			}
+			// A long double is stored as a double: the spec goes without its L
+			int k = 0;
+			for (int i = 0; i < speclen; i++)
+				if (q[i] != 'L')
+					spec[k++] = q[i];
+			spec[k] = '\0';
+
+			uint8	type = rec->Types[iarg++];
+			uint64	v;
+			memcpy (&v, arg, 8);
+			if (type == LOGARG_STR) {
+				uint32 n;
+				memcpy (&n, arg, 4);
+				STR<LOG_MAXSTR+2> s;
+				s.Copy ((cchar*)arg + 4, int(n));
+				arg += (4 + n + 7) & ~7u;
+				if (conv == 's')
+					line.AddSprintf (spec, (cchar*)s);
+				else
+					line += "(?)";
+				continue;
+			}
+			arg += 8;
+
+			double d;
+			memcpy (&d, &v, 8);
+			if (type != LOGARG_DOUBLE)
+				d = type == LOGARG_INT ? double(int64(v)) : double(v);
+			switch (conv) {
+				case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+					if (type == LOGARG_DOUBLE)
+						v = uint64(int64(d));
+					if (is64)
+						line.AddSprintf (spec, int64(v));
+					else
+						line.AddSprintf (spec, int(v));
+					break;
+				case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+					line.AddSprintf (spec, d);
+					break;
+				case 'p':
+					line.AddSprintf (spec, (void*)uintptr_t(v));
+					break;
+				default:
+					line += "(?)";
+					break;
+			}
+		}
+	}
+
+	std::mutex				Mtx;				// Protects everything below
+	std::condition_variable	Cond;				// Flush request or stop
+	std::condition_variable	DrainedCond;		// A drain pass is done
+	std::vector<LogRing*>	Rings;
+	std::thread				Thread;
+	std::mutex				OutMtx;				// Protects Out, held by the writer while it writes
+	FILE*					Out;
+	bool					Stopping;
+	bool					Running;
+	uint64					FlushReq, FlushDone;
+	int						Nthreads;
+	int64					Ndropped;			// Drops of freed rings not reported
+	int64					T0;
+
+	std::vector<LogItem>	Items;				// Writer thread only
+};
+
+LogWriter  Writer;
+
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									LOGGER
+\*--------------------------------------------------------------------------------------*/
+
+LogRecord* LOGGER::Reserve (uint32 size)
+{
+	LogRing* r = ThisRing.Ring;
+	if (!r)
+		r = ThisRing.Ring = Writer.Register();
+
+	size = (size + 7) & ~7u;
+	uint64 head   = r->Head.load(std::memory_order_relaxed);
+	uint64 tail   = r->Tail.load(std::memory_order_acquire);
+	uint32 offset = uint32(head & (UTILS_LOG_RINGSIZE - 1));
+	uint32 skip   = UTILS_LOG_RINGSIZE - offset < size ? UTILS_LOG_RINGSIZE - offset : 0;		// Records never wrap
+
+	if (head + skip + size - tail > UTILS_LOG_RINGSIZE) {
+		r->Ndropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+	if (skip) {
+		if (skip >= sizeof(LogRecord)) {
+			LogRecord* pad = (LogRecord*)(r->Buf + offset);
+			pad->Site = nullptr;
+			pad->Size = skip;
+		}
+		offset = 0;		// Head is moved past the pad by Commit(), with the record: the writer sees both written
+	}
+
+	LogRecord* rec = (LogRecord*)(r->Buf + offset);
+	rec->Time = LogNow();
+	rec->Size = size;
+	return rec;
+}
+
+
+void LOGGER::Commit (LogRecord* rec)
+{
+	LogRing* r		= ThisRing.Ring;
+	uint64	 head	= r->Head.load(std::memory_order_relaxed);
+	uint32	 offset = uint32(head & (UTILS_LOG_RINGSIZE - 1));
+	uint32	 skip	= uint32((uint8*)rec - r->Buf) != offset ? UTILS_LOG_RINGSIZE - offset : 0;		// Reserve() wrapped to the start
+	r->Head.store(head + skip + rec->Size, std::memory_order_release);
+}
+
+
+bool LOGGER::Configure (cchar* spec)
+{
+	STR<32> level;
+	level.Copy (spec, ',');
+
+	int n = -1;
+	if (STRB::isdigit(level[0]))
+		n = level;
+	for (int i = LOGLEVEL_OFF; i <= LOGLEVEL_TRACE; i++)
+		if (level == LevelName(i))
+			n = i;
+	if (n < LOGLEVEL_OFF || n > LOGLEVEL_TRACE)
+		return false;
+
+	cchar* file = strchr(spec, ',');
+	if (file && !SetOutput(file + 1))
+		return false;
+	SetLevel (LogLevel(n));
+	return true;
+}
+
+
+bool LOGGER::SetOutput (cchar* file)
+{
+	return Writer.SetOutput(file);
+}
+
+
+void LOGGER::Flush ()
+{
+	Writer.Flush();
+}
+
+
+void LOGGER::Close ()
+{
+	Writer.Stop();
+}
+
+
+int64 LOGGER::Dropped ()
+{
+	return Writer.Dropped();
+}
+
+
+cchar* LOGGER::LevelName (int level)
+{
+	static cchar* const names[] = { "off", "error", "warn", "info", "debug", "trace" };
+	return level >= LOGLEVEL_OFF && level <= LOGLEVEL_TRACE ? names[level] : "?";
+}
@@ -0,0 +1,179 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  logger.h
+ Purpose     :  Deferred logging for hot paths
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  LOG(INFO, "[%2d:%2d] D = %3d", x, y, d) costs the calling thread
+				a timestamp and a copy of the arguments into its own ring, no
+				locks and no I/O. A background thread formats the records
+				with STRB and writes them to the console or a file.
+\**********************************************************************/
+
+#ifndef _LOGGER_H
+#define _LOGGER_H
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+
+
+enum LogLevel
+{
+	LOGLEVEL_OFF,
+	LOGLEVEL_ERROR,
+	LOGLEVEL_WARN,
+	LOGLEVEL_INFO,
+	LOGLEVEL_DEBUG,
+	LOGLEVEL_TRACE
+};
+
+
+/*
+ * Writes a log message when level (ERROR, WARN, INFO, DEBUG or TRACE) is enabled.
+ * The format is printf-like; all conversions but '*' width/precision and %n are supported.
+ * Strings are copied (up to LOG_MAXSTR chars), so any temporary may be passed.
+ */
+#define LOG(level, sformat, ...)																\
+	do {																						\
+		if (LOGLEVEL_##level <= LOGGER::Level.load(std::memory_order_relaxed)) {				\
+			static const LogSite  _logsite = { sformat, LOGLEVEL_##level };						\
+			LOGGER::Record (&_logsite, ##__VA_ARGS__);											\
+		}																						\
+	} while (0)
+
+
+// Call site of a LOG() statement, its address identifies the format
+struct LogSite
+{
+	cchar*		Format;
+	LogLevel	Level;
+};
+
+
+enum
+{
+	LOG_MAXARGS = 11,			// Arguments per message
+	LOG_MAXSTR  = 255			// Longer string arguments are truncated
+};
+
+// Header of a record in a thread ring, the packed arguments follow
+struct LogRecord
+{
+	const LogSite*	Site;		// nullptr for the padding before a wrap
+	int64			Time;		// steady clock, ns
+	uint32			Size;		// Bytes including the header, multiple of 8
+	uint8			Nargs;
+	uint8			Types [LOG_MAXARGS];
+};
+
+enum LogArgType
+{
+	LOGARG_INT,					// int64
+	LOGARG_UINT,				// uint64
+	LOGARG_DOUBLE,
+	LOGARG_PTR,					// uint64
+	LOGARG_STR					// uint32 length + chars, padded to 8 bytes
+};
+
+
+/*
+ ***************************************************************************
+ Deferred logger. Every thread writing logs gets a lock-free single producer
+ ring of UTILS_LOG_RINGSIZE bytes; when it's full the message is dropped and
+ counted (never blocks). The writer thread drains all rings every
+ UTILS_LOG_FLUSH_MS, merges the records in time order and reports drops.
+ The level can be changed at any time; disabled LOG() statements cost one
+ relaxed load.
+ ***************************************************************************
+*/
+class LOGGER
+{
+  public:
+	static std::atomic<int>  Level;										// LOGLEVEL_INFO by default
+
+	// "level[,file]", e.g. "debug" or "info,playfile.log": level name or number, output file (console by default). Returns false on a bad spec
+	static bool		Configure (cchar* spec);
+	static void		SetLevel  (LogLevel level)		{ Level.store(level, std::memory_order_relaxed); }
+	static bool		SetOutput (cchar* file);							// nullptr - console
+	static void		Flush ();											// Waits until the messages logged so far are written
+	static void		Close ();											// Flushes, stops the writer thread and closes the file
+	static int64	Dropped ();											// Messages dropped on full rings so far
+	static cchar*	LevelName (int level);
+
+	template <class... Args> static void Record (const LogSite* site, const Args&... args)
+	{
+		static_assert (sizeof...(Args) <= LOG_MAXARGS, "Too many LOG() arguments");
+		LogRecord* r = Reserve (uint32(sizeof(LogRecord) + ArgsSize(args...)));
+		if (!r)
+			return;
+		r->Site  = site;
+		r->Nargs = uint8(sizeof...(Args));
+		uint8* p = (uint8*)(r + 1);
+		Put (r->Types, p, args...);
+		Commit (r);
+	}
+
+  private:
+	static LogRecord*	Reserve (uint32 size);							// Space in the thread ring with Time and Size set, nullptr when full
+	static void			Commit  (LogRecord* r);
+
+	static uint32 StrSize (size_t len)			{ return uint32((4 + MIN(len, size_t(LOG_MAXSTR)) + 7) & ~size_t(7)); }
+	static cchar* NonNull (cchar* s)			{ return s ? s : "(null)"; }		// Sized and written the same
+
+	template <class T> static typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, uint32>::type
+					ArgSize (const T&)			{ return 8; }
+	static uint32	ArgSize (const void*)		{ return 8; }
+	static uint32	ArgSize (cchar* s)			{ return StrSize(strlen(NonNull(s))); }
+	static uint32	ArgSize (const STRB& s)		{ return StrSize(s.Length()); }
+	static uint32	ArgSize (const std::string& s)	{ return StrSize(s.size()); }
+
+	static uint32	ArgsSize ()					{ return 0; }
+	template <class T, class... Rest> static uint32 ArgsSize (const T& a, const Rest&... rest)	{ return ArgSize(a) + ArgsSize(rest...); }
+
+	template <class T> static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint8>::type
+	PutArg (uint8*& p, const T& v)
+	{
+		bool sgn = std::is_enum<T>::value || std::is_signed<T>::value;
+		uint64 x = sgn ? uint64(int64(v)) : uint64(v);
+		memcpy (p, &x, 8);
+		p += 8;
+		return sgn ? LOGARG_INT : LOGARG_UINT;
+	}
+	template <class T> static typename std::enable_if<std::is_floating_point<T>::value, uint8>::type
+	PutArg (uint8*& p, const T& v)
+	{
+		double x = v;
+		memcpy (p, &x, 8);
+		p += 8;
+		return LOGARG_DOUBLE;
+	}
+	static uint8 PutArg (uint8*& p, const void* v)
+	{
+		uint64 x = uint64(uintptr_t(v));
+		memcpy (p, &x, 8);
+		p += 8;
+		return LOGARG_PTR;
+	}
+	static uint8 PutStr (uint8*& p, cchar* s, size_t len)
+	{
+		uint32 n = uint32(MIN(len, size_t(LOG_MAXSTR)));
+		memcpy (p, &n, 4);
+		memcpy (p + 4, s, n);
+		p += StrSize(len);
+		return LOGARG_STR;
+	}
+	static uint8 PutArg (uint8*& p, cchar* s)				{ s = NonNull(s); return PutStr(p, s, strlen(s)); }
+	static uint8 PutArg (uint8*& p, const STRB& s)			{ return PutStr(p, (cchar*)s, s.Length()); }
+	static uint8 PutArg (uint8*& p, const std::string& s)	{ return PutStr(p, s.c_str(), s.size()); }
+
+	static void Put (uint8*, uint8*&)			{}
+	template <class T, class... Rest> static void Put (uint8* types, uint8*& p, const T& a, const Rest&... rest)
+	{
+		*types = PutArg(p, a);
+		Put (types + 1, p, rest...);
+	}
+};
+
+
+#endif // _LOGGER_H
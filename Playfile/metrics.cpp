@@ -0,0 +1,537 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  metrics.cpp
+ Purpose     :  Counters, gauges and histograms in Prometheus text format
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "str.h"
+#include "metrics.h"
+#include "alloctrack.h"
+
+#include <float.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if PLATFORM == PLATFORM_WIN
+#include <winsock2.h>
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "ws2_32.lib")
+#pragma comment(lib, "psapi.lib")
+typedef SOCKET			socket_t;
+#define closesock		closesocket
+#define MSG_NOSIGNAL	0
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <unistd.h>
+typedef int				socket_t;
+#define INVALID_SOCKET	(-1)
+#define closesock		close
+#endif
+
+
+namespace {
+
+// Function statics: metrics of other modules register during their static initialization
+struct Registry
+{
+	std::mutex				Mtx;
+	std::vector<MetricB*>	Metrics;										// In registration order
+};
+
+Registry& TheRegistry ()
+{
+	static Registry r;
+	return r;
+}
+
+
+struct ShardPool
+{
+	std::mutex			Mtx;
+	std::vector<int>	Free;												// Shards of finished threads
+	int					Next;
+
+	ShardPool () : Next(0) {}
+};
+
+ShardPool& TheShardPool ()
+{
+	static ShardPool p;
+	return p;
+}
+
+// Gives the shard of a thread back when it exits; its counts stay in the shard for the next owner
+struct ShardOwner
+{
+	int  Shard;
+
+	ShardOwner () : Shard(-1) {}
+	~ShardOwner ()
+	{
+		if (Shard >= 0 && Shard < METRIC_SHARDS) {
+			ShardPool& p = TheShardPool();
+			std::lock_guard<std::mutex> lock(p.Mtx);
+			p.Free.push_back(Shard);
+		}
+	}
+};
+
+
+void AppendNumber (std::string& out, double v)
+{
+	char buf[48];
+	if (v != v)
+		out += "NaN";
+	else if (v > DBL_MAX)
+		out += "+Inf";
+	else if (v < -DBL_MAX)
+		out += "-Inf";
+	else {
+		STRB::ftoa_short (v, buf);
+		out += buf;
+	}
+}
+
+
+void AppendNumber (std::string& out, uint64 v)
+{
+	char buf[24];
+	STRB::ulltoa (v, buf);
+	out += buf;
+}
+
+
+double ProcessMemory ()
+{
+#if PLATFORM == PLATFORM_WIN
+	PROCESS_MEMORY_COUNTERS pmc;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)) ? double(pmc.WorkingSetSize) : 0;
+#else
+	long  size = 0, resident = 0;
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f) {
+		if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+			resident = 0;
+		fclose (f);
+	}
+	return double(resident) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+MetricGauge  ProcessMemoryGauge ("process_resident_memory_bytes", "Resident memory size in bytes", nullptr, ProcessMemory);
+
+
+/*--------------------------------------------------------------------------------------*\
+									HTTP endpoint
+\*--------------------------------------------------------------------------------------*/
+
+const int	HTTP_MAXREQUEST	= 4096;
+const int	HTTP_TIMEOUT_MS	= 2000;			// A client not sending its request in time is dropped
+const int	HTTP_POLL_MS	= 200;			// How soon Stop() is noticed
+
+std::mutex			ServerMtx;				// Serializes Serve() and Stop()
+std::thread			ServerThread;
+std::atomic<bool>	ServerRunning (false);
+socket_t			Listener = INVALID_SOCKET;
+std::atomic<int>	ServerPort (0);
+std::string			UnixPath;
+
+
+bool SendAll (socket_t s, cchar* data, size_t size)
+{
+	while (size) {
+		int n = send(s, data, int(MIN(size, size_t(1) << 30)), MSG_NOSIGNAL);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+
+void HandleClient (socket_t s)
+{
+#if PLATFORM == PLATFORM_WIN
+	DWORD tv = HTTP_TIMEOUT_MS;
+#else
+	timeval tv = { HTTP_TIMEOUT_MS / 1000, (HTTP_TIMEOUT_MS % 1000) * 1000 };
+#endif
+	setsockopt (s, SOL_SOCKET, SO_RCVTIMEO, (cchar*)&tv, sizeof(tv));
+
+	// Only the request line matters, but the whole header is read so the client isn't reset
+	char req [HTTP_MAXREQUEST + 1];
+	int  len = 0;
+	while (len < HTTP_MAXREQUEST) {
+		int n = recv(s, req + len, HTTP_MAXREQUEST - len, 0);
+		if (n <= 0)
+			return;
+		len += n;
+		req[len] = '\0';
+		if (strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+			break;
+	}
+
+	cchar* path = STRB::strequ(req, "GET ", 4) ? req + 4 : nullptr;
+	size_t plen = path ? strcspn(path, " ?\r\n") : 0;
+	bool   found = path && ((plen == 8 && STRB::strequ(path, "/metrics", 8)) || (plen == 1 && *path == '/'));
+
+	std::string body;
+	if (found)
+		METRICS::Expose (body);
+	else
+		body = "Not found, try /metrics\n";
+
+	STR<256> head;
+	head.Print ("HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+				found ? "200 OK" : "404 Not Found", unsigned(body.size()));
+	if (SendAll(s, (cchar*)head, head.Length()))
+		SendAll (s, body.data(), body.size());
+}
+
+
+void ServerProcess (socket_t listener)
+{
+	ALLOC_TAG ("metrics");
+	while (ServerRunning.load()) {
+		fd_set fds;
+		FD_ZERO (&fds);
+		FD_SET (listener, &fds);
+		timeval tv = { 0, HTTP_POLL_MS * 1000 };
+		if (select(int(listener) + 1, &fds, nullptr, nullptr, &tv) <= 0)
+			continue;
+
+		socket_t s = accept(listener, nullptr, nullptr);
+		if (s == INVALID_SOCKET)
+			continue;
+		HandleClient (s);
+		closesock (s);
+	}
+}
+
+
+socket_t Listen (cchar* addr)
+{
+#if PLATFORM == PLATFORM_WIN
+	static bool started = false;
+	if (!started) {
+		WSADATA wsa;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+			return INVALID_SOCKET;
+		started = true;
+	}
+#endif
+
+	socket_t s;
+	if (STRB::strequ(addr, "unix:", 5)) {
+#if PLATFORM == PLATFORM_WIN
+		return INVALID_SOCKET;
+#else
+		sockaddr_un sa;
+		memset (&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (!addr[5] || strlen(addr + 5) >= sizeof(sa.sun_path))
+			return INVALID_SOCKET;
+		strcpy (sa.sun_path, addr + 5);
+		if ((s = socket(AF_UNIX, SOCK_STREAM, 0)) == INVALID_SOCKET)
+			return INVALID_SOCKET;
+		unlink (sa.sun_path);
+		if (bind(s, (sockaddr*)&sa, sizeof(sa)) != 0 || listen(s, 8) != 0) {
+			closesock (s);
+			return INVALID_SOCKET;
+		}
+		UnixPath = sa.sun_path;
+		return s;
+#endif
+	}
+
+	uint32 ip;
+	uint16 port;
+	if (!STRB::str2addr(addr, &ip, &port))
+		return INVALID_SOCKET;
+
+	sockaddr_in sa;
+	memset (&sa, 0, sizeof(sa));
+	sa.sin_family	   = AF_INET;
+	sa.sin_addr.s_addr = ip;				// IpAddr is in network order already
+	sa.sin_port		   = htons(port);
+	if ((s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET)
+		return INVALID_SOCKET;
+#if PLATFORM != PLATFORM_WIN
+	int on = 1;
+	setsockopt (s, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));	// Restarts don't wait for TIME_WAIT (on Windows it would allow stealing the port)
+#endif
+	socklen_t salen = sizeof(sa);
+	if (bind(s, (sockaddr*)&sa, sizeof(sa)) != 0 || listen(s, 8) != 0 || getsockname(s, (sockaddr*)&sa, &salen) != 0) {
+		closesock (s);
+		return INVALID_SOCKET;
+	}
+	ServerPort = ntohs(sa.sin_port);
+	return s;
+}
+
+
+// A server left running is stopped before its thread object is destroyed
+struct ServerGuard
+{
+	~ServerGuard ()		{ METRICS::Stop(); }
+} TheServerGuard;
+
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									Metrics
+\*--------------------------------------------------------------------------------------*/
+
+//static
+int MetricB::NewShard ()
+{
+	static thread_local ShardOwner owner;
+
+	ShardPool& p = TheShardPool();
+	std::lock_guard<std::mutex> lock(p.Mtx);
+	if (!p.Free.empty()) {
+		owner.Shard = p.Free.back();
+		p.Free.pop_back();
+	}
+	else if (p.Next < METRIC_SHARDS)
+		owner.Shard = p.Next++;
+	else
+		owner.Shard = METRIC_SHARDS;
+	return owner.Shard;
+}
+
+
+void MetricB::ExposeName (std::string& out, cchar* suffix, cchar* le) const
+{
+	out += Name;
+	if (suffix)
+		out += suffix;
+	if (Labels || le) {
+		out += '{';
+		if (Labels)
+			out += Labels;
+		if (le) {
+			if (Labels)
+				out += ',';
+			out += "le=\"";
+			out += le;
+			out += '"';
+		}
+		out += '}';
+	}
+	out += ' ';
+}
+
+
+MetricCounter::MetricCounter (cchar* name, cchar* help, cchar* labels) : MetricB(METRIC_COUNTER, name, help, labels)
+{
+	for (auto& s : Shards)
+		s.Value.store(0, std::memory_order_relaxed);
+	METRICS::Register (this);
+}
+
+
+uint64 MetricCounter::Value () const
+{
+	uint64 v = 0;
+	for (auto& s : Shards)
+		v += s.Value.load(std::memory_order_relaxed);
+	return v;
+}
+
+
+void MetricCounter::Expose (std::string& out) const
+{
+	ExposeName (out, nullptr, nullptr);
+	AppendNumber (out, Value());
+	out += '\n';
+}
+
+
+void MetricGauge::Expose (std::string& out) const
+{
+	ExposeName (out, nullptr, nullptr);
+	AppendNumber (out, Value());
+	out += '\n';
+}
+
+
+MetricHistogram::MetricHistogram (cchar* name, cchar* help, cchar* labels) : MetricB(METRIC_HISTOGRAM, name, help, labels)
+{
+	Init ({ 0.0005, 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1 });
+}
+
+
+MetricHistogram::MetricHistogram (cchar* name, cchar* help, cchar* labels, std::initializer_list<double> bounds) : MetricB(METRIC_HISTOGRAM, name, help, labels)
+{
+	Init (bounds);
+}
+
+
+void MetricHistogram::Init (std::initializer_list<double> bounds)
+{
+	Nbounds = 0;
+	for (double b : bounds) {
+		if (Nbounds == METRIC_MAXBUCKETS || (Nbounds && b <= Bounds[Nbounds - 1]))
+			break;		// too many or not ascending, the rest goes to +Inf
+		Bounds[Nbounds++] = b;
+	}
+	for (auto& s : Shards) {
+		for (auto& c : s.Counts)
+			c.store(0, std::memory_order_relaxed);
+		s.Sum.store(0, std::memory_order_relaxed);
+	}
+	METRICS::Register (this);
+}
+
+
+void MetricHistogram::Expose (std::string& out) const
+{
+	uint64 counts [METRIC_MAXBUCKETS + 1] = {};
+	double sum = 0;
+	for (auto& s : Shards) {
+		for (int b = 0; b <= Nbounds; b++)
+			counts[b] += s.Counts[b].load(std::memory_order_relaxed);
+		sum += s.Sum.load(std::memory_order_relaxed);
+	}
+
+	// Buckets are cumulative: observations <= le
+	uint64 total = 0;
+	char   le [48];
+	for (int b = 0; b <= Nbounds; b++) {
+		total += counts[b];
+		if (b < Nbounds)
+			STRB::ftoa_short (Bounds[b], le);
+		else
+			strcpy (le, "+Inf");
+		ExposeName (out, "_bucket", le);
+		AppendNumber (out, total);
+		out += '\n';
+	}
+	ExposeName (out, "_sum", nullptr);
+	AppendNumber (out, sum);
+	out += '\n';
+	ExposeName (out, "_count", nullptr);
+	AppendNumber (out, total);
+	out += '\n';
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									METRICS
+\*--------------------------------------------------------------------------------------*/
+
+//static
+void METRICS::Register (MetricB* m)
+{
+	Registry& r = TheRegistry();
+	std::lock_guard<std::mutex> lock(r.Mtx);
+	r.Metrics.push_back(m);
+}
+
+
+//static
+void METRICS::Unregister (MetricB* m)
+{
+	Registry& r = TheRegistry();
+	std::lock_guard<std::mutex> lock(r.Mtx);
+	for (size_t i = 0; i < r.Metrics.size(); i++) {
+		if (r.Metrics[i] == m) {
+			r.Metrics.erase(r.Metrics.begin() + i);
+			break;
+		}
+	}
+}
+
+
+//static
+void METRICS::Expose (std::string& out)
+{
+	static cchar* const typeNames[] = { "counter", "gauge", "histogram" };
+
+	Registry& r = TheRegistry();
+	std::lock_guard<std::mutex> lock(r.Mtx);
+
+	// All the members of a family follow its HELP and TYPE lines
+	std::vector<bool> done(r.Metrics.size());
+	for (size_t i = 0; i < r.Metrics.size(); i++) {
+		if (done[i])
+			continue;
+		MetricB* m = r.Metrics[i];
+		out += "# HELP ";
+		out += m->Name;
+		out += ' ';
+		for (cchar* h = m->Help; h && *h; h++) {
+			if (*h == '\\' || *h == '\n')
+				out += '\\';
+			out += *h == '\n' ? 'n' : *h;
+		}
+		out += "\n# TYPE ";
+		out += m->Name;
+		out += ' ';
+		out += typeNames[m->Type];
+		out += '\n';
+
+		for (size_t j = i; j < r.Metrics.size(); j++) {
+			if (!done[j] && STRB::strequ(r.Metrics[j]->Name, m->Name)) {
+				r.Metrics[j]->Expose(out);
+				done[j] = true;
+			}
+		}
+	}
+}
+
+
+//static
+bool METRICS::Serve (cchar* addr)
+{
+	std::lock_guard<std::mutex> lock(ServerMtx);
+	if (ServerRunning.load())
+		return false;
+
+	Listener = Listen(addr);
+	if (Listener == INVALID_SOCKET)
+		return false;
+	ServerRunning = true;
+	ServerThread = std::thread(ServerProcess, Listener);
+	return true;
+}
+
+
+//static
+void METRICS::Stop ()
+{
+	std::lock_guard<std::mutex> lock(ServerMtx);
+	if (!ServerRunning.load())
+		return;
+
+	ServerRunning = false;
+	ServerThread.join();
+	closesock (Listener);
+	Listener   = INVALID_SOCKET;
+	ServerPort = 0;
+#if PLATFORM != PLATFORM_WIN
+	if (!UnixPath.empty())
+		unlink (UnixPath.c_str());
+#endif
+	UnixPath.clear();
+}
+
+
+//static
+int METRICS::Port ()
+{
+	return ServerPort.load();
+}
@@ -0,0 +1,209 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  metrics.h
+ Purpose     :  Counters, gauges and histograms in Prometheus text format
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  Metrics are usually static objects next to the code updating
+				them. METRICS::Serve("127.0.0.1:9100") exposes all of them
+				at http://127.0.0.1:9100/metrics for a Prometheus scraper;
+				any HTTP client (curl) works for a quick look.
+\**********************************************************************/
+
+#ifndef _METRICS_H
+#define _METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
+#include <string>
+
+
+enum MetricType
+{
+	METRIC_COUNTER,
+	METRIC_GAUGE,
+	METRIC_HISTOGRAM
+};
+
+
+class MetricB;
+
+
+/*
+ ***************************************************************************
+ Registry of all the metrics and the HTTP endpoint serving them. The server
+ thread answers "GET /metrics" (or "/") with the Prometheus text exposition
+ and closes the connection; anything else gets 404.
+ ***************************************************************************
+*/
+class METRICS
+{
+  public:
+	// "[ip:]port" - TCP, 127.0.0.1 by default, port 0 picks a free one; "unix:<path>" - Unix socket (Linux).
+	// Returns false on a bad address or when it can't listen
+	static bool		Serve (cchar* addr);
+	static void		Stop ();
+	static int		Port ();												// TCP port being served, 0 if none
+	static void		Expose (std::string& out);								// Appends all the metrics in Prometheus text format
+
+	// Called by the metrics: after the construction and before the destruction of their data
+	static void		Register   (MetricB* m);
+	static void		Unregister (MetricB* m);
+};
+
+
+enum
+{
+	METRIC_SHARDS		= UTILS_METRICS_SHARDS,		// Threads with their own shard, the others share one more
+	METRIC_MAXBUCKETS	= 16						// Histogram bounds, +Inf is implied
+};
+
+
+/*
+ ***************************************************************************
+ Base of all the metrics, registered in METRICS for the life time of the
+ object. Metrics of the same name (family) differ by labels, e.g.
+ name "playfile_stage_seconds" with labels "stage=\"grab\"".
+ Name, help and labels must be literals or live as long as the metric.
+ ***************************************************************************
+*/
+class MetricB
+{
+  public:
+	MetricB (MetricType type, cchar* name, cchar* help, cchar* labels) : Type(type), Name(name), Help(help), Labels(labels)	{}
+	virtual ~MetricB ()								{}
+
+	virtual void	Expose (std::string& out) const = 0;					// Appends the sample lines
+
+	MetricType		Type;
+	cchar*			Name;
+	cchar*			Help;
+	cchar*			Labels;													// nullptr - none
+
+  protected:
+	// Shard of the calling thread: every thread owns one (updated with plain stores) until they run out,
+	// then METRIC_SHARDS which is shared and updated with atomic adds
+	static int ThisShard ()
+	{
+		static thread_local int shard = -1;
+		if (shard < 0)
+			shard = NewShard();
+		return shard;
+	}
+	static int		NewShard ();
+
+	static void		AddValue (std::atomic<uint64>& v, uint64 n, bool shared)	{ if (shared) v.fetch_add(n, std::memory_order_relaxed); else v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+	static void		AddValue (std::atomic<double>& v, double d, bool shared)
+	{
+		if (!shared)
+			v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+		else {
+			double x = v.load(std::memory_order_relaxed);
+			while (!v.compare_exchange_weak(x, x + d, std::memory_order_relaxed))
+				;
+		}
+	}
+
+	void			ExposeName (std::string& out, cchar* suffix, cchar* le) const;	// "name_suffix{labels,le="le"} "
+};
+
+
+/*
+ * Monotonic counter. Inc() is a load and a store to a cache line owned by the calling thread
+ */
+class MetricCounter : public MetricB
+{
+  public:
+	MetricCounter (cchar* name, cchar* help, cchar* labels = nullptr);
+	~MetricCounter ()								{ METRICS::Unregister(this); }
+
+	void	Inc (uint64 n = 1)						{ int s = ThisShard(); AddValue (Shards[s].Value, n, s == METRIC_SHARDS); }
+	uint64	Value () const;
+
+	void	Expose (std::string& out) const override;
+
+  private:
+	struct alignas(64) Shard
+	{
+		std::atomic<uint64>	Value;
+	};
+	Shard	Shards [METRIC_SHARDS + 1];
+};
+
+
+/*
+ * Current value, set by the owner or sampled by a function at the scrape time
+ */
+class MetricGauge : public MetricB
+{
+  public:
+	MetricGauge (cchar* name, cchar* help, cchar* labels = nullptr) : MetricB(METRIC_GAUGE, name, help, labels), Val(0)	{ METRICS::Register(this); }
+	MetricGauge (cchar* name, cchar* help, cchar* labels, std::function<double()> sample) : MetricB(METRIC_GAUGE, name, help, labels), Val(0), Sample(sample)	{ METRICS::Register(this); }
+	~MetricGauge ()									{ METRICS::Unregister(this); }
+
+	void	Set (double v)							{ Val.store(v, std::memory_order_relaxed); }
+	void	Add (double d)							{ AddValue (Val, d, true); }
+	double	Value () const							{ return Sample ? Sample() : Val.load(std::memory_order_relaxed); }
+
+	void	Expose (std::string& out) const override;
+
+  private:
+	std::atomic<double>		Val;
+	std::function<double()>	Sample;
+};
+
+
+/*
+ * Distribution over fixed bucket bounds; the default bounds suit latencies in seconds, 0.5 ms to 1 s
+ */
+class MetricHistogram : public MetricB
+{
+  public:
+	MetricHistogram (cchar* name, cchar* help, cchar* labels = nullptr);
+	MetricHistogram (cchar* name, cchar* help, cchar* labels, std::initializer_list<double> bounds);
+	~MetricHistogram ()								{ METRICS::Unregister(this); }
+
+	void Observe (double v)
+	{
+		int b = 0;
+		while (b < Nbounds && v > Bounds[b])
+			b++;
+		int s = ThisShard();
+		AddValue (Shards[s].Counts[b], 1, s == METRIC_SHARDS);
+		AddValue (Shards[s].Sum, v, s == METRIC_SHARDS);
+	}
+
+	void	Expose (std::string& out) const override;
+
+  private:
+	void	Init (std::initializer_list<double> bounds);
+
+	struct alignas(64) Shard
+	{
+		std::atomic<uint64>	Counts [METRIC_MAXBUCKETS + 1];
+		std::atomic<double>	Sum;
+	};
+	double	Bounds [METRIC_MAXBUCKETS];										// Ascending
+	int		Nbounds;
+	Shard	Shards [METRIC_SHARDS + 1];
+};
+
+
+/*
+ * Observes the time spent in the enclosing scope, in seconds
+ */
+class MetricTimer
+{
+  public:
+	MetricTimer (MetricHistogram& hist) : Hist(hist), T0(std::chrono::steady_clock::now())	{}
+	~MetricTimer ()									{ Hist.Observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - T0).count()); }
+
+  private:
+	MetricHistogram&						Hist;
+	std::chrono::steady_clock::time_point	T0;
+};
+
+
+#endif // _METRICS_H
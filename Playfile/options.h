@@ -23,12 +23,70 @@
 
 
 /*
- * Auto-allocated strings Cyclic buffer size
+ * Auto-allocated strings Cyclic buffer size, per thread
  */
 #ifndef UTILS_AUTOSTR_CYCLBUF_SIZE
 #define UTILS_AUTOSTR_CYCLBUF_SIZE		512
 #endif
 
 
+/*
+ * Deferred logger (logger.h): ring size per logging thread, bytes (power of 2),
+ * and the period the writer thread drains the rings with, ms
+ */
+#ifndef UTILS_LOG_RINGSIZE
+#define UTILS_LOG_RINGSIZE				(256*1024)
+#endif
+
+#ifndef UTILS_LOG_FLUSH_MS
+#define UTILS_LOG_FLUSH_MS				10
+#endif
+
+
+/*
+ * Trace zones (tracer.h): 0 compiles them out. Zones kept per thread, the rest are dropped
+ */
+#ifndef UTILS_TRACE
+#define UTILS_TRACE						1
+#endif
+
+#ifndef UTILS_TRACE_MAXZONES
+#define UTILS_TRACE_MAXZONES			(1024*1024)
+#endif
+
+
+/*
+ * Metrics (metrics.h): threads updating a counter or a histogram with their own cache line, the others share one
+ */
+#ifndef UTILS_METRICS_SHARDS
+#define UTILS_METRICS_SHARDS			16
+#endif
+
+
+/*
+ * Frame buffer pool (framepool.h): free buffers kept for reuse at most, bytes; the others go back to the OS
+ */
+#ifndef UTILS_FRAMEPOOL_MAXCACHED
+#define UTILS_FRAMEPOOL_MAXCACHED		((size_t)512 << 20)
+#endif
+
+
+/*
+ * Allocation tracking (alloctrack.h): 1 hooks malloc & co. and operator new to count the allocations.
+ * Frames of the frame path before its steady state, and live allocations tracked at most (power of 2)
+ */
+#ifndef UTILS_ALLOCTRACK
+#define UTILS_ALLOCTRACK				0
+#endif
+
+#ifndef UTILS_ALLOCTRACK_WARMUP
+#define UTILS_ALLOCTRACK_WARMUP			100
+#endif
+
+#ifndef UTILS_ALLOCTRACK_MAXLIVE
+#define UTILS_ALLOCTRACK_MAXLIVE		(1024*1024)
+#endif
+
+
 
 #endif /* _OPTIONS_H */
@@ -0,0 +1,455 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  pixconv.cpp
+ Purpose     :  Camera pixel formats to BGR / BGRA / gray conversion
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "pixconv.h"
+#include "threadpool.h"
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PIX_X86		1
+#include <tmmintrin.h>
+#if PLATCOMPL == PLATCOMPL_MS
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define PIX_X86		0
+#endif
+
+
+namespace {
+
+/*--------------------------------------------------------------------------------------*\
+									Format traits
+\*--------------------------------------------------------------------------------------*/
+
+typedef void (*PixRow) (const uint8* in, uint8* out, int width);
+
+const int	PIX_MINBANDPIXELS = 64 * 1024;	// Smaller bands don't pay for the task switch
+
+constexpr bool IsYuv	(PixFormat s)	{ return s == PIX_YUYV || s == PIX_UYVY; }
+constexpr bool IsColor	(PixFormat s)	{ return s == PIX_RGB8 || s == PIX_BGR8 || s == PIX_RGBA8 || s == PIX_BGRA8; }
+constexpr bool IsRgb	(PixFormat s)	{ return s == PIX_RGB8 || s == PIX_RGBA8; }			// R first in memory
+constexpr bool IsGray8	(PixFormat s)	{ return s == PIX_Y8 || s == PIX_RAW8; }
+constexpr int  SrcBpp	(PixFormat s)	{ return s == PIX_RGB8 || s == PIX_BGR8 ? 3 : s == PIX_RGBA8 || s == PIX_BGRA8 ? 4 : IsGray8(s) ? 1 : 2; }	// RAW10 excluded
+constexpr int  SrcBytes (PixFormat s, int x)	{ return s == PIX_RAW10 ? x / 4 * 5 : x * SrcBpp(s); }
+constexpr int  DstBpp	(PixTarget d)	{ return d == PIX_TO_BGR ? 3 : d == PIX_TO_BGRA ? 4 : 1; }
+
+
+// Fixed point BT.601 limited range, 6 fractional bits. The SIMD code computes the same in 16 bits,
+// saturating only where the result is clamped to 255 anyway
+enum
+{
+	YUV_Y	= 74,		// 1.164
+	YUV_RV	= 102,		// 1.596
+	YUV_GV	= 52,		// 0.813
+	YUV_GU	= 25,		// 0.391
+	YUV_BU	= 129,		// 2.018
+	LUMA_B	= 15,		// 0.114, 7 fractional bits
+	LUMA_G	= 75,		// 0.587
+	LUMA_R	= 38		// 0.299
+};
+
+inline int Clamp255 (int v)		{ return v < 0 ? 0 : v > 255 ? 255 : v; }
+inline int Luma (int b, int g, int r)	{ return (LUMA_B * b + LUMA_G * g + LUMA_R * r + 64) >> 7; }
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									Scalar
+\*--------------------------------------------------------------------------------------*/
+
+template <PixFormat S> inline int LoadGray (const uint8* in, int x)
+{
+	switch (S) {
+		case PIX_YUYV:	return in[x * 2];
+		case PIX_UYVY:	return in[x * 2 + 1];
+		case PIX_Y16:	return ((const uint16*)in)[x] >> 8;
+		case PIX_RAW16:	return MIN(((const uint16*)in)[x] >> 2, 255);
+		case PIX_RAW10:	return in[x / 4 * 5 + x % 4];
+		case PIX_Y8:
+		case PIX_RAW8:	return in[x];
+		default: {
+			const uint8* p = in + x * SrcBpp(S);
+			return IsRgb(S) ? Luma(p[2], p[1], p[0]) : Luma(p[0], p[1], p[2]);
+		}
+	}
+}
+
+
+template <PixFormat S> inline void LoadBgr (const uint8* in, int x, int& b, int& g, int& r)
+{
+	if (IsYuv(S)) {
+		const uint8* p = in + (x & ~1) * 2;
+		int y = LoadGray<S>(in, x);
+		int u = (S == PIX_YUYV ? p[1] : p[0]) - 128;
+		int v = (S == PIX_YUYV ? p[3] : p[2]) - 128;
+		y = (y - 16) * YUV_Y;
+		b = Clamp255((y + YUV_BU * u + 32) >> 6);
+		g = Clamp255((y - YUV_GV * v - YUV_GU * u + 32) >> 6);
+		r = Clamp255((y + YUV_RV * v + 32) >> 6);
+	}
+	else if (IsColor(S)) {
+		const uint8* p = in + x * SrcBpp(S);
+		b = p[IsRgb(S) ? 2 : 0];
+		g = p[1];
+		r = p[IsRgb(S) ? 0 : 2];
+	}
+	else {
+		b = g = r = LoadGray<S>(in, x);
+	}
+}
+
+
+// Pixels [x, width) of a row
+template <PixFormat S, PixTarget D> void RowScalar (const uint8* in, uint8* out, int x, int width)
+{
+	for (; x < width; x++) {
+		if (D == PIX_TO_GRAY) {
+			out[x] = uint8(LoadGray<S>(in, x));
+			continue;
+		}
+		int b, g, r;
+		LoadBgr<S>(in, x, b, g, r);
+		uint8* o = out + x * DstBpp(D);
+		o[0] = uint8(b);
+		o[1] = uint8(g);
+		o[2] = uint8(r);
+		if (D == PIX_TO_BGRA)
+			o[3] = 255;
+	}
+}
+
+
+template <PixFormat S, PixTarget D> void RowScalar (const uint8* in, uint8* out, int width)
+{
+	RowScalar<S, D> (in, out, 0, width);
+}
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									SSSE3
+\*--------------------------------------------------------------------------------------*/
+
+// Every kernel converts the first pixels of a row and returns how many, the scalar code does the rest.
+// Kernels loading or storing 3 bytes per pixel access 16 bytes at a time: they stop 2 pixels early.
+#if PIX_X86
+
+#if PLATCOMPL == PLATCOMPL_GNU
+#pragma GCC push_options
+#pragma GCC target("ssse3")
+#endif
+
+inline __m128i LoadMask (const int8* m)				{ return _mm_loadu_si128((const __m128i*)m); }
+
+
+// 4 pixels of sbpp bytes to 4 pixels of dbpp bytes, B G R order; the 4th byte of the target is 0
+inline __m128i SwizzleMask (int sbpp, bool rgb, int dbpp)
+{
+	int8 m[16];
+	memset (m, 0x80, sizeof(m));
+	for (int p = 0; p < 4; p++)
+		for (int c = 0; c < 3; c++)
+			m[p * dbpp + c] = int8(p * sbpp + (rgb ? 2 - c : c));
+	return LoadMask(m);
+}
+
+
+template <PixFormat S, PixTarget D> int ColorSsse3 (const uint8* in, uint8* out, int width)
+{
+	const int sb = SrcBpp(S), db = DstBpp(D);
+	int x = 0;
+
+	if (S == PIX_BGR8 && D == PIX_TO_BGR) {
+		memcpy (out, in, width * 3);
+		return width;
+	}
+	if (D == PIX_TO_GRAY) {
+		__m128i mask = SwizzleMask(sb, IsRgb(S), 4);
+		__m128i w	 = _mm_set1_epi32(LUMA_B | LUMA_G << 8 | LUMA_R << 16);
+		__m128i half = _mm_set1_epi16(64);
+		for (; x + 8 + (sb == 3 ? 2 : 0) <= width; x += 8) {
+			__m128i a = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + x * sb)), mask), w);
+			__m128i b = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + (x + 4) * sb)), mask), w);
+			__m128i s = _mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(a, b), half), 7);
+			_mm_storel_epi64 ((__m128i*)(out + x), _mm_packus_epi16(s, s));
+		}
+		return x;
+	}
+
+	__m128i mask  = SwizzleMask(sb, IsRgb(S), db);
+	__m128i alpha = db == 4 ? _mm_set1_epi32(0xFF000000) : _mm_setzero_si128();
+	for (; x + 4 + (sb == 3 || db == 3 ? 2 : 0) <= width; x += 4)
+		_mm_storeu_si128 ((__m128i*)(out + x * db), _mm_or_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + x * sb)), mask), alpha));
+	return x;
+}
+
+
+template <PixFormat S, PixTarget D> int YuvSsse3 (const uint8* in, uint8* out, int width)
+{
+	const int yo = S == PIX_YUYV ? 0 : 1, uo = S == PIX_YUYV ? 1 : 0, vo = uo + 2;
+	int8 ym[16], um[16], vm[16], y8[16];
+	memset (y8, 0x80, sizeof(y8));
+	for (int i = 0; i < 8; i++) {
+		ym[2*i] = int8(yo + 2*i);		ym[2*i + 1] = -128;
+		um[2*i] = int8(uo + 4*(i/2));	um[2*i + 1] = -128;
+		vm[2*i] = int8(vo + 4*(i/2));	vm[2*i + 1] = -128;
+		y8[i]	= int8(yo + 2*i);
+	}
+	int x = 0;
+
+	if (D == PIX_TO_GRAY) {
+		__m128i mask = LoadMask(y8);
+		for (; x + 8 <= width; x += 8)
+			_mm_storel_epi64 ((__m128i*)(out + x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + x * 2)), mask));
+		return x;
+	}
+
+	__m128i ymask = LoadMask(ym), umask = LoadMask(um), vmask = LoadMask(vm);
+	__m128i c16 = _mm_set1_epi16(16), c128 = _mm_set1_epi16(128), c32 = _mm_set1_epi16(32);
+	__m128i cy = _mm_set1_epi16(YUV_Y), crv = _mm_set1_epi16(YUV_RV), cgv = _mm_set1_epi16(YUV_GV), cgu = _mm_set1_epi16(YUV_GU), cbu = _mm_set1_epi16(YUV_BU);
+	__m128i alpha = _mm_set1_epi8(-1);
+	__m128i pack3 = SwizzleMask(4, false, 3);
+
+	for (; x + 8 + (D == PIX_TO_BGR ? 2 : 0) <= width; x += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i*)(in + x * 2));
+		__m128i y = _mm_mullo_epi16(_mm_sub_epi16(_mm_shuffle_epi8(s, ymask), c16), cy);
+		__m128i u = _mm_sub_epi16(_mm_shuffle_epi8(s, umask), c128);
+		__m128i v = _mm_sub_epi16(_mm_shuffle_epi8(s, vmask), c128);
+
+		__m128i b = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(u, cbu)), c32), 6);
+		__m128i g = _mm_srai_epi16(_mm_adds_epi16(_mm_subs_epi16(_mm_subs_epi16(y, _mm_mullo_epi16(v, cgv)), _mm_mullo_epi16(u, cgu)), c32), 6);
+		__m128i r = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(y, _mm_mullo_epi16(v, crv)), c32), 6);
+
+		__m128i bg = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_packus_epi16(g, g));
+		__m128i ra = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), alpha);
+		__m128i p0 = _mm_unpacklo_epi16(bg, ra);
+		__m128i p1 = _mm_unpackhi_epi16(bg, ra);
+		if (D == PIX_TO_BGRA) {
+			_mm_storeu_si128 ((__m128i*)(out + x * 4), p0);
+			_mm_storeu_si128 ((__m128i*)(out + x * 4 + 16), p1);
+		}
+		else {
+			_mm_storeu_si128 ((__m128i*)(out + x * 3), _mm_shuffle_epi8(p0, pack3));
+			_mm_storeu_si128 ((__m128i*)(out + x * 3 + 12), _mm_shuffle_epi8(p1, pack3));
+		}
+	}
+	return x;
+}
+
+
+// 8 bit gray to the targets
+template <PixTarget D> int Gray8Ssse3 (const uint8* in, uint8* out, int width)
+{
+	const int db = DstBpp(D);
+	int x = 0;
+
+	if (D == PIX_TO_GRAY) {
+		memcpy (out, in, width);
+		return width;
+	}
+
+	__m128i mask[4];
+	for (int k = 0; k < db; k++) {
+		int8 m[16];
+		for (int i = 0; i < 16; i++)
+			m[i] = db == 4 && i % 4 == 3 ? -128 : int8((k * 16 + i) / db);
+		mask[k] = LoadMask(m);
+	}
+	__m128i alpha = db == 4 ? _mm_set1_epi32(0xFF000000) : _mm_setzero_si128();
+	for (; x + 16 <= width; x += 16) {
+		__m128i g = _mm_loadu_si128((const __m128i*)(in + x));
+		for (int k = 0; k < db; k++)
+			_mm_storeu_si128 ((__m128i*)(out + x * db + k * 16), _mm_or_si128(_mm_shuffle_epi8(g, mask[k]), alpha));
+	}
+	return x;
+}
+
+
+// 16 bit gray and RAW10 to 8 bit gray
+template <PixFormat S> int Gray16Ssse3 (const uint8* in, uint8* out, int width)
+{
+	int x = 0;
+	if (S == PIX_RAW10) {
+		const int8 m[16] = { 0, 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, -128, -128, -128, -128 };
+		__m128i mask = LoadMask(m);
+		for (; x + 16 <= width; x += 12)
+			_mm_storeu_si128 ((__m128i*)(out + x), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + x / 4 * 5)), mask));
+		return x;
+	}
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(in + x * 2));
+		__m128i b = _mm_loadu_si128((const __m128i*)(in + x * 2 + 16));
+		if (S == PIX_Y16) {
+			a = _mm_srli_epi16(a, 8);
+			b = _mm_srli_epi16(b, 8);
+		}
+		else {
+			a = _mm_srli_epi16(a, 2);
+			b = _mm_srli_epi16(b, 2);
+		}
+		_mm_storeu_si128 ((__m128i*)(out + x), _mm_packus_epi16(a, b));
+	}
+	return x;
+}
+
+
+template <PixFormat S, PixTarget D> void RowSsse3 (const uint8* in, uint8* out, int width)
+{
+	int x;
+	if (IsYuv(S))
+		x = YuvSsse3<S, D> (in, out, width);
+	else if (IsColor(S))
+		x = ColorSsse3<S, D> (in, out, width);
+	else if (IsGray8(S))
+		x = Gray8Ssse3<D> (in, out, width);
+	else if (D == PIX_TO_GRAY)
+		x = Gray16Ssse3<S> (in, out, width);
+	else {
+		// Through 8 bit gray, a chunk at a time
+		uint8 gray[256];
+		for (x = 0; x < width; x += sizeof(gray)) {
+			int n = MIN(int(sizeof(gray)), width - x);
+			RowSsse3<S, PIX_TO_GRAY> (in + SrcBytes(S, x), gray, n);
+			RowSsse3<PIX_Y8, D> (gray, out + x * DstBpp(D), n);
+		}
+	}
+	RowScalar<S, D> (in, out, x, width);
+}
+
+#if PLATCOMPL == PLATCOMPL_GNU
+#pragma GCC pop_options
+#endif
+
+#endif // PIX_X86
+
+
+
+/*--------------------------------------------------------------------------------------*\
+									Dispatch
+\*--------------------------------------------------------------------------------------*/
+
+struct RowTable
+{
+	PixRow	Rows [PIX_ISAS][PIX_FORMATS][PIX_TARGETS];
+	PixIsa	Best;
+
+	template <PixFormat S> void Add ()
+	{
+		Rows[PIX_ISA_SCALAR][S][PIX_TO_BGR]  = RowScalar<S, PIX_TO_BGR>;
+		Rows[PIX_ISA_SCALAR][S][PIX_TO_BGRA] = RowScalar<S, PIX_TO_BGRA>;
+		Rows[PIX_ISA_SCALAR][S][PIX_TO_GRAY] = RowScalar<S, PIX_TO_GRAY>;
+#if PIX_X86
+		Rows[PIX_ISA_SSSE3][S][PIX_TO_BGR]	 = RowSsse3<S, PIX_TO_BGR>;
+		Rows[PIX_ISA_SSSE3][S][PIX_TO_BGRA]	 = RowSsse3<S, PIX_TO_BGRA>;
+		Rows[PIX_ISA_SSSE3][S][PIX_TO_GRAY]	 = RowSsse3<S, PIX_TO_GRAY>;
+#endif
+	}
+
+	RowTable ()
+	{
+		memset (Rows, 0, sizeof(Rows));
+		Add<PIX_YUYV>();
+		Add<PIX_UYVY>();
+		Add<PIX_RGB8>();
+		Add<PIX_BGR8>();
+		Add<PIX_RGBA8>();
+		Add<PIX_BGRA8>();
+		Add<PIX_Y8>();
+		Add<PIX_RAW8>();
+		Add<PIX_Y16>();
+		Add<PIX_RAW16>();
+		Add<PIX_RAW10>();
+
+		Best = PIX_ISA_SCALAR;
+#if PIX_X86
+  #if PLATCOMPL == PLATCOMPL_MS
+		int r[4];
+		__cpuid (r, 1);
+		if (r[2] & (1 << 9))
+			Best = PIX_ISA_SSSE3;
+  #else
+		unsigned a, b, c, d;
+		if (__get_cpuid(1, &a, &b, &c, &d) && (c & bit_SSSE3))
+			Best = PIX_ISA_SSSE3;
+  #endif
+#endif
+	}
+};
+
+const RowTable		Table;
+std::atomic<int>	UsedIsa(-1);			// -1 - the best one
+
+}
+
+
+
+bool PIXCONV::Supported (PixFormat src)
+{
+	return src >= 0 && src < PIX_FORMATS && Table.Rows[PIX_ISA_SCALAR][src][PIX_TO_BGR] != nullptr;
+}
+
+
+int PIXCONV::RowBytes (PixFormat src, int width)
+{
+	switch (src) {
+		case PIX_RAW10:	return SrcBytes(PIX_RAW10, width);
+		case PIX_RGB8:	return SrcBytes(PIX_RGB8,  width);
+		case PIX_BGR8:	return SrcBytes(PIX_BGR8,  width);
+		case PIX_RGBA8:	return SrcBytes(PIX_RGBA8, width);
+		case PIX_BGRA8:	return SrcBytes(PIX_BGRA8, width);
+		case PIX_Y8:
+		case PIX_RAW8:	return width;
+		default:		return width * 2;
+	}
+}
+
+
+bool PIXCONV::Convert (PixFormat src, PixTarget dst, const void* in, int inStride, void* out, int outStride, int width, int height)
+{
+	if (!Supported(src) || dst < 0 || dst >= PIX_TARGETS)
+		return false;
+
+	PixRow row = Table.Rows[Isa()][src][dst];
+	if (!inStride)
+		inStride = RowBytes(src, width);
+	if (!outStride)
+		outStride = width * DstBpp(dst);
+
+	// Bands of rows on the thread pool, a small image stays on the calling thread
+	THREADPOOL::ParallelFor (height, MAX(1, PIX_MINBANDPIXELS / MAX(width, 1)), [&] (int y0, int y1) {
+		for (int y = y0; y < y1; y++)
+			row ((const uint8*)in + size_t(y) * inStride, (uint8*)out + size_t(y) * outStride, width);
+	});
+	return true;
+}
+
+
+PixIsa PIXCONV::Isa ()
+{
+	int isa = UsedIsa.load(std::memory_order_relaxed);
+	return isa < 0 ? Table.Best : PixIsa(isa);
+}
+
+
+void PIXCONV::SetIsa (PixIsa isa)
+{
+	UsedIsa = MIN(int(isa), int(Table.Best));
+}
+
+
+cchar* PIXCONV::IsaName (PixIsa isa)
+{
+	static cchar* names[PIX_ISAS] = { "scalar", "SSSE3" };
+	return isa >= 0 && isa < PIX_ISAS ? names[isa] : "?";
+}
@@ -0,0 +1,84 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  pixconv.h
+ Purpose     :  Camera pixel formats to BGR / BGRA / gray conversion
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _PIXCONV_H
+#define _PIXCONV_H
+
+
+// Source pixel formats, the same values as rs2_format
+enum PixFormat
+{
+	PIX_ANY,
+	PIX_Z16,
+	PIX_DISPARITY16,
+	PIX_XYZ32F,
+	PIX_YUYV,
+	PIX_RGB8,
+	PIX_BGR8,
+	PIX_RGBA8,
+	PIX_BGRA8,
+	PIX_Y8,
+	PIX_Y16,
+	PIX_RAW10,
+	PIX_RAW16,
+	PIX_RAW8,
+	PIX_UYVY,
+	PIX_FORMATS
+};
+
+
+// Destination pixel formats, OpenCV channel order
+enum PixTarget
+{
+	PIX_TO_BGR,											// CV_8UC3
+	PIX_TO_BGRA,										// CV_8UC4, opaque
+	PIX_TO_GRAY,										// CV_8UC1
+	PIX_TARGETS
+};
+
+
+// Instruction sets the row converters are built for
+enum PixIsa
+{
+	PIX_ISA_SCALAR,
+	PIX_ISA_SSSE3,
+	PIX_ISAS
+};
+
+
+/*
+ ******************************************************************************
+  Converts the video formats of RealSense cameras to the formats OpenCV shows.
+  Every source/target pair is a row converter instantiated from templates for
+  every instruction set; the best one the CPU supports is picked at startup.
+  All of them give exactly the same bytes. Large images are converted in
+  bands of rows on the thread pool.
+   YUYV, UYVY   - BT.601 limited range; gray is the luma (Y) as is
+   RGB*, BGR*   - gray is BT.601 luma, 0.299 R + 0.587 G + 0.114 B
+   Y16          - the high byte (infrared, 10 bits shifted left by 6)
+   RAW16        - 10 bits in the low bits, scaled to 8 bits
+   RAW10        - MIPI packed, 4 pixels in 5 bytes; the high 8 bits are taken
+   RAW8         - as Y8: the Bayer mosaic is shown as is, not interpolated
+ ******************************************************************************
+*/
+class PIXCONV
+{
+  public:
+	static bool		Supported (PixFormat src);
+	static int		RowBytes (PixFormat src, int width);					// Bytes of a tightly packed source row
+
+	// Strides in bytes, 0 - tightly packed. Returns false for an unsupported source format
+	static bool		Convert (PixFormat src, PixTarget dst, const void* in, int inStride, void* out, int outStride, int width, int height);
+
+	static PixIsa	Isa ();													// The instruction set in use
+	static void		SetIsa (PixIsa isa);									// Limits the instruction set, the CPU's best one at most
+	static cchar*	IsaName (PixIsa isa);
+};
+
+
+#endif // _PIXCONV_H
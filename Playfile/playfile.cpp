@@ -11,8 +11,20 @@
 #include "def.h"
 #include "str.h"
 #include "playfile.h"
+#include "bench.h"
+#include "logger.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "resize.h"
+#include "framepool.h"
+#include "alloctrack.h"
+#include "threadpool.h"
+#include "frameshm.h"
+#include "framenet.h"
 #include "reader-rs.h"
 #include "reader-zed.h"
+#include "reader-shm.h"
+#include "reader-net.h"
 
 /*--------------------------------------------------------------------------------------*\
 									Global data & funcs
@@ -20,6 +32,32 @@
 
 PlayerB*  Player;
 
+static cchar*			PublishName;	// -publish: the segment name, nullptr when the frames aren't published
+static FrameShmWriter	Publisher;
+static const int		PUBLISH_SLOTS = 8;	// Frames a consumer may hold before the producer overwrites them
+static FrameNetServer	Server;			// -serve: the frames shown streamed to the viewers connected
+
+static MetricCounter	FramesShown		("playfile_frames_total",		"Frames shown");
+static MetricGauge		FrameNumber		("playfile_frame_number",		"Number of the frame shown");
+static MetricHistogram	GrabSeconds		("playfile_stage_seconds",		"Latency of the frame pipeline stages", "stage=\"grab\"");
+static MetricHistogram	RenderSeconds	("playfile_stage_seconds",		"Latency of the frame pipeline stages", "stage=\"render\"");
+static MetricCounter	RendersSkipped	("playfile_renders_skipped_total", "Loop iterations with nothing new to show");
+static MetricGauge		PoolUsed		("framepool_used_bytes",		"Bytes of pooled frame buffers in use", nullptr, [] { return double(FRAMEPOOL::GetStats().Used); });
+static MetricGauge		PoolReserved	("framepool_reserved_bytes",	"Bytes of pooled frame buffers, in use and free", nullptr, [] { return double(FRAMEPOOL::GetStats().Reserved); });
+static MetricGauge		PoolHitRatio	("framepool_hit_ratio",			"Share of frame buffers reused from the pool", nullptr,
+										 [] { FRAMEPOOL::Stats s = FRAMEPOOL::GetStats(); return s.Gets ? double(s.Hits) / s.Gets : 0.; });
+static MetricGauge		PoolTasks		("threadpool_tasks",			"Tasks run by the thread pool", nullptr,
+										 [] { THREADPOOL::Stats s = THREADPOOL::GetStats(); return double(s.Executed[TASK_CAPTURE] + s.Executed[TASK_PROCESSING] + s.Executed[TASK_EXPORT]); });
+static MetricGauge		PoolStolen		("threadpool_stolen_tasks",		"Tasks taken from another worker's deque", nullptr, [] { return double(THREADPOOL::GetStats().Stolen); });
+#if UTILS_ALLOCTRACK
+static MetricGauge		AllocLive		("alloc_live_bytes",			"Bytes allocated and not freed", nullptr, [] { return double(ALLOCTRACK::GetStats().Live); });
+static MetricGauge		AllocPeak		("alloc_peak_bytes",			"Peak of the bytes allocated and not freed", nullptr, [] { return double(ALLOCTRACK::GetStats().Peak); });
+static MetricGauge		AllocSteady		("alloc_steady_state_total",	"Allocations after the warm up frames, the frame path should make none", nullptr,
+										 [] { return double(ALLOCTRACK::GetStats().SteadyAllocs); });
+#endif
+
+const int  IDLE_WAIT_MS = 30;		// waitKey() timeout while paused or without new frames
+
 void onMouse (int event, int x, int y, int flags, void* param)
 {
 	((PlayerB*)param)->onMouse (event, x, y, flags);
@@ -35,8 +73,12 @@ void PlayerB::Construct (int64 jump, cchar* file)
 {
 	cv::namedWindow ((cchar*)PlayerName, cv::WINDOW_AUTOSIZE);
 	cv::setMouseCallback ((cchar*)PlayerName, ::onMouse, this);
-	OverlapText.Clear();
-	Iframe = -1;
+	OverlapText.Clear();
+	View.Invalidate();
+	ViewScale = AreaFactor(FrameSize.width, ViewWidth);
+	if (ViewScale > 1)
+		printf ("Window: %d * %d, 1/%d of the frame\n\n", FrameSize.width / ViewScale, FrameSize.height / ViewScale, ViewScale);
+	Iframe = -1;
 	Ijump  = jump;
 	Paused = false;
 }
@@ -51,44 +93,83 @@ void PlayerB::onMouse (int event, int x, int y, int flags)
 
 	if (event == CV_EVENT_LBUTTONDOWN || event == CV_EVENT_RBUTTONDOWN)
 	{
+		// Window to Frame coordinates: the middle of the block a window pixel averages
+		x = MIN(x * ViewScale + ViewScale / 2, FrameSize.width - 1);
+		y = MIN(y * ViewScale + ViewScale / 2, FrameSize.height - 1);
 		LastX = x;
 		LastY = y;
 		unsigned d = GetDepthCoordinate (x, y);
 
 		OverlapText.Print ("[%2d:%2d] D = %3d", x, y, d);
-		puts ((cchar*)OverlapText);
+		LOG (INFO, "[%2d:%2d] D = %3d", x, y, d);
 
 		switch (event) {
 			case CV_EVENT_LBUTTONDOWN:	Paused = false;  break;
-			case CV_EVENT_RBUTTONDOWN:	Paused = true;	 break;
+			case CV_EVENT_RBUTTONDOWN:	Paused = true;	 OnPause();	 break;
+		}
+	}
+}
+
+
+void PlayerB::PublishFrame ()
+{
+	TRACE_ZONE ("Publish", Iframe);
+	const DepthFrame& depth = GetDepth();
+	if (Server.IsRunning())
+		Server.Publish (Iframe, Frame, depth);
+	if (!PublishName)
+		return;
+	if (!Publisher.IsOpen()) {
+		// Slots for the frame size, the depth as float at most
+		if (!Publisher.Create(PublishName, PUBLISH_SLOTS, Frame.total() * Frame.elemSize(), size_t(FrameSize.area()) * sizeof(float))) {
+			printf ("\nCannot create shared memory '%s', the frames are not published\n", PublishName);
+			PublishName = nullptr;
+			return;
 		}
+		printf ("\nFrames published as '%s'\n", PublishName);
 	}
+	Publisher.Write (Iframe, Frame, depth);
 }
 
 
-void PlayerB::Loop ()
+int PlayerB::Loop ()
 {
 	if (!Paused) {
 		// Do not call GetNextFrame() in a pause
-		if (GetNextFrame() < 0)
-			return;	// still no data
+		TraceZone zone ("GetNextFrame");
+		ALLOC_TAG ("grab");
+		int64 prev = Iframe;
+		auto  t0   = std::chrono::steady_clock::now();
+		int64 n    = GetNextFrame();
+		zone.SetFrame (n);
+		if (n < 0)
+			return 1;	// still no data
+		if (n != prev) {
+			GrabSeconds.Observe (std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+			FramesShown.Inc ();
+			FrameNumber.Set (double(n));
+			ALLOCTRACK::Frame ();
+			if (PublishName || Server.IsRunning())
+				PublishFrame ();
+		}
 	}
 
-	cv::Mat  img = Frame.clone ();
-
-	const cv::Scalar TEXTCOLOR = CV_RGB(0,255,0);
 	STR<100> str;
+	View.SetFrame (Frame, Iframe, ViewScale);
 
 	if (Ijump >= 0 && Iframe < Ijump) {
 		str = "Looking forward to frame #";
 		str += Ijump;
-		cv::putText (img, (cchar*)str, cv::Point(3,25), cv::FONT_HERSHEY_DUPLEX, 1.0, TEXTCOLOR, 2);
+		View.SetText (0, str);
+		View.SetText (1, "");
+		View.SetMarker (-1, -1);
 	}
 	else {
 		if (Ijump >= 0) {
 			// just switched from the condition above, pause the video
 			Paused = true;
 			Ijump = -1;
+			OnPause ();
 		}
 		str = '#';
 		str += Iframe;
@@ -96,13 +177,24 @@ void PlayerB::Loop ()
 			str += " / ";
 			str += Nframes;
 		}
-		cv::putText (img, (cchar*)str,		   cv::Point(3,25), cv::FONT_HERSHEY_DUPLEX, 1.0, TEXTCOLOR, 2);
-		cv::putText (img, (cchar*)OverlapText, cv::Point(3,65), cv::FONT_HERSHEY_DUPLEX, 1.0, TEXTCOLOR, 2);
-		if (LastX || LastY)
-			cv::circle (img, cv::Point (LastX, LastY), 5, TEXTCOLOR, -1, 8);
+		View.SetText (0, str);
+		View.SetText (1, OverlapText);
+		View.SetMarker ((LastX || LastY) ? LastX : -1, LastY);
 	}
 
-	cv::imshow ((cchar*)PlayerName, img);
+	// GetNextFrame() waits for frames itself: while they come the keys are only polled,
+	// otherwise main() sleeps in waitKey() until a key, a click or the idle timeout
+	int wait = (Paused || !View.NeedsRender()) ? IDLE_WAIT_MS : 1;
+	if (!View.NeedsRender()) {
+		RendersSkipped.Inc ();
+		return wait;
+	}
+
+	TRACE_ZONE ("Render", Iframe);
+	ALLOC_TAG ("render");
+	MetricTimer rendertimer (RenderSeconds);
+	cv::imshow ((cchar*)PlayerName, View.Render());
+	return wait;
 }
 
 
@@ -112,20 +204,87 @@ void PlayerB::Loop ()
 
 int main (int argc, char * argv[]) try
 {
-	// 1. Check arguments 
+	// 1. Check arguments, the logging and tracing options may precede all the others
+	cchar*  tracefile = nullptr;
+	bool	metrics   = false;
+	int		viewwidth = 0;
+	for (; argc > 1; argv++, argc--) {
+		if (STRB::strequ(argv[1], "-log=", 5)) {
+			if (!LOGGER::Configure(argv[1] + 5)) {
+				printf ("\nBad log option: %s\n", argv[1]);
+				goto usage;
+			}
+		}
+		else if (STRB::strequ(argv[1], "-trace=", 7)) {
+			tracefile = argv[1] + 7;
+			TRACER::SetThreadName ("main");
+			TRACER::Start ();
+		}
+		else if (STRB::strequ(argv[1], "-metrics=", 9)) {
+			if (!(metrics = METRICS::Serve(argv[1] + 9))) {
+				printf ("\nCannot serve metrics on %s\n", argv[1] + 9);
+				goto usage;
+			}
+			printf ("\nMetrics served on %s\n", argv[1] + 9);
+		}
+		else if (STRB::strequ(argv[1], "-view=", 6)) {
+			viewwidth = STRB::atoi32(argv[1] + 6);
+		}
+		else if (STRB::strequ(argv[1], "-threads=", 9)) {
+			THREADPOOL::Start (STRB::atoi32(argv[1] + 9), strstr(argv[1], ",pin") != nullptr);
+		}
+		else if (STRB::strequ(argv[1], "-publish=", 9)) {
+			PublishName = argv[1] + 9;
+		}
+		else if (STRB::strequ(argv[1], "-serve=", 7)) {
+			if (!Server.Start(argv[1] + 7)) {
+				printf ("\nCannot serve frames on %s\n", argv[1] + 7);
+				goto usage;
+			}
+			printf ("\nFrames served on port %d\n", Server.Port());
+		}
+		else if (STRB::strequ(argv[1], "-hugepages")) {
+			if (!FRAMEPOOL::UseHugePages(true))
+				printf ("\nLarge pages are not available, frame buffers use normal pages\n");
+		}
+		else
+			break;
+	}
+
 	if (argc != 2 && argc != 3 && argc != 4) {
 		usage:
-		puts ("\nUsage:\n  playfile -{zed|rs} [-j=<JumpToFrameNum>] [file-path]\n");
+		puts ("\nUsage:\n  playfile [-log=<level>[,<log-file>]] [-trace=<json-file>] [-metrics=[<ip>:]<port>|unix:<path>] [-view=<max-width>] [-threads=<n>[,pin]] [-hugepages] [-publish=<name>] [-serve=[<ip>:]<port>] -{zed|rs|shm|net} [-j=<JumpToFrameNum>] [file-path]\n"
+		      "  playfile -bench=<name|all>\n"
+		      "\nLog levels: off, error, warn, info (default), debug, trace\n"
+		      "Trace: timing zones saved on exit as Chrome trace JSON, open it in ui.perfetto.dev\n"
+		      "Metrics: Prometheus text at http://127.0.0.1:<port>/metrics, 127.0.0.1 unless an ip is given\n"
+		      "View: the window is the frame downscaled 2, 3, ... times to fit the width, clicks query the full frame\n"
+		      "Threads: workers of the thread pool shared by the processing stages, one per core by default; pin - one core each\n"
+		      "Hugepages: frame buffers of 2 MB and more on large pages; Windows needs the \"Lock pages in memory\" right\n"
+		      "Publish: the frames shown are shared with other processes through shared memory\n"
+		      "Shm: plays the frames another playfile publishes, file-path is the name given to -publish (playfile by default)\n"
+		      "Serve: the frames shown are streamed over TCP, 127.0.0.1 unless an ip is given (0.0.0.0 - all the interfaces)\n"
+		      "Net: plays the frames a playfile serves, file-path is [<ip>:]<port>[,image][,depth][,dec=<n>][,delta]\n"
+		      "\nZED file keys:\n  ',' '.'  step one frame back/forward\n  '[' ']'  jump one second back/forward\n  'r'      reverse\n  ' '      pause\n");
 		goto end;
 	}
 
 	// 2. Parse command line args
-	if (STRB::strequ(argv[1], "-zed")) {
+	if (STRB::strequ(argv[1], "-bench=", 7)) {
+		return BenchRun (argv[1] + 7);
+	}
+	else if (STRB::strequ(argv[1], "-zed")) {
 		Player = new PlayerZed();
 	}
 	else if (STRB::strequ (argv[1], "-rs")) {
 		Player = new PlayerRealsense();
 	}
+	else if (STRB::strequ (argv[1], "-shm")) {
+		Player = new PlayerShm();
+	}
+	else if (STRB::strequ (argv[1], "-net")) {
+		Player = new PlayerNet();
+	}
 	else {
 		goto usage;
 	}
@@ -145,17 +304,36 @@ int main (int argc, char * argv[]) try
 	}
 
 	// 3. Construct the necessary Player object
+	Player->SetViewWidth (viewwidth);
 	Player->Construct(jump, file);
 
-	// 3. Endless loop calling PlayerB::Loop() func, will be ended after a user closes OpenCV Window
-	while (cv::waitKey(1) < 0 && Player->GetWindowHandle())
+	// 3. Endless loop calling PlayerB::Loop() func, will be ended after a user closes OpenCV Window or presses a key not handled by the Player
+	int key, wait = 1;
+	while (((key = cv::waitKey(wait)) < 0 || Player->OnKey(key)) && Player->GetWindowHandle())
     {
-		Player->Loop();
+		wait = Player->Loop();
     }
 
 	end:
 	// 4. Finalize
-	delete Player;
+	if (Player) {
+		delete Player;
+		FRAMEPOOL::PrintStats ();
+		ALLOCTRACK::Report ();
+	}
+	Publisher.Close ();
+	Server.Stop ();
+	THREADPOOL::Stop ();
+	if (metrics)
+		METRICS::Stop ();
+	LOGGER::Close ();
+	if (tracefile) {
+		TRACER::Stop ();
+		if (TRACER::Save(tracefile))
+			printf ("\nTrace saved to %s: %lld zones, %lld dropped\n", tracefile, TRACER::Zones(), TRACER::Dropped());
+		else
+			printf ("\nCannot write trace file %s\n", tracefile);
+	}
 	_getch ();
 	return 0;
 }
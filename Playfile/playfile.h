@@ -10,7 +10,9 @@
 #define _PLAYFILE_H
 
 #include <opencv2/opencv.hpp>   // OpenCV API
-#include "str.h"
+#include "str.h"
+#include "depth.h"
+#include "render.h"
 
 
 /*
@@ -22,20 +24,33 @@
 class PlayerB
 {
   public:
+						PlayerB () : LastX(0), LastY(0), ViewWidth(0), ViewScale(1) {}
+	virtual				~PlayerB () {}
 	virtual void		Construct (int64 jump = -1, cchar* file = nullptr);	// Construct the object. If file param is supplied then use it as input stream. Otherwise to work with correspondent Camera HW
 	virtual int64		GetNextFrame () = 0;								// Called from PlayerB::Loop(), returns frame number (IFrame), should fill PlayerB::Frame. Returning -1 means a 1st frame still was not appeared
-	virtual unsigned	GetDepthCoordinate (int x, int y) = 0;				// Get Depth value for the X,Y pixel in Frame
+	virtual const DepthFrame& GetDepth ()	{ return Depth; }					// Depth of the current frame, players retrieving it lazily override this
+	unsigned			GetDepthCoordinate (int x, int y)	{ return GetDepth().Millimeters(x, y); }	// Depth in mm for the X,Y pixel in Frame, 0 if unknown
+	virtual bool		OnKey (int key)		{ return false; }				// Called from main() loop for a pressed key. Returning false ends the program
+	virtual void		OnPause ()			{}								// Called when the playing pauses; a player showing frames it doesn't own keeps a copy
 
 	void  onMouse			(int event, int x, int y, int flags);			// OpenCV onMouse callback for a specific Player object
 	void* GetWindowHandle() { return cvGetWindowHandle(PlayerName); }		// Gets current player OpenCV window handle
-	void  Loop();															// Endless loop body function to show the video, called from main() while loop
+	int   Loop();															// Endless loop body function to show the video, called from main() while loop. Returns ms main() may wait for keys
+	void  SetViewWidth (int width)	{ ViewWidth = width; }					// Max window width, 0 - full frame. Called before Construct()
+
+  private:
+	void  PublishFrame ();													// -publish, -serve: Frame and its depth to other processes and machines
 
   protected:
 	STRING			PlayerName;												// Player OpenCV Window name
 	STRING			OverlapText;											// Overlapped text formated by PlayerB::onMouse() func
 	cv::Mat			Frame;													// Current frame RGB data filled by GetNextFrame()
+	DepthFrame		Depth;													// Depth of Frame in its viewport, filled by GetNextFrame() or GetDepth()
 	cv::Size		FrameSize;												// Frame size 
 	int				LastX, LastY;											// X,Y coordinates in the Frame after last mouse press
+	int				ViewWidth;												// Max window width requested, 0 - no limit
+	int				ViewScale;												// Frame pixels per window pixel, set by PlayerB::Construct()
+	ViewRender		View;													// Window image, redrawn by PlayerB::Loop() only when something changed
 	int64			Nframes;												// Keeps amount of frames or -1 when it's unknown. Actually it should contain last frame number.
 	int64			Iframe;													// Frame sequence number, initialized in PlayerB::Construct as -1, in order to detect first interations with no data 
 	int64			Ijump;													// When != 0, the playing starts from Iframe == Ijump
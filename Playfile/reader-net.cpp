@@ -0,0 +1,72 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  reader-net.cpp
+ Purpose     :  Player of the frames a server streams over TCP
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "reader-net.h"
+#include "tracer.h"
+#include "metrics.h"
+
+#include <stdexcept>
+#include <thread>
+
+static MetricCounter	NetBytes	("playfile_network_bytes_total",	"Bytes of the frames received from the server");
+static const int		NET_WAIT_MS = 100;	// Longest wait for a frame, keeps the window responsive while the server is away
+
+
+void PlayerNet::Construct (int64 jump, cchar* file)
+{
+	if (!file)
+		throw std::runtime_error ("The server address is missing");
+	Addr = file;
+	Addr.SeekStart();
+	char* options = Addr.ScanCharSet0(',');		// Addr keeps the address only
+	if (!Request.Parse(options))
+		throw std::runtime_error ("Bad stream options, expected image, depth, dec=<n>, delta, raw");
+	Request.Streams |= FRAMENET_IMAGE;
+
+	PlayerName = "Quickest Owl : NETWORK : ";
+	PlayerName += file;
+
+	// The window is made for the size of the server's frames
+	printf ("Connecting to %s...\n", (cchar*)Addr);
+	FrameNetFrame f;
+	while (!Client.Receive(f, NET_WAIT_MS) || f.Image.empty()) {
+		if (!Client.IsOpen() && !Client.Connect(Addr, Request))
+			std::this_thread::sleep_for (std::chrono::milliseconds(NET_WAIT_MS));
+	}
+	FrameSize = f.Image.size();
+	Nframes	  = -1;
+
+	printf ("\nStreamed frames:\n"
+	        "  Video: %d * %d, %d channels, decimated %d times\n"
+			"  Depth: %s\n\n", FrameSize.width, FrameSize.height, f.Image.channels(), Request.Decimation,
+			f.Depth.Empty() ? "none" : Request.Codec == FRAMENET_DELTA ? "delta coded" : "raw");
+
+	PlayerB::Construct (jump, file);
+}
+
+
+int64 PlayerNet::GetNextFrame ()
+{
+	TraceZone	  zone ("WaitFrames");
+	FrameNetFrame f;
+
+	if (!Client.IsOpen() && !Client.Connect(Addr, Request)) {
+		std::this_thread::sleep_for (std::chrono::milliseconds(NET_WAIT_MS));
+		return Iframe;	// the server is away
+	}
+	if (!Client.Receive(f, NET_WAIT_MS) || f.Image.size() != FrameSize)
+		return Iframe;	// nothing new, or a server restarted with another size
+
+	NetBytes.Inc (f.WireBytes);
+	Frame  = f.Image;
+	Depth  = f.Depth;
+	Iframe = f.N;
+	zone.SetFrame (Iframe);
+	return Iframe;
+}
@@ -0,0 +1,38 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  reader-net.h
+ Purpose     :  Player of the frames a server streams over TCP
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _PLAYFILE_NET_H
+#define _PLAYFILE_NET_H
+
+#include <opencv2/opencv.hpp>					// OpenCV API
+#include "playfile.h"
+#include "framenet.h"
+
+
+/*
+ ******************************************************************************
+  Plays the frames "playfile -serve=<port>" streams from the capture box.
+  The address is "[<ip>:]<port>[,<options>]", options of FrameNetRequest:
+  the streams, decimation and codec. The image is always asked for, the
+  window shows it. A connection lost is made again when the server is back.
+ ******************************************************************************
+*/
+class PlayerNet : public PlayerB
+{
+  private:
+	virtual void		Construct (int64 jump = -1, cchar* file = nullptr);	// file - the address and options
+	virtual int64		GetNextFrame ();
+
+  private:
+	FrameNetClient	Client;
+	FrameNetRequest	Request;
+	STRING			Addr;
+};
+
+
+#endif // _PLAYFILE_NET_H
@@ -8,9 +8,30 @@
 
 #include "def.h"
 #include "reader-rs.h"
+#include "tracer.h"
+#include "metrics.h"
+#include "framepool.h"
 
 using namespace rs2;
 
+static MetricCounter  FramesDropped ("playfile_frames_dropped_total", "Frames skipped by the player as it could not keep up");
+static const unsigned FILE_WAIT_MS = 100;	// Longest wait for a frame of a file, keeps the window responsive before the 1st one
+
+
+static AlignIntrinsics ToAlign (const rs2_intrinsics& in)
+{
+	AlignIntrinsics out;
+	out.Width  = in.width;
+	out.Height = in.height;
+	out.Ppx    = in.ppx;
+	out.Ppy    = in.ppy;
+	out.Fx     = in.fx;
+	out.Fy     = in.fy;
+	out.Model  = AlignDistortion(in.model);
+	memcpy (out.Coeffs, in.coeffs, sizeof(out.Coeffs));
+	return out;
+}
+
 //static
 cchar* PlayerRealsense::FormatNames [RS2_FORMAT_COUNT] = 
 {
@@ -82,28 +103,49 @@ void PlayerRealsense::Construct (int64 jump, cchar* file)
 		printf ("%4d. %s, %s, FPS = %d\n", ++i, s.stream_name().c_str(), FormatNames[s.format()], s.fps());
 	}
 	
-	video_stream_profile&&  colorstream = profile.get_stream(RS2_STREAM_COLOR).as<video_stream_profile>();
-	assert (colorstream.format() == RS2_FORMAT_RGB8);
-
-	video_stream_profile&&  depthstream = profile.get_stream(RS2_STREAM_DEPTH).as<video_stream_profile>();
-	assert (depthstream.format() == RS2_FORMAT_Z16);
-
-	Nframes = -1;  // didn't find how to get RS BAG file amount of frames
-	Iframe0 = 0;
-
-	FrameSize = { colorstream.width(), colorstream.height() };
-
-	ImageDataBuf = new char[FrameSize.width * FrameSize.height * 3];
-	assert (ImageDataBuf);
-
-	DepthDataBuf = new uint16[FrameSize.width * FrameSize.height];
-	assert (DepthDataBuf);
+	// The image shown: color if there is one, otherwise infrared or any other video stream of a format PIXCONV knows
+	video_stream_profile  colorstream;
+	for (auto&& s : profile.get_streams()) {
+		if (!s.is<video_stream_profile>() || s.stream_type() == RS2_STREAM_DEPTH || !PIXCONV::Supported(PixFormat(s.format())))
+			continue;
+		if (!colorstream || (s.stream_type() == RS2_STREAM_COLOR && colorstream.stream_type() != RS2_STREAM_COLOR))
+			colorstream = s.as<video_stream_profile>();
+	}
+	if (!colorstream)
+		throw std::runtime_error ("No video stream of a supported format");
+	ImageStream = colorstream.stream_type();
+	ImageFormat = PixFormat(colorstream.format());
+
+	Nframes = -1;  // didn't find how to get RS BAG file amount of frames
+	Iframe0 = 0;
+
+	FrameSize = { colorstream.width(), colorstream.height() };
+
+	// Depth comes from another camera, usually of another resolution: map it into the color frame
+	// so the depth under a clicked pixel is the depth of what is seen there
+	float depthscale = 0;
+	for (auto&& s : profile.get_streams()) {
+		if (s.stream_type() != RS2_STREAM_DEPTH || s.format() != RS2_FORMAT_Z16)
+			continue;
+		video_stream_profile&&  depthstream = s.as<video_stream_profile>();
+		AlignExtrinsics extrin;
+		rs2_extrinsics  rsextrin = depthstream.get_extrinsics_to(colorstream);
+		memcpy (extrin.Rotation, rsextrin.rotation, sizeof(extrin.Rotation));
+		memcpy (extrin.Translation, rsextrin.translation, sizeof(extrin.Translation));
+		depthscale = profile.get_device().first<depth_sensor>().get_depth_scale();
+		Aligner = new DepthAligner (ToAlign(depthstream.get_intrinsics()), ToAlign(colorstream.get_intrinsics()), extrin, depthscale);
+		break;
+	}
 
-	Frame = cv::Mat (FrameSize.height, FrameSize.width, CV_8UC4, ImageDataBuf);
+	// Every frame gets new pooled buffers: what a stage still holds stays intact while the next frame comes
+	Frame = FRAMEPOOL::NewMat (FrameSize.height, FrameSize.width, CV_8UC3);
+	Depth = DepthFrame (DEPTH_Z16, depthscale, FrameSize.width, FrameSize.height, nullptr);	// unknown without a depth stream
+	Depth.Intrin = ToAlign(colorstream.get_intrinsics());
     
 	printf ("\nCommon parameters:\n"
-	        "  Video size: %d * %d\n"
-			"  Depth scale: %.6f\n\n", FrameSize.width, FrameSize.height, profile.get_device().first<depth_sensor>().get_depth_scale());
+	        "  Video: %s %s, %d * %d, converted with %s\n"
+			"  Depth scale: %.6f\n\n", colorstream.stream_name().c_str(), FormatNames[ImageFormat], FrameSize.width, FrameSize.height,
+			PIXCONV::IsaName(PIXCONV::Isa()), depthscale);
 
 	PlayerB::Construct (jump, file);
 }
@@ -114,8 +156,9 @@ int64 PlayerRealsense::GetNextFrame ()
 	bool		newdata;
 	frameset	curset;
 
+	TraceZone	zone ("WaitFrames");
 	if (FromFile) {
-		newdata = Pipe.poll_for_frames (&curset);
+		newdata = Pipe.try_wait_for_frames (&curset, FILE_WAIT_MS);	// blocks until the next frame instead of polling
 		if (Iframe < 0  &&  !newdata)
 			return Iframe;	// 1st frame still not appeared
 	}
@@ -124,20 +167,34 @@ int64 PlayerRealsense::GetNextFrame ()
 		curset = Pipe.wait_for_frames();
 	}
 
-	rs2::frame& imgframe = curset.get_color_frame();
+	rs2::video_frame imgframe = curset.first_or_default(ImageStream);
+	if (!imgframe)
+		return Iframe;
 
 	if (Iframe < 0)
 		Iframe0 = imgframe.get_frame_number();
 
+	zone.SetFrame (Iframe + 1);
 	if (newdata) {
-		Iframe = imgframe.get_frame_number() - Iframe0;
-		cv::Mat mat(FrameSize, CV_8UC3, (void*)imgframe.get_data());	// create OpenCV matrix of w*h size from the RGB data
-		cv::cvtColor(mat, Frame, CV_RGB2BGR);							// convert to OpenCV's BGR
-
-		rs2::frame& dthframe = curset.get_depth_frame();
+		TRACE_ZONE ("CopyFrame", imgframe.get_frame_number() - Iframe0);
+		int64 n = imgframe.get_frame_number() - Iframe0;
+		if (Iframe >= 0 && n > Iframe + 1)
+			FramesDropped.Inc (n - Iframe - 1);
+		Iframe = n;
+		Frame = FRAMEPOOL::NewMat (FrameSize.height, FrameSize.width, CV_8UC3);
+		PIXCONV::Convert (ImageFormat, PIX_TO_BGR, imgframe.get_data(), imgframe.get_stride_in_bytes(), Frame.data, int(Frame.step),
+						  FrameSize.width, FrameSize.height);								// convert to OpenCV's BGR
+
+		rs2::frame dthframe = curset.first_or_default(RS2_STREAM_DEPTH);
 		//assert (dthframe.as<video_frame>().get_bits_per_pixel() == sizeof(uint16)*8);
 		//it's already checcked by format == RS2_FORMAT_Z16
-		memcpy (DepthDataBuf, dthframe.get_data(), FrameSize.width * FrameSize.height * sizeof(uint16));
+		if (Aligner && dthframe) {
+			TRACE_ZONE ("AlignDepth", Iframe);
+			DepthFrame depth (DEPTH_Z16, Depth.Scale, FRAMEPOOL::NewMat(FrameSize.height, FrameSize.width, CV_16UC1));
+			depth.Intrin = Depth.Intrin;
+			Aligner->DepthToColor ((const uint16*)dthframe.get_data(), (uint16*)depth.Hold.data);
+			Depth = depth;
+		}
 	}
 
 	return Iframe;
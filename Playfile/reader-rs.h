@@ -15,26 +15,25 @@
 #include <librealsense2/hpp/rs_context.hpp>
 
 #include "playfile.h"
+#include "align.h"
+#include "pixconv.h"
 
 
 class PlayerRealsense : public PlayerB
 {
   public:
-	PlayerRealsense() : ImageDataBuf(nullptr), DepthDataBuf(nullptr)
+	PlayerRealsense() : Aligner(nullptr)
 	{}
 
 	virtual ~PlayerRealsense ()
 	{
-		if (ImageDataBuf)
-			delete ImageDataBuf;
-		if (DepthDataBuf)
-			delete DepthDataBuf;
+		if (Aligner)
+			delete Aligner;
 	}
 
   private:
 	virtual void		Construct (int64 jump = -1, cchar* file = nullptr);
 	virtual int64		GetNextFrame ();
-	virtual unsigned	GetDepthCoordinate (int x, int y);
 
   private:
 	static cchar* FormatNames[RS2_FORMAT_COUNT];
@@ -43,15 +42,10 @@ class PlayerRealsense : public PlayerB
 	rs2::pipeline	Pipe;
 	bool			FromFile;
 	int64			Iframe0;
-	char*			ImageDataBuf;
-	uint16*			DepthDataBuf;
+	DepthAligner*	Aligner;
+	rs2_stream		ImageStream;					// Stream shown: color, infrared, ...
+	PixFormat		ImageFormat;
 };
 
 
-inline unsigned PlayerRealsense::GetDepthCoordinate (int x, int y)
-{
-	return DepthDataBuf [FrameSize.width * y + x];
-}
-
-
 #endif // _PLAYFILE_RS_H
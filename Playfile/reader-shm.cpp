@@ -0,0 +1,92 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  reader-shm.cpp
+ Purpose     :  Player of the frames another process shares
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "reader-shm.h"
+#include "tracer.h"
+#include "framepool.h"
+
+#include <thread>
+
+static const int  SHM_WAIT_MS = 100;	// Longest wait for a frame, keeps the window responsive while the producer is away
+
+
+void PlayerShm::Construct (int64 jump, cchar* file)
+{
+	Name = file ? file : "playfile";
+	PlayerName = "Quickest Owl : SHARED : ";
+	PlayerName += Name;
+
+	// The window is made for the size of the producer's frames
+	printf ("Waiting for frames published as '%s'...\n", (cchar*)Name);
+	while (!Reader.Next(Shown, SHM_WAIT_MS) || Shown.Image.empty()) {
+		if (Reader.Closed() && !Reader.Open(Name))
+			std::this_thread::sleep_for (std::chrono::milliseconds(SHM_WAIT_MS));
+	}
+	FrameSize = Shown.Image.size();
+	Nframes	  = -1;
+
+	printf ("\nShared frames:\n"
+	        "  Video: %d * %d, %d channels\n"
+			"  Depth: %s\n\n", FrameSize.width, FrameSize.height, Shown.Image.channels(),
+			Shown.Depth.Empty() ? "none" : Shown.Depth.IsFloat() ? "float" : "uint16");
+
+	PlayerB::Construct (jump, file);
+}
+
+
+int64 PlayerShm::GetNextFrame ()
+{
+	TraceZone	 zone ("WaitFrames");
+	FrameShmView view;
+
+	if (Reader.Closed() && !Reader.Open(Name)) {
+		std::this_thread::sleep_for (std::chrono::milliseconds(SHM_WAIT_MS));
+		return Iframe;	// the producer is away
+	}
+	if (!Reader.Next(view, SHM_WAIT_MS) || view.Image.size() != FrameSize)
+		return Iframe;	// nothing new, or a producer restarted with another size
+
+	// Newest first: the frames the producer published meanwhile are skipped
+	Shown	 = view;
+	Frame	 = view.Image;
+	Depth	 = view.Depth;
+	Detached = false;
+	Iframe	 = view.N;
+	zone.SetFrame (Iframe);
+	return Iframe;
+}
+
+
+const DepthFrame& PlayerShm::GetDepth ()
+{
+	// Overwritten while the player stalled: unknown rather than the depth of a later frame
+	if (!Detached && !Depth.Empty() && !Reader.Valid(Shown))
+		Depth = DepthFrame();
+	return Depth;
+}
+
+
+void PlayerShm::OnPause ()
+{
+	if (Detached)
+		return;
+	TRACE_ZONE ("CopyFrame", Iframe);
+	cv::Mat frame = FRAMEPOOL::Clone(Frame);
+	DepthFrame depth;
+	if (!Depth.Empty()) {
+		cv::Mat view (Depth.Height, Depth.Width, Depth.IsFloat() ? CV_32FC1 : CV_16UC1, (void*)Depth.Data, Depth.Stride);
+		depth = DepthFrame(Depth.Units, Depth.Scale, FRAMEPOOL::Clone(view));
+		depth.Intrin = Depth.Intrin;
+	}
+	if (!Reader.Valid(Shown))
+		return;		// overwritten while copied: the window keeps what it shows, clicks get no depth
+	Frame	 = frame;
+	Depth	 = depth;
+	Detached = true;
+}
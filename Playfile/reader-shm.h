@@ -0,0 +1,46 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  reader-shm.h
+ Purpose     :  Player of the frames another process shares
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _PLAYFILE_SHM_H
+#define _PLAYFILE_SHM_H
+
+#include <opencv2/opencv.hpp>					// OpenCV API
+#include "playfile.h"
+#include "frameshm.h"
+
+
+/*
+ ******************************************************************************
+  Plays the frames a producer owning the camera ("playfile -publish=<name>")
+  puts into shared memory, always the newest one. Frame and Depth are views
+  of the producer's slot, nothing is copied while playing; the pause copies
+  the frame, as the producer goes on and overwrites the slot. A producer
+  restarted is picked up again when it comes back.
+ ******************************************************************************
+*/
+class PlayerShm : public PlayerB
+{
+  public:
+	PlayerShm () : Detached(false)
+	{}
+
+  private:
+	virtual void		Construct (int64 jump = -1, cchar* file = nullptr);	// file - the name given to -publish
+	virtual int64		GetNextFrame ();
+	virtual const DepthFrame& GetDepth ();
+	virtual void		OnPause ();
+
+  private:
+	FrameShmReader	Reader;
+	FrameShmView	Shown;													// The slot Frame and Depth are views of
+	STRING			Name;
+	bool			Detached;												// Frame and Depth are copies, Shown no longer matters
+};
+
+
+#endif // _PLAYFILE_SHM_H
@@ -8,6 +8,9 @@
 
 #include "def.h"
 #include "reader-zed.h"
+#include "logger.h"
+#include "tracer.h"
+#include "framepool.h"
 
 using namespace sl;
 
@@ -47,37 +50,210 @@ void PlayerZed::Construct (int64 jump, cchar* file)
 
 	FrameSize = { int(Zed.getResolution().width), int(Zed.getResolution().height) };
 
-	new (&SvoImage) sl::Mat (FrameSize.width, FrameSize.height, MAT_TYPE_8U_C4, MEM_CPU);
+	sl::Mat& left = SvoChannels[CHANNEL_LEFT];
+	new (&left) sl::Mat (FrameSize.width, FrameSize.height, MAT_TYPE_8U_C4, MEM_CPU);
 
-	Frame = cv::Mat (FrameSize.height, FrameSize.width, CV_8UC4, SvoImage.getPtr<sl::uchar1>(MEM_CPU));
+	Frame = cv::Mat (FrameSize.height, FrameSize.width, CV_8UC4, left.getPtr<sl::uchar1>(MEM_CPU));
+
+	// Depth is computed on the rectified left image: no distortion
+	CameraParameters& cam = Zed.getCameraInformation().calibration_parameters.left_cam;
+	Intrin = { FrameSize.width, FrameSize.height, cam.cx, cam.cy, cam.fx, cam.fy, ALIGN_DISTORTION_NONE, { 0, 0, 0, 0, 0 } };
 
+	Fps = int(Zed.getCameraFPS());
 	printf ("\nCommon parameters:\n"
 	        "  Video size: %d * %d\n"
-			"  FPS: %d\n\n", FrameSize.width, FrameSize.height, int(Zed.getCameraFPS()));
+			"  FPS: %d\n\n", FrameSize.width, FrameSize.height, Fps);
 
+	if (FromFile && Nframes > 0) {
+		// Play files through the cache: jumps, stepping back and forth and reverse playing reuse decoded frames
+		FrameCache::Params prm;
+		prm.Budget		= size_t(1) << 30;
+		prm.FullRadius	= 2 * Fps;
+		prm.Prefetch	= Fps / 2;
+		prm.ProxyScale	= 1;		// no proxies: clicks need the depth of the displayed frame
+		SvoPos = -2;
+		Dir = 1;
+		Cache = new FrameCache ([this] (int64 n, CachedFrame& out) { return DecodeFrame(n, out); }, Nframes + 1, prm);
+	}
 
 	PlayerB::Construct (jump, file);
+
+	if (Cache && jump > 0)
+		Iframe = MIN(jump, Nframes) - 1;	// the cache seeks directly, no need to play till the jump frame
 }
 
 
 int64 PlayerZed::GetNextFrame ()
 {
+	if (Cache) {
+		int64 n = Iframe + Dir;
+		if (n < 0 || n > Nframes)
+			return Iframe;	// hold the first/last frame
+		return ShowFrame (n);
+	}
+
 	if (Nframes >= 0 && Iframe == Nframes)
 		return Iframe;	// for some strange reason Zed.grab() on some SVO files returns SUCCESS after the end, this mechanism guards it
 
-	if (Zed.grab() == SUCCESS) {
-		Zed.retrieveImage (SvoImage, VIEW_LEFT);
-		//Zed.retrieveImage (SvoDepth, VIEW_DEPTH);
-		Zed.retrieveMeasure(SvoDepth, MEASURE_DEPTH);
+	TRACE_ZONE ("Grab", Iframe + 1);
+	if (Grab()) {
+		Retrieve (CHANNEL_LEFT);	// shown right away, the other channels wait for GetDepth() or Retrieve()
 		Iframe++;
 	}
 	return Iframe;
 }
 
 
-unsigned PlayerZed::GetDepthCoordinate (int x, int y)
+void PlayerZed::Need (unsigned channels)
+{
+	Needed |= channels;
+}
+
+
+bool PlayerZed::Grab ()
+{
+	RuntimeParameters prm;
+	prm.enable_depth = (Needed & ~(1u << CHANNEL_LEFT)) != 0;
+	if (Zed.grab(prm) != SUCCESS)
+		return false;
+
+	GrabbedDepth = prm.enable_depth;
+	Retrieved	 = 0;
+	Depth		 = DepthFrame();
+	return true;
+}
+
+
+sl::Mat& PlayerZed::Retrieve (Channel ch)
+{
+	static sl::Mat none;
+	if (Retrieved & (1 << ch))
+		return SvoChannels[ch];
+
+	if (Cache)
+		return none;	// the cache thread owns the camera; the left image of the frame shown is retrieved by ShowFrame()
+	if (ch != CHANNEL_LEFT && !GrabbedDepth) {
+		Need (1 << ch);
+		if (!FromFile || Iframe < 0)
+			return none;	// the live camera has it from the next frame
+		// Grab this frame again, with depth
+		TRACE_ZONE ("Regrab", Iframe);
+		Zed.setSVOPosition (int(Iframe));
+		if (!Grab())
+			return none;
+		Retrieve (CHANNEL_LEFT);
+	}
+
+	TRACE_ZONE ("Retrieve", Iframe);
+	switch (ch) {
+		case CHANNEL_LEFT:			Zed.retrieveImage	(SvoChannels[ch], VIEW_LEFT);			break;
+		case CHANNEL_DEPTH:			Zed.retrieveMeasure	(SvoChannels[ch], MEASURE_DEPTH);		break;
+		case CHANNEL_CONFIDENCE:	Zed.retrieveMeasure	(SvoChannels[ch], MEASURE_CONFIDENCE);	break;
+		case CHANNEL_CLOUD:			Zed.retrieveMeasure	(SvoChannels[ch], MEASURE_XYZRGBA);		break;
+		default:					return none;
+	}
+	Retrieved |= 1 << ch;
+	return SvoChannels[ch];
+}
+
+
+const DepthFrame& PlayerZed::GetDepth ()
 {
-	float depth_value = 0;
-	SvoDepth.getValue (x, y, &depth_value);
-	return unsigned (depth_value);
+	if (Cache) {
+		if (Depth.Empty() && Iframe >= 0) {
+			// Decoded without depth: decode it again, and the next ones with depth
+			Need (1 << CHANNEL_DEPTH);
+			Cache->Drop (Iframe);
+			ShowFrame (Iframe);
+		}
+		return Depth;
+	}
+
+	if (Depth.Empty()) {
+		sl::Mat& d = Retrieve(CHANNEL_DEPTH);
+		if (d.isInit()) {
+			Depth = DepthFrame (DEPTH_MM32F, 0, FrameSize.width, FrameSize.height, d.getPtr<sl::float1>(MEM_CPU), d.getStepBytes(MEM_CPU));
+			Depth.Intrin = Intrin;
+		}
+	}
+	return Depth;
+}
+
+
+int64 PlayerZed::ShowFrame (int64 n)
+{
+	TRACE_ZONE ("CacheGet", n);
+	Cache->SetPlayhead (n, Paused ? 0 : Dir);
+
+	CachedFrame f;
+	if (!Cache->Get (n, f, -1))
+		return Iframe;
+
+	Frame = f.Image;
+	Depth = f.Depth.empty() ? DepthFrame() : DepthFrame (DEPTH_MM32F, 0, f.Depth);
+	Depth.Intrin = Intrin;
+
+	// Retrieve(CHANNEL_LEFT) views the pooled image, Frame holds it till the next frame
+	SvoChannels[CHANNEL_LEFT] = sl::Mat (FrameSize.width, FrameSize.height, MAT_TYPE_8U_C4, Frame.data, Frame.step, MEM_CPU);
+	Retrieved = 1 << CHANNEL_LEFT;
+	return Iframe = n;
+}
+
+
+bool PlayerZed::DecodeFrame (int64 n, CachedFrame& out)
+{
+	TRACE_ZONE ("Grab", n);
+	if (n != SvoPos + 1)
+		Zed.setSVOPosition (int(n));
+
+	RuntimeParameters prm;
+	prm.enable_depth = (Needed & (1u << CHANNEL_DEPTH)) != 0;
+	if (Zed.grab(prm) != SUCCESS) {
+		SvoPos = -2;
+		return false;
+	}
+	SvoPos = n;
+
+	sl::Mat& image = DecodeChannels[CHANNEL_LEFT];
+	sl::Mat& depth = DecodeChannels[CHANNEL_DEPTH];
+	Zed.retrieveImage (image, VIEW_LEFT);
+	if (prm.enable_depth)
+		Zed.retrieveMeasure (depth, MEASURE_DEPTH);
+
+	// The SDK reuses its buffers, the cache keeps its own copies: pooled, evicted frames give them back for the next ones
+	TRACE_ZONE ("CopyFrame", n);
+	out.Image = FRAMEPOOL::Clone (cv::Mat(FrameSize, CV_8UC4,  image.getPtr<sl::uchar1>(MEM_CPU), image.getStepBytes(MEM_CPU)));
+	if (prm.enable_depth)
+		out.Depth = FRAMEPOOL::Clone (cv::Mat(FrameSize, CV_32FC1, depth.getPtr<sl::float1>(MEM_CPU), depth.getStepBytes(MEM_CPU)));
+	out.Timestamp = Zed.getTimestamp (TIME_REFERENCE_IMAGE);
+	return true;
+}
+
+
+bool PlayerZed::OnKey (int key)
+{
+	if (!Cache || (Ijump >= 0 && Iframe < Ijump))
+		return PlayerB::OnKey (key);
+
+	int64 n = Iframe;
+	switch (key) {
+		case ',':	n -= 1;		break;
+		case '.':	n += 1;		break;
+		case '[':	n -= Fps;	break;
+		case ']':	n += Fps;	break;
+		case 'r':
+			Dir = -Dir;
+			LOG (INFO, "%s", Dir > 0 ? "Forward" : "Reverse");
+			return true;
+		case ' ':
+			Paused = !Paused;
+			return true;
+		default:
+			return PlayerB::OnKey (key);
+	}
+
+	// Stepping and jumping pause the player on the new frame
+	Paused = true;
+	ShowFrame (MAX(0, MIN(n, Nframes)));
+	return true;
 }
@@ -12,27 +12,73 @@
 #include <opencv2/opencv.hpp>			// OpenCV API
 #include <sl_zed/Camera.hpp>			// ZED API
 #include "playfile.h"
+#include "framecache.h"
+#include <atomic>
 
 
+/*
+ ******************************************************************************
+  The channels of a grabbed frame are retrieved from the SDK when they are
+  asked for the first time, and kept until the next grab. Consumers register
+  the channels they will ask for with Need(); unless one of them needs a
+  depth based channel, frames are grabbed without computing depth at all.
+  Asking for depth of a frame grabbed without it registers the need: files
+  grab the frame again, the live camera has it from the next frame.
+  Playing through the cache keeps the image and the depth only.
+ ******************************************************************************
+*/
 class PlayerZed : public PlayerB
 {
   public:
-	PlayerZed ()
+	enum Channel
+	{
+		CHANNEL_LEFT,														// VIEW_LEFT, 8U_C4
+		CHANNEL_DEPTH,														// MEASURE_DEPTH, 32F_C1 millimeters
+		CHANNEL_CONFIDENCE,													// MEASURE_CONFIDENCE, 32F_C1
+		CHANNEL_CLOUD,														// MEASURE_XYZRGBA, 32F_C4 millimeters
+		CHANNELS
+	};
+
+	PlayerZed () : Cache(nullptr), Needed(1 << CHANNEL_LEFT), Retrieved(0), GrabbedDepth(false)
 	{}
 
 	virtual ~PlayerZed ()
-	{}
+	{
+		if (Cache) {
+			Cache->PrintStats();
+			delete Cache;
+		}
+	}
 
   private:
 	virtual void		Construct (int64 jump = -1, cchar* file = nullptr);
 	virtual int64		GetNextFrame ();
-	virtual unsigned	GetDepthCoordinate (int x, int y);
+	virtual bool		OnKey (int key);
+
+  public:
+	void				Need (unsigned channels);							// Mask of 1 << Channel the consumers will ask for
+	sl::Mat&			Retrieve (Channel ch);								// The channel of the current frame, not initialized if unavailable
+	virtual const DepthFrame& GetDepth ();
+
+  private:
+	bool				Grab ();											// Grabs with depth if some depth based channel is needed
+
+	bool				DecodeFrame (int64 n, CachedFrame& out);			// FrameCache decode function, called from the cache thread only
+	int64				ShowFrame (int64 n);								// Takes frame #n from the cache into Frame and Depth
 
   private:
 	sl::Camera		Zed;
-	sl::Mat			SvoImage;
-	sl::Mat			SvoDepth;
+	sl::Mat			SvoChannels [CHANNELS];									// Retrieved channels of the last grab, the cached frame's left image with the cache
+	sl::Mat			DecodeChannels [CHANNEL_DEPTH + 1];						// Image and depth the cache thread grabs into
 	bool			FromFile;
+	FrameCache*		Cache;													// Decoded frames of a SVO file, nullptr for the live camera
+	int64			SvoPos;													// Last grabbed SVO frame, used by the cache thread only
+	AlignIntrinsics	Intrin;													// Of the rectified left image, the depth viewport
+	int				Fps;
+	int				Dir;													// Playing direction: 1 forward, -1 backward
+	std::atomic<unsigned>	Needed;											// Channel mask registered by Need()
+	unsigned		Retrieved;												// Channels of the last grab retrieved so far
+	bool			GrabbedDepth;											// The last grab computed depth
 };
 
 
@@ -0,0 +1,129 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  render.cpp
+ Purpose     :  Window image of the player, redrawn only where changed
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "render.h"
+#include "resize.h"
+
+
+namespace {
+
+const cv::Scalar	TEXTCOLOR	= CV_RGB(0,255,0);
+const int			FONT		= cv::FONT_HERSHEY_DUPLEX;
+const double		FONTSCALE	= 1.0;
+const int			THICKNESS	= 2;
+const int			MARKER		= 5;										// Marker radius
+
+}
+
+
+
+void ViewRender::SetFrame (const cv::Mat& frame, int64 n, int scale)
+{
+	if (frame.size() != Src.size() || frame.type() != Src.type() || scale != Scale)
+		Dirty = DIRTY_ALL;	// another window size
+	else if (n != FrameN || frame.data != Src.data)
+		Dirty |= DIRTY_FRAME;
+	Src	   = frame;
+	FrameN = n;
+	Scale  = MAX(scale, 1);
+}
+
+
+void ViewRender::SetText (int line, cchar* text)
+{
+	assert (line >= 0 && line < TEXTS);
+	if (Texts[line] != text) {
+		Texts[line] = text;
+		Dirty |= DIRTY_OVERLAY;
+	}
+}
+
+
+void ViewRender::SetMarker (int x, int y)
+{
+	if (x < 0)
+		x = y = -1;
+	if (x != MarkerX || y != MarkerY) {
+		MarkerX = x;
+		MarkerY = y;
+		Dirty |= DIRTY_OVERLAY;
+	}
+}
+
+
+const cv::Mat& ViewRender::Render ()
+{
+	if (Src.empty()) {
+		Dirty = 0;
+		return View;
+	}
+
+	if (Dirty & DIRTY_FRAME) {
+		if (Scale > 1)
+			AreaDownscale (Src, Base, Scale);
+		else
+			Base = Src;
+		Base.copyTo (View);	// reuses View's buffer
+		if (Layer.size() != View.size() || Layer.type() != View.type()) {
+			Layer = cv::Mat::zeros (View.size(), View.type());
+			Mask  = cv::Mat::zeros (View.size(), CV_8UC1);
+			Rects.clear ();
+			Dirty |= DIRTY_OVERLAY;
+		}
+	}
+	else if (Dirty & DIRTY_OVERLAY) {
+		// Take the old overlay off
+		for (auto& r : Rects)
+			Base(r).copyTo (View(r));
+	}
+
+	if (Dirty & DIRTY_OVERLAY)
+		DrawOverlay ();
+	for (auto& r : Rects)
+		Layer(r).copyTo (View(r), Mask(r));
+
+	Dirty = 0;
+	return View;
+}
+
+
+void ViewRender::DrawOverlay ()
+{
+	for (auto& r : Rects) {
+		Layer(r).setTo (0);
+		Mask(r).setTo (0);
+	}
+	Rects.clear ();
+
+	for (int i = 0; i < TEXTS; i++) {
+		if (!Texts[i].Length())
+			continue;
+		int		  baseline;
+		cv::Point org (3, 25 + 40 * i);
+		cv::Size  size = cv::getTextSize ((cchar*)Texts[i], FONT, FONTSCALE, THICKNESS, &baseline);
+		cv::putText (Layer, (cchar*)Texts[i], org, FONT, FONTSCALE, TEXTCOLOR, THICKNESS);
+		cv::putText (Mask,	(cchar*)Texts[i], org, FONT, FONTSCALE, cv::Scalar(255), THICKNESS);
+		AddRect (cv::Rect (org.x - THICKNESS, org.y - size.height - THICKNESS, size.width + 2 * THICKNESS, size.height + baseline + 2 * THICKNESS));
+	}
+
+	if (MarkerX >= 0) {
+		cv::Point c (MarkerX / Scale, MarkerY / Scale);
+		cv::circle (Layer, c, MARKER, TEXTCOLOR, -1, 8);
+		cv::circle (Mask,  c, MARKER, cv::Scalar(255), -1, 8);
+		AddRect (cv::Rect (c.x - MARKER - 1, c.y - MARKER - 1, 2 * MARKER + 3, 2 * MARKER + 3));
+	}
+}
+
+
+void ViewRender::AddRect (cv::Rect r)
+{
+	r &= cv::Rect (0, 0, View.cols, View.rows);
+	if (r.area() > 0)
+		Rects.push_back (r);
+}
@@ -0,0 +1,68 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  render.h
+ Purpose     :  Window image of the player, redrawn only where changed
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _RENDER_H
+#define _RENDER_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+#include "str.h"
+#include <vector>
+
+
+/*
+ ******************************************************************************
+  The player window is the frame, downscaled to the window size, and an
+  overlay of text lines and the click marker. The overlay is drawn into a
+  layer of its own, with a mask of its pixels, only when its content
+  changes; it is composited into the window image over the parts it covers.
+  A new frame is copied into the window image once; an overlay change
+  restores the parts the old overlay covered from the frame and composites
+  the new one. When nothing changed NeedsRender() is false and the window
+  does not have to be shown again at all.
+ ******************************************************************************
+*/
+class ViewRender
+{
+  public:
+	enum { TEXTS = 2 };														// Overlay text lines
+
+	ViewRender () : FrameN(-2), Scale(1), MarkerX(-1), MarkerY(-1), Dirty(DIRTY_ALL) {}
+
+	void			SetFrame (const cv::Mat& frame, int64 n, int scale);	// Frame #n and its pixels per window pixel. Pixels are taken as new when n or the buffer changes
+	void			SetText (int line, cchar* text);						// "" - no text on the line
+	void			SetMarker (int x, int y);								// Frame coordinates, x < 0 - no marker
+	void			Invalidate ()					{ Dirty = DIRTY_ALL; }	// Everything is drawn again
+	bool			NeedsRender () const			{ return Dirty != 0; }
+	const cv::Mat&	Render ();												// The window image, updated where changed
+
+  private:
+	enum
+	{
+		DIRTY_FRAME		= 1,
+		DIRTY_OVERLAY	= 2,
+		DIRTY_ALL		= DIRTY_FRAME | DIRTY_OVERLAY
+	};
+
+	void			DrawOverlay ();
+	void			AddRect (cv::Rect r);
+
+  private:
+	cv::Mat					Src;											// Frame as given, its data is not owned
+	cv::Mat					Base;											// Frame at the window size, Src itself when Scale is 1
+	cv::Mat					View;											// Base with the overlay, the window image
+	cv::Mat					Layer, Mask;									// Overlay pixels and where they are, window size
+	std::vector<cv::Rect>	Rects;											// Parts of View the overlay covers
+	STRING					Texts [TEXTS];
+	int64					FrameN;
+	int						Scale;
+	int						MarkerX, MarkerY;
+	unsigned				Dirty;
+};
+
+
+#endif // _RENDER_H
@@ -0,0 +1,162 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  resize.cpp
+ Purpose     :  Fast integer factor downscaling for display
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#include "def.h"
+#include "resize.h"
+#include "framepool.h"
+#include "threadpool.h"
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define RESIZE_SSE2	1
+#include <emmintrin.h>
+#else
+#define RESIZE_SSE2	0
+#endif
+
+
+namespace {
+
+const int	RESIZE_MINBANDPIXELS = 64 * 1024;		// Input pixels; smaller bands don't pay for the task switch
+
+
+// acc[i] += row[i]
+void AddRow (const uint8* row, uint16* acc, int n)
+{
+	int i = 0;
+#if RESIZE_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= n; i += 16) {
+		__m128i v  = _mm_loadu_si128((const __m128i*)(row + i));
+		__m128i lo = _mm_loadu_si128((const __m128i*)(acc + i));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(acc + i + 8));
+		_mm_storeu_si128 ((__m128i*)(acc + i),	   _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero)));
+		_mm_storeu_si128 ((__m128i*)(acc + i + 8), _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero)));
+	}
+#endif
+	for (; i < n; i++)
+		acc[i] += row[i];
+}
+
+
+// out[x] = sum of factor neighbouring pixels of acc / area, rounded. The division is a multiplication
+// by 2^24 / area rounded up: the error stays below 2^16 / 2^24, less than the 1 / area a fraction can be off an integer
+template <int CH> void SumColumns (const uint16* acc, uint8* out, int ow, int factor)
+{
+	const uint32 area = factor * factor, half = area / 2;
+	const uint64 recip = ((uint64(1) << 24) + area - 1) / area;
+	for (int x = 0; x < ow; x++, acc += factor * CH, out += CH) {
+		uint32 s[CH] = {};
+		for (int j = 0; j < factor; j++)
+			for (int c = 0; c < CH; c++)
+				s[c] += acc[j * CH + c];
+		for (int c = 0; c < CH; c++)
+			out[c] = uint8(((s[c] + half) * recip) >> 24);
+	}
+}
+
+
+// The same for factor 2, the common case
+template <int CH> void SumColumns2 (const uint16* acc, uint8* out, int ow, uint8* tmp)
+{
+	int x = 0;
+#if RESIZE_SSE2
+	if (CH != 4) {
+		// Averages of every pixel and its right neighbour, every other one is taken
+		int n = (ow * 2 - 1) * CH, i = 0;
+		__m128i two = _mm_set1_epi16(2);
+		for (; i + 16 <= n; i += 16) {
+			__m128i a = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(acc + i)),	  _mm_loadu_si128((const __m128i*)(acc + i + CH)));
+			__m128i b = _mm_add_epi16(_mm_loadu_si128((const __m128i*)(acc + i + 8)), _mm_loadu_si128((const __m128i*)(acc + i + 8 + CH)));
+			_mm_storeu_si128 ((__m128i*)(tmp + i), _mm_packus_epi16(_mm_srli_epi16(_mm_add_epi16(a, two), 2), _mm_srli_epi16(_mm_add_epi16(b, two), 2)));
+		}
+		for (; i < n; i++)
+			tmp[i] = uint8((acc[i] + acc[i + CH] + 2) >> 2);
+		for (; x < ow; x++)
+			for (int c = 0; c < CH; c++)
+				out[x * CH + c] = tmp[x * 2 * CH + c];
+	}
+	else {
+		// 4 output pixels from 8 input ones: add the neighbouring pixels, round, divide by 4
+		__m128i two = _mm_set1_epi16(2);
+		for (; x + 4 <= ow; x += 4) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(acc + x * 8));			// pixels 0 1
+			__m128i b = _mm_loadu_si128((const __m128i*)(acc + x * 8 + 8));		// pixels 2 3
+			__m128i c = _mm_loadu_si128((const __m128i*)(acc + x * 8 + 16));
+			__m128i d = _mm_loadu_si128((const __m128i*)(acc + x * 8 + 24));
+			__m128i ab = _mm_add_epi16(_mm_unpacklo_epi64(a, b), _mm_unpackhi_epi64(a, b));
+			__m128i cd = _mm_add_epi16(_mm_unpacklo_epi64(c, d), _mm_unpackhi_epi64(c, d));
+			ab = _mm_srli_epi16(_mm_add_epi16(ab, two), 2);
+			cd = _mm_srli_epi16(_mm_add_epi16(cd, two), 2);
+			_mm_storeu_si128 ((__m128i*)(out + x * 4), _mm_packus_epi16(ab, cd));
+		}
+	}
+#endif
+	for (; x < ow; x++)
+		for (int c = 0; c < CH; c++)
+			out[x * CH + c] = uint8((acc[x * 2 * CH + c] + acc[x * 2 * CH + CH + c] + 2) >> 2);
+}
+
+
+// Output rows [y0, y1)
+template <int CH> void DownscaleRows (const cv::Mat& src, cv::Mat& dst, int factor, int y0, int y1)
+{
+	int ow = src.cols / factor;
+	int n  = ow * factor * CH;
+	FrameBuf buf = FRAMEPOOL::Get(n * (sizeof(uint16) + 1));		// row sums, then a byte row for SumColumns2()
+	uint16*  acc = (uint16*)buf.Data();
+	uint8*	 tmp = buf.Data() + n * sizeof(uint16);
+
+	for (int y = y0; y < y1; y++) {
+		memset (acc, 0, n * sizeof(uint16));
+		for (int k = 0; k < factor; k++)
+			AddRow (src.ptr<uint8>(y * factor + k), acc, n);
+		if (factor == 2)
+			SumColumns2<CH> (acc, dst.ptr<uint8>(y), ow, tmp);
+		else
+			SumColumns<CH> (acc, dst.ptr<uint8>(y), ow, factor);
+	}
+}
+
+
+// Bands of output rows on the thread pool, a small image stays on the calling thread
+template <int CH> void Downscale (const cv::Mat& src, cv::Mat& dst, int factor)
+{
+	int rowpixels = MAX(src.cols * factor, 1);
+	THREADPOOL::ParallelFor (src.rows / factor, MAX(1, RESIZE_MINBANDPIXELS / rowpixels), [&] (int y0, int y1) {
+		DownscaleRows<CH> (src, dst, factor, y0, y1);
+	});
+}
+
+}
+
+
+
+void AreaDownscale (const cv::Mat& src, cv::Mat& dst, int factor)
+{
+	assert (src.depth() == CV_8U && src.channels() <= 4 && factor >= 1 && factor <= RESIZE_MAXFACTOR);
+	if (factor <= 1) {
+		src.copyTo (dst);
+		return;
+	}
+
+	dst.create (src.rows / factor, src.cols / factor, src.type());
+	switch (src.channels()) {
+		case 1:  Downscale<1> (src, dst, factor);  break;
+		case 2:  Downscale<2> (src, dst, factor);  break;
+		case 3:  Downscale<3> (src, dst, factor);  break;
+		default: Downscale<4> (src, dst, factor);  break;
+	}
+}
+
+
+int AreaFactor (int width, int maxwidth)
+{
+	if (maxwidth <= 0 || width <= maxwidth)
+		return 1;
+	return MIN((width + maxwidth - 1) / maxwidth, int(RESIZE_MAXFACTOR));
+}
@@ -0,0 +1,31 @@
+/**********************************************************************\
+ Project     :  TA Roofs / player app
+ Filename    :  resize.h
+ Purpose     :  Fast integer factor downscaling for display
+ Created	 :  19.10.2026
+ Author      :  (c) Quickest-Owl Ltd
+\**********************************************************************/
+
+#ifndef _RESIZE_H
+#define _RESIZE_H
+
+#include <opencv2/opencv.hpp>   // OpenCV API
+
+
+enum
+{
+	RESIZE_MAXFACTOR = 15				// factor^2 * 255 still fits 16 bits
+};
+
+
+// Averages factor x factor pixel blocks of an 8 bit image of 1..4 channels, as cv::resize(INTER_AREA)
+// does for an integer factor. The rows and columns not filling a whole block are dropped.
+// The input rows are summed 16 bytes at a time with SSE2, the block sums are rounded to nearest.
+// Large images are processed in bands of rows on the thread pool.
+void	AreaDownscale (const cv::Mat& src, cv::Mat& dst, int factor);
+
+// Smallest factor bringing width down to maxwidth at most, 1 if maxwidth <= 0
+int		AreaFactor (int width, int maxwidth);
+
+
+#endif // _RESIZE_H
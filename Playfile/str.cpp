@@ -193,6 +193,32 @@ uint32 STRB::str2ipport (cchar* str, uint16* port)
 }
 
 
+//static 
+bool STRB::str2addr (cchar* str, uint32* ip, uint16* port)
+{
+	STR<32>	s;
+	int64	n = 0;
+
+	s = str;
+	s.SeekStart();
+	char* portstr = s.ScanCharSet0(':');
+	if (strchr((cchar*)s, '.')) {
+		if (!str2ip((cchar*)s, ip))
+			return false;
+	}
+	else if (!s.IsEmpty() && portstr)
+		return false;	// host names are not resolved
+	else {
+		*ip		= IpAddr(127,0,0,1);
+		portstr = portstr ? portstr : (char*)s;
+	}
+	if (portstr && (!atoi(portstr, &n) || n < 0 || n > 65535))
+		return false;
+	*port = uint16(n);
+	return true;
+}
+
+
 
 //static 
 bool STRB::strequ_rn (cchar* str1, cchar* str2)
@@ -301,7 +327,7 @@ STRB& STRB::Print (cchar* sformat, ...)
 {
 	va_list  argptr;
 	va_start (argptr, sformat);
-	Len = vsprintf (Str, sformat, argptr);
+	Len = STRFMT::Vformat (Str, sformat, argptr);
 	va_end (argptr);
 	return (*this);
 }
@@ -311,7 +337,7 @@ int STRB::AddSprintf (cchar* sformat, ...)
 {
 	va_list  argptr;
 	va_start (argptr, sformat);
-	int ret = vsprintf (Str+Len, sformat, argptr);
+	int ret = STRFMT::Vformat (Str+Len, sformat, argptr);
 	va_end (argptr);
 	if (ret > 0)
 		Len += ret;
@@ -323,7 +349,7 @@ int STRB::PrnSetEnd (cchar* sformat, ...)
 {
 	va_list  argptr;
 	va_start (argptr, sformat);
-	int ret = vsprintf (Str, sformat, argptr);
+	int ret = STRFMT::Vformat (Str, sformat, argptr);
 	va_end (argptr);
 	Len = ret;
 	SetToEnd();
@@ -10,6 +10,7 @@
 #define _STR_H
 
 #include "autostr.h"
+#include "strfmt.h"
 
 
 #define STRB_USEC_THRESHOLD_10YEARS		315360000000000ll		// Threshold meaning to show or not the date part, to use in STRB::datetime2str
@@ -82,11 +83,18 @@ class STRB
 	static bool  atoi	(cchar* str, int64* x,  cchar* sformat = "%lld");
 	static bool  atoi	(cchar* str, uint64* x, cchar* sformat = "%llu")	{ return atoi(str,(int64*)x,sformat); }
 
-	static int   itoa	(int    val, char* str, cchar* sformat = "%d")		{ return sprintf(str,sformat,val); }
-	static int   ultoa	(uint32 val, char* str, cchar* sformat = "%u")		{ return sprintf(str,sformat,val); }
-	static int   lltoa	(int64  val, char* str, cchar* sformat = "%lld")	{ return sprintf(str,sformat,val); }
-	static int   ulltoa (uint64 val, char* str, cchar* sformat = "%llu")	{ return sprintf(str,sformat,val); }
-	static int   ftoa	(double val, char* str, cchar* sformat = "%lf")		{ return sprintf(str,sformat,val); }
+	// Same output as sprintf (see strfmt.h); the formats without sformat are parsed at compile time
+	static int   itoa	(int    val, char* str)								{ static constexpr STRFMT f("%d");   return STRFMT::Int(str,f,val,uint32(val),32); }
+	static int   ultoa	(uint32 val, char* str)								{ static constexpr STRFMT f("%u");   return STRFMT::Int(str,f,int32(val),val,32); }
+	static int   lltoa	(int64  val, char* str)								{ static constexpr STRFMT f("%lld"); return STRFMT::Int(str,f,val,uint64(val),64); }
+	static int   ulltoa (uint64 val, char* str)								{ static constexpr STRFMT f("%llu"); return STRFMT::Int(str,f,int64(val),val,64); }
+	static int   ftoa	(double val, char* str)								{ static constexpr STRFMT f("%lf");  return STRFMT::Float(str,f,val); }
+	static int   itoa	(int    val, char* str, cchar* sformat)				{ return STRFMT::Int(str,STRFMT(sformat),val,uint32(val),32); }
+	static int   ultoa	(uint32 val, char* str, cchar* sformat)				{ return STRFMT::Int(str,STRFMT(sformat),int32(val),val,32); }
+	static int   lltoa	(int64  val, char* str, cchar* sformat)				{ return STRFMT::Int(str,STRFMT(sformat),val,uint64(val),64); }
+	static int   ulltoa (uint64 val, char* str, cchar* sformat)				{ return STRFMT::Int(str,STRFMT(sformat),int64(val),val,64); }
+	static int   ftoa	(double val, char* str, cchar* sformat)				{ return STRFMT::Float(str,STRFMT(sformat),val); }
+	static int   ftoa_short (double val, char* str)							{ return STRFMT::Shortest(str,val); }		// Shortest string reading back as the same double, e.g. "0.1"
 
 	static char* int2str   (int val)										{ char* strout = autostrGet(); itoa  (val,strout); return strout; }
 	static char* int2str   (int64 val)										{ char* strout = autostrGet(); lltoa (val,strout); return strout; }
@@ -124,14 +132,18 @@ class STRB
 	// Convert an IP:PORT pair string to uint32 IP (returned) + uint16 *port. If :PORT is not present the *port == 0
 	static uint32 str2ipport (cchar* str, uint16* port);
 
+	// Convert an [IP:]PORT string ("ip:port", ":port" or "port", the last two on 127.0.0.1) to *ip + *port (returns true if succeeded).
+	// Unlike str2ipport, 0.0.0.0 (INADDR_ANY) is a valid IP
+	static bool	  str2addr (cchar* str, uint32* ip, uint16* port);
+
 	// Convert an uint64 to a hex string. Returns number of bytes in strout
-	static int    hex2str (uint64 x, char* strout)							{ return sprintf(strout,"%llX",x);  }
+	static int    hex2str (uint64 x, char* strout)							{ static constexpr STRFMT f("%llX");   return STRFMT::Int(strout,f,int64(x),x,64); }
 	static char*  hex2str (uint64 x)										{ char* strout = autostrGet();  hex2str(x,strout);  return strout; }	// Same as above hex2str() but take strout from autostrGet
 
-	static int    hex0xstr (uint64 x, char* strout)							{ return sprintf(strout,"0x%llX",x);  }
+	static int    hex0xstr (uint64 x, char* strout)							{ static constexpr STRFMT f("0x%llX"); return STRFMT::Int(strout,f,int64(x),x,64); }
 	static char*  hex0xstr (uint64 x)										{ char* strout = autostrGet();  hex0xstr(x,strout);  return strout; }	// Same as above hex2str() but take strout from autostrGet
 
-	static int    hex0xstr (uint32 x, char* strout)							{ return sprintf(strout,"0x%08X",x);  }									// Same as above hex2str() but works with uint32 arg
+	static int    hex0xstr (uint32 x, char* strout)							{ static constexpr STRFMT f("0x%08X"); return STRFMT::Int(strout,f,int32(x),x,32); }									// Same as above hex2str() but works with uint32 arg
 	static char*  hex0xstr (uint32 x)										{ char* strout = autostrGet();  hex0xstr(x,strout);  return strout; }	// Same as above hex2str() but take strout from autostrGet
 
 	// Convert an int64 integer with n decimal places to string. Returns number of bytes in strout
@@ -495,6 +507,13 @@ template <unsigned MaxSize> class STR : public STRB
  **************************************************************************
 */
 
+// With allocation tracking STRD is recorded at its "new" expression (the caller of the inlined operator), not in this file
+#if UTILS_ALLOCTRACK && !defined(ALLOCTRACK_NOHOOK)
+#define STRD_MALLOC(n)		AllocTrackMalloc (n, nullptr, 0)
+#else
+#define STRD_MALLOC(n)		malloc (n)
+#endif
+
 class STRD : public STRB
 {
   public:
@@ -511,7 +530,7 @@ class STRD : public STRB
 	void* operator new (size_t size, int size2)
 	{
 		LOW_ASSERT (size2 >= 0);
-		char* ret = (char*) malloc (size + size2 + 1);
+		char* ret = (char*) STRD_MALLOC (size + size2 + 1);
 		char* sbuf = ret + size;
 		((STRB*)ret)->Construct (sbuf, size2+1);
 		return ret;
@@ -520,7 +539,7 @@ class STRD : public STRB
 	void* operator new (size_t size, cchar* sinit)
 	{
 		int size2 = (int) strlen(sinit);
-		char* ret = (char*) malloc (size + size2 + 1);
+		char* ret = (char*) STRD_MALLOC (size + size2 + 1);
 		char* sbuf = ret + size;
 		memcpy (sbuf, sinit, size2 + 1);
 		((STRB*)ret)->Construct (sbuf, size2+1, size2);
@@ -530,7 +549,7 @@ class STRD : public STRB
 	void* operator new (size_t size, cchar* sinit, DoNotCopy)
 	{
 		int size2 = (int) strlen(sinit);
-		char* ret = (char*) malloc (size);
+		char* ret = (char*) STRD_MALLOC (size);
 		((STRB*)ret)->Construct ((char*)sinit, size2+1, size2);
 		return ret;
 	}
@@ -540,7 +559,7 @@ class STRD : public STRB
 		LOW_ASSERT (size3 >= 0);
 		int size2 = (int) strlen(sinit);
 		LOW_ASSERT (size3 >= size2);
-		char* ret = (char*) malloc (size + size3 + 1);
+		char* ret = (char*) STRD_MALLOC (size + size3 + 1);
 		char* sbuf = ret + size;
 		memcpy (sbuf, sinit, size2 + 1);
 		((STRB*)ret)->Construct (sbuf, size3+1, size2);
@@ -805,7 +824,7 @@ inline void STRB::TruncateBgn (unsigned len)
 
 inline int STRB::Vsprintf (cchar* sformat, va_list arglist)
 {
-	int ret = vsprintf (Str, sformat, arglist);
+	int ret = STRFMT::Vformat (Str, sformat, arglist);
 	return (Len = ret);
 }
 
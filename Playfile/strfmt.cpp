@@ -0,0 +1,420 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  strfmt.cpp
+ Purpose     :  Fast printf-compatible number formatting for STRB
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "strfmt.h"
+
+
+static const char Digits2[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+static const uint64 Pow10[] = { 1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull };
+
+static const int	FloatMaxPrec = 9;			// 10^9 < 2^30 keeps mantissa*10^prec within 83 bits
+static const double	FloatMaxFixed = 1e19;		// Below 2^64, so value*10^prec fits uint64
+
+
+/*--------------------------------------------------------------------------------------*\
+									Helpers
+\*--------------------------------------------------------------------------------------*/
+
+// Writes the decimal digits of v ending at end, returns the start
+static char* UtoaBack (char* end, uint64 v)
+{
+	while (v >= 100) {
+		int i = int(v % 100) * 2;
+		v /= 100;
+		*--end = Digits2[i+1];
+		*--end = Digits2[i];
+	}
+	if (v >= 10) {
+		*--end = Digits2[v*2+1];
+		*--end = Digits2[v*2];
+	}
+	else
+		*--end = char('0' + v);
+	return end;
+}
+
+
+static char* XtoaBack (char* end, uint64 v, bool upper)
+{
+	cchar* hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	do {
+		*--end = hex[v & 15];
+		v >>= 4;
+	} while (v);
+	return end;
+}
+
+
+// Lays out sign + zero padding + digits within the field width, as printf does
+static int Pad (char* out, const STRFMT& f, char sign, cchar* digits, int ndigits, int nzeros)
+{
+	int len = (sign != 0) + nzeros + ndigits;
+	int fill = f.Width > len ? f.Width - len : 0;
+	char* o = out;
+
+	if (!f.Minus && !f.Zero) {
+		memset (o, ' ', fill);
+		o += fill;
+	}
+	if (sign)
+		*o++ = sign;
+	if (!f.Minus && f.Zero) {
+		memset (o, '0', fill);
+		o += fill;
+	}
+	memset (o, '0', nzeros);
+	o += nzeros;
+	memcpy (o, digits, ndigits);
+	o += ndigits;
+	if (f.Minus) {
+		memset (o, ' ', fill);
+		o += fill;
+	}
+	return int(o - out);
+}
+
+
+// Portable 128-bit unsigned arithmetics, just what the float conversion needs
+struct U128
+{
+	uint64 Hi, Lo;
+
+	static U128 Mul (uint64 a, uint64 b)	// b < 2^32
+	{
+		uint64 lo = (a & 0xFFFFFFFFull) * b;
+		uint64 hi = (a >> 32) * b;
+		U128 r;
+		r.Lo = lo + (hi << 32);
+		r.Hi = (hi >> 32) + (r.Lo < lo);
+		return r;
+	}
+	bool operator < (const U128& b) const	{ return Hi < b.Hi || (Hi == b.Hi && Lo < b.Lo); }
+	bool operator == (const U128& b) const	{ return Hi == b.Hi && Lo == b.Lo; }
+};
+
+
+/*
+ * Decomposes a finite double into mantissa * 2^-k and computes the value scaled by 10^prec:
+ *   q   - the scaled value truncated,
+ *   rem - the discarded low bits (as a 128-bit fraction of 2^k).
+ * Returns false when the value is out of the exact range.
+ */
+static bool ScaleExact (double v, int prec, uint64& m, int& k, uint64& q, U128& rem)
+{
+	uint64 bits;
+	memcpy (&bits, &v, sizeof(bits));
+	int exp = int((bits >> 52) & 0x7FF);
+	m = bits & 0xFFFFFFFFFFFFFull;
+	if (exp == 0x7FF || fabs(v) >= FloatMaxFixed / Pow10[prec])
+		return false;
+	if (exp)
+		m |= 1ull << 52;
+	else
+		exp = 1;
+	k = 1075 - exp;						// v = m * 2^-k
+
+	if (k <= 0) {
+		q = (m << -k) * Pow10[prec];
+		rem.Hi = rem.Lo = 0;
+		return true;
+	}
+
+	U128 n = U128::Mul(m, Pow10[prec]);
+	if (k >= 128) {
+		q = 0;
+		rem = n;
+	}
+	else if (k >= 64) {
+		q = k == 64 ? n.Hi : n.Hi >> (k - 64);
+		rem.Hi = k == 64 ? 0 : n.Hi & ((1ull << (k - 64)) - 1);
+		rem.Lo = n.Lo;
+	}
+	else {
+		q = (n.Lo >> k) | (n.Hi << (64 - k));
+		rem.Hi = 0;
+		rem.Lo = n.Lo & ((1ull << k) - 1);
+	}
+	return true;
+}
+
+
+// 2^(k-1): the half of the remainder unit, k in 1..127
+static U128 HalfUnit (int k)
+{
+	U128 h;
+	h.Hi = k - 1 >= 64 ? 1ull << (k - 65) : 0;
+	h.Lo = k - 1 >= 64 ? 0 : 1ull << (k - 1);
+	return h;
+}
+
+
+/*--------------------------------------------------------------------------------------*\
+									STRFMT
+\*--------------------------------------------------------------------------------------*/
+
+int STRFMT::FormatInt (char* out, const STRFMT& f, int64 sval, uint64 uval)
+{
+	char	buf[24];
+	char*	end = buf + sizeof(buf);
+	char*	digits;
+	char	sign = 0;
+
+	if (f.Conv == 'd' || f.Conv == 'i') {
+		if (sval < 0) {
+			sign = '-';
+			uval = 0 - uint64(sval);
+		}
+		else {
+			sign = f.Plus ? '+' : f.Space ? ' ' : 0;
+			uval = uint64(sval);
+		}
+	}
+
+	if (uval == 0 && f.Prec == 0)
+		digits = end;					// "%.0d" prints nothing for 0
+	else if (f.Conv == 'x' || f.Conv == 'X')
+		digits = XtoaBack(end, uval, f.Conv == 'X');
+	else
+		digits = UtoaBack(end, uval);
+
+	int ndigits = int(end - digits);
+	int nzeros  = f.Prec > ndigits ? f.Prec - ndigits : 0;
+	if (f.Prec >= 0 && f.Zero) {
+		STRFMT g = f;					// '0' is ignored when precision is given
+		g.Zero = false;
+		return Pad (out, g, sign, digits, ndigits, nzeros);
+	}
+	return Pad (out, f, sign, digits, ndigits, nzeros);
+}
+
+
+int STRFMT::FormatFloat (char* out, const STRFMT& f, double val)
+{
+	int prec = f.Prec < 0 ? 6 : f.Prec;
+	if (prec > FloatMaxPrec)
+		return -1;
+
+	uint64	m, q;
+	int		k;
+	U128	rem;
+	if (!ScaleExact(val, prec, m, k, q, rem))
+		return -1;
+
+	// Round half to even
+	if (k > 0 && k < 128) {
+		U128 half = HalfUnit(k);
+		if (half < rem || (rem == half && (q & 1)))
+			q++;
+	}
+
+	char	buf[48];
+	char*	end = buf + sizeof(buf);
+	char*	digits = end;
+	if (prec) {
+		uint64 frac = q % Pow10[prec];
+		q /= Pow10[prec];
+		char* fd = UtoaBack(end, frac);
+		while (end - fd < prec)
+			*--fd = '0';
+		*--fd = '.';
+		digits = fd;
+	}
+	digits = UtoaBack(digits, q);
+
+	char sign = signbit(val) ? '-' : f.Plus ? '+' : f.Space ? ' ' : 0;
+	return Pad (out, f, sign, digits, int(end - digits), 0);
+}
+
+
+int STRFMT::Int (char* out, const STRFMT& f, int64 sval, uint64 uval, int bits)
+{
+	if (!f.IsInt() || f.LenBits != bits)
+		return bits == 64 ? sprintf(out, f.Fmt, sval) : sprintf(out, f.Fmt, int(sval));
+
+	memcpy (out, f.Fmt, f.PrefixLen);
+	int len = f.PrefixLen + FormatInt(out + f.PrefixLen, f, sval, uval);
+	cchar* suffix = f.Fmt + f.SpecEnd;
+	while (*suffix)
+		out[len++] = *suffix++;
+	out[len] = '\0';
+	return len;
+}
+
+
+int STRFMT::Float (char* out, const STRFMT& f, double val)
+{
+	int len = f.IsFloat() ? FormatFloat(out + f.PrefixLen, f, val) : -1;
+	if (len < 0)
+		return sprintf (out, f.Fmt, val);
+
+	memcpy (out, f.Fmt, f.PrefixLen);
+	len += f.PrefixLen;
+	cchar* suffix = f.Fmt + f.SpecEnd;
+	while (*suffix)
+		out[len++] = *suffix++;
+	out[len] = '\0';
+	return len;
+}
+
+
+int STRFMT::Vformat (char* out, cchar* fmt, va_list args)
+{
+	va_list args0;
+	va_copy (args0, args);
+	char* o = out;
+
+	for (cchar* p = fmt; *p; ) {
+		if (*p != '%') {
+			*o++ = *p++;
+			continue;
+		}
+		if (p[1] == '%') {
+			*o++ = '%';
+			p += 2;
+			continue;
+		}
+
+		STRFMT f;
+		p += 1 + f.ParseSpec(p + 1);
+		int len = -1;
+
+		switch (f.Conv) {
+			case 'd': case 'i': case 'u': case 'x': case 'X':
+				if (f.LenBits == 64) {
+					int64 v = va_arg(args, int64);
+					len = FormatInt(o, f, v, uint64(v));
+				}
+				else {
+					int v = va_arg(args, int);
+					len = FormatInt(o, f, v, uint32(v));
+				}
+				break;
+			case 'f':
+				len = FormatFloat(o, f, va_arg(args, double));
+				break;
+			case 'c': {
+				if (f.Zero)
+					break;
+				char c = char(va_arg(args, int));
+				len = Pad(o, f, 0, &c, 1, 0);
+				break;
+			}
+			case 's': {
+				cchar* s = va_arg(args, cchar*);
+				if (!s || f.Zero)
+					break;						// "(null)" and zero padding differ between libraries
+				int n = 0;
+				while (s[n] && (f.Prec < 0 || n < f.Prec))
+					n++;
+				len = Pad(o, f, 0, s, n, 0);
+				break;
+			}
+		}
+		if (len < 0) {
+			len = vsprintf (out, fmt, args0);
+			va_end (args0);
+			return len;
+		}
+		o += len;
+	}
+
+	*o = '\0';
+	va_end (args0);
+	return int(o - out);
+}
+
+
+int STRFMT::Shortest (char* out, double val)
+{
+	char* o = out;
+	if (signbit(val))
+		*o++ = '-';
+
+	// The fewest decimals which read back exactly: |digits - val| must be below half the gap to the neighbour double
+	uint64	m, q;
+	int		k;
+	U128	rem;
+	for (int prec = 0; prec <= FloatMaxPrec; prec++) {
+		if (!ScaleExact(val, prec, m, k, q, rem))
+			break;
+		if (k <= 0) {					// An integer
+			char	buf[24];
+			char*	digits = UtoaBack(buf + sizeof(buf), q);
+			memcpy (o, digits, buf + sizeof(buf) - digits);
+			o += buf + sizeof(buf) - digits;
+			*o = '\0';
+			return int(o - out);
+		}
+		if (k > 120)
+			break;
+
+		U128 unit;
+		unit.Hi = k >= 64 ? 1ull << (k - 64) : 0;
+		unit.Lo = k >= 64 ? 0 : 1ull << k;
+		bool up = HalfUnit(k) < rem || (rem == HalfUnit(k) && (q & 1));
+		U128 diff = rem;
+		if (up) {						// unit - rem
+			diff.Lo = unit.Lo - rem.Lo;
+			diff.Hi = unit.Hi - rem.Hi - (unit.Lo < rem.Lo);
+		}
+
+		// 2*diff (or 4*diff below a power of two, where the lower gap is half as wide) vs 10^prec
+		bool lowerEdge = !up && m == (1ull << 52) && k < 1074;
+		int shift = lowerEdge ? 2 : 1;
+		U128 scaled = { (diff.Hi << shift) | (diff.Lo >> (64 - shift)), diff.Lo << shift };
+		U128 limit = { 0, Pow10[prec] };
+		if (scaled < limit || (scaled == limit && !(m & 1))) {
+			uint64 d = q + up;
+			char	buf[32];
+			char*	end = buf + sizeof(buf);
+			char*	digits = end;
+			if (prec) {
+				uint64 frac = d % Pow10[prec];
+				d /= Pow10[prec];
+				char* fd = UtoaBack(end, frac);
+				while (end - fd < prec)
+					*--fd = '0';
+				while (end[-1] == '0')
+					end--;
+				*--fd = '.';
+				digits = fd;
+			}
+			digits = UtoaBack(digits, d);
+			memcpy (o, digits, end - digits);
+			o += end - digits;
+			*o = '\0';
+			return int(o - out);
+		}
+	}
+
+	// Very large, very small or many digits: the shortest %g which reads back.
+	// Most such doubles need 15 to 17 digits, so the short precisions are only tried below 15.
+	auto readsBack = [&] (int prec) {
+		sprintf (out, "%.*g", prec, val);
+		return strtod(out, nullptr) == val;
+	};
+	int prec = 15;
+	while (prec < 17 && !readsBack(prec))
+		prec++;
+	if (prec == 15)
+		for (prec = 1; !readsBack(prec); prec++)
+			;
+	return sprintf (out, "%.*g", prec, val);
+}
@@ -0,0 +1,126 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  strfmt.h
+ Purpose     :  Fast printf-compatible number formatting for STRB
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  The output is byte-for-byte the same as sprintf gives; what the
+				built-in formatters don't support is passed to sprintf.
+\**********************************************************************/
+
+#ifndef _STRFMT_H
+#define _STRFMT_H
+
+
+/*
+ ***************************************************************************
+ One printf conversion specification with optional literal text around it:
+	[prefix]%[-0+ ][width][.precision][l|ll]{d|i|u|x|X|f|s|c}[suffix]
+
+ The parser is constexpr, so formats given as literals to the inline STRB
+ wrappers (itoa, lltoa, ftoa, ...) are parsed at compile time. Conv == 0
+ means the format is not supported by the built-in formatters (other
+ conversions or flags, '*' width, '%' in the suffix, ...).
+
+ Integers are converted two digits at a time by table. Floats ("%f" with
+ precision up to 9) are rounded exactly from the binary value, so the digits
+ are the ones a correctly rounding printf (glibc, UCRT) gives; NaN, Inf and
+ values above 1e19 / 10^precision go to sprintf.
+ ***************************************************************************
+*/
+struct STRFMT
+{
+	cchar*	Fmt;
+	int		PrefixLen;		// Literal text before '%'
+	int		SpecEnd;		// Index after the conversion char, the suffix starts there
+	char	Conv;			// Conversion char, 0 - not supported
+	bool	Minus;			// Flags
+	bool	Zero;
+	bool	Plus;
+	bool	Space;
+	int		Width;
+	int		Prec;			// -1 when absent
+	int		LenBits;		// Size of the integer argument: 32 without a length modifier, 64 for ll
+
+	constexpr STRFMT () : Fmt(nullptr), PrefixLen(0), SpecEnd(0), Conv(0), Minus(false), Zero(false), Plus(false), Space(false), Width(0), Prec(-1), LenBits(32)	{}
+
+	constexpr STRFMT (cchar* fmt) : STRFMT()
+	{
+		Fmt = fmt;
+		int i = 0;
+		while (fmt[i] && fmt[i] != '%')
+			i++;
+		PrefixLen = i;
+		if (!fmt[i])
+			return;
+		SpecEnd = i + 1 + ParseSpec(fmt + i + 1);
+		for (int j = SpecEnd; Conv && fmt[j]; j++)
+			if (fmt[j] == '%')
+				Conv = 0;
+	}
+
+	// Parses a specification following '%', returns its length including the conversion char
+	constexpr int ParseSpec (cchar* s)
+	{
+		int i = 0;
+		for (;; i++) {
+			if		(s[i] == '-')	Minus = true;
+			else if (s[i] == '0')	Zero  = true;
+			else if (s[i] == '+')	Plus  = true;
+			else if (s[i] == ' ')	Space = true;
+			else break;
+		}
+		for (; s[i] >= '0' && s[i] <= '9'; i++)
+			Width = Width * 10 + (s[i] - '0');
+		if (s[i] == '.') {
+			Prec = 0;
+			for (i++; s[i] >= '0' && s[i] <= '9'; i++)
+				Prec = Prec * 10 + (s[i] - '0');
+		}
+
+		int nl = 0;
+		for (; s[i] == 'l'; i++)
+			nl++;
+		LenBits = (nl == 0) ? 32 : (nl == 1) ? int(sizeof(long) * 8) : 64;
+
+		Conv = s[i];
+		switch (Conv) {
+			case 'd': case 'i': case 'u': case 'x': case 'X':
+				if (nl > 2)
+					Conv = 0;
+				break;
+			case 'f':
+				if (nl > 1)
+					Conv = 0;
+				break;
+			case 's': case 'c':
+				if (nl)
+					Conv = 0;
+				break;
+			default:
+				Conv = 0;
+				break;
+		}
+		return s[i] ? i + 1 : i;
+	}
+
+	bool	IsInt   () const	{ return Conv == 'd' || Conv == 'i' || Conv == 'u' || Conv == 'x' || Conv == 'X'; }
+	bool	IsFloat () const	{ return Conv == 'f'; }
+
+	// STRB formatters. sval/uval are the argument seen as signed/unsigned, bits is its size (32 or 64). Return the string length
+	static int	Int   (char* out, const STRFMT& f, int64 sval, uint64 uval, int bits);
+	static int	Float (char* out, const STRFMT& f, double val);
+
+	// Same as vsprintf, the built-in formatters are used when all conversions of the format are supported
+	static int	Vformat (char* out, cchar* fmt, va_list args);
+
+	// Shortest decimal string which reads back as the same double, e.g. "0.1", "-2.5", "3"
+	static int	Shortest (char* out, double val);
+
+	// Single conversion formatters without prefix and suffix, return -1 if the value is out of the built-in range
+	static int	FormatInt   (char* out, const STRFMT& f, int64 sval, uint64 uval);
+	static int	FormatFloat (char* out, const STRFMT& f, double val);
+};
+
+
+#endif // _STRFMT_H
@@ -0,0 +1,359 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  threadpool.cpp
+ Purpose     :  Process-wide work-stealing thread pool
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "threadpool.h"
+#include "tracer.h"
+
+#include <deque>
+#include <thread>
+#include <vector>
+
+#if PLATFORM == PLATFORM_WIN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace {
+
+typedef std::function<void ()>  Task;
+
+// Count is kept besides the deque, so an idle worker looks for tasks without taking the locks
+struct TaskQueue
+{
+	std::mutex				Mtx;
+	std::deque<Task>		Tasks [TASK_CLASSES];
+	std::atomic<int>		Count [TASK_CLASSES];
+
+	TaskQueue ()			{ for (auto& c : Count) c = 0; }
+};
+
+struct Worker
+{
+	TaskQueue				Queue;
+	std::thread				Thread;
+};
+
+struct Pool
+{
+	std::mutex				StartMtx;										// Start() and Stop()
+	std::atomic<bool>		Started;
+	std::atomic<bool>		Stopping;
+	std::atomic<int>		Nthreads;
+	std::vector<Worker*>	Workers;										// Fixed while started
+	TaskQueue				Global;											// Tasks of the threads out of the pool
+
+	// A worker goes to sleep only with no task queued anywhere: Pending is raised before Sleepers is read
+	std::atomic<int>		Pending;
+	std::atomic<int>		Sleepers;
+	std::mutex				SleepMtx;
+	std::condition_variable	SleepCond;
+
+	std::atomic<uint64>		Executed [TASK_CLASSES];
+	std::atomic<uint64>		Stolen;
+
+	Pool () : Started(false), Stopping(false), Nthreads(0), Pending(0), Sleepers(0), Stolen(0)	{ for (auto& e : Executed) e = 0; }
+};
+
+thread_local int	ThisWorker = -1;
+
+
+// Never destroyed: tasks may still be submitted by destructors of other statics
+Pool& ThePool ()
+{
+	static Pool* p = new Pool;
+	return *p;
+}
+
+
+void Push (TaskQueue& q, TaskClass cls, Task&& task)
+{
+	std::lock_guard<std::mutex> lock(q.Mtx);
+	q.Tasks[cls].push_back(std::move(task));
+	q.Count[cls]++;
+}
+
+
+// The owner takes the newest task, the others the oldest
+bool Pop (TaskQueue& q, TaskClass cls, bool back, Task& task)
+{
+	if (!q.Count[cls].load(std::memory_order_relaxed))
+		return false;
+	std::lock_guard<std::mutex> lock(q.Mtx);
+	std::deque<Task>& d = q.Tasks[cls];
+	if (d.empty())
+		return false;
+	if (back) {
+		task = std::move(d.back());
+		d.pop_back();
+	}
+	else {
+		task = std::move(d.front());
+		d.pop_front();
+	}
+	q.Count[cls]--;
+	ThePool().Pending--;
+	return true;
+}
+
+
+// Highest class first: own deque, the shared queue, then the other workers' deques
+bool Take (int me, Task& task, TaskClass& cls)
+{
+	Pool& p = ThePool();
+	int	  n = int(p.Workers.size());
+	for (int c = 0; c < TASK_CLASSES; c++) {
+		cls = TaskClass(c);
+		if (Pop(p.Workers[me]->Queue, cls, true, task) || Pop(p.Global, cls, false, task))
+			return true;
+		for (int k = 1; k < n; k++) {
+			if (Pop(p.Workers[(me + k) % n]->Queue, cls, false, task)) {
+				p.Stolen.fetch_add(1, std::memory_order_relaxed);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+void PinThread (int core)
+{
+#if PLATFORM == PLATFORM_WIN
+	SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (core % (8 * sizeof(DWORD_PTR))));
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % CPU_SETSIZE, &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+
+void WorkerProcess (int me, int core)
+{
+	TRACER::SetThreadName ("pool worker");
+	ThisWorker = me;
+	if (core >= 0)
+		PinThread(core);
+
+	Pool& p = ThePool();
+	for (;;) {
+		Task	  task;
+		TaskClass cls;
+		if (Take(me, task, cls)) {
+			task();
+			p.Executed[cls].fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(p.SleepMtx);
+		if (p.Stopping && !p.Pending)
+			break;
+		p.Sleepers++;
+		p.SleepCond.wait(lock, [&p] { return p.Pending > 0 || p.Stopping; });
+		p.Sleepers--;
+	}
+	ThisWorker = -1;
+}
+
+
+void EnsureStarted ()
+{
+	if (!ThePool().Started.load(std::memory_order_acquire))
+		THREADPOOL::Start();
+}
+
+} // namespace
+
+
+
+/*--------------------------------------------------------------------------*\
+ Pool
+\*--------------------------------------------------------------------------*/
+
+bool THREADPOOL::Start (int nthreads, bool pin)
+{
+	Pool& p = ThePool();
+	std::lock_guard<std::mutex> lock(p.StartMtx);
+	if (p.Started)
+		return false;
+
+	int ncores = MAX(1, int(std::thread::hardware_concurrency()));
+	if (nthreads <= 0)
+		nthreads = ncores;
+	p.Stopping = false;
+	p.Workers.resize(nthreads);
+	for (auto& w : p.Workers)
+		w = new Worker;
+	for (int i = 0; i < nthreads; i++)
+		p.Workers[i]->Thread = std::thread(WorkerProcess, i, pin ? i % ncores : -1);
+	p.Nthreads = nthreads;
+	p.Started.store(true, std::memory_order_release);
+	return true;
+}
+
+
+void THREADPOOL::Stop ()
+{
+	Pool& p = ThePool();
+	std::lock_guard<std::mutex> lock(p.StartMtx);
+	if (!p.Started)
+		return;
+
+	{
+		std::lock_guard<std::mutex> sleep(p.SleepMtx);
+		p.Stopping = true;
+	}
+	p.SleepCond.notify_all();
+	for (auto w : p.Workers)
+		w->Thread.join();
+	for (auto w : p.Workers)
+		delete w;
+	p.Workers.clear();
+	p.Nthreads = 0;
+	p.Started  = false;
+}
+
+
+int THREADPOOL::Threads ()
+{
+	EnsureStarted();
+	return ThePool().Nthreads;
+}
+
+
+int THREADPOOL::WorkerIndex ()
+{
+	return ThisWorker;
+}
+
+
+void THREADPOOL::Submit (std::function<void ()> task, TaskClass cls)
+{
+	EnsureStarted();
+	Pool& p = ThePool();
+	Push(ThisWorker >= 0 ? p.Workers[ThisWorker]->Queue : p.Global, cls, std::move(task));
+
+	p.Pending++;
+	if (p.Sleepers > 0) {
+		std::lock_guard<std::mutex> lock(p.SleepMtx);
+		p.SleepCond.notify_one();
+	}
+}
+
+
+THREADPOOL::Stats THREADPOOL::GetStats ()
+{
+	Pool& p = ThePool();
+	Stats s;
+	for (int c = 0; c < TASK_CLASSES; c++)
+		s.Executed[c] = p.Executed[c].load(std::memory_order_relaxed);
+	s.Stolen = p.Stolen.load(std::memory_order_relaxed);
+	return s;
+}
+
+
+void THREADPOOL::ParallelFor (int n, int grain, const std::function<void (int i0, int i1)>& body, int maxthreads, TaskClass cls)
+{
+	if (n <= 0)
+		return;
+
+	// Four ranges per thread, so a thread slowed down by others doesn't hold the rest waiting
+	int nthreads = maxthreads > 0 ? maxthreads : Threads() + 1;
+	int nranges	 = MAX(1, MIN(4 * nthreads, n / MAX(1, grain)));
+	if (nranges == 1 || nthreads == 1) {
+		body(0, n);
+		return;
+	}
+
+	ParallelJob job(nranges, [&] (int k) {
+		body(int(int64(n) * k / nranges), int(int64(n) * (k + 1) / nranges));
+	}, nthreads, cls);
+	job.Wait();
+}
+
+
+
+/*--------------------------------------------------------------------------*\
+ ParallelJob
+\*--------------------------------------------------------------------------*/
+
+ParallelJob::ParallelJob (int n, std::function<void (int i)> body, int maxthreads, TaskClass cls) : St(std::make_shared<State>())
+{
+	St->N	 = MAX(0, n);
+	St->Body = std::move(body);
+	St->Next = 0;
+	St->Nfinished = 0;
+	St->Done.reset(new std::atomic<bool>[St->N]);
+	for (int i = 0; i < St->N; i++)
+		St->Done[i] = false;
+
+	// The waiting thread runs items as well
+	int nthreads = MIN(St->N, THREADPOOL::Threads() + 1);
+	if (maxthreads > 0)
+		nthreads = MIN(nthreads, maxthreads);
+	for (int h = 1; h < nthreads; h++) {
+		std::shared_ptr<State> st = St;
+		THREADPOOL::Submit([st] { while (st->RunOne()); }, cls);
+	}
+}
+
+
+bool ParallelJob::State::RunOne ()
+{
+	int i = Next.fetch_add(1);
+	if (i >= N)
+		return false;
+
+	std::exception_ptr err;
+	try {
+		Body(i);
+	}
+	catch (...) {
+		err = std::current_exception();
+	}
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		if (err && !Error)
+			Error = err;
+		Done[i] = true;
+		Nfinished++;
+	}
+	DoneCond.notify_all();
+	return true;
+}
+
+
+void ParallelJob::WaitItem (int i)
+{
+	while (!St->Done[i]) {
+		if (St->RunOne())
+			continue;
+		std::unique_lock<std::mutex> lock(St->Mtx);
+		St->DoneCond.wait(lock, [&] { return St->Done[i].load(); });
+	}
+}
+
+
+void ParallelJob::Wait ()
+{
+	while (St->RunOne());
+
+	std::unique_lock<std::mutex> lock(St->Mtx);
+	St->DoneCond.wait(lock, [this] { return St->Nfinished == St->N; });
+	if (St->Error) {
+		std::exception_ptr err = St->Error;
+		St->Error = nullptr;
+		lock.unlock();
+		std::rethrow_exception(err);
+	}
+}
@@ -0,0 +1,104 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  threadpool.h
+ Purpose     :  Process-wide work-stealing thread pool
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  Tasks must not wait for events nor for other tasks: a
+				thread waiting for a camera or a socket stays a thread of
+				its own. A task may wait for a ParallelJob, the waiting
+				thread runs the job's items itself meanwhile.
+\**********************************************************************/
+
+#ifndef _THREADPOOL_H
+#define _THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+
+// Priority classes, a worker takes the tasks of a higher one first
+enum TaskClass
+{
+	TASK_CAPTURE,							// Feeding the pipeline: decoding, grabbing
+	TASK_PROCESSING,						// Frame processing
+	TASK_EXPORT,							// Saving, encoding: may lag behind
+	TASK_CLASSES
+};
+
+
+/*
+ ***************************************************************************
+ One pool of workers shared by all the stages, so parallel stages don't add
+ threads of their own and oversubscribe the cores. Every worker has a deque
+ per class: it pushes and pops its own tasks at the back (the most recent,
+ still in cache), idle workers steal from the front of the others' deques.
+ Tasks submitted by other threads go to a shared queue per class. Workers
+ are started by Start() or with the defaults on first use, optionally
+ pinned to a core each.
+ ***************************************************************************
+*/
+class THREADPOOL
+{
+  public:
+	struct Stats
+	{
+		uint64		Executed [TASK_CLASSES];
+		uint64		Stolen;												// Taken from another worker's deque
+	};
+
+	static bool		Start (int nthreads = 0, bool pin = false);			// 0 - one per core. False if already started
+	static void		Stop ();											// Runs the tasks queued, joins the workers
+	static int		Threads ();
+	static int		WorkerIndex ();										// 0 .. Threads()-1 on a worker, -1 on other threads
+	static void		Submit (std::function<void ()> task, TaskClass cls = TASK_PROCESSING);
+	static Stats	GetStats ();
+
+	// Runs body(i0, i1) over [0, n) in ranges of grain items at least, on up to maxthreads threads
+	// (0 - all the workers and the calling one, which takes part); returns when all are done
+	static void		ParallelFor (int n, int grain, const std::function<void (int i0, int i1)>& body, int maxthreads = 0, TaskClass cls = TASK_PROCESSING);
+};
+
+
+/*
+ ***************************************************************************
+ Items 0 .. n-1 run by body(i) on the pool, in ascending order of starting.
+ The owner may wait for one item (WaitItem) and use it while the next ones
+ run, e.g. write band k to a file while bands k+1 ... are being prepared.
+ A thread waiting runs the items not started yet itself, so waiting in a
+ task can't deadlock the pool. An exception of body is rethrown by Wait().
+ ***************************************************************************
+*/
+class ParallelJob
+{
+  public:
+	ParallelJob (int n, std::function<void (int i)> body, int maxthreads = 0, TaskClass cls = TASK_PROCESSING);
+	~ParallelJob ()									{ try { Wait(); } catch (...) {} }
+
+	void	WaitItem (int i);
+	void	Wait ();
+
+  private:
+	struct State
+	{
+		int							N;
+		std::function<void (int)>	Body;
+		std::atomic<int>			Next;									// Next item to start
+		int							Nfinished;								// Protected by Mtx
+		std::unique_ptr<std::atomic<bool>[]>	Done;
+		std::mutex					Mtx;
+		std::condition_variable		DoneCond;
+		std::exception_ptr			Error;
+
+		bool	RunOne ();													// Runs the next item, false if all are started
+	};
+
+	std::shared_ptr<State>	St;												// Shared with the helper tasks, which may start after the job is over
+};
+
+
+#endif // _THREADPOOL_H
@@ -0,0 +1,189 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  tracer.cpp
+ Purpose     :  Scoped timing zones exported as Chrome trace JSON
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+\**********************************************************************/
+
+#include "def.h"
+#include "tracer.h"
+
+#if UTILS_TRACE
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+
+std::atomic<bool>  TRACER::Enabled (false);
+
+
+namespace {
+
+enum
+{
+	TRACE_CHUNK		= 4096,					// Zones per chunk
+	TRACE_MAXCHUNKS	= UTILS_TRACE_MAXZONES / TRACE_CHUNK
+};
+
+struct TraceEvent
+{
+	cchar*	Name;
+	int64	Frame;
+	int64	T0, T1;
+};
+
+// Written by its thread only; Count is published after the event, so Save() reads complete events
+struct TraceBuffer
+{
+	TraceEvent*				Chunks [TRACE_MAXCHUNKS];
+	std::atomic<uint32>		Count;
+	std::atomic<int64>		Ndropped;
+	cchar*					Name;			// Protected by Mtx
+	int						Tid;
+
+	TraceBuffer (int tid) : Count(0), Ndropped(0), Name(nullptr), Tid(tid)	{ memset (Chunks, 0, sizeof(Chunks)); }
+};
+
+std::mutex					Mtx;			// Protects the list and the thread names
+std::vector<TraceBuffer*>	Buffers;
+thread_local TraceBuffer*	ThisBuffer;
+int64						Origin;			// Time of the first Start()
+
+
+TraceBuffer* GetBuffer ()
+{
+	if (!ThisBuffer) {
+		std::lock_guard<std::mutex> lock(Mtx);
+		ThisBuffer = new TraceBuffer(int(Buffers.size()) + 1);
+		Buffers.push_back(ThisBuffer);
+	}
+	return ThisBuffer;
+}
+
+
+void WriteString (FILE* f, cchar* s)
+{
+	fputc ('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc ('\\', f);
+		if ((unsigned char)*s >= ' ')
+			fputc (*s, f);
+	}
+	fputc ('"', f);
+}
+
+}
+
+
+
+int64 TRACER::Now ()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void TRACER::Start ()
+{
+	{
+		std::lock_guard<std::mutex> lock(Mtx);
+		if (!Origin)
+			Origin = Now();
+	}
+	Enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void TRACER::Record (cchar* name, int64 frame, int64 t0, int64 t1)
+{
+	TraceBuffer* b = GetBuffer();
+	uint32 n = b->Count.load(std::memory_order_relaxed);
+	uint32 c = n / TRACE_CHUNK;
+	if (c >= TRACE_MAXCHUNKS) {
+		b->Ndropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (!b->Chunks[c]) {
+		b->Chunks[c] = (TraceEvent*) malloc (TRACE_CHUNK * sizeof(TraceEvent));
+		if (!b->Chunks[c]) {
+			b->Ndropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	TraceEvent& e = b->Chunks[c][n % TRACE_CHUNK];
+	e.Name	= name;
+	e.Frame	= frame;
+	e.T0	= t0;
+	e.T1	= t1;
+	b->Count.store(n + 1, std::memory_order_release);
+}
+
+
+void TRACER::SetThreadName (cchar* name)
+{
+	TraceBuffer* b = GetBuffer();
+	std::lock_guard<std::mutex> lock(Mtx);
+	b->Name = name;
+}
+
+
+bool TRACER::Save (cchar* file)
+{
+	FILE* f = fopen(file, "w");
+	if (!f)
+		return false;
+
+	std::lock_guard<std::mutex> lock(Mtx);
+
+	fputs ("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+	fputs ("{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"playfile\"}}", f);
+	for (auto b : Buffers) {
+		fprintf (f, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", b->Tid);
+		if (b->Name)
+			WriteString (f, b->Name);
+		else
+			fprintf (f, "\"thread %d\"", b->Tid);
+		fputs ("}}", f);
+
+		uint32 count = b->Count.load(std::memory_order_acquire);
+		for (uint32 i = 0; i < count; i++) {
+			const TraceEvent& e = b->Chunks[i / TRACE_CHUNK][i % TRACE_CHUNK];
+			fputs (",\n{\"ph\":\"X\",\"pid\":1,\"name\":", f);
+			WriteString (f, e.Name);
+			fprintf (f, ",\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", b->Tid, (e.T0 - Origin) / 1e3, (e.T1 - e.T0) / 1e3);
+			if (e.Frame >= 0)
+				fprintf (f, ",\"args\":{\"frame\":%lld}", e.Frame);
+			fputc ('}', f);
+		}
+	}
+	fputs ("\n]}\n", f);
+
+	bool ok = !ferror(f);
+	return fclose(f) == 0 && ok;
+}
+
+
+int64 TRACER::Zones ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	int64 n = 0;
+	for (auto b : Buffers)
+		n += b->Count.load(std::memory_order_relaxed);
+	return n;
+}
+
+
+int64 TRACER::Dropped ()
+{
+	std::lock_guard<std::mutex> lock(Mtx);
+	int64 n = 0;
+	for (auto b : Buffers)
+		n += b->Ndropped.load(std::memory_order_relaxed);
+	return n;
+}
+
+
+#endif // UTILS_TRACE
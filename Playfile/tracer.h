@@ -0,0 +1,91 @@
+/**********************************************************************\
+ Library     :  Utils / Common
+ Filename    :  tracer.h
+ Purpose     :  Scoped timing zones exported as Chrome trace JSON
+ Author      :  (c) Quickest-Owl Ltd
+ Created     :  19.10.2026
+ Note		 :  The saved file opens in Perfetto (ui.perfetto.dev) or
+				chrome://tracing: one track per thread, one slice per zone,
+				the frame number in the slice arguments.
+\**********************************************************************/
+
+#ifndef _TRACER_H
+#define _TRACER_H
+
+#include <atomic>
+
+
+/*
+ * Times the rest of the enclosing scope as zone "name" of frame number frame (-1 if none).
+ * Costs one relaxed load while tracing is off; compiled out with UTILS_TRACE = 0.
+ */
+#define TRACE_ZONE(name, frame)		TraceZone  TRACE_ZONE_VAR(__LINE__) (name, frame)
+#define TRACE_ZONE_VAR(line)		TRACE_ZONE_VAR2(line)
+#define TRACE_ZONE_VAR2(line)		_tracezone##line
+
+
+#if UTILS_TRACE
+
+/*
+ ***************************************************************************
+ Zone recorder. Every thread appends its zones to its own buffer without
+ locks; Save() may run while the threads keep recording. Buffers live until
+ the process exits, so zones of finished threads are saved as well.
+ ***************************************************************************
+*/
+class TRACER
+{
+  public:
+	static std::atomic<bool>  Enabled;
+
+	static void		Start ();											// Saved timestamps count from the first Start()
+	static void		Stop ()							{ Enabled.store(false, std::memory_order_relaxed); }
+	static bool		Save (cchar* file);									// Writes all the zones recorded so far, false on file error
+	static void		SetThreadName (cchar* name);						// Track name of the calling thread, name must be a literal or live forever
+	static int64	Zones ();											// Zones recorded so far
+	static int64	Dropped ();											// Zones lost on full buffers
+
+	static int64	Now ();												// ns
+	static void		Record (cchar* name, int64 frame, int64 t0, int64 t1);
+};
+
+
+class TraceZone
+{
+  public:
+	TraceZone (cchar* name, int64 frame = -1) : Name(name), Frame(frame), T0(TRACER::Enabled.load(std::memory_order_relaxed) ? TRACER::Now() : 0)	{}
+	~TraceZone ()									{ if (T0) TRACER::Record(Name, Frame, T0, TRACER::Now()); }
+
+	void	SetFrame (int64 frame)					{ Frame = frame; }	// For zones which learn their frame number at the end
+
+  private:
+	cchar*	Name;
+	int64	Frame;
+	int64	T0;															// 0 - tracing was off when the zone began
+};
+
+#else
+
+class TRACER
+{
+  public:
+	static void		Start ()						{}
+	static void		Stop ()							{}
+	static bool		Save (cchar* file)				{ return false; }
+	static void		SetThreadName (cchar* name)		{}
+	static int64	Zones ()						{ return 0; }
+	static int64	Dropped ()						{ return 0; }
+};
+
+
+class TraceZone
+{
+  public:
+	TraceZone (cchar* name, int64 frame = -1)		{}
+	void	SetFrame (int64 frame)					{}
+};
+
+#endif // UTILS_TRACE
+
+
+#endif // _TRACER_H
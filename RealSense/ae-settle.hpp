@@ -0,0 +1,169 @@
+// Quickest-Owl Ltd. TA Roofs / RealSense samples
+// Auto-exposure settle detector.
+//
+// Instead of dropping a fixed number of frames at capture start, the detector watches
+// per-frame exposure and gain metadata of every video stream plus a subsampled mean
+// luminance of the color (or infrared) image, and reports convergence as soon as all
+// of them stop changing for a few consecutive frames. A timeout bounds the wait in
+// hard lighting, e.g. roofs in direct sunlight.
+//
+// Without metadata support (on Windows it requires the metadata registry patch) the
+// luminance alone decides. Without either, the classic fixed frame count is used.
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+
+struct settle_config
+{
+    int    window        = 4;       // Consecutive stable frames required
+    int    min_frames    = 3;       // Never settle earlier than that (AE may not have started yet)
+    int    fallback      = 30;      // Frame count used when there is nothing to watch
+    double exposure_tol  = 0.02;    // Max relative frame-to-frame change of exposure
+    double gain_tol      = 0.02;    // Max relative frame-to-frame change of gain
+    double luma_tol      = 0.015;   // Max relative frame-to-frame change of mean luminance
+    int    luma_step     = 8;       // Luminance sampling step in pixels, both directions
+    std::chrono::milliseconds timeout{ 3000 };
+};
+
+
+// Mean luminance of a video frame sampled on a sparse grid; -1 for unsupported formats.
+// For RGB formats the green channel is used as a cheap luma proxy.
+inline double mean_luma(const rs2::video_frame& vf, int step)
+{
+    int offset;
+    switch (vf.get_profile().format())
+    {
+    case RS2_FORMAT_RGB8:
+    case RS2_FORMAT_BGR8:
+    case RS2_FORMAT_RGBA8:
+    case RS2_FORMAT_BGRA8: offset = 1; break;
+    case RS2_FORMAT_YUYV:  offset = 0; break;
+    case RS2_FORMAT_UYVY:  offset = 1; break;
+    case RS2_FORMAT_Y8:    offset = 0; break;
+    case RS2_FORMAT_Y16:   offset = 1; break;   // high byte of little-endian 16 bits
+    default: return -1;
+    }
+
+    auto data   = static_cast<const uint8_t*>(vf.get_data());
+    int  bpp    = vf.get_bytes_per_pixel();
+    int  stride = vf.get_stride_in_bytes();
+    int  w      = vf.get_width();
+    int  h      = vf.get_height();
+
+    uint64_t sum = 0, n = 0;
+    for (int y = step / 2; y < h; y += step)
+    {
+        const uint8_t* row = data + y * stride + offset;
+        for (int x = step / 2; x < w; x += step, n++)
+            sum += row[x * bpp];
+    }
+    return n ? double(sum) / n : -1;
+}
+
+
+class settle_detector
+{
+public:
+    explicit settle_detector(const settle_config& cfg = settle_config()) : _cfg(cfg) {}
+
+    // Feed the next frameset, returns true once the streams have settled or the timeout expired
+    bool update(const rs2::frameset& frames)
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (!_frames++)
+            _start = now;
+        _elapsed = now - _start;
+
+        bool watched = false;
+        bool luma_done = false;
+        for (auto&& frame : frames)
+        {
+            auto vf = frame.as<rs2::video_frame>();
+            if (!vf)
+                continue;
+
+            auto profile = frame.get_profile();
+            int  key = (int(profile.stream_type()) * 16 + profile.stream_index()) * 4;
+
+            if (frame.supports_frame_metadata(RS2_FRAME_METADATA_ACTUAL_EXPOSURE))
+            {
+                track(key + 0, double(frame.get_frame_metadata(RS2_FRAME_METADATA_ACTUAL_EXPOSURE)), _cfg.exposure_tol);
+                watched = true;
+            }
+            if (frame.supports_frame_metadata(RS2_FRAME_METADATA_GAIN_LEVEL))
+            {
+                track(key + 1, double(frame.get_frame_metadata(RS2_FRAME_METADATA_GAIN_LEVEL)), _cfg.gain_tol);
+                watched = true;
+            }
+
+            // One image is enough for luminance; color is preferred as it comes first in the set
+            if (!luma_done && !vf.is<rs2::depth_frame>())
+            {
+                double luma = mean_luma(vf, _cfg.luma_step);
+                if (luma >= 0)
+                {
+                    track(key + 2, luma, _cfg.luma_tol);
+                    watched = luma_done = true;
+                }
+            }
+        }
+
+        if (_done)
+            return true;
+
+        if (!watched)
+            _done = _frames >= _cfg.fallback;
+        else if (_frames >= _cfg.min_frames && stable())
+            _done = true;
+
+        if (!_done && _elapsed >= _cfg.timeout)
+            _done = _timed_out = true;
+
+        return _done;
+    }
+
+    bool   settled()    const { return _done && !_timed_out; }
+    bool   timed_out()  const { return _timed_out; }
+    int    frames()     const { return _frames; }
+    double elapsed_ms() const { return std::chrono::duration<double, std::milli>(_elapsed).count(); }
+
+private:
+    struct signal
+    {
+        double value = 0;
+        int    stable = 0;      // Number of consecutive frames without a significant change
+        int    seen = 0;
+    };
+
+    void track(int key, double value, double tol)
+    {
+        signal& s = _signals[key];
+        if (s.seen++ && std::fabs(value - s.value) <= tol * std::fmax(std::fabs(s.value), 1.0))
+            s.stable++;
+        else
+            s.stable = 0;
+        s.value = value;
+    }
+
+    bool stable() const
+    {
+        for (auto&& s : _signals)
+            if (s.second.stable < _cfg.window)
+                return false;
+        return !_signals.empty();
+    }
+
+    settle_config         _cfg;
+    std::map<int, signal> _signals;
+    int                   _frames = 0;
+    bool                  _done = false;
+    bool                  _timed_out = false;
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::duration   _elapsed{};
+};
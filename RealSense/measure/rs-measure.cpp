@@ -12,6 +12,27 @@
 #include <unordered_set>
 #include <map>
 #include <thread>
+#include <condition_variable>
+#include <chrono>
+
+#include "def.h"
+#include "str.h"
+#include "logger.h"             // Quality adaptations, "-log=<level>[,<file>]" sets the level and the output
+#include "tracer.h"             // Timing zones, "-trace=<file>" saves them for ui.perfetto.dev
+#include "metrics.h"            // Prometheus metrics, "-metrics=<port>" serves them on localhost
+#include "threadpool.h"         // Shared worker threads, "-workers=<n>" sets their number, "-pin" pins them to the cores
+#include "frameexec.h"          // Frame-parallel processing on the pool
+
+static MetricCounter frames_processed("measure_frames_total", "Framesets post-processed");
+static MetricCounter frames_rendered("measure_frames_rendered_total", "Post-processed framesets taken by the render loop");
+static MetricHistogram process_seconds("measure_stage_seconds", "Latency of the pipeline stages", "stage=\"process\"");
+static MetricHistogram pathfinding_seconds("measure_stage_seconds", "Latency of the pipeline stages", "stage=\"pathfinding\"");
+static MetricHistogram render_seconds("measure_stage_seconds", "Latency of the pipeline stages", "stage=\"render\"");
+static MetricGauge path_length("measure_path_length_meters", "Length of the last shortest path");
+static MetricGauge frames_in_flight("measure_frames_in_flight", "Framesets being post-processed at once");
+static MetricHistogram latency_seconds("measure_latency_seconds", "Frameset latency from its arrival to the output", nullptr, { 0.01, 0.02, 0.03, 0.05, 0.075, 0.1, 0.15, 0.2, 0.5, 1 });
+static MetricCounter frames_dropped("measure_frames_dropped_total", "Framesets dropped to hold the latency target");
+static MetricGauge quality_gauge("measure_quality_level", "Post-processing quality level, 0 is the full quality");
 
 using pixel = std::pair<int, int>;
 
@@ -86,6 +107,132 @@ struct state
 // Helper function to register to UI events
 void register_glfw_callbacks(window& app, state& app_state);
 
+// Post-processing blocks keep buffers of the frame they work on, so each worker
+// processing framesets in parallel has its own set of the stateless ones
+struct filter_set
+{
+    filter_set()
+    {
+        // If the demo is too slow, make sure you run in Release (-DCMAKE_BUILD_TYPE=Release)
+        // but you can also increase the following parameter to decimate depth more (reducing quality)
+        // "-latency=<ms>" does it when the framesets come out later than that
+        dec.set_option(RS2_OPTION_FILTER_MAGNITUDE, float(decimation));
+        // Enable hole-filling
+        // Hole filling is an agressive heuristic and it gets the depth wrong many times
+        // However, this demo is not built to handle holes 
+        // (the shortest-path will always prefer to "cut" through the holes since they have zero 3D distance)
+        spat.set_option(RS2_OPTION_HOLES_FILL, 5); // 5 = fill all the zero pixels
+    }
+
+    // Colorizer is used to visualize depth data
+    rs2::colorizer color_map;
+    // Decimation filter reduces the amount of data (while preserving best samples)
+    rs2::decimation_filter dec;
+    int decimation = 2;
+    // Define transformations from and to Disparity domain
+    rs2::disparity_transform depth2disparity;
+    rs2::disparity_transform disparity2depth{ false };
+    // Define spatial filter (edge-preserving)
+    rs2::spatial_filter spat;
+    // Spatially align all streams to depth viewport
+    // We do this because:
+    //   a. Usually depth has wider FOV, and we only really need depth for this demo
+    //   b. We don't want to introduce new holes
+    rs2::align align_to{ RS2_STREAM_DEPTH };
+};
+
+// A frameset on its way through the post-processing stages
+struct measure_frame
+{
+    rs2::frameset data;         // Aligned frameset
+    rs2::frame depth;           // Post-processed depth
+    rs2::frame colorized;
+    int64 n = 0;
+    int quality = 0;            // Quality level the frameset is processed with
+    std::chrono::steady_clock::time_point arrival;  // Arrival from the camera, before it waited in the SDK's queue
+    std::chrono::steady_clock::time_point t0;       // Taken by the capture thread
+};
+
+// Quality levels of the post-processing, the first one is the full quality;
+// each next one gives up a bit more to keep up with the camera on a slower machine
+struct quality_level
+{
+    const char* change;         // What the level gives up, for the log
+    int decimation;             // RS2_OPTION_FILTER_MAGNITUDE
+    bool spatial;
+    bool temporal;
+    float path_radius;          // Pathfinding visits the pixels within this times the ruler length from its start
+    bool drop_frames;           // Framesets coming while all the workers are busy are dropped, not queued
+};
+
+static const quality_level quality_levels[] =
+{
+    { "full quality",           2, true,  true,  1.2f,  false },
+    { "narrower pathfinding",   2, true,  true,  1.05f, false },
+    { "spatial filter off",     2, false, true,  1.05f, false },
+    { "decimation 3",           3, false, true,  1.05f, false },
+    { "decimation 4",           4, false, true,  1.05f, false },
+    { "temporal filter off",    4, false, false, 1.05f, false },
+    { "dropping frames",        4, false, false, 1.05f, true  },
+};
+
+// Holds the latency of the framesets under a target: the output stage reports the latency
+// of every frameset, the controller smooths it and steps the quality down while it is over
+// the target, and back up once it stays well under it. After a step it waits for the framesets
+// in flight, still processed at the previous level, to come out
+class quality_controller
+{
+public:
+    quality_controller(double target_ms, int settle_frames)
+        : target_ms(target_ms), settle_frames(settle_frames) {}
+
+    bool enabled() const { return target_ms > 0; }
+    int current() const { return level.load(std::memory_order_relaxed); }
+
+    // Called by the output stage, one frameset at a time
+    void report(int64 n, double latency_ms)
+    {
+        if (!enabled())
+            return;
+        smoothed_ms = frames++ ? smoothed_ms + smoothing * (latency_ms - smoothed_ms) : latency_ms;
+        calm = smoothed_ms < recover * target_ms ? calm + 1 : 0;
+        int l = current();
+        if (frames - last_change < settle_frames)
+            return;
+        if (smoothed_ms > target_ms && l + 1 < int(sizeof(quality_levels) / sizeof(quality_levels[0])))
+            change(n, l + 1, latency_ms);
+        else if (calm >= recover_frames && l > 0)
+            change(n, l - 1, latency_ms);
+    }
+
+private:
+    void change(int64 n, int l, double latency_ms)
+    {
+        if (l > current())
+            LOG(INFO, "Frame %lld: latency %.1f ms, %.1f ms smoothed, over the %.0f ms target: quality level %d, %s",
+                n, latency_ms, smoothed_ms, target_ms, l, quality_levels[l].change);
+        else
+            LOG(INFO, "Frame %lld: latency %.1f ms, %.1f ms smoothed, under %.0f%% of the %.0f ms target: quality level %d, %s",
+                n, latency_ms, smoothed_ms, recover * 100, target_ms, l, quality_levels[l].change);
+        level = l;
+        last_change = frames;
+        calm = 0;
+        quality_gauge.Set(l);
+    }
+
+    static constexpr double smoothing = 0.1;    // Weight of the last frameset in the smoothed latency
+    static constexpr double recover = 0.6;      // Share of the target to stay under before a step up
+    static constexpr int recover_frames = 90;   // Framesets to stay there, ~3 s
+
+    const double target_ms;
+    const int settle_frames;
+    std::atomic<int> level{ 0 };
+    double smoothed_ms = 0;                     // The members below are used by the output stage only
+    int64 frames = 0;
+    int64 last_change = 0;
+    int calm = 0;                               // Framesets in a row under the recover share of the target
+};
+
 // Distance rendering functions:
 
 // Simple distance is the classic pythagorean distance between 3D points
@@ -105,33 +252,55 @@ void render_shortest_path(const rs2::depth_frame& depth,
 
 int main(int argc, char * argv[]) try
 {
+    // Optional timeline of the pipeline stages, metrics endpoint, number of processing threads and latency target
+    const char* trace_file = nullptr;
+    int workers = 0;            // All the cores but the render one
+    bool pin = false;
+    double latency_ms = 0;      // 0 - the full quality whatever the latency
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-log=", 5) == 0 && !LOGGER::Configure(argv[i] + 5))
+        {
+            std::cerr << "Bad log option " << argv[i] << std::endl;
+            return EXIT_FAILURE;
+        }
+        else if (strncmp(argv[i], "-trace=", 7) == 0)
+        {
+            trace_file = argv[i] + 7;
+            TRACER::SetThreadName("render");
+            TRACER::Start();
+        }
+        else if (strncmp(argv[i], "-metrics=", 9) == 0 && !METRICS::Serve(argv[i] + 9))
+        {
+            std::cerr << "Cannot serve metrics on " << argv[i] + 9 << std::endl;
+            return EXIT_FAILURE;
+        }
+        else if (strncmp(argv[i], "-workers=", 9) == 0)
+            workers = atoi(argv[i] + 9);
+        else if (strcmp(argv[i], "-pin") == 0)
+            pin = true;
+        else if (strncmp(argv[i], "-latency=", 9) == 0)
+            latency_ms = atof(argv[i] + 9);
+    }
+    if (workers <= 0)
+        workers = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+    THREADPOOL::Start(workers, pin);
+
     // OpenGL textures for the color and depth frames
     texture depth_image, color_image;
 
-    // Colorizer is used to visualize depth data
-    rs2::colorizer color_map;
-    // Decimation filter reduces the amount of data (while preserving best samples)
-    rs2::decimation_filter dec;
-    // If the demo is too slow, make sure you run in Release (-DCMAKE_BUILD_TYPE=Release)
-    // but you can also increase the following parameter to decimate depth more (reducing quality)
-    dec.set_option(RS2_OPTION_FILTER_MAGNITUDE, 2);
-    // Define transformations from and to Disparity domain
-    rs2::disparity_transform depth2disparity;
-    rs2::disparity_transform disparity2depth(false);
-    // Define spatial filter (edge-preserving)
-    rs2::spatial_filter spat;
-    // Enable hole-filling
-    // Hole filling is an agressive heuristic and it gets the depth wrong many times
-    // However, this demo is not built to handle holes 
-    // (the shortest-path will always prefer to "cut" through the holes since they have zero 3D distance)
-    spat.set_option(RS2_OPTION_HOLES_FILL, 5); // 5 = fill all the zero pixels
-    // Define temporal filter
+    // Consecutive framesets are post-processed on the thread pool, several at once, so the
+    // filters may cost more than a frame interval without falling behind the camera.
+    // The stateless filters run in parallel, each pool worker with its own filter_set;
+    // the temporal filter and the output take the framesets one at a time, in their order
+    // Framesets in flight hold camera frames and the SDK's frame pools are small:
+    // the reorder buffer has a slot for each worker and for each ordered stage
+    FrameExecutor<measure_frame> executor(workers + 2);
+    std::vector<filter_set> filters(executor.Workers());
+    // With "-latency=<ms>" the quality steps down while the framesets come out later than that
+    quality_controller quality(latency_ms, executor.Capacity() + 5);
+    // Define temporal filter, it blends each frame with the previous ones
     rs2::temporal_filter temp;
-    // Spatially align all streams to depth viewport
-    // We do this because:
-    //   a. Usually depth has wider FOV, and we only really need depth for this demo
-    //   b. We don't want to introduce new holes
-    rs2::align align_to(RS2_STREAM_DEPTH);
 
     // Declare RealSense pipeline, encapsulating the actual device and sensors
     rs2::pipeline pipe;
@@ -170,10 +339,15 @@ int main(int argc, char * argv[]) try
     // After initial post-processing, frames will flow into this queue:
     rs2::frame_queue postprocessed_frames;
 
-    // In addition, depth frames will also flow into this queue:
-    rs2::frame_queue pathfinding_queue; 
+    // In addition, the latest depth frame waits here for the pathfinding task,
+    // which is submitted to the pool when none is running
+    rs2::frame pathfinding_depth;
+    bool pathfinding_busy = false;
+    std::mutex pathfinding_mutex; // Protects the two above
+    std::condition_variable pathfinding_done;
+    std::function<void()> shortest_path_task;
 
-    // Alive boolean will signal the worker threads to finish-up
+    // Alive boolean will signal the capture thread and the pathfinding task to finish-up
     std::atomic_bool alive{ true };
 
     // The pathfinding thread will write its output to this memory:
@@ -181,154 +355,272 @@ int main(int argc, char * argv[]) try
     float total_dist = 0.f;
     std::mutex path_mutex; // It is protected by a mutex
 
-    // Video-processing thread will fetch frames from the camera,
-    // apply post-processing and send the result to the main thread for rendering
+    // Color frame of the frameset being output, the output stage takes one frameset at a time
+    rs2::frame output_color;
+    // In order to generate new composite frames, we have to wrap the grouping
+    // code in a lambda
+    rs2::processing_block frame_composer(
+        [&](rs2::frame colorized, // Colorized depth of the frameset being output
+            rs2::frame_source& source) // Frame pool that can allocate new frames
+    {
+        // Group the two frames together (to make sure they are rendered in sync)
+        rs2::frameset combined = source.allocate_composite_frame({ colorized, output_color });
+        // Send the composite frame for rendering
+        source.frame_ready(combined);
+    });
+    // Indicate that we want the results of frame_composer 
+    // to be pushed into postprocessed_frames queue
+    frame_composer >> postprocessed_frames;
+
+    // Stage 1, in parallel: alignment and the spatial depth post-processing
+    executor.AddStage(STAGE_PARALLEL, [&](measure_frame& f, int worker)
+    {
+        filter_set& fs = filters[worker];
+        const quality_level& q = quality_levels[f.quality];
+
+        // First make the frames spatially aligned
+        {
+            TRACE_ZONE("align", f.n);
+            f.data = fs.align_to.process(f.data);
+        }
+
+        // Next, apply depth post-processing
+        f.depth = f.data.get_depth_frame();
+        // Decimation will reduce the resultion of the depth image,
+        // closing small holes and speeding-up the algorithm
+        {
+            TRACE_ZONE("decimation", f.n);
+            if (fs.decimation != q.decimation)
+                fs.dec.set_option(RS2_OPTION_FILTER_MAGNITUDE, float(fs.decimation = q.decimation));
+            f.depth = fs.dec.process(f.depth);
+        }
+        // To make sure far-away objects are filtered proportionally
+        // we try to switch to disparity domain
+        {
+            TRACE_ZONE("depth2disparity", f.n);
+            f.depth = fs.depth2disparity.process(f.depth);
+        }
+        // Apply spatial filtering
+        if (q.spatial)
+        {
+            TRACE_ZONE("spatial", f.n);
+            f.depth = fs.spat.process(f.depth);
+        }
+    });
+
+    // Stage 2, in frame order: temporal filtering
+    executor.AddStage(STAGE_ORDERED, [&](measure_frame& f, int)
+    {
+        if (!quality_levels[f.quality].temporal)
+            return;
+        TRACE_ZONE("temporal", f.n);
+        f.depth = temp.process(f.depth);
+    });
+
+    // Stage 3, in parallel: back to depth and the color map
+    executor.AddStage(STAGE_PARALLEL, [&](measure_frame& f, int worker)
+    {
+        filter_set& fs = filters[worker];
+
+        // If we are in disparity domain, switch back to depth
+        {
+            TRACE_ZONE("disparity2depth", f.n);
+            f.depth = fs.disparity2depth.process(f.depth);
+        }
+        // Apply color map for visualization of depth
+        TRACE_ZONE("colorize", f.n);
+        f.colorized = fs.color_map(f.depth);
+    });
+
+    // Stage 4, in frame order: the output
+    executor.AddStage(STAGE_ORDERED, [&](measure_frame& f, int)
+    {
+        // Send the post-processed depth for path-finding
+        {
+            std::lock_guard<std::mutex> lock(pathfinding_mutex);
+            pathfinding_depth = f.depth;
+            if (!pathfinding_busy)
+            {
+                pathfinding_busy = true;
+                THREADPOOL::Submit(shortest_path_task);
+            }
+        }
+        // And the composite frame for rendering
+        output_color = f.data.get_color_frame();
+        frame_composer.invoke(f.colorized);
+        output_color = rs2::frame();
+
+        frames_processed.Inc();
+        frames_in_flight.Set(executor.GetStats().InFlight);
+        auto now = std::chrono::steady_clock::now();
+        process_seconds.Observe(std::chrono::duration<double>(now - f.t0).count());
+        double latency = std::chrono::duration<double>(now - f.arrival).count();
+        latency_seconds.Observe(latency);
+        quality.report(f.n, latency * 1e3);
+    });
+
+    // Video-processing thread will fetch frames from the camera
+    // and hand them to the executor for post-processing, the output goes to the main thread for rendering
     // It recieves synchronized (but not spatially aligned) pairs 
     // and outputs synchronized and aligned pairs
+    // It stays a thread of its own, out of the pool: it spends its time waiting for the camera
     std::thread video_processing_thread([&]() {
-        // In order to generate new composite frames, we have to wrap the processing
-        // code in a lambda
-        rs2::processing_block frame_processor(
-            [&](rs2::frameset data, // Input frameset (from the pipeline)
-                rs2::frame_source& source) // Frame pool that can allocate new frames
-        {
-            // First make the frames spatially aligned
-            data = align_to.process(data);
-
-            // Next, apply depth post-processing
-            rs2::frame depth = data.get_depth_frame();
-            // Decimation will reduce the resultion of the depth image,
-            // closing small holes and speeding-up the algorithm
-            depth = dec.process(depth); 
-            // To make sure far-away objects are filtered proportionally
-            // we try to switch to disparity domain
-            depth = depth2disparity.process(depth);
-            // Apply spatial filtering
-            depth = spat.process(depth);
-            // Apply temporal filtering
-            depth = temp.process(depth);
-            // If we are in disparity domain, switch back to depth
-            depth = disparity2depth.process(depth);
-            // Send the post-processed depth for path-finding
-            pathfinding_queue.enqueue(depth);
-
-            // Apply color map for visualization of depth
-            auto colorized = color_map(depth);
-            auto color = data.get_color_frame();
-            // Group the two frames together (to make sure they are rendered in sync)
-            rs2::frameset combined = source.allocate_composite_frame({ colorized, color });
-            // Send the composite frame for rendering
-            source.frame_ready(combined);
-        });
-        // Indicate that we want the results of frame_processor 
-        // to be pushed into postprocessed_frames queue
-        frame_processor >> postprocessed_frames;
-
+        TRACER::SetThreadName("capture");
         while (alive)
         {
             // Fetch frames from the pipeline and send them for processing
-            rs2::frameset fs;
-            if (pipe.poll_for_frames(&fs)) frame_processor.invoke(fs);
+            measure_frame f;
+            bool newdata;
+            {
+                TraceZone zone("wait_for_frames");
+                newdata = pipe.try_wait_for_frames(&f.data, 100);
+                if (newdata) zone.SetFrame(f.n = (int64)f.data.get_frame_number());
+            }
+            if (!newdata) continue;
+            f.t0 = f.arrival = std::chrono::steady_clock::now();
+            // The latency counts from the arrival in the SDK, the frameset may have waited in its queue
+            auto depth = f.data.get_depth_frame();
+            if (depth && depth.supports_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL))
+            {
+                auto arrived = std::chrono::system_clock::time_point(std::chrono::milliseconds(depth.get_frame_metadata(RS2_FRAME_METADATA_TIME_OF_ARRIVAL)));
+                auto waited = std::chrono::system_clock::now() - arrived;
+                if (waited > std::chrono::system_clock::duration::zero() && waited < std::chrono::seconds(10))
+                    f.arrival -= std::chrono::duration_cast<std::chrono::steady_clock::duration>(waited);
+            }
+            // At the lowest quality a frameset is dropped rather than queued behind busy workers
+            f.quality = quality.current();
+            if (quality_levels[f.quality].drop_frames && executor.GetStats().InFlight >= executor.Workers())
+            {
+                frames_dropped.Inc();
+                continue;
+            }
+            try
+            {
+                // Waits while the workers have as many framesets as they may hold
+                executor.Push(std::move(f));
+            }
+            catch (const rs2::error& e)
+            {
+                std::cerr << "Post-processing error calling " << e.get_failed_function() << "(" << e.get_failed_args() << "):\n    " << e.what() << std::endl;
+            }
         }
     });
 
-    // Shortest-path thread is recieving depth frame and
+    // Shortest-path task is recieving depth frame and
     // runs classic Dijkstra on it to find the shortest path (in 3D)
     // between the two points the user have chosen
-    std::thread shortest_path_thread([&]() {
-        while (alive)
+    // It runs on the thread pool, one at a time: while it runs, the output stage
+    // keeps replacing the depth frame waiting, so the next run takes the latest
+    shortest_path_task = [&]() {
+        for (;;)
         {
-            // Try to fetch frames from the pathfinding_queue
             rs2::frame depth;
-            if (pathfinding_queue.poll_for_frame(&depth))
             {
-                // Define vertex+distance struct
-                using dv = std::pair<float, pixel>;
-
-                // Define source, target and a terminator pixel
-                pixel src = app_state.ruler_start.get_pixel(depth);
-                pixel trg = app_state.ruler_end.get_pixel(depth);
-                pixel token{ -1, -1 }; // When we see this value we know we reached source
-
-                // Dist holds distances of every pixel from source
-                std::map<pixel, float> dist;
-                // Parent map is used to reconsturct the shortest-path
-                std::map<pixel, pixel> parent;
-                // Priority queue holds pixels (ordered by their distance)
-                std::priority_queue<dv, std::vector<dv>, std::greater<dv>> q;
-
-                // Initialize the source pixel:
-                dist[src] = 0.f;
-                parent[src] = token;
-                q.emplace(0.f, src);
-
-                // To save calculation we apply a heuristic
-                // Don't visit pixels that are too far away in 2D space
-                // It is very rare for objects in 3D space to violate this
-                auto max_2d_dist = dist_2d(src, trg) * 1.2;
-
-                while (!q.empty() && alive)
+                std::lock_guard<std::mutex> lock(pathfinding_mutex);
+                depth = pathfinding_depth;
+                pathfinding_depth = rs2::frame();
+                if (!depth || !alive)
+                {
+                    pathfinding_busy = false;
+                    pathfinding_done.notify_all();
+                    return;
+                }
+            }
+
+            TRACE_ZONE("pathfinding", (int64)depth.get_frame_number());
+            MetricTimer timer(pathfinding_seconds);
+
+            // Define vertex+distance struct
+            using dv = std::pair<float, pixel>;
+
+            // Define source, target and a terminator pixel
+            pixel src = app_state.ruler_start.get_pixel(depth);
+            pixel trg = app_state.ruler_end.get_pixel(depth);
+            pixel token{ -1, -1 }; // When we see this value we know we reached source
+
+            // Dist holds distances of every pixel from source
+            std::map<pixel, float> dist;
+            // Parent map is used to reconsturct the shortest-path
+            std::map<pixel, pixel> parent;
+            // Priority queue holds pixels (ordered by their distance)
+            std::priority_queue<dv, std::vector<dv>, std::greater<dv>> q;
+
+            // Initialize the source pixel:
+            dist[src] = 0.f;
+            parent[src] = token;
+            q.emplace(0.f, src);
+
+            // To save calculation we apply a heuristic
+            // Don't visit pixels that are too far away in 2D space
+            // It is very rare for objects in 3D space to violate this
+            // The radius shrinks at the lower quality levels
+            auto max_2d_dist = dist_2d(src, trg) * quality_levels[quality.current()].path_radius;
+
+            while (!q.empty() && alive)
+            {
+                // Fetch the closest pixel from the queue
+                pixel u = q.top().second; q.pop();
+
+                // If we reached the max radius, don't continue to expand
+                if (dist_2d(src, u) > max_2d_dist) continue;
+
+                // Fetch the list of neighboring pixels
+                auto n = neighbors(depth, u);
+                for (auto&& v : n)
                 {
-                    // Fetch the closest pixel from the queue
-                    pixel u = q.top().second; q.pop();
+                    // If this pixel was not yet visited, initialize
+                    // its distance as +INF
+                    if (dist.find(v) == dist.end()) dist[v] = INFINITY;
 
-                    // If we reached the max radius, don't continue to expand
-                    if (dist_2d(src, u) > max_2d_dist) continue;
+                    // Calculate distance in 3D between the two neighboring pixels
+                    auto d = dist_3d(intrinsics, depth, u, v);
+                    // Calculate total distance from source
+                    auto total_dist = dist[u] + d;
 
-                    // Fetch the list of neighboring pixels
-                    auto n = neighbors(depth, u);
-                    for (auto&& v : n)
+                    // If we encounter a potential improvement,
+                    if (dist[v] > total_dist)
                     {
-                        // If this pixel was not yet visited, initialize
-                        // its distance as +INF
-                        if (dist.find(v) == dist.end()) dist[v] = INFINITY;
-
-                        // Calculate distance in 3D between the two neighboring pixels
-                        auto d = dist_3d(intrinsics, depth, u, v);
-                        // Calculate total distance from source
-                        auto total_dist = dist[u] + d;
-
-                        // If we encounter a potential improvement,
-                        if (dist[v] > total_dist)
-                        {
-                            // Update parent and distance
-                            parent[v] = u;
-                            dist[v] = total_dist;
-                            // And re-visit that pixel by re-introducing it to the queue
-                            q.emplace(total_dist, v);
-                        }
+                        // Update parent and distance
+                        parent[v] = u;
+                        dist[v] = total_dist;
+                        // And re-visit that pixel by re-introducing it to the queue
+                        q.emplace(total_dist, v);
                     }
                 }
+            }
 
+            {
+                // Write the shortest-path to the path variable
+                std::lock_guard<std::mutex> lock(path_mutex);
+                total_dist = dist[trg];
+                path_length.Set(total_dist);
+                path.clear();
+                // Iterate until encounter token special pixel
+                while (trg != token)
                 {
-                    // Write the shortest-path to the path variable
-                    std::lock_guard<std::mutex> lock(path_mutex);
-                    total_dist = dist[trg];
-                    path.clear();
-                    // Iterate until encounter token special pixel
-                    while (trg != token)
-                    {
-                        // Handle the case we didn't find a path
-                        if (trg == parent[trg]) break;
+                    // Handle the case we didn't find a path
+                    if (trg == parent[trg]) break;
 
-                        path.emplace_back(trg);
-                        trg = parent[trg];
-                    }
+                    path.emplace_back(trg);
+                    trg = parent[trg];
                 }
             }
         }
-    });
+    };
 
     while(app) // Application still alive?
     {
         // Fetch the latest available post-processed frameset
         static rs2::frameset current_frameset;
-        postprocessed_frames.poll_for_frame(&current_frameset);
+        if (postprocessed_frames.poll_for_frame(&current_frameset))
+            frames_rendered.Inc();
 
         if (current_frameset)
         {
             auto depth = current_frameset.get_depth_frame();
             auto color = current_frameset.get_color_frame();
+            TRACE_ZONE("render", (int64)depth.get_frame_number());
+            MetricTimer timer(render_seconds);
 
             glEnable(GL_BLEND);
             // Use the Alpha channel for blending
@@ -369,7 +661,23 @@ int main(int argc, char * argv[]) try
     // Signal threads to finish and wait until they do
     alive = false;
     video_processing_thread.join();
-    shortest_path_thread.join();
+    executor.Stop();
+    {
+        std::unique_lock<std::mutex> lock(pathfinding_mutex);
+        pathfinding_done.wait(lock, [&] { return !pathfinding_busy; });
+    }
+    THREADPOOL::Stop();
+    METRICS::Stop();
+    LOGGER::Close();
+
+    if (trace_file)
+    {
+        TRACER::Stop();
+        if (TRACER::Save(trace_file))
+            std::cout << "Trace saved to " << trace_file << ": " << TRACER::Zones() << " zones" << std::endl;
+        else
+            std::cerr << "Cannot write trace file " << trace_file << std::endl;
+    }
 
     return EXIT_SUCCESS;
 }
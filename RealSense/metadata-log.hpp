@@ -0,0 +1,466 @@
+// Quickest-Owl Ltd. TA Roofs / RealSense samples
+// Columnar binary per-frame metadata log.
+//
+// The log replaces per-frame CSV writing on the capture path. Each frame appends
+// one fixed-width record into a memory-mapped file. The file is split into chunks
+// of METADATA_LOG_CHUNK records, and every chunk stores its data column by column:
+//
+//     [frame number x N][timestamp x N][presence bitmap x N][attr 0 x N] ... [attr K-1 x N]
+//
+// so a reader computing statistics over one attribute touches only that column.
+// CSV is produced offline from the log by metadata_log_reader::export_csv().
+
+#pragma once
+
+#include <librealsense2/rs.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static_assert(RS2_FRAME_METADATA_COUNT <= 64, "presence bitmap is a single 64-bit word");
+
+const char     METADATA_LOG_MAGIC[8]  = { 'R','S','M','D','L','O','G','1' };
+const uint32_t METADATA_LOG_VERSION   = 1;
+const uint64_t METADATA_LOG_CHUNK     = 8192;               // Records per chunk: 8 KB records * 8 bytes = 64 KB column, a multiple of the Windows map granularity
+const uint64_t METADATA_LOG_COLBYTES  = METADATA_LOG_CHUNK * sizeof(int64_t);
+const uint64_t METADATA_LOG_HDRBYTES  = METADATA_LOG_COLBYTES;  // Header block occupies one column-sized slot to keep chunks aligned
+const uint32_t METADATA_LOG_FIXEDCOLS = 3;                  // frame number, timestamp, presence bitmap
+
+// File header, stored at offset 0 and padded to METADATA_LOG_HDRBYTES
+struct metadata_log_header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t ncolumns;          // Number of metadata attribute columns (RS2_FRAME_METADATA_COUNT of the writer)
+    uint64_t chunk_records;     // Records per chunk
+    int32_t  stream;            // rs2_stream the log belongs to
+    uint32_t reserved;
+    uint64_t nrecords;          // Number of complete records, updated after every append
+};
+
+inline uint64_t metadata_log_chunk_bytes(uint32_t ncolumns)
+{
+    return (METADATA_LOG_FIXEDCOLS + ncolumns) * METADATA_LOG_COLBYTES;
+}
+
+
+// Thin cross-platform wrapper of a memory-mapped file
+class mapped_file
+{
+public:
+    mapped_file() = default;
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    void open(const std::string& filename, bool writable)
+    {
+        _writable = writable;
+#ifdef _WIN32
+        _file = CreateFileA(filename.c_str(), writable ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+                            FILE_SHARE_READ, nullptr, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("Cannot open metadata log " + filename);
+        LARGE_INTEGER sz;
+        GetFileSizeEx(_file, &sz);
+        _size = uint64_t(sz.QuadPart);
+#else
+        _fd = ::open(filename.c_str(), writable ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644);
+        if (_fd < 0)
+            throw std::runtime_error("Cannot open metadata log " + filename);
+        struct stat st;
+        fstat(_fd, &st);
+        _size = uint64_t(st.st_size);
+#endif
+    }
+
+    // Grow the file to newsize bytes (never shrinks)
+    void resize(uint64_t newsize)
+    {
+        if (newsize <= _size)
+            return;
+#ifdef _WIN32
+        // A mapping object created with a larger size extends the file itself
+        if (_mapping)
+            CloseHandle(_mapping);
+        _mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, DWORD(newsize >> 32), DWORD(newsize), nullptr);
+        if (!_mapping)
+            throw std::runtime_error("Cannot extend metadata log");
+#else
+        if (ftruncate(_fd, off_t(newsize)) != 0)
+            throw std::runtime_error("Cannot extend metadata log");
+#endif
+        _size = newsize;
+    }
+
+    // Map [offset, offset+bytes), offset must be a multiple of 64 KB
+    void* map(uint64_t offset, uint64_t bytes)
+    {
+#ifdef _WIN32
+        if (!_mapping) {
+            _mapping = CreateFileMappingA(_file, nullptr, _writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+            if (!_mapping)
+                throw std::runtime_error("Cannot map metadata log");
+        }
+        void* p = MapViewOfFile(_mapping, _writable ? FILE_MAP_WRITE : FILE_MAP_READ, DWORD(offset >> 32), DWORD(offset), SIZE_T(bytes));
+        if (!p)
+            throw std::runtime_error("Cannot map metadata log view");
+#else
+        void* p = mmap(nullptr, size_t(bytes), _writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _fd, off_t(offset));
+        if (p == MAP_FAILED)
+            throw std::runtime_error("Cannot map metadata log view");
+#endif
+        return p;
+    }
+
+    static void unmap(void* p, uint64_t bytes)
+    {
+        if (!p)
+            return;
+#ifdef _WIN32
+        FlushViewOfFile(p, 0);
+        UnmapViewOfFile(p);
+#else
+        munmap(p, size_t(bytes));
+#endif
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (_mapping) { CloseHandle(_mapping); _mapping = nullptr; }
+        if (_file != INVALID_HANDLE_VALUE) { CloseHandle(_file); _file = INVALID_HANDLE_VALUE; }
+#else
+        if (_fd >= 0) { ::close(_fd); _fd = -1; }
+#endif
+        _size = 0;
+    }
+
+    uint64_t size() const { return _size; }
+
+private:
+#ifdef _WIN32
+    HANDLE   _file = INVALID_HANDLE_VALUE;
+    HANDLE   _mapping = nullptr;
+#else
+    int      _fd = -1;
+#endif
+    uint64_t _size = 0;
+    bool     _writable = false;
+};
+
+
+// Appends one record per frame. Only the header and the current chunk are mapped.
+class metadata_log_writer
+{
+public:
+    metadata_log_writer() = default;
+    ~metadata_log_writer() { close(); }
+
+    void open(const std::string& filename, rs2_stream stream)
+    {
+        close();
+        _file.open(filename, true);
+        _file.resize(METADATA_LOG_HDRBYTES);
+        _header = static_cast<metadata_log_header*>(_file.map(0, METADATA_LOG_HDRBYTES));
+
+        memcpy(_header->magic, METADATA_LOG_MAGIC, sizeof(_header->magic));
+        _header->version       = METADATA_LOG_VERSION;
+        _header->ncolumns      = RS2_FRAME_METADATA_COUNT;
+        _header->chunk_records = METADATA_LOG_CHUNK;
+        _header->stream        = stream;
+        _header->reserved      = 0;
+        _header->nrecords      = 0;
+    }
+
+    void append(const rs2::frame& frm)
+    {
+        uint64_t n = _header->nrecords;
+        uint64_t ichunk = n / METADATA_LOG_CHUNK;
+        uint64_t irec   = n % METADATA_LOG_CHUNK;
+
+        if (!_chunk || ichunk != _ichunk)
+            map_chunk(ichunk);
+
+        int64_t* col = _chunk;
+        uint64_t presence = 0;
+
+        col[irec] = int64_t(frm.get_frame_number());
+        double ts = frm.get_timestamp();
+        memcpy(&col[METADATA_LOG_CHUNK + irec], &ts, sizeof(ts));
+
+        int64_t* attrs = col + METADATA_LOG_FIXEDCOLS * METADATA_LOG_CHUNK;
+        for (uint32_t i = 0; i < RS2_FRAME_METADATA_COUNT; i++)
+        {
+            auto attr = (rs2_frame_metadata_value)i;
+            if (frm.supports_frame_metadata(attr))
+            {
+                attrs[i * METADATA_LOG_CHUNK + irec] = frm.get_frame_metadata(attr);
+                presence |= uint64_t(1) << i;
+            }
+        }
+        col[2 * METADATA_LOG_CHUNK + irec] = int64_t(presence);
+
+        // Publish the record only after all its columns are written
+        _header->nrecords = n + 1;
+    }
+
+    uint64_t size() const { return _header ? _header->nrecords : 0; }
+
+    void close()
+    {
+        uint64_t chunkbytes = metadata_log_chunk_bytes(RS2_FRAME_METADATA_COUNT);
+        mapped_file::unmap(_chunk, chunkbytes);
+        mapped_file::unmap(_header, METADATA_LOG_HDRBYTES);
+        _chunk = nullptr;
+        _header = nullptr;
+        _file.close();
+    }
+
+private:
+    void map_chunk(uint64_t ichunk)
+    {
+        uint64_t chunkbytes = metadata_log_chunk_bytes(RS2_FRAME_METADATA_COUNT);
+        uint64_t offset = METADATA_LOG_HDRBYTES + ichunk * chunkbytes;
+
+        mapped_file::unmap(_chunk, chunkbytes);
+        _file.resize(offset + chunkbytes);
+        _chunk = static_cast<int64_t*>(_file.map(offset, chunkbytes));
+        _ichunk = ichunk;
+    }
+
+    mapped_file          _file;
+    metadata_log_header* _header = nullptr;
+    int64_t*             _chunk = nullptr;
+    uint64_t             _ichunk = 0;
+};
+
+
+// Single pass statistics over one column
+struct metadata_stats
+{
+    uint64_t count = 0;
+    double   min = std::numeric_limits<double>::max();
+    double   max = std::numeric_limits<double>::lowest();
+    double   mean = 0;
+    double   stddev = 0;
+};
+
+
+// Maps a complete log read-only and scans its columns
+class metadata_log_reader
+{
+public:
+    metadata_log_reader() = default;
+    ~metadata_log_reader() { close(); }
+
+    void open(const std::string& filename)
+    {
+        close();
+        _file.open(filename, false);
+        if (_file.size() < METADATA_LOG_HDRBYTES)
+            throw std::runtime_error("Not a metadata log: " + filename);
+
+        _base = static_cast<const uint8_t*>(_file.map(0, _file.size()));
+        _header = reinterpret_cast<const metadata_log_header*>(_base);
+        if (memcmp(_header->magic, METADATA_LOG_MAGIC, sizeof(_header->magic)) != 0 || _header->version != METADATA_LOG_VERSION)
+            throw std::runtime_error("Not a metadata log: " + filename);
+
+        _chunkbytes = metadata_log_chunk_bytes(_header->ncolumns);
+        if (METADATA_LOG_HDRBYTES + chunks() * _chunkbytes > _file.size())
+            throw std::runtime_error("Truncated metadata log: " + filename);
+    }
+
+    void close()
+    {
+        mapped_file::unmap(const_cast<uint8_t*>(_base), _file.size());
+        _base = nullptr;
+        _header = nullptr;
+        _file.close();
+    }
+
+    uint64_t   size()     const { return _header->nrecords; }
+    uint32_t   columns()  const { return _header->ncolumns; }
+    rs2_stream stream()   const { return rs2_stream(_header->stream); }
+
+    uint64_t frame_number(uint64_t i) const { return uint64_t(column(i / METADATA_LOG_CHUNK, 0)[i % METADATA_LOG_CHUNK]); }
+    uint64_t presence    (uint64_t i) const { return uint64_t(column(i / METADATA_LOG_CHUNK, 2)[i % METADATA_LOG_CHUNK]); }
+    double   timestamp   (uint64_t i) const
+    {
+        double ts;
+        memcpy(&ts, &column(i / METADATA_LOG_CHUNK, 1)[i % METADATA_LOG_CHUNK], sizeof(ts));
+        return ts;
+    }
+
+    bool has(uint64_t i, rs2_frame_metadata_value attr) const
+    {
+        return uint32_t(attr) < columns() && (presence(i) >> attr) & 1;
+    }
+
+    rs2_metadata_type value(uint64_t i, rs2_frame_metadata_value attr) const
+    {
+        return column(i / METADATA_LOG_CHUNK, METADATA_LOG_FIXEDCOLS + attr)[i % METADATA_LOG_CHUNK];
+    }
+
+    // Statistics of an attribute over all records where it is present
+    metadata_stats stats(rs2_frame_metadata_value attr) const
+    {
+        return scan(attr, false);
+    }
+
+    // Statistics of the differences between consecutive present values (e.g. sensor timestamps)
+    metadata_stats delta_stats(rs2_frame_metadata_value attr) const
+    {
+        return scan(attr, true);
+    }
+
+    // Statistics of the differences between consecutive frame timestamps, in milliseconds
+    metadata_stats timestamp_delta_stats() const
+    {
+        accumulator acc;
+        double prev = 0;
+        for (uint64_t i = 0; i < size(); i++)
+        {
+            double ts = timestamp(i);
+            if (i)
+                acc.add(ts - prev);
+            prev = ts;
+        }
+        return acc.result();
+    }
+
+    // Offline conversion: one row per record, empty cells for unsupported attributes
+    void export_csv(const std::string& filename) const
+    {
+        std::ofstream csv(filename);
+        csv << "Stream," << rs2_stream_to_string(stream()) << "\nFrame,Timestamp";
+        for (uint32_t a = 0; a < columns(); a++)
+            csv << "," << rs2_frame_metadata_to_string((rs2_frame_metadata_value)a);
+        csv << "\n";
+
+        csv.precision(std::numeric_limits<double>::digits10 + 1);
+        for (uint64_t i = 0; i < size(); i++)
+        {
+            uint64_t mask = presence(i);
+            csv << frame_number(i) << "," << timestamp(i);
+            for (uint32_t a = 0; a < columns(); a++)
+            {
+                csv << ",";
+                if ((mask >> a) & 1)
+                    csv << value(i, (rs2_frame_metadata_value)a);
+            }
+            csv << "\n";
+        }
+    }
+
+    // Offline conversion of a single record to the classic "Metadata Attribute,Value" layout, nothing if there is no record i
+    void export_csv(const std::string& filename, uint64_t i) const
+    {
+        if (i >= size())
+            return;
+        std::ofstream csv(filename);
+        csv << "Stream," << rs2_stream_to_string(stream()) << "\nMetadata Attribute,Value\n";
+        uint64_t mask = presence(i);
+        for (uint32_t a = 0; a < columns(); a++)
+        {
+            if ((mask >> a) & 1)
+                csv << rs2_frame_metadata_to_string((rs2_frame_metadata_value)a) << ","
+                    << value(i, (rs2_frame_metadata_value)a) << "\n";
+        }
+    }
+
+private:
+    struct accumulator
+    {
+        metadata_stats s;
+        double sum = 0, sumsq = 0;
+
+        void add(double x)
+        {
+            s.count++;
+            sum += x;
+            sumsq += x * x;
+            if (x < s.min) s.min = x;
+            if (x > s.max) s.max = x;
+        }
+
+        metadata_stats result()
+        {
+            if (s.count)
+            {
+                s.mean = sum / s.count;
+                double var = sumsq / s.count - s.mean * s.mean;
+                s.stddev = var > 0 ? std::sqrt(var) : 0;
+            }
+            else
+            {
+                s.min = s.max = 0;
+            }
+            return s;
+        }
+    };
+
+    uint64_t chunks() const { return (size() + METADATA_LOG_CHUNK - 1) / METADATA_LOG_CHUNK; }
+
+    const int64_t* column(uint64_t ichunk, uint32_t icol) const
+    {
+        return reinterpret_cast<const int64_t*>(_base + METADATA_LOG_HDRBYTES + ichunk * _chunkbytes + icol * METADATA_LOG_COLBYTES);
+    }
+
+    // Walks the presence and value columns chunk by chunk, touching nothing else
+    metadata_stats scan(rs2_frame_metadata_value attr, bool deltas) const
+    {
+        accumulator acc;
+        if (uint32_t(attr) >= columns())
+            return acc.result();
+
+        bool     have_prev = false;
+        int64_t  prev = 0;
+        uint64_t bit = uint64_t(1) << attr;
+
+        for (uint64_t c = 0, n = size(); c < chunks(); c++)
+        {
+            const int64_t* mask = column(c, 2);
+            const int64_t* vals = column(c, METADATA_LOG_FIXEDCOLS + attr);
+            uint64_t cnt = std::min<uint64_t>(METADATA_LOG_CHUNK, n - c * METADATA_LOG_CHUNK);
+
+            for (uint64_t i = 0; i < cnt; i++)
+            {
+                if (!(uint64_t(mask[i]) & bit))
+                    continue;
+                if (!deltas)
+                    acc.add(double(vals[i]));
+                else if (have_prev)
+                    acc.add(double(vals[i] - prev));
+                prev = vals[i];
+                have_prev = true;
+            }
+        }
+        return acc.result();
+    }
+
+    mapped_file                _file;
+    const uint8_t*             _base = nullptr;
+    const metadata_log_header* _header = nullptr;
+    uint64_t                   _chunkbytes = 0;
+};
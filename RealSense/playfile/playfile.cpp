@@ -6,9 +6,14 @@
 #include <librealsense2/hpp/rs_context.hpp>
 #include "example.hpp"          // Include short list of convenience functions for rendering
 
+#include "def.h"
+#include "str.h"
+#include "logger.h"             // Deferred logging, keeps console output off the frame loop
+#include "framepool.h"          // Pooled frame buffers, no allocation per frame
+
 
 const auto		MainWindowName = "Quickest Owl Playfile";
-cv::Mat			MainImg;
+cv::Mat			MainImg;						// Last frame, pooled
 rs2::frame		MainDepth;
 cv::Size		MainFrameSize;
 char			MainOverlapText[100];
@@ -26,7 +31,7 @@ void onMouse (int event, int x, int y, int flags, void* param)
 		UINT16* pd = (UINT16*)MainDepth.get_data();
 
 		sprintf (MainOverlapText, "[%4d:%4d] D = %5d", x, y, pd[MainFrameSize.width * y + x]);
-		puts (MainOverlapText);
+		LOG (INFO, "%s", MainOverlapText);
 	}
 }
 
@@ -34,6 +39,11 @@ void onMouse (int event, int x, int y, int flags, void* param)
 
 int main(int argc, char * argv[]) try
 {
+	if (argc > 2 && !LOGGER::Configure(argv[2])) {
+		printf ("Usage: playfile <bag-file> [<log-level>[,<log-file>]]\n");
+		return EXIT_FAILURE;
+	}
+
 	rs2::config cfg;
 	cfg.enable_device_from_file (argv[1]);
 	rs2::pipeline pipe;					// Declare RealSense pipeline, encapsulating the actual device and sensors
@@ -42,9 +52,8 @@ int main(int argc, char * argv[]) try
 	cv::namedWindow (MainWindowName, cv::WINDOW_AUTOSIZE);
 	cv::setMouseCallback (MainWindowName, onMouse, 0);
 
-	int				iframe = 0;
-	cv::Mat*		image = nullptr;
-	cv::Vec3b*		previmage = nullptr;
+	int				iframe = 0;
+	cv::Mat			shown;						// MainImg with the overlay, its pooled buffer is reused
 	rs2::frameset	data;
 	bool			newdata;
 
@@ -53,7 +62,7 @@ int main(int argc, char * argv[]) try
 		//rs2::frameset data = pipe.wait_for_frames();
 		if (newdata = pipe.poll_for_frames(&data)) {
 			++iframe;
-			printf ("Frame #%d\n", iframe);
+			LOG (DEBUG, "Frame #%d", iframe);
 		}
 		
 		if (!iframe)
@@ -67,28 +76,23 @@ int main(int argc, char * argv[]) try
 
 		//int x = MainDepth.as<rs2::video_frame>().get_bits_per_pixel();
 
-		MainFrameSize = cv::Size(fr.as<rs2::video_frame>().get_width(), fr.as<rs2::video_frame>().get_height());
-		int size_bytes = MainFrameSize.width * MainFrameSize.height * sizeof(cv::Vec3b);
-
-		if (newdata) {
-			image = new(&MainImg) cv::Mat (MainFrameSize, CV_8UC3, (void*)fr.get_data());	// create OpenCV matrix of w*h size from the RGB data
-			if (!previmage) 
-				previmage = new cv::Vec3b[MainFrameSize.width * MainFrameSize.height];
-			memcpy (previmage, fr.get_data(), size_bytes);
-		}
-		else {
-			assert (previmage);
-			image = new(&MainImg) cv::Mat (MainFrameSize, CV_8UC3, (void*)previmage);
-		}
-
-		cv::Mat img2 = image->clone ();
-		cv::putText (img2, MainOverlapText, cv::Point(5,25), cv::FONT_HERSHEY_DUPLEX, 1.0, CV_RGB(0,255,0), 2);
-		cv::circle  (img2, cv::Point(MainLastX,MainLastY), 5, CV_RGB(0,255,0), -1, 8);
-		cv::imshow (MainWindowName, img2);
+		MainFrameSize = cv::Size(fr.as<rs2::video_frame>().get_width(), fr.as<rs2::video_frame>().get_height());
+
+		if (newdata)
+			MainImg = FRAMEPOOL::Clone (cv::Mat(MainFrameSize, CV_8UC3, (void*)fr.get_data()));	// the SDK recycles its frames, keep a pooled copy of the RGB data
+		if (shown.empty())
+			shown = FRAMEPOOL::NewMat (MainFrameSize.height, MainFrameSize.width, CV_8UC3);
+
+		MainImg.copyTo (shown);
+		cv::putText (shown, MainOverlapText, cv::Point(5,25), cv::FONT_HERSHEY_DUPLEX, 1.0, CV_RGB(0,255,0), 2);
+		cv::circle  (shown, cv::Point(MainLastX,MainLastY), 5, CV_RGB(0,255,0), -1, 8);
+		cv::imshow (MainWindowName, shown);
     }
 
-	if (previmage)
-		delete previmage;
+	MainImg.release ();
+	shown.release ();
+	FRAMEPOOL::PrintStats ();
+	LOGGER::Close ();
 
 	return EXIT_SUCCESS;
 }
@@ -6,18 +6,32 @@
 #include <fstream>              // File IO
 #include <iostream>             // Terminal IO
 #include <sstream>              // Stringstreams
+#include <map>
+#include <tuple>
+
+#include "metadata-log.hpp"     // Columnar binary per-frame metadata log
+#include "ae-settle.hpp"        // Auto-exposure settle detector
 
 // 3rd party header for writing png files
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
-// Helper function for writing metadata to disk as a csv file
-void metadata_to_csv(const rs2::frame& frm, const std::string& filename);
+// Offline conversion of a binary metadata log to CSV, and metadata statistics
+int metadata_tool(int argc, char * argv[]);
 
-// This sample captures 30 frames and writes the last frame to disk.
+// This sample waits for auto-exposure to settle and writes the next frame to disk.
 // It can be useful for debugging an embedded system with no display.
 int main(int argc, char * argv[]) try
 {
+    settle_config settle_cfg;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--settle-timeout" && i + 1 < argc)
+            settle_cfg.timeout = std::chrono::milliseconds(atoi(argv[++i]));
+        else
+            return metadata_tool(argc, argv);   // Any other argument selects the offline metadata tool
+    }
+
     // Declare depth colorizer for pretty visualization of depth data
     rs2::colorizer color_map;
 
@@ -26,12 +40,44 @@ int main(int argc, char * argv[]) try
     // Start streaming with default recommended configuration
     pipe.start();
 
-    // Capture 30 frames to give autoexposure, etc. a chance to settle
-    for (auto i = 0; i < 30; ++i) pipe.wait_for_frames();
+    // Per-frame metadata of every stream is appended to a binary log, one per stream
+    std::map<std::string, metadata_log_writer> metadata_logs;
+    auto log_metadata = [&](const rs2::frameset& frames)
+    {
+        for (auto&& frame : frames)
+        {
+            auto name = frame.get_profile().stream_name();
+            auto it = metadata_logs.find(name);
+            if (it == metadata_logs.end())
+            {
+                it = metadata_logs.emplace(std::piecewise_construct, std::forward_as_tuple(name), std::forward_as_tuple()).first;
+                it->second.open("rs-save-to-disk-output-" + name + "-metadata.rsmd", frame.get_profile().stream_type());
+            }
+            it->second.append(frame);
+        }
+    };
+
+    // Capture frames until exposure, gain and image luminance stop changing,
+    // to give autoexposure, etc. a chance to settle
+    settle_detector settle(settle_cfg);
+    for (;;)
+    {
+        rs2::frameset frames = pipe.wait_for_frames();
+        log_metadata(frames);
+        if (settle.update(frames)) break;
+    }
+    std::cout << (settle.settled() ? "Settled" : "Settle timeout") << " after " << settle.frames()
+              << " frames, " << settle.elapsed_ms() << " ms" << std::endl;
 
     // Wait for the next set of frames from the camera. Now that autoexposure, etc.
     // has settled, we will write these to disk
-    for (auto&& frame : pipe.wait_for_frames())
+    rs2::frameset frames = pipe.wait_for_frames();
+    log_metadata(frames);
+
+    // The logs must be closed before they can be read back
+    for (auto&& log : metadata_logs) log.second.close();
+
+    for (auto&& frame : frames)
     {
         // We can only save video frames as pngs, so we skip the rest
         if (auto vf = frame.as<rs2::video_frame>())
@@ -47,11 +93,14 @@ int main(int argc, char * argv[]) try
                            vf.get_bytes_per_pixel(), vf.get_data(), vf.get_stride_in_bytes());
             std::cout << "Saved " << png_file.str() << std::endl;
 
-            // Record per-frame metadata for UVC streams
-            std::stringstream csv_file;
-            csv_file << "rs-save-to-disk-output-" << vf.get_profile().stream_name()
-                     << "-metadata.csv";
-            metadata_to_csv(vf, csv_file.str());
+            // Convert metadata of the saved frame (the last log record) to CSV
+            auto name = frame.get_profile().stream_name();
+            metadata_log_reader log;
+            log.open("rs-save-to-disk-output-" + name + "-metadata.rsmd");
+            if (log.size())
+                log.export_csv("rs-save-to-disk-output-" + name + "-metadata.csv", log.size() - 1);
+            else
+                std::cout << "No metadata recorded for " << name << std::endl;
         }
     }
 
@@ -68,24 +117,41 @@ catch(const std::exception & e)
     return EXIT_FAILURE;
 }
 
-void metadata_to_csv(const rs2::frame& frm, const std::string& filename)
+int metadata_tool(int argc, char * argv[])
 {
-    std::ofstream csv;
-
-    csv.open(filename);
-
-    //    std::cout << "Writing metadata to " << filename << endl;
-    csv << "Stream," << rs2_stream_to_string(frm.get_profile().stream_type()) << "\nMetadata Attribute,Value\n";
+    std::string cmd = argv[1];
+    if (cmd == "--csv" && argc == 4)
+    {
+        metadata_log_reader log;
+        log.open(argv[2]);
+        log.export_csv(argv[3]);
+        std::cout << "Converted " << log.size() << " records to " << argv[3] << std::endl;
+        return EXIT_SUCCESS;
+    }
 
-    // Record all the available metadata attributes
-    for (size_t i = 0; i < RS2_FRAME_METADATA_COUNT; i++)
+    if (cmd == "--stats" && argc == 3)
     {
-        if (frm.supports_frame_metadata((rs2_frame_metadata_value)i))
+        metadata_log_reader log;
+        log.open(argv[2]);
+        std::cout << rs2_stream_to_string(log.stream()) << ": " << log.size() << " records\n";
+
+        auto print = [](const char* name, const metadata_stats& s)
         {
-            csv << rs2_frame_metadata_to_string((rs2_frame_metadata_value)i) << ","
-                << frm.get_frame_metadata((rs2_frame_metadata_value)i) << "\n";
-        }
+            std::cout << "  " << name << ": n=" << s.count << " min=" << s.min << " max=" << s.max
+                      << " mean=" << s.mean << " stddev=" << s.stddev << "\n";
+        };
+        print("Timestamp delta, ms", log.timestamp_delta_stats());
+        print("Exposure",            log.stats(RS2_FRAME_METADATA_ACTUAL_EXPOSURE));
+        print("Gain",                log.stats(RS2_FRAME_METADATA_GAIN_LEVEL));
+        print("Sensor ts delta, us", log.delta_stats(RS2_FRAME_METADATA_SENSOR_TIMESTAMP));
+        print("Frame counter delta", log.delta_stats(RS2_FRAME_METADATA_FRAME_COUNTER));
+        return EXIT_SUCCESS;
     }
 
-    csv.close();
+    std::cout << "Usage:\n"
+              << "  rs-save-to-disk [--settle-timeout <ms>]\n"
+              << "                                       capture and save PNG, metadata log and CSV\n"
+              << "  rs-save-to-disk --csv <log> <csv>    convert a binary metadata log to CSV\n"
+              << "  rs-save-to-disk --stats <log>        print exposure, gain and timestamp statistics\n";
+    return EXIT_FAILURE;
 }
@@ -6,6 +6,9 @@
 #include "example.hpp" 
 #include "example.hpp"          // Include short list of convenience functions for rendering
 
+#include "def.h"
+#include "framepool.h"          // Pooled frame buffers, handed to the device by reference
+
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
@@ -21,7 +24,7 @@ const int BPP = 2;
 struct synthetic_frame
 {
     int x, y, bpp;
-    std::vector<uint8_t> frame;
+    FrameBuf frame;             // Shared with the frames of the device until it releases them
 };
 
 class custom_frame_source
@@ -35,26 +38,26 @@ public:
 
         last = std::chrono::high_resolution_clock::now();
 
-        std::vector<uint8_t> pixels_depth(depth_frame.x * depth_frame.y * depth_frame.bpp, 0);
-        depth_frame.frame = std::move(pixels_depth);
+        depth_frame.frame = FRAMEPOOL::Get(depth_frame.x * depth_frame.y * depth_frame.bpp);
+        memset(depth_frame.frame.Data(), 0, depth_frame.frame.Size());
 
         auto realsense_logo = stbi_load_from_memory(splash, (int)splash_size, &color_frame.x, &color_frame.y, &color_frame.bpp, false);
 
-        std::vector<uint8_t> pixels_color(color_frame.x * color_frame.y * color_frame.bpp, 0);
+        color_frame.frame = FRAMEPOOL::Get(color_frame.x * color_frame.y * color_frame.bpp);
+        uint8_t* pixels_color = color_frame.frame.Data();
 
-        memcpy(pixels_color.data(), realsense_logo, color_frame.x*color_frame.y * 4);
+        memcpy(pixels_color, realsense_logo, color_frame.x*color_frame.y * 4);
 
         for (auto i = 0; i< color_frame.y; i++)
             for (auto j = 0; j < color_frame.x * 4; j += 4)
             {
-                if (pixels_color.data()[i*color_frame.x * 4 + j] == 0)
+                if (pixels_color[i*color_frame.x * 4 + j] == 0)
                 {
-                    pixels_color.data()[i*color_frame.x * 4 + j] = 22;
-                    pixels_color.data()[i*color_frame.x * 4 + j + 1] = 115;
-                    pixels_color.data()[i*color_frame.x * 4 + j + 2] = 185;
+                    pixels_color[i*color_frame.x * 4 + j] = 22;
+                    pixels_color[i*color_frame.x * 4 + j + 1] = 115;
+                    pixels_color[i*color_frame.x * 4 + j + 2] = 185;
                 }
             }
-        color_frame.frame = std::move(pixels_color);
     }
 
     synthetic_frame& get_synthetic_texture()
@@ -73,12 +76,14 @@ public:
             wave_base += 0.1;
             last = now;
 
+            // A new buffer: the device may still hold the previous one. In steady state the pool recycles them
+            depth_frame.frame = FRAMEPOOL::Get(depth_frame.x * depth_frame.y * depth_frame.bpp);
             for (int i = 0; i < depth_frame.y; i++)
             {
                 for (int j = 0; j < depth_frame.x; j++)
                 {
                     auto d = 2 + 0.1 * (1 + sin(wave_base + j / 50.f));
-                    ((uint16_t*)depth_frame.frame.data())[i*depth_frame.x + j] = (int)(d * 0xff);
+                    ((uint16_t*)depth_frame.frame.Data())[i*depth_frame.x + j] = (int)(d * 0xff);
                 }
             }
         }
@@ -161,17 +166,18 @@ int main(int argc, char * argv[]) try
 
     while (app) // Application still alive?
     {
-        synthetic_frame depth_frame = app_data.get_synthetic_depth(app_state);
+        synthetic_frame& depth_frame = app_data.get_synthetic_depth(app_state);
 
-        depth_sensor.on_video_frame({ depth_frame.frame.data(), // Frame pixels from capture API
-            [](void*) {}, // Custom deleter (if required)
+        // Each frame holds a reference to its buffer, the deleter drops it
+        depth_sensor.on_video_frame({ FrameBuf(depth_frame.frame).Detach(), // Frame pixels from capture API
+            [](void* p) { FRAMEPOOL::Release(p); }, // Custom deleter (if required)
             depth_frame.x*depth_frame.bpp, depth_frame.bpp, // Stride and Bytes-per-pixel
             (rs2_time_t)frame_number * 16, RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, frame_number, // Timestamp, Frame# for potential sync services
             depth_stream });
 
 
-        color_sensor.on_video_frame({ texture.frame.data(), // Frame pixels from capture API
-            [](void*) {}, // Custom deleter (if required)
+        color_sensor.on_video_frame({ FrameBuf(texture.frame).Detach(), // Frame pixels from capture API
+            [](void* p) { FRAMEPOOL::Release(p); }, // Custom deleter (if required)
             texture.x*texture.bpp, texture.bpp, // Stride and Bytes-per-pixel
             (rs2_time_t)frame_number * 16, RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK, frame_number, // Timestamp, Frame# for potential sync services
             color_stream });
@@ -33,6 +33,9 @@
 #include <iostream>
 #include <limits>
 #include <thread>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
@@ -45,21 +48,17 @@
 #include <opencv2/core/utility.hpp>
 #endif
 
-using namespace std;
+#include "save-queue.hpp"
 
-typedef struct SaveParamStruct {
-    sl::POINT_CLOUD_FORMAT PC_Format;
-    sl::DEPTH_FORMAT Depth_Format;
-    sl::String saveName;
-    bool askSavePC;
-    bool askSaveDepth;
-    bool stop_signal;
-} SaveParam;
+using namespace std;
 
 sl::Camera *zed_ptr;
-SaveParam *param;
 
-std::string getFormatNamePC(sl::POINT_CLOUD_FORMAT f) {
+// Point cloud formats cycled by 'm': the SDK ASCII formats followed by our binary ones
+const int nb_formats_PC_SDK = 4;
+const int nb_formats_PC = nb_formats_PC_SDK + 2;
+
+std::string getFormatNamePC(int f) {
     std::string str_;
     switch (f) {
         case sl::POINT_CLOUD_FORMAT_XYZ_ASCII:
@@ -74,6 +73,12 @@ std::string getFormatNamePC(sl::POINT_CLOUD_FORMAT f) {
         case sl::POINT_CLOUD_FORMAT_VTK_ASCII:
             str_ = "VTK";
             break;
+        case nb_formats_PC_SDK + POINT_CLOUD_FILE_PLY_BINARY:
+            str_ = "PLY (binary)";
+            break;
+        case nb_formats_PC_SDK + POINT_CLOUD_FILE_PCD_BINARY:
+            str_ = "PCD (binary)";
+            break;
         default:
             break;
     }
@@ -122,30 +127,123 @@ void nix_exit_handler(int s) {
 }
 #endif
 
-// Save function called in a thread
+// Snapshot the current depth map into a pooled buffer and enqueue its saving
 
-void saveProcess() {
-    while (!param->stop_signal) {
+void requestSaveDepth(SaveQueue& queue, sl::DEPTH_FORMAT format, const std::string& name) {
+    float max_value = std::numeric_limits<unsigned short int>::max();
 
-        if (param->askSaveDepth) {
-            float max_value = std::numeric_limits<unsigned short int>::max();
-            float scale_factor = max_value / zed_ptr->getDepthMaxRangeValue();
+    SaveJob* job = queue.acquire();
+    job->kind = SaveJob::DEPTH;
+    job->depthFormat = format;
+    job->scaleFactor = max_value / zed_ptr->getDepthMaxRangeValue();
+    job->name = name;
+    zed_ptr->retrieveMeasure(job->data, sl::MEASURE_DEPTH);
 
-            std::cout << "Saving Depth Map " << param->saveName << " in " << getFormatNameD(param->Depth_Format) << " ..." << flush;
-            sl::saveDepthAs(*zed_ptr, param->Depth_Format, param->saveName, scale_factor);
-            std::cout << "done" << endl;
-            param->askSaveDepth = false;
-        }
+    if (queue.isVerbose())
+        std::cout << "Saving Depth Map " << name << " in " << getFormatNameD(format) << " ..." << endl;
+    queue.submit(job);
+}
+
+// Snapshot the current point cloud into a pooled buffer and enqueue its saving
+
+void requestSavePointCloud(SaveQueue& queue, int mode_PC, const std::string& name) {
+    SaveJob* job = queue.acquire();
+    job->kind = SaveJob::POINT_CLOUD;
+    job->pcBinary = mode_PC >= nb_formats_PC_SDK;
+    if (job->pcBinary)
+        job->pcBinaryFormat = static_cast<PointCloudFileFormat> (mode_PC - nb_formats_PC_SDK);
+    else
+        job->pcFormat = static_cast<sl::POINT_CLOUD_FORMAT> (mode_PC);
+    job->name = name;
+    zed_ptr->retrieveMeasure(job->data, sl::MEASURE_XYZRGBA);
+
+    if (queue.isVerbose())
+        std::cout << "Saving Point Cloud " << name << " in " << getFormatNamePC(mode_PC) << " ..." << endl;
+    queue.submit(job);
+}
+
+// Headless export parameters
+
+struct ExportParams {
+    int start;                      // First exported frame
+    int end;                        // Last exported frame, -1 : until the end of the SVO
+    int stride;                     // Export every Nth frame
+    bool depth;
+    bool pointCloud;
+    sl::DEPTH_FORMAT depthFormat;
+    int pcFormat;                   // Point cloud format index as cycled by 'm'
+    std::string path;
+};
+
+// Export the selected frames of one SVO without display. The SVO is grabbed as fast as
+// the SDK allows while the save queue writes the snapshots in parallel. A marker file is
+// written when the whole SVO is done, so an interrupted batch restarts with the first
+// unfinished file. Returns the number of exported frames, -1 if the SVO can't be opened
+// or a frame of the range can't be grabbed (no marker then, the file is exported again).
+
+int exportSVO(const std::string& svo, sl::InitParameters parameters, const ExportParams& ep, SaveQueue& queue) {
+    size_t slash = svo.find_last_of("/\\");
+    std::string stem = svo.substr(slash == std::string::npos ? 0 : slash + 1);
+    stem = stem.substr(0, stem.find_last_of('.'));
+
+    std::string doneMarker = ep.path + stem + ".export-done";
+    if (std::ifstream(doneMarker)) {
+        cout << "Skipping " << svo << " : already exported" << endl;
+        return 0;
+    }
+
+    sl::Camera zed;
+    parameters.svo_input_filename = svo.c_str();
+    parameters.svo_real_time_mode = false;
+    sl::ERROR_CODE err = zed.open(parameters);
+    if (err != sl::SUCCESS) {
+        cout << svo << " : " << toString(err).c_str() << endl;
+        return -1;
+    }
+    zed.setDepthMaxRangeValue(5000.f);
+    zed_ptr = &zed;
 
-        if (param->askSavePC) {
-            std::cout << "Saving Point Cloud " << param->saveName << " in " << getFormatNamePC(param->PC_Format) << " ..." << flush;
-            sl::savePointCloudAs(*zed_ptr, param->PC_Format, param->saveName, false);
-            std::cout << "done" << endl;
-            param->askSavePC = false;
+    int nbFrames = zed.getSVONumberOfFrames();
+    int last = (ep.end < 0) ? nbFrames - 1 : std::min(ep.end, nbFrames - 1);
+    int exported = 0;
+    int failedFrame = -1;
+    auto t0 = std::chrono::steady_clock::now();
+
+    for (int frame = ep.start; frame <= last; frame += ep.stride) {
+        // Seeking is only needed to skip frames, sequential grabbing is faster
+        if (frame == ep.start || ep.stride > 1)
+            zed.setSVOPosition(frame);
+        if (zed.grab(sl::SENSING_MODE_STANDARD) != sl::SUCCESS) {
+            failedFrame = frame;
+            break;
         }
 
-        sl::sleep_ms(1);
+        char num[16];
+        sprintf(num, "_%06d", frame);
+        if (ep.depth)
+            requestSaveDepth(queue, ep.depthFormat, ep.path + "Depth_" + stem + num);
+        if (ep.pointCloud)
+            requestSavePointCloud(queue, ep.pcFormat, ep.path + "PC_" + stem + num);
+        exported++;
+
+        if (exported % 100 == 0)
+            cout << stem << " : frame " << frame << " / " << last << "\r" << flush;
     }
+
+    // Snapshots are independent of the camera, but the marker must follow the last written file
+    queue.wait();
+    zed_ptr = nullptr;
+    zed.close();
+
+    if (failedFrame >= 0) {
+        cout << stem << " : cannot grab frame " << failedFrame << ", export incomplete (" << exported << " frames)" << endl;
+        return -1;
+    }
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    cout << stem << " : " << exported << " frames in " << secs << " s, " << (secs > 0 ? exported / secs : 0.) << " frames/s" << endl;
+    std::ofstream(doneMarker) << exported << endl;
+    return exported;
 }
 
 
@@ -183,6 +281,15 @@ int main(int argc, char **argv) {
         "{ m | mode      |   2                |Disparity Map mode, ENUM 1: PERFORMANCE  2: MEDIUM   3: QUALITY}"
         "{ p | path      |   ./               |Output path (can include output filename prefix)}"
         "{ d | device    |   -1               |CUDA device ID }"
+        "{ x | export    |   false            |Headless export of SVO frames (no display) }"
+        "{ l | list      |                    |Text file with SVO files to export, one per line }"
+        "{ s | start     |   0                |First frame to export }"
+        "{ e | end       |   -1               |Last frame to export, -1 : until the end }"
+        "{ t | stride    |   1                |Export every Nth frame }"
+        "{ w | what      |   dp               |Exported data, d : depth, p : point cloud }"
+        "{ n | dformat   |   0                |Exported depth format, ENUM 0: PNG  1: PFM  2: PGM }"
+        "{ c | pcformat  |   4                |Exported point cloud format, ENUM 0: XYZ  1: PCD  2: PLY  3: VTK  4: PLY binary  5: PCD binary }"
+        "{ g | metrics   |                    |Serve Prometheus metrics on this localhost port }"
     };
 
     cv::CommandLineParser parser(argc, argv, keys.c_str());
@@ -194,7 +301,16 @@ int main(int argc, char **argv) {
             "{resolution r|2|ZED Camera resolution, ENUM 0: HD2K   1: HD1080   2: HD720   3: VGA (ex : -r=1  or --resolution=1 for HD1080)}"
             "{mode m|2|Disparity Map mode, ENUM 1: PERFORMANCE  2: MEDIUM   3: QUALITY  (ex : -m=1  or --mode=1)}"
             "{path p|./|Output path (can include output filename prefix) (ex : -p=./../ or --path=./../)}"
-            "{device d|-1|CUDA device (ex : -d=0 or --device=0) }";
+            "{device d|-1|CUDA device (ex : -d=0 or --device=0) }"
+            "{export x||Headless export of SVO frames, no display (ex : -x -f=test.svo) }"
+            "{list l||Text file with SVO files to export, one per line (ex : --list=svos.txt) }"
+            "{start|0|First frame to export}"
+            "{end|-1|Last frame to export, -1 : until the end of the SVO}"
+            "{stride|1|Export every Nth frame}"
+            "{what|dp|Exported data, d : depth, p : point cloud (ex : --what=p)}"
+            "{dformat|0|Exported depth format, ENUM 0: PNG  1: PFM  2: PGM}"
+            "{pcformat|4|Exported point cloud format, ENUM 0: XYZ  1: PCD  2: PLY  3: VTK (ASCII)  4: PLY  5: PCD (binary)}"
+            "{metrics||Serve Prometheus metrics on this localhost port, see save-queue.hpp (ex : --metrics=9101)}";
 
     cv::CommandLineParser parser(argc, argv, keys);
     parser.about("Sample from ZED SDK" + std::string(sl::Camera::getSDKVersion())); //about is not available under OpenCV2.4
@@ -256,6 +372,9 @@ int main(int argc, char **argv) {
     depth_mode = static_cast<sl::DEPTH_MODE> (mode);
     string path = parser.get<std::string>("path");
     int device = parser.get<int>("device");
+    std::string metrics = parser.get<std::string>("metrics");
+    if (!metrics.empty() && !METRICS::Serve(metrics.c_str()))
+        cout << "Cannot serve metrics on " << metrics << endl;
 
 #ifndef _SL_JETSON_
     //this check is available on 3.1 but not on OpenCV4Tegra
@@ -276,6 +395,61 @@ int main(int argc, char **argv) {
     parameters.sdk_verbose = 1;
     parameters.sdk_gpu_id = device;
 
+#ifdef _SL_JETSON_
+    bool headless = parser.get<bool>("export");
+#else
+    bool headless = parser.has("export");
+#endif
+    if (headless) {
+        ExportParams ep;
+        ep.start = std::max(0, parser.get<int>("start"));
+        ep.end = parser.get<int>("end");
+        ep.stride = std::max(1, parser.get<int>("stride"));
+        std::string what = parser.get<std::string>("what");
+        ep.depth = what.find('d') != std::string::npos;
+        ep.pointCloud = what.find('p') != std::string::npos;
+        ep.depthFormat = static_cast<sl::DEPTH_FORMAT> (parser.get<int>("dformat") % 3);
+        ep.pcFormat = parser.get<int>("pcformat") % nb_formats_PC;
+        ep.path = path;
+
+        std::vector<std::string> svos;
+        if (!filename.empty())
+            svos.push_back(filename);
+        std::string list = parser.get<std::string>("list");
+        if (!list.empty()) {
+            std::ifstream in(list);
+            for (std::string line; std::getline(in, line); )
+                if (!line.empty() && line[0] != '#')
+                    svos.push_back(line);
+        }
+        if (svos.empty()) {
+            cout << "Headless export needs --filename or --list" << endl;
+            return 1;
+        }
+
+        parameters.sdk_verbose = 0;
+        int nb_workers = std::max(2, int(std::thread::hardware_concurrency()) / 2);
+        SaveQueue save_queue(nb_workers, 2 * nb_workers);
+        save_queue.setVerbose(false);
+
+        int total = 0, failed = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        for (auto& svo : svos) {
+            int n = exportSVO(svo, parameters, ep, save_queue);
+            if (n < 0)
+                failed++;
+            else
+                total += n;
+        }
+        save_queue.stop();
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        cout << "Exported " << total << " frames of " << svos.size() - failed << " SVO files in " << secs << " s, "
+             << (secs > 0 ? total / secs : 0.) << " frames/s" << (failed ? ", failed files: " + to_string(failed) : "") << endl;
+        save_queue.printStats();
+        return failed ? 1 : 0;
+    }
+
     sl::ERROR_CODE err = zed.open(parameters);
     cout << toString(err).c_str() << endl;
 
@@ -310,14 +484,11 @@ int main(int argc, char **argv) {
     int mode_PC = 0;
     int mode_Depth = 0;
 
-    param = new SaveParam();
-    param->askSavePC = false;
-    param->askSaveDepth = false;
-    param->stop_signal = false;
-    param->PC_Format = static_cast<sl::POINT_CLOUD_FORMAT> (mode_PC);
-    param->Depth_Format = static_cast<sl::DEPTH_FORMAT> (mode_Depth);
+    sl::DEPTH_FORMAT Depth_Format = static_cast<sl::DEPTH_FORMAT> (mode_Depth);
 
-    std::thread grab_thread(saveProcess);
+    // Writers run in parallel, leaving the rest of the cores to grabbing and depth computation
+    int nb_workers = std::max(2, int(std::thread::hardware_concurrency()) / 2);
+    SaveQueue save_queue(nb_workers, 2 * nb_workers);
 
     bool quit_ = false;
 
@@ -346,22 +517,19 @@ int main(int argc, char **argv) {
         switch (key) {
             case 'p':
             case 'P':
-                param->saveName = std::string(path + prefixPC + to_string(count)).c_str();
-                param->askSavePC = true;
+                requestSavePointCloud(save_queue, mode_PC % nb_formats_PC, path + prefixPC + to_string(count));
                 break;
 
             case 'd':
             case 'D':
-                param->saveName =  std::string(path + prefixDepth + to_string(count)).c_str();
-                param->askSaveDepth = true;
+                requestSaveDepth(save_queue, Depth_Format, path + prefixDepth + to_string(count));
                 break;
 
             case 'm': // point cloud format
             case 'M':
             {
                 mode_PC++;
-                param->PC_Format = static_cast<sl::POINT_CLOUD_FORMAT> (mode_PC % 4);
-                std::cout << "Format Point Cloud " << getFormatNamePC(param->PC_Format) << std::endl;
+                std::cout << "Format Point Cloud " << getFormatNamePC(mode_PC % nb_formats_PC) << std::endl;
             }
                 break;
 
@@ -369,8 +537,8 @@ int main(int argc, char **argv) {
             case 'N':
             {
                 mode_Depth++;
-                param->Depth_Format = static_cast<sl::DEPTH_FORMAT> (mode_Depth % 3);
-                std::cout << "Format Depth " << getFormatNameD(param->Depth_Format) << std::endl;
+                Depth_Format = static_cast<sl::DEPTH_FORMAT> (mode_Depth % 3);
+                std::cout << "Format Depth " << getFormatNameD(Depth_Format) << std::endl;
             }
                 break;
 
@@ -392,8 +560,9 @@ int main(int argc, char **argv) {
         count++;
     }
 
-    param->stop_signal = true;
-    grab_thread.join();
+    // Finish the pending saves before closing the camera
+    save_queue.stop();
+    save_queue.printStats();
 
     zed.close();
     return 0;
@@ -0,0 +1,217 @@
+// Quickest-Owl Ltd. TA Roofs / ZED samples
+// Binary point cloud writers (little-endian PLY and binary PCD), independent of the ZED SDK.
+//
+// The cloud is split into row bands which are serialized concurrently on the thread pool
+// (Playfile/threadpool.h) into 64-byte aligned buffers, optionally dropping invalid
+// points on the way. Bands are streamed
+// to the file in order with large unbuffered writes as soon as each one is ready, so
+// serialization of the next bands overlaps with the I/O of the previous ones. The
+// buffers belong to the writer object and are reused between calls.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "def.h"
+#include "threadpool.h"
+
+// A deprojected, organized cloud: 4 floats per point - X, Y, Z and the color packed
+// as 4 bytes R, G, B, A (the ZED MEASURE_XYZRGBA layout). Points with a non finite
+// Z are invalid.
+struct PointCloudView {
+    const float* data;
+    int width;
+    int height;
+    size_t stepFloats;          // Row step in floats (>= 4 * width)
+};
+
+enum PointCloudFileFormat {
+    POINT_CLOUD_FILE_PLY_BINARY,
+    POINT_CLOUD_FILE_PCD_BINARY
+};
+
+struct PointCloudWriteOptions {
+    bool skipInvalid = true;    // Drop points with a non finite Z; otherwise the cloud stays organized
+    bool withColor = true;
+    int nbands = 0;             // Number of row bands serialized in parallel, 0 - one per pool thread
+};
+
+class PointCloudWriter {
+public:
+    PointCloudWriter() {}
+    ~PointCloudWriter() {
+        for (auto& b : bands)
+            alignedFree(b.buf);
+    }
+
+    PointCloudWriter(const PointCloudWriter&) = delete;
+    PointCloudWriter& operator=(const PointCloudWriter&) = delete;
+
+    // Returns the number of written points, or -1 on I/O error
+    int64_t write(const std::string& filename, const PointCloudView& cloud, PointCloudFileFormat format, const PointCloudWriteOptions& opt = PointCloudWriteOptions()) {
+        int nbands = opt.nbands > 0 ? opt.nbands : THREADPOOL::Threads();
+        nbands = std::max(1, std::min(nbands, cloud.height));
+        size_t pointBytes = recordSize(format, opt.withColor);
+
+        if (int(bands.size()) < nbands)
+            bands.resize(nbands);
+
+        for (int b = 0; b < nbands; b++) {
+            Band& band = bands[b];
+            band.y0 = int(int64_t(cloud.height) * b / nbands);
+            band.y1 = int(int64_t(cloud.height) * (b + 1) / nbands);
+            reserve(band, size_t(band.y1 - band.y0) * cloud.width * pointBytes);
+        }
+
+        // Launch serialization of all bands; waiting for one runs the bands not started yet
+        ParallelJob done(nbands, [&](int b) { serialize(bands[b], cloud, format, opt); }, 0, TASK_EXPORT);
+
+        FILE* f = fopen(filename.c_str(), "wb");
+        if (!f) {
+            done.Wait();
+            return -1;
+        }
+        setvbuf(f, nullptr, _IONBF, 0);     // Bands are already large contiguous blocks
+
+        // The header needs the point count, so it waits for all bands when invalid points are skipped
+        int64_t npoints = 0;
+        if (opt.skipInvalid) {
+            for (int b = 0; b < nbands; b++) {
+                done.WaitItem(b);
+                npoints += bands[b].npoints;
+            }
+        } else {
+            npoints = int64_t(cloud.width) * cloud.height;
+        }
+
+        std::string header = format == POINT_CLOUD_FILE_PLY_BINARY
+                           ? plyHeader(npoints, opt.withColor)
+                           : pcdHeader(npoints, cloud, opt);
+        bool ok = fwrite(header.data(), 1, header.size(), f) == header.size();
+
+        // Stream bands in order as soon as each one is serialized
+        for (int b = 0; b < nbands; b++) {
+            done.WaitItem(b);
+            size_t bytes = size_t(bands[b].npoints) * pointBytes;
+            if (ok && bytes)
+                ok = fwrite(bands[b].buf, 1, bytes, f) == bytes;
+        }
+
+        ok = (fclose(f) == 0) && ok;
+        return ok ? npoints : -1;
+    }
+
+    static const char* formatName(PointCloudFileFormat format) {
+        return format == POINT_CLOUD_FILE_PLY_BINARY ? "PLY binary" : "PCD binary";
+    }
+
+    static const char* formatExtension(PointCloudFileFormat format) {
+        return format == POINT_CLOUD_FILE_PLY_BINARY ? ".ply" : ".pcd";
+    }
+
+private:
+    struct Band {
+        uint8_t* buf = nullptr;
+        size_t capacity = 0;
+        int y0 = 0, y1 = 0;
+        int64_t npoints = 0;
+    };
+
+    static size_t recordSize(PointCloudFileFormat format, bool withColor) {
+        if (!withColor)
+            return 3 * sizeof(float);
+        // PLY stores uchar red, green, blue; PCD stores rgb as one packed 4-byte field
+        return format == POINT_CLOUD_FILE_PLY_BINARY ? 3 * sizeof(float) + 3 : 4 * sizeof(float);
+    }
+
+    static void serialize(Band& band, const PointCloudView& cloud, PointCloudFileFormat format, const PointCloudWriteOptions& opt) {
+        uint8_t* out = band.buf;
+        bool ply = format == POINT_CLOUD_FILE_PLY_BINARY;
+
+        for (int y = band.y0; y < band.y1; y++) {
+            const float* p = cloud.data + y * cloud.stepFloats;
+            for (int x = 0; x < cloud.width; x++, p += 4) {
+                if (opt.skipInvalid && !std::isfinite(p[2]))
+                    continue;
+                memcpy(out, p, 3 * sizeof(float));
+                out += 3 * sizeof(float);
+                if (!opt.withColor)
+                    continue;
+
+                uint8_t rgba[4];
+                memcpy(rgba, &p[3], 4);
+                if (ply) {
+                    out[0] = rgba[0];
+                    out[1] = rgba[1];
+                    out[2] = rgba[2];
+                    out += 3;
+                } else {
+                    // PCL packs rgb as 0x00RRGGBB in a little-endian 32-bit word
+                    out[0] = rgba[2];
+                    out[1] = rgba[1];
+                    out[2] = rgba[0];
+                    out[3] = 0;
+                    out += 4;
+                }
+            }
+        }
+        band.npoints = int64_t(out - band.buf) / int64_t(recordSize(format, opt.withColor));
+    }
+
+    static std::string plyHeader(int64_t npoints, bool withColor) {
+        std::string h = "ply\nformat binary_little_endian 1.0\ncomment Quickest-Owl point cloud\n"
+                        "element vertex " + std::to_string(npoints) + "\n"
+                        "property float x\nproperty float y\nproperty float z\n";
+        if (withColor)
+            h += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+        return h + "end_header\n";
+    }
+
+    static std::string pcdHeader(int64_t npoints, const PointCloudView& cloud, const PointCloudWriteOptions& opt) {
+        std::string w = opt.skipInvalid ? std::to_string(npoints) : std::to_string(cloud.width);
+        std::string h = opt.skipInvalid ? "1" : std::to_string(cloud.height);
+        std::string s = "# .PCD v0.7 - Point Cloud Data file format\nVERSION 0.7\n";
+        s += opt.withColor ? "FIELDS x y z rgb\nSIZE 4 4 4 4\nTYPE F F F F\nCOUNT 1 1 1 1\n"
+                           : "FIELDS x y z\nSIZE 4 4 4\nTYPE F F F\nCOUNT 1 1 1\n";
+        s += "WIDTH " + w + "\nHEIGHT " + h + "\nVIEWPOINT 0 0 0 1 0 0 0\n";
+        s += "POINTS " + std::to_string(npoints) + "\nDATA binary\n";
+        return s;
+    }
+
+    static void reserve(Band& band, size_t bytes) {
+        if (bytes <= band.capacity)
+            return;
+        alignedFree(band.buf);
+        band.buf = static_cast<uint8_t*>(alignedAlloc(bytes));
+        band.capacity = band.buf ? bytes : 0;
+        if (!band.buf)
+            throw std::bad_alloc();
+    }
+
+    static void* alignedAlloc(size_t bytes) {
+#ifdef _WIN32
+        return _aligned_malloc(bytes, 64);
+#else
+        void* p = nullptr;
+        return posix_memalign(&p, 64, bytes) == 0 ? p : nullptr;
+#endif
+    }
+
+    static void alignedFree(void* p) {
+#ifdef _WIN32
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+
+    std::vector<Band> bands;
+};
@@ -0,0 +1,194 @@
+// Quickest-Owl Ltd. TA Roofs / ZED samples
+// Save queue for depth maps and point clouds.
+//
+// A keypress snapshots the current depth or point cloud into a pooled sl::Mat and
+// enqueues a job, so the file always matches the frame that was on screen. Up to
+// nworkers export tasks of the thread pool (Playfile/threadpool.h) encode and write
+// jobs concurrently; a task drains the queue and ends when it is empty, so nothing
+// occupies the pool between saves. When all pooled buffers are in flight the
+// producer waits for one to be released, so no request is ever dropped.
+// The queue depth, the saves and their latencies are exposed as metrics (Playfile/metrics.h).
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sl/Camera.hpp>
+
+#include "def.h"
+#include "metrics.h"
+#include "threadpool.h"
+
+#include "pointcloud-writer.hpp"
+
+struct SaveJob {
+    enum Kind { DEPTH, POINT_CLOUD };
+
+    Kind kind;
+    sl::Mat data;                           // Pooled snapshot buffer, reused between jobs
+    sl::DEPTH_FORMAT depthFormat;
+    sl::POINT_CLOUD_FORMAT pcFormat;
+    bool pcBinary;                          // Point cloud only: use our binary writer with pcBinaryFormat instead of pcFormat
+    PointCloudFileFormat pcBinaryFormat;
+    float scaleFactor;                      // Depth only: metric value to 16-bit scale
+    std::string name;
+    std::chrono::steady_clock::time_point enqueued;
+};
+
+class SaveQueue {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    SaveQueue(int nworkers, int poolSize) : nworkers(nworkers) {
+        for (int i = 0; i < poolSize; i++) {
+            pool.emplace_back(new SaveJob());
+            freeJobs.push_back(pool.back().get());
+        }
+        // A task runs on one pool worker at a time, so each one keeps a writer
+        for (int i = 0; i < THREADPOOL::Threads(); i++)
+            pcWriters.emplace_back(new PointCloudWriter());
+    }
+
+    ~SaveQueue() {
+        stop();
+    }
+
+    // Get a free pooled job to snapshot into; waits while all buffers are in flight
+    SaveJob* acquire() {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (freeJobs.empty())
+            std::cout << "Save queue is full, waiting for a free buffer..." << std::endl;
+        freeCond.wait(lock, [this] { return !freeJobs.empty(); });
+        SaveJob* job = freeJobs.back();
+        freeJobs.pop_back();
+        return job;
+    }
+
+    void submit(SaveJob* job) {
+        job->enqueued = clock::now();
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!nsubmitted++)
+            firstSubmit = job->enqueued;
+        jobs.push_back(job);
+        if (running < nworkers) {
+            running++;
+            THREADPOOL::Submit([this] { saveProcess(); }, TASK_EXPORT);
+        }
+    }
+
+    // Wait until every submitted job is written
+    void wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        freeCond.wait(lock, [this] { return freeJobs.size() == pool.size(); });
+    }
+
+    // Per-save console messages, on by default
+    void setVerbose(bool on) { verbose = on; }
+    bool isVerbose() const { return verbose; }
+
+    // Write all pending jobs and wait for the tasks to end
+    void stop() {
+        std::unique_lock<std::mutex> lock(mtx);
+        freeCond.wait(lock, [this] { return running == 0; });
+    }
+
+    void printStats() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!nsaved) {
+            std::cout << "No saves" << std::endl;
+            return;
+        }
+        double span = std::chrono::duration<double>(lastDone - firstSubmit).count();
+        std::cout << "Saves: " << nsaved
+                  << ", " << (span > 0 ? nsaved / span : 0.) << " saves/sec"
+                  << ", queue latency avg " << totalQueueMs / nsaved << " ms, max " << maxQueueMs << " ms"
+                  << ", write avg " << totalWriteMs / nsaved << " ms" << std::endl;
+    }
+
+private:
+    void saveProcess() {
+        PointCloudWriter& pcWriter = *pcWriters[THREADPOOL::WorkerIndex()];    // Keeps its band buffers between jobs
+        PointCloudWriteOptions pcOptions;
+        pcOptions.nbands = std::max(1, THREADPOOL::Threads() / nworkers);
+
+        for (;;) {
+            SaveJob* job;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (jobs.empty()) {
+                    running--;
+                    freeCond.notify_all();      // Wakes stop()
+                    return;
+                }
+                job = jobs.front();
+                jobs.pop_front();
+            }
+
+            auto started = clock::now();
+            if (job->kind == SaveJob::DEPTH)
+                sl::saveDepthAs(job->data, job->depthFormat, job->name.c_str(), job->scaleFactor);
+            else if (!job->pcBinary)
+                sl::savePointCloudAs(job->data, job->pcFormat, job->name.c_str(), false);
+            else {
+                PointCloudView cloud = { job->data.getPtr<float>(sl::MEM_CPU), int(job->data.getWidth()), int(job->data.getHeight()),
+                                         job->data.getStepBytes(sl::MEM_CPU) / sizeof(float) };
+                job->name += PointCloudWriter::formatExtension(job->pcBinaryFormat);
+                if (pcWriter.write(job->name, cloud, job->pcBinaryFormat, pcOptions) < 0)
+                    std::cout << "Error writing " << job->name << std::endl;
+            }
+            auto done = clock::now();
+
+            double queueMs = std::chrono::duration<double, std::milli>(started - job->enqueued).count();
+            double writeMs = std::chrono::duration<double, std::milli>(done - started).count();
+            savesTotal.Inc();
+            queueSeconds.Observe(queueMs / 1000);
+            writeSeconds.Observe(writeMs / 1000);
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (verbose)
+                    std::cout << "Saved " << job->name << " (queued " << queueMs << " ms, written in " << writeMs << " ms)" << std::endl;
+                nsaved++;
+                totalQueueMs += queueMs;
+                totalWriteMs += writeMs;
+                if (queueMs > maxQueueMs)
+                    maxQueueMs = queueMs;
+                lastDone = done;
+                freeJobs.push_back(job);
+            }
+            freeCond.notify_all();      // Wakes acquire(), wait() and stop()
+        }
+    }
+
+    std::mutex mtx;                             // Protects everything below
+    std::condition_variable freeCond;           // Signalled when a pooled buffer is released or a task ends
+    std::deque<SaveJob*> jobs;
+    std::vector<SaveJob*> freeJobs;
+    std::vector<std::unique_ptr<SaveJob>> pool;
+    std::vector<std::unique_ptr<PointCloudWriter>> pcWriters;  // One per pool worker
+    const int nworkers;                         // Save tasks running at most
+    int running = 0;
+    bool verbose = true;
+
+    int nsubmitted = 0;
+    int nsaved = 0;
+    double totalQueueMs = 0;
+    double totalWriteMs = 0;
+    double maxQueueMs = 0;
+    clock::time_point firstSubmit;
+    clock::time_point lastDone;
+
+    MetricCounter savesTotal{ "zed_saves_total", "Depth maps and point clouds written" };
+    MetricGauge queueDepth{ "zed_save_queue_depth", "Save jobs waiting for a worker", nullptr, [this] { std::lock_guard<std::mutex> lock(mtx); return double(jobs.size()); } };
+    MetricHistogram queueSeconds{ "zed_save_seconds", "Save latency by stage", "stage=\"queue\"", { 0.001, 0.01, 0.05, 0.1, 0.2, 0.5, 1, 2, 5, 10 } };
+    MetricHistogram writeSeconds{ "zed_save_seconds", "Save latency by stage", "stage=\"write\"", { 0.001, 0.01, 0.05, 0.1, 0.2, 0.5, 1, 2, 5, 10 } };
+};
@@ -29,6 +29,7 @@
 // Sample includes
 #include <opencv2/opencv.hpp>
 #include "utils.hpp"
+#include "playback.hpp"
 
 // Using namespace
 using namespace sl;
@@ -60,55 +61,92 @@ int main(int argc, char **argv) {
     // Define OpenCV window size
     int width = 720;
     int height = 404;
-    Mat svo_image(width * 2, height, MAT_TYPE_8U_C4, MEM_CPU);
-    cv::Mat svo_image_ocv = slMat2cvMat(svo_image);
 
     // Setup key, images, times
     char key = ' ';
     cout << " Press 's' to save SVO image as a PNG" << endl;
     cout << " Press 'f' to jump forward in the video" << endl;
     cout << " Press 'b' to jump backward in the video" << endl;
+    cout << " Press '+' / '-' to change the playback speed (0.25x to 16x)" << endl;
+    cout << " Press 'u' to toggle unthrottled playback" << endl;
+    cout << " Press 'r' to toggle reverse playback" << endl;
+    cout << " Press ',' / '.' to step one frame backward / forward" << endl;
+    cout << " Press ' ' to pause" << endl;
     cout << " Press 'q' to exit..." << endl;
 
     int svo_frame_rate = int(zed.getCameraFPS());
     int nb_frames = zed.getSVONumberOfFrames();
 
+    // Frames are decoded ahead by the playback thread and presented at their recorded timestamps
+    SvoPlayback playback(zed, width, height);
+    playback.start();
+    PlaybackFrame* shown = nullptr;
+
     // Start SVO playback
     while (key != 'q') {
-        if (zed.grab() == SUCCESS) {
-
-            // Get the side by side image
-            zed.retrieveImage(svo_image, VIEW_SIDE_BY_SIDE, MEM_CPU, width, height);
-
-            // Display the frame
-            cv::imshow("View", svo_image_ocv);
-
-            key = cv::waitKey(15);
-
-            int svo_position = zed.getSVOPosition();
-
-            switch (key) {
-                case 's':
-                svo_image.write(("capture_" + to_string(svo_position) + ".png").c_str());
-                break;
-                case 'f':
-                zed.setSVOPosition(svo_position + svo_frame_rate);
-                break;
-                case 'b':
-                zed.setSVOPosition(svo_position - svo_frame_rate);
-                break;
-            }
+        PlaybackFrame* frame = playback.next(std::chrono::milliseconds(10));
+        if (frame) {
+            shown = frame;
+
+            // Display the frame, proxies are shown enlarged until the full frame is decoded
+            if (frame->proxy) {
+                cv::Mat view;
+                cv::resize(frame->image, view, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+                cv::imshow("View", view);
+            } else
+                cv::imshow("View", frame->image);
+            ProgressBar((float) (frame->position / (float) nb_frames), 30);
+        }
 
-            // Check if we have reached the end of the video
-            if (svo_position >= (nb_frames - 1)) { // End of SVO
-                cout << "\nSVO end has been reached. Exiting now.\n";
-                break;
-            }
+        key = cv::waitKey(1);
+
+        switch (key) {
+            case 's':
+            if (shown && !shown->proxy)
+                cv::imwrite("capture_" + to_string(shown->position) + ".png", shown->image);
+            break;
+            case 'f':
+            playback.seekRelative(svo_frame_rate);
+            break;
+            case 'b':
+            playback.seekRelative(-svo_frame_rate);
+            break;
+            case '+':
+            playback.setSpeed(playback.getSpeed() * 2);
+            cout << "\nSpeed " << playback.getSpeed() << "x" << endl;
+            break;
+            case '-':
+            playback.setSpeed(playback.getSpeed() / 2);
+            cout << "\nSpeed " << playback.getSpeed() << "x" << endl;
+            break;
+            case 'u':
+            playback.setUnthrottled(!playback.isUnthrottled());
+            cout << "\nUnthrottled " << (playback.isUnthrottled() ? "on" : "off") << endl;
+            break;
+            case ' ':
+            playback.setPaused(!playback.isPaused());
+            break;
+            case 'r':
+            playback.setDirection(-playback.getDirection());
+            cout << "\n" << (playback.getDirection() > 0 ? "Forward" : "Reverse") << endl;
+            break;
+            case ',':
+            playback.step(-1);
+            break;
+            case '.':
+            playback.step(1);
+            break;
+        }
 
-            ProgressBar((float) (svo_position / (float) nb_frames), 30);
+        // Check if we have reached the end of the video
+        if (playback.finished()) { // End of SVO
+            cout << "\nSVO end has been reached. Exiting now.\n";
+            break;
         }
     }
 
+    playback.stop();
+    playback.printStats();
     zed.close();
     return 0;
 }
@@ -0,0 +1,374 @@
+// Quickest-Owl Ltd. TA Roofs / ZED samples
+// SVO playback engine.
+//
+// A read-ahead thread fetches SVO frames into a small ring of images while the UI
+// thread presents them at their recorded timestamps, scaled by a speed factor (or as
+// fast as they decode in unthrottled mode), forward or backward. Seeking is only a
+// request: the read-ahead thread repositions while the UI keeps showing the last frame
+// and handling keys. Frames presented later than a tolerance after their due time are
+// counted, so the report tells whether decoding keeps up with the requested speed.
+//
+// Frames come from the player's FrameCache (Playfile/framecache.h), whose thread is
+// the only one using the camera. Recently viewed frames are served without decoding,
+// and after a jump a cached proxy is shown at once while the full frame decodes.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sl_zed/Camera.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "def.h"
+#include "framecache.h"
+
+struct PlaybackFrame {
+    cv::Mat image;                          // Side by side view at the display size, shared with the cache
+    bool proxy = false;                     // Downscaled preview, the full frame follows
+    int position = -1;                      // SVO frame number
+    unsigned long long timestamp = 0;       // Recorded image timestamp, ns
+};
+
+class SvoPlayback {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    static constexpr double minSpeed = 0.25;
+    static constexpr double maxSpeed = 16.;
+
+    // The camera must have an SVO opened; from now on it is used by the cache thread only, until stop()
+    SvoPlayback(sl::Camera& zed, int width, int height, const FrameCache::Params& cacheParams = FrameCache::Params(), int ringSize = 6)
+        : zed(zed), width(width), height(height),
+          cache([this](int64 n, CachedFrame& out) { return decodeFrame(n, out); }, zed.getSVONumberOfFrames(), cacheParams) {
+        nbFrames = zed.getSVONumberOfFrames();
+        float fps = zed.getCameraFPS();
+        lateTolerance = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(0.5 / (fps > 0 ? fps : 30.f)));
+        for (int i = 0; i < ringSize; i++) {
+            slots.emplace_back(new PlaybackFrame());
+            freeSlots.push_back(slots.back().get());
+        }
+    }
+
+    ~SvoPlayback() {
+        stop();
+    }
+
+    void start() {
+        decoder = std::thread(&SvoPlayback::decodeProcess, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+        }
+        decodeCond.notify_all();
+        if (decoder.joinable())
+            decoder.join();
+        cache.Stop();                               // The camera is used by the cache thread until then
+    }
+
+    // Returns the next frame once it is due, or nullptr if none became due within maxWait.
+    // The returned frame stays valid until the next non null return.
+    PlaybackFrame* next(std::chrono::milliseconds maxWait) {
+        std::unique_lock<std::mutex> lock(mtx);
+        auto deadline = clock::now() + maxWait;
+
+        for (;;) {
+            if (ready.empty() || (paused && !stepOne)) {
+                if (presentCond.wait_until(lock, deadline) == std::cv_status::timeout)
+                    return nullptr;
+                continue;
+            }
+
+            PlaybackFrame* frame = ready.front();
+            auto now = clock::now();
+            if (!unthrottled) {
+                if (reanchor) {
+                    anchorWall = now;
+                    anchorTimestamp = frame->timestamp;
+                    reanchor = false;
+                }
+                auto media = std::chrono::nanoseconds(int64_t(frame->timestamp - anchorTimestamp) * direction);
+                auto due = anchorWall + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::nano>(media.count() / speed));
+                if (now < due) {
+                    if (deadline <= now)
+                        return nullptr;
+                    presentCond.wait_until(lock, std::min(due, deadline));
+                    continue;       // The ring may have been flushed or the speed changed meanwhile
+                }
+                auto late = now - due;
+                if (late > lateTolerance) {
+                    nlate++;
+                    maxLate = std::max(maxLate, late);
+                    // After a decode stall keep the recorded pace instead of rushing to catch up
+                    if (late > std::chrono::seconds(1))
+                        reanchor = true;
+                }
+            }
+
+            ready.pop_front();
+            if (current)
+                freeSlots.push_back(current);
+            current = frame;
+            if (!frame->proxy)
+                stepOne = false;        // A step ends on the full frame
+            npresented++;
+            lock.unlock();
+            decodeCond.notify_one();
+            return frame;
+        }
+    }
+
+    // Jump to an absolute frame; pending decoded frames are dropped, the displayed one is kept
+    void seek(int position) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            requestSeek(position);
+        }
+        decodeCond.notify_one();
+        presentCond.notify_all();
+    }
+
+    // Jump relative to the last requested position, so repeated presses accumulate without waiting for the decoder
+    void seekRelative(int delta) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            int from = seekPending ? seekPosition : (current ? current->position : 0);
+            requestSeek(from + delta);
+        }
+        decodeCond.notify_one();
+        presentCond.notify_all();
+    }
+
+    // Pause and show the frame delta frames away
+    void step(int delta) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            int from = seekPending ? seekPosition : (current ? current->position : 0);
+            paused = true;
+            stepOne = true;
+            requestSeek(from + delta);
+        }
+        decodeCond.notify_one();
+        presentCond.notify_all();
+    }
+
+    // 1 forward, -1 backward; playback continues from the displayed frame
+    void setDirection(int dir) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (dir == direction)
+                return;
+            direction = dir;
+            requestSeek(current ? current->position + dir : 0);
+        }
+        decodeCond.notify_one();
+        presentCond.notify_all();
+    }
+
+    int getDirection() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return direction;
+    }
+
+    void setSpeed(double s) {
+        std::lock_guard<std::mutex> lock(mtx);
+        speed = std::max(double(minSpeed), std::min(double(maxSpeed), s));
+        reanchor = true;
+    }
+
+    double getSpeed() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return speed;
+    }
+
+    // Present frames as soon as they are decoded, ignoring timestamps
+    void setUnthrottled(bool on) {
+        std::lock_guard<std::mutex> lock(mtx);
+        unthrottled = on;
+        reanchor = true;
+    }
+
+    bool isUnthrottled() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return unthrottled;
+    }
+
+    void setPaused(bool on) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            paused = on;
+            reanchor = true;
+        }
+        presentCond.notify_all();
+    }
+
+    bool isPaused() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return paused;
+    }
+
+    // The end of the SVO was reached in forward direction and every frame was presented
+    bool finished() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return eof && direction > 0 && ready.empty() && !seekPending;
+    }
+
+    int getNbFrames() const { return nbFrames; }
+
+    void printStats() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            std::cout << "Presented " << npresented << " frames, late " << nlate
+                      << " (max " << std::chrono::duration<double, std::milli>(maxLate).count() << " ms)"
+                      << ", decode avg " << (ndecoded ? totalDecodeMs / ndecoded : 0.) << " ms" << std::endl;
+        }
+        cache.PrintStats();
+    }
+
+private:
+    // Called with mtx held
+    void requestSeek(int position) {
+        seekPosition = std::max(0, std::min(position, nbFrames - 1));
+        seekPending = true;
+        generation++;
+        for (auto f : ready)
+            freeSlots.push_back(f);
+        ready.clear();
+        eof = false;
+        reanchor = true;
+    }
+
+    // Cache thread: the only user of the camera
+    bool decodeFrame(int64 n, CachedFrame& out) {
+        if (n != svoPosition + 1)
+            zed.setSVOPosition(int(n));
+        auto started = clock::now();
+        if (zed.grab() != sl::SUCCESS) {
+            svoPosition = -2;
+            return false;
+        }
+        svoPosition = n;
+        zed.retrieveImage(decodeImage, sl::VIEW_SIDE_BY_SIDE, sl::MEM_CPU, width, height);
+        out.Image = cv::Mat(int(decodeImage.getHeight()), int(decodeImage.getWidth()), CV_8UC4,
+                            decodeImage.getPtr<sl::uchar1>(sl::MEM_CPU), decodeImage.getStepBytes(sl::MEM_CPU)).clone();
+        out.Timestamp = zed.getTimestamp(sl::TIME_REFERENCE_IMAGE);
+        double decodeMs = std::chrono::duration<double, std::milli>(clock::now() - started).count();
+
+        std::lock_guard<std::mutex> lock(mtx);
+        ndecoded++;
+        totalDecodeMs += decodeMs;
+        return true;
+    }
+
+    // Read-ahead thread: fills the ring in presentation order
+    void decodeProcess() {
+        int position = 0;
+        for (;;) {
+            PlaybackFrame* slot;
+            bool seeked;
+            int gen, dir;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                decodeCond.wait(lock, [this] { return stopping || seekPending || (!eof && !freeSlots.empty()); });
+                if (stopping)
+                    return;
+                if (freeSlots.empty())
+                    continue;       // Seek requested while the ring is full, wait for the UI to release a slot
+                seeked = seekPending;
+                if (seeked)
+                    position = seekPosition;
+                seekPending = false;
+                gen = generation;
+                dir = direction;
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+
+            cache.SetPlayhead(position, dir);
+
+            // Right after a jump a cached proxy is shown at once, the full frame follows
+            CachedFrame f;
+            bool ok = seeked && cache.Peek(position, f) && f.Proxy;
+            bool proxy = ok;
+            while (!ok) {
+                ok = cache.Get(position, f, 50);
+                if (ok || cache.IsMissing(position))
+                    break;
+                std::lock_guard<std::mutex> lock(mtx);
+                if (stopping || gen != generation)
+                    break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!ok || gen != generation) {
+                    freeSlots.push_back(slot);      // No such frame or fetched before a newer seek
+                } else {
+                    slot->image = f.Image;
+                    slot->proxy = proxy;
+                    slot->position = position;
+                    slot->timestamp = f.Timestamp;
+                    ready.push_back(slot);
+                }
+                if (gen == generation && !proxy) {
+                    if (!ok || (dir > 0 && position >= nbFrames - 1) || (dir < 0 && position <= 0))
+                        eof = true;
+                    else
+                        position += dir;
+                }
+            }
+            presentCond.notify_all();
+        }
+    }
+
+    sl::Camera& zed;
+    const int width;
+    const int height;
+    int nbFrames;
+    sl::Mat decodeImage;                            // Cache thread only
+    int64 svoPosition = -2;                         // Last grabbed frame, cache thread only
+    clock::duration lateTolerance;
+    std::thread decoder;
+
+    std::mutex mtx;                                 // Protects everything below
+    std::condition_variable decodeCond;             // Free slot, seek request or stop
+    std::condition_variable presentCond;            // New decoded frame or playback state change
+    std::vector<std::unique_ptr<PlaybackFrame>> slots;
+    std::vector<PlaybackFrame*> freeSlots;
+    std::deque<PlaybackFrame*> ready;               // Decoded, in presentation order
+    PlaybackFrame* current = nullptr;               // Displayed by the UI
+
+    bool stopping = false;
+    bool eof = false;
+    bool seekPending = false;
+    int seekPosition = 0;
+    int generation = 0;
+
+    double speed = 1.;
+    bool unthrottled = false;
+    bool paused = false;
+    bool stepOne = false;                           // Present frames while paused until the stepped one is shown
+    int direction = 1;
+    bool reanchor = true;
+    clock::time_point anchorWall;
+    unsigned long long anchorTimestamp = 0;
+
+    int npresented = 0;
+    int nlate = 0;
+    clock::duration maxLate = clock::duration::zero();
+    int ndecoded = 0;
+    double totalDecodeMs = 0;
+
+    FrameCache cache;                               // Last member: its thread is stopped first
+};